@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""
+Integration tests for Rust and Go compiles waiting on heavy job slots.
+
+These tests verify that:
+- A compile gives up once the caller's wait time passes with every slot held
+- The error says how many heavy jobs it was queued behind
+- The abandoned request leaves the queue, so later jobs are not held up
+"""
+
+import os
+import sys
+import time
+import shutil
+import asyncio
+import tempfile
+import unittest
+from pathlib import Path
+from unittest import mock
+
+# Add the source directory to the path so we can import the server module
+sys.path.insert(0, str(Path(__file__).parent.parent / "src"))
+
+import exec as exec_server
+
+
+class TestCompileQueue(unittest.TestCase):
+    """Compile a script while long-lived heavy sessions hold both slots."""
+
+    def setUp(self):
+        """Point the binary cache at a scratch directory so nothing is cached."""
+        self.test_dir = tempfile.mkdtemp(prefix="mcp_exec_compile_test_")
+        self.patches = [
+            mock.patch.object(exec_server, "SCRIPT_BUILD_DIR", self.test_dir),
+            mock.patch.object(exec_server, "heavy_jobs", exec_server.JobScheduler(2, "fifo")),
+        ]
+        for patch in self.patches:
+            patch.start()
+
+    def tearDown(self):
+        """Restore the scheduler and clean up."""
+        for patch in self.patches:
+            patch.stop()
+        shutil.rmtree(self.test_dir)
+
+    def test_compile_times_out_behind_held_slots(self):
+        """execute_script returns once wait_time passes instead of blocking."""
+
+        async def run():
+            held = [exec_server.heavy_jobs.request() for _ in range(2)]
+            self.assertTrue(all(slot.done() for slot in held))
+            started = time.monotonic()
+            result = await exec_server.execute_script(
+                "package main\nfunc main() {}\n", "go", wait_time=0.3
+            )
+            elapsed = time.monotonic() - started
+            queued = exec_server.heavy_jobs.queued
+            for slot in held:
+                exec_server.heavy_jobs.release(slot)
+            return result, elapsed, queued
+
+        result, elapsed, queued = asyncio.run(run())
+        self.assertIn("queued behind 2 heavy jobs", result)
+        self.assertLess(elapsed, 5)
+        self.assertEqual(queued, 0)
+        self.assertEqual(exec_server.heavy_jobs.running, 0)
+        self.assertEqual(os.listdir(os.path.join(self.test_dir, "bin")), [])  # Nothing built
+
+
+if __name__ == "__main__":
+    unittest.main()
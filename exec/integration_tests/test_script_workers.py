@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+"""
+Integration tests for the warm interpreter workers behind execute_script.
+
+These tests verify that:
+- A script guarded by `if __name__ == "__main__"` runs in the Python worker
+- A script guarded by `if (require.main === module)` runs in the Node worker
+- Errors exit non-zero as they would with a plain interpreter
+"""
+
+import os
+import sys
+import json
+import shutil
+import tempfile
+import unittest
+import subprocess
+from pathlib import Path
+
+# Add the source directory to the path so we can import the server module
+sys.path.insert(0, str(Path(__file__).parent.parent / "src"))
+
+import exec as exec_server
+
+
+class TestScriptWorkers(unittest.TestCase):
+    """Run scripts through the worker programs as InterpreterPool does."""
+
+    def setUp(self):
+        """Create a scratch directory."""
+        self.test_dir = tempfile.mkdtemp(prefix="mcp_exec_worker_test_")
+
+    def tearDown(self):
+        """Clean up the scratch directory."""
+        shutil.rmtree(self.test_dir)
+
+    def _run(self, language: str, filename: str, source: str) -> subprocess.CompletedProcess:
+        interpreter, flag, program = exec_server.SCRIPT_WORKERS[language]
+        if not shutil.which(interpreter):
+            self.skipTest(f"{interpreter} is not installed")
+        path = os.path.join(self.test_dir, filename)
+        with open(path, "w") as f:
+            f.write(source)
+        return subprocess.run(
+            [interpreter, flag, program, ""],
+            input=json.dumps({"path": path, "cwd": self.test_dir}),
+            capture_output=True,
+            text=True,
+            timeout=30,
+        )
+
+    def test_python_main_guard(self):
+        """The Python worker runs the script as __main__."""
+        result = self._run(
+            "python", "guard.py", 'if __name__ == "__main__":\n    print("main ran")\n'
+        )
+        self.assertEqual(result.returncode, 0, result.stderr)
+        self.assertEqual(result.stdout, "main ran\n")
+
+    def test_node_require_main_guard(self):
+        """The Node worker loads the script as the entry module."""
+        result = self._run(
+            "node",
+            "guard.js",
+            "function main() { console.log('main ran', process.argv.length); }\n"
+            "if (require.main === module) main();\n",
+        )
+        self.assertEqual(result.returncode, 0, result.stderr)
+        self.assertEqual(result.stdout, "main ran 2\n")
+
+    def test_node_error_exits_nonzero(self):
+        """An uncaught error fails the worker like `node script.js`."""
+        result = self._run("node", "bad.js", "throw new Error('boom');\n")
+        self.assertNotEqual(result.returncode, 0)
+        self.assertIn("boom", result.stderr)
+
+
+if __name__ == "__main__":
+    unittest.main()
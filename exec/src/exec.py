@@ -4,15 +4,24 @@ import subprocess
 import tempfile
 import time
 import asyncio
+import signal
+import threading
 import psutil
 import shutil
+import json
+import shlex
+import hashlib
+import heapq
+import itertools
 from datetime import datetime
-from dataclasses import dataclass
+from dataclasses import dataclass, field
 from enum import Enum
-from typing import List, Dict, Any, Union, Set, Optional
+from typing import List, Dict, Any, Union, Set, Optional, Tuple
 
 from mcp.server.fastmcp import FastMCP
 
+from mcp_trace import instrument, render_prometheus, span, start_metrics_server, traced
+
 MCP_INSTRUCTIONS = """
 The Exec MCP Server is a powerful execution environment that allows AI assistants like Claude to run commands, scripts, and tests. The mounted filesystem is shared with the Filesystem MCP Server.
 
@@ -22,12 +31,15 @@ Key capabilities:
 
 1. Command & Script Execution:
    - `execute_command`: Run shell commands asynchronously with configurable wait time. The process doesn't terminate after wait time, but is run in a session pool that can be accessed later. You can simultaneously execute multiple commands in a fork-join pattern 
+     Heavy commands (builds, package installs) run a few at a time; extra ones are queued by `priority` and return a session ID to poll with `read_output`
    - `execute_script`: Run multi-line code in Python, JavaScript, Rust, Go, or Bash asynchronously
    - `run_command_sync`: Run shell commands synchronously with configurable wait time. Use this for commands that interfere with async I/O, such as `npm test`
    
 2. Process Management:
    - `list_sessions`: View all active command sessions
-   - `read_output`: Read output from a running session
+   - `get_metrics`: Per-program totals of CPU time, max RSS, disk I/O and output bytes for finished sessions
+   - `get_server_stats`: Per-tool latency (p50/p99) broken down by phase (queue wait, spawn, subprocess, compile)
+   - `read_output`: Read new output from a running session. Each call returns only output since the last read, up to `max_bytes` per stream; pass `since_offset` to re-read from an earlier byte offset, or `wait_for_bytes` to wait for new output instead of polling
    - `force_terminate`: Kill a specific running session
    - `list_processes`: List all running system processes by PID
    - `kill_process`: Terminate a process by its PID
@@ -50,10 +62,81 @@ For optimal usage:
 
 # Create MCP server
 mcp = FastMCP("command-execution-server", instructions=MCP_INSTRUCTIONS)
+instrument(mcp, "exec")
 
 # Default timeout for commands (in seconds)
 DEFAULT_TIMEOUT = 30
 
+# Bytes of output each session keeps in memory per stream
+OUTPUT_BUFFER_BYTES = int(os.environ.get("MCP_EXEC_OUTPUT_BUFFER_BYTES", str(1024 * 1024)))
+# Bytes per stream moved to a temp file once they leave memory (0 drops them instead)
+OUTPUT_SPILL_BYTES = int(
+    os.environ.get("MCP_EXEC_OUTPUT_SPILL_BYTES", str(256 * 1024 * 1024))
+)
+# Bytes per stream returned by one execute_command or read_output call
+DEFAULT_MAX_OUTPUT_BYTES = 256 * 1024
+# Bytes read from a pipe at a time
+READ_CHUNK_BYTES = 64 * 1024
+
+# Warm interpreters execute_script keeps ready per language (0 starts one per script)
+SCRIPT_POOL_SIZE = int(os.environ.get("MCP_EXEC_SCRIPT_POOL_SIZE", "1"))
+# Comma-separated modules a warm interpreter imports before it is handed a script
+SCRIPT_PRELOAD = {
+    "python": os.environ.get("MCP_EXEC_PYTHON_PRELOAD", ""),
+    "node": os.environ.get("MCP_EXEC_NODE_PRELOAD", ""),
+}
+# Seconds a warm interpreter waits before it is replaced, so it sees newly installed packages
+SCRIPT_WORKER_MAX_AGE = 600
+
+# Persistent build workspace for Rust and Go scripts: cargo target dir, Go cache and binaries
+SCRIPT_BUILD_DIR = os.environ.get(
+    "MCP_EXEC_BUILD_DIR", os.path.join(tempfile.gettempdir(), "mcp-exec-build")
+)
+# Compiled script binaries kept, least recently used evicted first
+COMPILE_CACHE_ENTRIES = int(os.environ.get("MCP_EXEC_COMPILE_CACHE_ENTRIES", "64"))
+# Seconds allowed for compiling a Rust or Go script
+COMPILE_TIMEOUT = 60
+
+# Port for a Prometheus /metrics HTTP endpoint (unset: only the get_metrics tool)
+METRICS_PORT = os.environ.get("MCP_EXEC_METRICS_PORT")
+
+# Heavy sessions (builds, installs) allowed to run at once; more wait in a queue (0: no limit)
+MAX_HEAVY_JOBS = int(os.environ.get("MCP_EXEC_MAX_HEAVY_JOBS", "2"))
+# "priority" starts the queued job with the highest priority first, "fifo" the oldest
+SCHEDULER_POLICY = os.environ.get("MCP_EXEC_SCHEDULER", "priority").lower()
+# Programs whose commands count as heavy
+HEAVY_COMMANDS = set(
+    filter(
+        None,
+        os.environ.get(
+            "MCP_EXEC_HEAVY_COMMANDS",
+            "cargo,rustc,go,make,cmake,ninja,gcc,g++,clang,clang++,mvn,gradle,npm,yarn,pnpm,pip,pip3,docker,tsc,webpack",
+        ).split(","),
+    )
+)
+# Words that run the program after them, so the program is what decides heaviness
+COMMAND_PREFIXES = {"sudo", "env", "time", "nice", "nohup", "timeout", "exec", "command"}
+
+# Writable cgroup v2 directory for per-session cgroups (unset: no limits are applied)
+CGROUP_ROOT = os.environ.get("MCP_EXEC_CGROUP_ROOT")
+# CPUs each session may use, e.g. "2" or "0.5" (cgroup cpu.max)
+SESSION_CPU_LIMIT = os.environ.get("MCP_EXEC_CPU_LIMIT")
+# Memory each session may use, e.g. "2G" (cgroup memory.max)
+SESSION_MEMORY_LIMIT = os.environ.get("MCP_EXEC_MEMORY_LIMIT")
+# cgroup cpu.max period in microseconds
+CPU_PERIOD_US = 100000
+# Shell program that moves itself into the cgroup.procs file in $0, then execs its arguments
+CGROUP_ENTER = 'echo $$ > "$0" && exec "$@"'
+
+RUST_CARGO_TOML = """
+[package]
+name = "temp_script"
+version = "0.1.0"
+edition = "2021"
+
+[dependencies]
+""".strip()
+
 # Package managers and their installation commands
 PACKAGE_MANAGERS = {
     "apt": {
@@ -152,21 +235,658 @@ class OutputType(Enum):
     BOTH = "both"
 
 
+class OutputBuffer:
+    """
+    Fixed-capacity byte ring buffer for one output stream.
+
+    Every byte written gets the next offset, starting at 0. The last
+    `capacity` bytes stay in memory. Older bytes are appended to a temp file
+    until it holds `spill_capacity` bytes, and dropped after that.
+    """
+
+    def __init__(
+        self, capacity: int = OUTPUT_BUFFER_BYTES, spill_capacity: int = OUTPUT_SPILL_BYTES
+    ):
+        self.capacity = max(1, capacity)
+        self.spill_capacity = spill_capacity
+        self.end_offset = 0  # Offset of the next byte written
+        self.eof = False  # Set once the stream has closed
+        self._ring = bytearray(self.capacity)
+        self._spill = None
+        self._spilled = 0  # The spill file holds offsets [0, _spilled)
+
+    @property
+    def memory_start(self) -> int:
+        """Oldest offset still held in memory."""
+        return max(0, self.end_offset - self.capacity)
+
+    def write(self, data: bytes):
+        if not data:
+            return
+        view = memoryview(data)
+        old_end = self.end_offset
+        old_start = self.memory_start
+        new_end = old_end + len(data)
+        new_start = max(0, new_end - self.capacity)
+
+        # Spill what is about to leave memory, oldest first
+        if new_start > old_start:
+            if min(new_start, old_end) > old_start:
+                self._spill_out(old_start, self._ring_slice(old_start, min(new_start, old_end)))
+            if new_start > old_end:
+                self._spill_out(old_end, view[: new_start - old_end])
+
+        keep_from = max(0, new_start - old_end)  # Leading bytes that do not fit
+        self._ring_write(old_end + keep_from, view[keep_from:])
+        self.end_offset = new_end
+
+    def read(self, offset: int, max_bytes: int) -> Tuple[bytes, int]:
+        """
+        Up to max_bytes from offset, and the offset they actually start at.
+
+        The start is later than offset when those bytes were dropped.
+        """
+        offset = min(max(offset, 0), self.end_offset)
+        if offset < self._spilled:
+            self._spill.seek(offset)
+            return self._spill.read(min(max_bytes, self._spilled - offset)), offset
+        offset = max(offset, self.memory_start)
+        return self._ring_slice(offset, min(self.end_offset, offset + max_bytes)), offset
+
+    def close(self):
+        if self._spill is not None:
+            self._spill.close()
+            self._spill = None
+            self._spilled = 0
+
+    def _ring_slice(self, start: int, stop: int) -> bytes:
+        i = start % self.capacity
+        length = stop - start
+        if i + length <= self.capacity:
+            return bytes(self._ring[i : i + length])
+        return bytes(self._ring[i:]) + bytes(self._ring[: length - (self.capacity - i)])
+
+    def _ring_write(self, offset: int, data: memoryview):
+        i = offset % self.capacity
+        first = min(len(data), self.capacity - i)
+        self._ring[i : i + first] = data[:first]
+        self._ring[: len(data) - first] = data[first:]
+
+    def _spill_out(self, offset: int, data):
+        if offset != self._spilled or self._spilled >= self.spill_capacity:
+            return  # Spilling is off or full: these bytes are dropped
+        data = data[: self.spill_capacity - self._spilled]
+        if self._spill is None:
+            self._spill = tempfile.TemporaryFile()
+        self._spill.seek(0, os.SEEK_END)
+        self._spill.write(data)
+        self._spilled += len(data)
+
+
+class TrackedProcess:
+    """
+    A child process reaped with os.wait4, so its resource usage is known.
+
+    Provides the parts of asyncio.subprocess.Process that sessions use. The
+    child is started with subprocess.Popen so that asyncio's child watcher
+    never reaps it and the rusage of the process, including everything it
+    waited for, is not lost.
+    """
+
+    def __init__(self, popen: subprocess.Popen, loop: asyncio.AbstractEventLoop):
+        self._popen = popen
+        self._loop = loop
+        self._exited = loop.create_future()
+        self.pid = popen.pid
+        self.stdin = popen.stdin
+        self.stdout: Optional[asyncio.StreamReader] = None
+        self.stderr: Optional[asyncio.StreamReader] = None
+        self.returncode: Optional[int] = None
+        self.rusage = None  # resource.struct_rusage once reaped
+        self.end_time: Optional[datetime] = None
+        self.cgroup: Optional[str] = None  # Session cgroup it runs in, if any
+
+    @classmethod
+    async def start(
+        cls,
+        args: Union[str, List[str]],
+        shell: bool = False,
+        stdin=None,
+        cwd: Optional[str] = None,
+        env: Optional[Dict[str, str]] = None,
+        new_session: bool = False,
+        cgroup: Optional[str] = None,
+    ) -> "TrackedProcess":
+        loop = asyncio.get_running_loop()
+        if cgroup:
+            # Join the cgroup before the command runs, so nothing it starts escapes it
+            if shell:
+                args, shell = ["/bin/sh", "-c", args], False
+            args = cgroup_args(args, cgroup)
+        popen = subprocess.Popen(
+            args,
+            shell=shell,
+            stdin=stdin,
+            stdout=subprocess.PIPE,
+            stderr=subprocess.PIPE,
+            cwd=cwd,
+            env=env,
+            start_new_session=new_session,
+        )
+        process = cls(popen, loop)
+        process.stdout = await process._connect(popen.stdout)
+        process.stderr = await process._connect(popen.stderr)
+        process._watch()
+        return process
+
+    async def _connect(self, pipe) -> asyncio.StreamReader:
+        reader = asyncio.StreamReader()
+        await self._loop.connect_read_pipe(lambda: asyncio.StreamReaderProtocol(reader), pipe)
+        return reader
+
+    def _watch(self):
+        try:
+            pidfd = os.pidfd_open(self.pid)
+        except (AttributeError, OSError):
+            # No pidfd support: block in a thread instead
+            def wait_blocking():
+                _, status, rusage = os.wait4(self.pid, 0)
+                self._loop.call_soon_threadsafe(self._reap, status, rusage)
+
+            threading.Thread(target=wait_blocking, daemon=True).start()
+            return
+
+        def on_exit():
+            self._loop.remove_reader(pidfd)
+            os.close(pidfd)
+            _, status, rusage = os.wait4(self.pid, 0)
+            self._reap(status, rusage)
+
+        self._loop.add_reader(pidfd, on_exit)
+
+    def _reap(self, status: int, rusage):
+        self.returncode = os.waitstatus_to_exitcode(status)
+        self._popen.returncode = self.returncode  # Popen must not wait for it again
+        self.rusage = rusage
+        self.end_time = datetime.now()
+        self._exited.set_result(self.returncode)
+
+    async def wait(self) -> int:
+        return await asyncio.shield(self._exited)
+
+    def send_signal(self, sig: int):
+        if self.returncode is None:
+            try:
+                os.kill(self.pid, sig)
+            except ProcessLookupError:
+                pass
+
+    def terminate(self):
+        self.send_signal(signal.SIGTERM)
+
+    def kill(self):
+        self.send_signal(signal.SIGKILL)
+
+
+def cgroup_args(args: List[str], cgroup: str) -> List[str]:
+    """Command line that runs args inside cgroup"""
+    return ["/bin/sh", "-c", CGROUP_ENTER, os.path.join(cgroup, "cgroup.procs"), *args]
+
+
+class SessionCgroups:
+    """
+    A cgroup v2 child of CGROUP_ROOT per session, with the configured CPU
+    quota and memory limit.
+
+    CGROUP_ROOT must be writable and must not hold processes itself, e.g. a
+    systemd scope with Delegate=yes or a subtree of a container's cgroup.
+    Without it, sessions run unconfined.
+    """
+
+    def __init__(self, root: Optional[str], cpu_limit: Optional[str], memory_limit: Optional[str]):
+        self.root = root
+        self.cpu_limit = cpu_limit
+        self.memory_limit = memory_limit
+        self._ready: Optional[bool] = None
+        self._names = itertools.count(1)
+        self._stale: Set[str] = set()  # Released while processes were still inside
+
+    @property
+    def enabled(self) -> bool:
+        if self._ready is None:
+            self._ready = False
+            if self.root:
+                try:
+                    os.makedirs(self.root, exist_ok=True)
+                    with open(os.path.join(self.root, "cgroup.controllers")) as f:
+                        available = f.read().split()
+                    wanted = [c for c in ("cpu", "memory") if c in available]
+                    if wanted:
+                        self._write(self.root, "cgroup.subtree_control", " ".join("+" + c for c in wanted))
+                    self._ready = True
+                except OSError as e:
+                    print(f"Session cgroups disabled: {e}", file=sys.stderr)
+        return self._ready
+
+    def create(self) -> Optional[str]:
+        """New cgroup with the session limits, or None when limits are unavailable"""
+        if not self.enabled:
+            return None
+        for path in list(self._stale):
+            self.release(path)
+        path = os.path.join(self.root, f"session-{os.getpid()}-{next(self._names)}")
+        try:
+            os.makedirs(path, exist_ok=True)
+            if self.cpu_limit:
+                quota = int(float(self.cpu_limit) * CPU_PERIOD_US)
+                self._write(path, "cpu.max", f"{quota} {CPU_PERIOD_US}")
+            if self.memory_limit:
+                self._write(path, "memory.max", self.memory_limit)
+        except (OSError, ValueError) as e:
+            print(f"Could not set up session cgroup {path}: {e}", file=sys.stderr)
+            self.release(path)
+            return None
+        return path
+
+    def attach(self, path: str, pid: int) -> bool:
+        """Move a process that has not started any children yet into a cgroup"""
+        try:
+            self._write(path, "cgroup.procs", str(pid))
+            return True
+        except OSError:
+            return False
+
+    def oom_killed(self, path: str) -> bool:
+        """Whether the memory limit of a cgroup made the kernel kill a process in it"""
+        try:
+            with open(os.path.join(path, "memory.events")) as f:
+                events = dict(line.split() for line in f if line.strip())
+            return int(events.get("oom_kill", 0)) > 0
+        except (OSError, ValueError):
+            return False
+
+    def release(self, path: str):
+        """Remove a cgroup, or retry later while background processes keep it busy"""
+        try:
+            os.rmdir(path)
+            self._stale.discard(path)
+        except FileNotFoundError:
+            self._stale.discard(path)
+        except OSError:
+            self._stale.add(path)
+
+    @staticmethod
+    def _write(path: str, name: str, value: str):
+        with open(os.path.join(path, name), "w") as f:
+            f.write(value)
+
+
+class JobScheduler:
+    """
+    Admits heavy jobs up to a concurrency limit.
+
+    Jobs that do not get a slot at once wait in a queue, ordered by
+    priority (higher first) and then by arrival, or by arrival alone with
+    the "fifo" policy.
+    """
+
+    def __init__(self, limit: int, policy: str):
+        self.limit = limit
+        self.policy = policy
+        self._order = itertools.count()
+        self._queue: List[Tuple[int, int, asyncio.Future]] = []
+        self._holders: Set[asyncio.Future] = set()
+
+    @property
+    def running(self) -> int:
+        return len(self._holders)
+
+    @property
+    def queued(self) -> int:
+        return sum(not future.cancelled() for _, _, future in self._queue)
+
+    def request(self, priority: int = 0) -> asyncio.Future:
+        """Future that resolves once the caller holds a slot; pass it to release() when done"""
+        future = asyncio.get_running_loop().create_future()
+        key = -priority if self.policy == "priority" else 0
+        heapq.heappush(self._queue, (key, next(self._order), future))
+        self._admit()
+        return future
+
+    def release(self, future: asyncio.Future):
+        """Free a held slot, or withdraw a request that is still queued"""
+        if future in self._holders:
+            self._holders.discard(future)
+            self._admit()
+        else:
+            future.cancel()
+
+    def position(self, future: asyncio.Future) -> int:
+        """1-based place of a queued request, 0 once it holds a slot"""
+        waiting = sorted(entry for entry in self._queue if not entry[2].cancelled())
+        for index, entry in enumerate(waiting):
+            if entry[2] is future:
+                return index + 1
+        return 0
+
+    def _admit(self):
+        while self._queue and (self.limit <= 0 or self.running < self.limit):
+            _, _, future = heapq.heappop(self._queue)
+            if not future.cancelled():
+                self._holders.add(future)
+                future.set_result(None)
+
+
+class HeavyJobsBusy(Exception):
+    """No heavy job slot became free within the caller's wait time"""
+
+
 @dataclass
 class Session:
     id: str
-    process: asyncio.subprocess.Process
+    process: Optional[TrackedProcess]  # None while queued for a heavy job slot
     command: str
     start_time: datetime
-    stdout_buffer: str
-    stderr_buffer: str
+    stdout: OutputBuffer
+    stderr: OutputBuffer
     last_read: datetime
+    # Where the next read of each stream continues
+    stdout_offset: int = 0
+    stderr_offset: int = 0
+    # Background tasks that drain the pipes and watch for exit
+    tasks: List[asyncio.Task] = field(default_factory=list)
+    # Set whenever output arrives, a stream closes or the process exits
+    output_event: asyncio.Event = field(default_factory=asyncio.Event)
+    # Largest total RSS of the process tree seen while sampling it
+    peak_rss: int = 0
+    # Heavy job slot held or waited for, and the task that starts a queued session
+    slot: Optional[asyncio.Future] = None
+    launch: Optional[asyncio.Task] = None
+    # Why a queued session could not be started
+    error: Optional[str] = None
+    # Whether the memory limit of the session's cgroup was hit
+    oom_killed: bool = False
+
+    @property
+    def finished(self) -> bool:
+        """The process has exited and both streams are fully captured"""
+        return (
+            self.process is not None
+            and self.process.returncode is not None
+            and self.stdout.eof
+            and self.stderr.eof
+        )
 
 
 # Global state
 active_sessions: Dict[str, Session] = {}
 last_session_id: int = 0
 blocked_commands: Set[str] = set(BLACKLISTED_COMMANDS)
+heavy_jobs = JobScheduler(MAX_HEAVY_JOBS, SCHEDULER_POLICY)
+session_cgroups = SessionCgroups(CGROUP_ROOT, SESSION_CPU_LIMIT, SESSION_MEMORY_LIMIT)
+
+
+async def pump_stream(stream, buffer: OutputBuffer, event: asyncio.Event):
+    """Copy a pipe into a session buffer as data arrives, until it closes"""
+    try:
+        while True:
+            chunk = await stream.read(READ_CHUNK_BYTES)
+            if not chunk:
+                break
+            buffer.write(chunk)
+            event.set()
+    finally:
+        buffer.eof = True
+        event.set()
+
+
+async def watch_exit(session: Session, readers: List[asyncio.Task]):
+    """Wake waiting readers when the process exits, then record its usage"""
+    await session.process.wait()
+    if session.slot is not None:
+        heavy_jobs.release(session.slot)  # The next queued heavy job can start
+    session_oom_killed(session)
+    session.output_event.set()
+    # Count output the readers are still collecting, even if the session goes away
+    await asyncio.wait(readers)
+    if session.process.cgroup:
+        session_cgroups.release(session.process.cgroup)
+    record_session_metrics(session)
+
+
+def session_oom_killed(session: Session) -> bool:
+    """Whether its cgroup memory limit made the kernel kill part of the session"""
+    cgroup = session.process.cgroup if session.process else None
+    if cgroup and not session.oom_killed:
+        session.oom_killed = session_cgroups.oom_killed(cgroup)
+    return session.oom_killed
+
+
+def start_session_tasks(session: Session):
+    """Start the background readers that fill the session buffers"""
+    readers = [
+        asyncio.create_task(pump_stream(session.process.stdout, session.stdout, session.output_event)),
+        asyncio.create_task(pump_stream(session.process.stderr, session.stderr, session.output_event)),
+    ]
+    session.tasks = readers + [asyncio.create_task(watch_exit(session, readers))]
+
+
+def remove_session(session_id: str):
+    """Forget a session, stop its readers and release its output buffers"""
+    session = active_sessions.pop(session_id, None)
+    if session:
+        if session.launch is not None:
+            session.launch.cancel()  # Still queued: give up its place
+        for task in session.tasks[:2]:  # watch_exit still records the usage
+            task.cancel()
+        session.stdout.close()
+        session.stderr.close()
+
+
+def _incomplete_utf8_tail(data: bytes) -> int:
+    """Number of trailing bytes that start a UTF-8 sequence not yet complete"""
+    for k in range(1, min(4, len(data)) + 1):
+        byte = data[-k]
+        if byte & 0xC0 != 0x80:  # Not a continuation byte
+            if byte >> 5 == 0b110:
+                needed = 2
+            elif byte >> 4 == 0b1110:
+                needed = 3
+            elif byte >> 3 == 0b11110:
+                needed = 4
+            else:
+                needed = 1
+            return k if needed > k else 0
+    return 0
+
+
+def read_session_output(
+    session: Session,
+    output_type: OutputType,
+    max_bytes: int = DEFAULT_MAX_OUTPUT_BYTES,
+    stdout_offset: Optional[int] = None,
+    stderr_offset: Optional[int] = None,
+) -> Dict[str, Any]:
+    """
+    Decode output of the selected streams and advance their read positions.
+
+    Each stream is read from the given offset, or from where the last read
+    stopped, up to max_bytes. Returns the text plus, per stream, the offset
+    to continue from, the bytes dropped before it and the bytes still unread.
+    """
+    result: Dict[str, Any] = {"stdout": "", "stderr": ""}
+    streams = {
+        "stdout": (session.stdout, stdout_offset),
+        "stderr": (session.stderr, stderr_offset),
+    }
+    for name, (buffer, offset) in streams.items():
+        if output_type not in (OutputType(name), OutputType.BOTH):
+            continue
+        if offset is None:
+            offset = getattr(session, f"{name}_offset")
+        data, start = buffer.read(offset, max(max_bytes, 4))
+        if not buffer.eof or start + len(data) < buffer.end_offset:
+            # Leave a split multi-byte character for the next read
+            cut = _incomplete_utf8_tail(data)
+            data = data[: len(data) - cut]
+        next_offset = start + len(data)
+        setattr(session, f"{name}_offset", next_offset)
+        result[name] = data.decode("utf-8", errors="replace").rstrip("\n")
+        result[f"{name}_offset"] = next_offset
+        result[f"{name}_dropped"] = max(0, start - max(offset, 0))
+        result[f"{name}_remaining"] = buffer.end_offset - next_offset
+    return result
+
+
+# Totals for finished sessions per program, exported by get_metrics
+METRIC_FIELDS = (
+    "wall_seconds",
+    "user_cpu_seconds",
+    "system_cpu_seconds",
+    "read_bytes",
+    "write_bytes",
+    "stdout_bytes",
+    "stderr_bytes",
+)
+session_totals: Dict[str, Dict[str, float]] = {}
+
+
+def session_program(command: str) -> str:
+    """Metric label for a command: the base name of the program it runs"""
+    try:
+        words = shlex.split(command)
+    except ValueError:
+        words = command.split()
+    return os.path.basename(words[0]) if words else ""
+
+
+def session_metrics(session: Session) -> Dict[str, Any]:
+    """
+    Resource usage of a session.
+
+    Once the process has exited this is its os.wait4 rusage, which includes
+    every descendant it waited for. While it runs, the process tree is
+    sampled with psutil instead. Linux counts the server's own RSS at fork
+    time towards the child's max RSS, so it is never below that.
+    """
+    process = session.process
+    end = process.end_time or datetime.now()
+    metrics: Dict[str, Any] = {
+        "wall_seconds": (end - session.start_time).total_seconds(),
+        "stdout_bytes": session.stdout.end_offset,
+        "stderr_bytes": session.stderr.end_offset,
+        "final": process.rusage is not None,
+    }
+    if process.rusage is not None:
+        usage = process.rusage
+        metrics.update(
+            {
+                "user_cpu_seconds": usage.ru_utime,
+                "system_cpu_seconds": usage.ru_stime,
+                "max_rss_bytes": usage.ru_maxrss * 1024,  # Reported in KiB on Linux
+                "read_bytes": usage.ru_inblock * 512,
+                "write_bytes": usage.ru_oublock * 512,
+            }
+        )
+        return metrics
+
+    user = system = rss = read = written = 0
+    try:
+        root = psutil.Process(process.pid)
+        for proc in [root] + root.children(recursive=True):
+            try:
+                with proc.oneshot():
+                    times = proc.cpu_times()
+                    user += times.user + times.children_user
+                    system += times.system + times.children_system
+                    rss += proc.memory_info().rss
+                    io = proc.io_counters()
+                    read += io.read_bytes
+                    written += io.write_bytes
+            except (psutil.NoSuchProcess, psutil.AccessDenied):
+                continue
+    except Exception:
+        pass  # Exited between checks, or psutil cannot inspect it
+    session.peak_rss = max(session.peak_rss, rss)
+    metrics.update(
+        {
+            "user_cpu_seconds": user,
+            "system_cpu_seconds": system,
+            "max_rss_bytes": session.peak_rss,
+            "read_bytes": read,
+            "write_bytes": written,
+        }
+    )
+    return metrics
+
+
+def record_session_metrics(session: Session):
+    """Add a finished session to the per-program totals"""
+    metrics = session_metrics(session)
+    totals = session_totals.setdefault(
+        session_program(session.command),
+        {"sessions": 0, "max_rss_bytes": 0, **{name: 0 for name in METRIC_FIELDS}},
+    )
+    totals["sessions"] += 1
+    totals["max_rss_bytes"] = max(totals["max_rss_bytes"], metrics["max_rss_bytes"])
+    for name in METRIC_FIELDS:
+        totals[name] += metrics[name]
+
+
+def format_bytes(size: float) -> str:
+    for unit in ("B", "KiB", "MiB", "GiB"):
+        if size < 1024 or unit == "GiB":
+            return f"{size:.0f} {unit}" if unit == "B" else f"{size:.1f} {unit}"
+        size /= 1024
+
+
+def format_metrics(metrics: Dict[str, Any]) -> str:
+    """One-line summary of session_metrics output"""
+    line = (
+        f"Resources: wall {metrics['wall_seconds']:.2f}s, "
+        f"CPU {metrics['user_cpu_seconds']:.2f}s user + {metrics['system_cpu_seconds']:.2f}s sys, "
+        f"max RSS {format_bytes(metrics['max_rss_bytes'])}, "
+        f"disk {format_bytes(metrics['read_bytes'])} read / {format_bytes(metrics['write_bytes'])} written, "
+        f"output {format_bytes(metrics['stdout_bytes'])} stdout / {format_bytes(metrics['stderr_bytes'])} stderr"
+    )
+    return line if metrics["final"] else line + " (sampled while running)"
+
+
+def render_metrics() -> str:
+    """Session usage and tool latency in the Prometheus text exposition format"""
+
+    def label(program: str) -> str:
+        escaped = program.replace("\\", "\\\\").replace('"', '\\"').replace("\n", "\\n")
+        return f'{{program="{escaped}"}}'
+
+    lines = [
+        "# HELP exec_active_sessions Sessions currently tracked",
+        "# TYPE exec_active_sessions gauge",
+        f"exec_active_sessions {len(active_sessions)}",
+        "# HELP exec_heavy_jobs_running Heavy jobs holding a slot",
+        "# TYPE exec_heavy_jobs_running gauge",
+        f"exec_heavy_jobs_running {heavy_jobs.running}",
+        "# HELP exec_heavy_jobs_queued Heavy jobs waiting for a slot",
+        "# TYPE exec_heavy_jobs_queued gauge",
+        f"exec_heavy_jobs_queued {heavy_jobs.queued}",
+    ]
+    families = [
+        ("exec_sessions_total", "counter", "Finished sessions", "sessions"),
+        ("exec_session_wall_seconds_total", "counter", "Wall time of finished sessions", "wall_seconds"),
+        ("exec_session_user_cpu_seconds_total", "counter", "User CPU time of finished sessions", "user_cpu_seconds"),
+        ("exec_session_system_cpu_seconds_total", "counter", "System CPU time of finished sessions", "system_cpu_seconds"),
+        ("exec_session_read_bytes_total", "counter", "Bytes read from storage by finished sessions", "read_bytes"),
+        ("exec_session_write_bytes_total", "counter", "Bytes written to storage by finished sessions", "write_bytes"),
+        ("exec_session_stdout_bytes_total", "counter", "Stdout bytes of finished sessions", "stdout_bytes"),
+        ("exec_session_stderr_bytes_total", "counter", "Stderr bytes of finished sessions", "stderr_bytes"),
+        ("exec_session_max_rss_bytes", "gauge", "Largest max RSS of any finished session", "max_rss_bytes"),
+    ]
+    for name, kind, help_text, key in families:
+        lines.append(f"# HELP {name} {help_text}")
+        lines.append(f"# TYPE {name} {kind}")
+        for program, totals in sorted(session_totals.items()):
+            lines.append(f"{name}{label(program)} {round(totals[key], 6)}")
+    return "\n".join(lines) + "\n" + render_prometheus()
 
 
 def is_command_blacklisted(command: str) -> bool:
@@ -175,10 +895,35 @@ def is_command_blacklisted(command: str) -> bool:
     return any(cmd in blocked_commands for cmd in cmd_parts)
 
 
+def is_heavy_command(command: str) -> bool:
+    """Whether any program the command line runs is in HEAVY_COMMANDS"""
+    try:
+        lexer = shlex.shlex(command, posix=True, punctuation_chars=True)
+        lexer.whitespace_split = True
+        words = list(lexer)
+    except ValueError:
+        words = command.split()
+    at_start = True  # The next word names a program
+    for word in words:
+        if word and all(c in "();<>|&" for c in word):
+            at_start = True
+            continue
+        if not at_start:
+            continue
+        name = os.path.basename(word)
+        if name in COMMAND_PREFIXES or word.startswith("-") or word.isdigit() or "=" in word:
+            continue  # Prefix, its options or a variable assignment
+        if name in HEAVY_COMMANDS:
+            return True
+        at_start = False
+    return False
+
+
 async def create_async_process(
     command: Union[str, List[str]],
     use_fork: bool = False,
     working_directory: Optional[str] = None,
+    env: Optional[Dict[str, str]] = None,
 ) -> asyncio.subprocess.Process:
     """Create an async subprocess, optionally using fork for isolation"""
     if isinstance(command, list):
@@ -198,6 +943,7 @@ async def create_async_process(
             start_new_session=True,  # This creates a new process group
             # preexec_fn=os.setsid  # This sets the process as session leader
             cwd=working_directory,
+            env=env,
         )
     else:
         return await asyncio.create_subprocess_shell(
@@ -205,9 +951,253 @@ async def create_async_process(
             stdout=asyncio.subprocess.PIPE,
             stderr=asyncio.subprocess.PIPE,
             cwd=working_directory,
+            env=env,
         )
 
 
+# Worker programs: import the preload list, then run the one script sent on stdin.
+# An empty stdin means the worker was retired unused.
+PYTHON_WORKER = """
+import os, sys, json, runpy
+for _name in filter(None, sys.argv[1].split(",")):
+    try:
+        __import__(_name)
+    except Exception:
+        pass
+job = json.loads(sys.stdin.read() or "null")
+if job is None:
+    sys.exit(0)
+if job["cwd"]:
+    os.chdir(job["cwd"])
+sys.argv = [job["path"]]
+sys.path[0] = os.path.dirname(job["path"])
+try:
+    runpy.run_path(job["path"], run_name="__main__")
+except SystemExit:
+    raise
+except BaseException as error:
+    # Report it as a plain `python script.py` would, without the worker's frames
+    import traceback
+    tb = error.__traceback__
+    while tb is not None and tb.tb_frame.f_code.co_filename != job["path"]:
+        tb = tb.tb_next
+    traceback.print_exception(type(error), error, tb or error.__traceback__)
+    sys.exit(1)
+"""
+
+NODE_WORKER = """
+const fs = require("fs");
+for (const name of (process.argv[1] || "").split(",").filter(Boolean)) {
+  try { require(name); } catch (e) {}
+}
+const job = JSON.parse(fs.readFileSync(0, "utf8") || "null");
+if (job) {
+  if (job.cwd) process.chdir(job.cwd);
+  process.argv = [process.argv[0], job.path];
+  // Run it as the entry module, so `require.main === module` holds as with `node script.js`
+  require("module").runMain();
+}
+"""
+
+# Language -> (interpreter, inline code flag, worker program)
+SCRIPT_WORKERS = {
+    "python": ("python", "-c", PYTHON_WORKER),
+    "node": ("node", "-e", NODE_WORKER),
+}
+
+
+class InterpreterPool:
+    """
+    Interpreters started ahead of time for execute_script.
+
+    Each worker has already paid interpreter startup and preload imports, and
+    runs exactly one script before exiting, so no state leaks between scripts.
+    Taking a worker starts its replacement in the background.
+    """
+
+    def __init__(self, size: int = SCRIPT_POOL_SIZE):
+        self.size = size
+        # Language -> idle workers as (generation, start time, process)
+        self._spares: Dict[str, List[Tuple[int, float, TrackedProcess]]] = {}
+        self._refills: Dict[str, asyncio.Task] = {}
+        self._generation = 0
+
+    async def _spawn(self, language: str) -> TrackedProcess:
+        interpreter, flag, program = SCRIPT_WORKERS[language]
+        return await TrackedProcess.start(
+            [interpreter, flag, program, SCRIPT_PRELOAD[language]], stdin=subprocess.PIPE
+        )
+
+    async def run(
+        self,
+        language: str,
+        script_path: str,
+        working_directory: Optional[str],
+        cgroup: Optional[str] = None,
+    ) -> TrackedProcess:
+        """Hand script_path to a warm worker, or a new one if none is ready"""
+        spares = self._spares.setdefault(language, [])
+        process = None
+        while spares and process is None:
+            generation, started, candidate = spares.pop(0)
+            if (
+                generation == self._generation
+                and candidate.returncode is None
+                and time.monotonic() - started < SCRIPT_WORKER_MAX_AGE
+            ):
+                process = candidate
+            elif candidate.returncode is None:
+                candidate.stdin.close()  # Empty job: the worker exits
+        if process is None:
+            process = await self._spawn(language)
+        self._refill(language)
+
+        if cgroup:
+            session_cgroups.attach(cgroup, process.pid)  # Idle worker: no children yet
+        job = {"path": script_path, "cwd": working_directory}
+        process.stdin.write(json.dumps(job).encode())
+        process.stdin.close()  # Flushes the job; the script then sees EOF on stdin
+        return process
+
+    def _refill(self, language: str):
+        running = self._refills.get(language)
+        if self.size > 0 and (running is None or running.done()):
+            self._refills[language] = asyncio.create_task(self._fill(language))
+
+    async def _fill(self, language: str):
+        spares = self._spares.setdefault(language, [])
+        try:
+            while len(spares) < self.size:
+                generation = self._generation
+                spares.append((generation, time.monotonic(), await self._spawn(language)))
+        except OSError:
+            pass  # Interpreter missing; run() raises and the script starts cold
+
+    def clear(self):
+        """Replace idle workers on next use, e.g. after packages were installed"""
+        self._generation += 1
+
+
+script_pool = InterpreterPool()
+
+
+# One build at a time per language: Rust scripts share a single cargo workspace
+compile_locks: Dict[str, asyncio.Lock] = {}
+
+
+def cached_binary_path(language: str, source: str) -> str:
+    """Where the binary built from this exact source is cached"""
+    manifest = RUST_CARGO_TOML if language == "rust" else ""
+    key = hashlib.sha256(f"{language}\0{manifest}\0{source}".encode()).hexdigest()
+    return os.path.join(SCRIPT_BUILD_DIR, "bin", f"{language}-{key[:32]}")
+
+
+def prune_binary_cache():
+    """Delete the least recently used binaries beyond COMPILE_CACHE_ENTRIES"""
+    bin_dir = os.path.join(SCRIPT_BUILD_DIR, "bin")
+    try:
+        entries = [e for e in os.scandir(bin_dir) if not e.name.endswith(".tmp")]
+    except OSError:
+        return
+    entries.sort(key=lambda e: e.stat().st_mtime, reverse=True)
+    for entry in entries[COMPILE_CACHE_ENTRIES:]:
+        try:
+            os.unlink(entry.path)
+        except OSError:
+            pass
+
+
+@traced("compile")
+async def compile_script(
+    language: str,
+    source: str,
+    script_path: str,
+    working_directory: Optional[str],
+    slot_wait: float = COMPILE_TIMEOUT,
+) -> Tuple[Optional[str], Optional[Dict[str, Any]]]:
+    """
+    Build a Rust or Go script, reusing the binary of an identical earlier source.
+
+    Rust builds in a persistent workspace whose target directory is shared by
+    every script, and Go builds use a persistent GOCACHE, so unchanged
+    dependencies are not rebuilt.
+
+    Returns:
+        (binary path, None) on success, or (None, compile result for format_output).
+        Raises HeavyJobsBusy if no heavy job slot frees up within slot_wait seconds,
+        and asyncio.TimeoutError if compiling takes longer than COMPILE_TIMEOUT.
+    """
+    binary = cached_binary_path(language, source)
+    if os.path.exists(binary):
+        os.utime(binary)  # Mark as recently used
+        return binary, None
+
+    os.makedirs(os.path.dirname(binary), exist_ok=True)
+    async with compile_locks.setdefault(language, asyncio.Lock()):
+        if os.path.exists(binary):
+            return binary, None  # Built by the call we waited for
+
+        env = dict(os.environ)
+        if language == "rust":
+            workspace = os.path.join(SCRIPT_BUILD_DIR, "rust")
+            os.makedirs(os.path.join(workspace, "src"), exist_ok=True)
+            with open(os.path.join(workspace, "Cargo.toml"), "w") as f:
+                f.write(RUST_CARGO_TOML)
+            with open(os.path.join(workspace, "src", "main.rs"), "w") as f:
+                f.write(source)
+            env["CARGO_TARGET_DIR"] = os.path.join(workspace, "target")
+            command = f"cargo build --release --manifest-path {shlex.quote(os.path.join(workspace, 'Cargo.toml'))}"
+            built = os.path.join(workspace, "target", "release", "temp_script")
+        else:
+            env.setdefault("GOCACHE", os.path.join(SCRIPT_BUILD_DIR, "go-cache"))
+            built = binary + ".tmp"
+            command = f"go build -o {shlex.quote(built)} {shlex.quote(script_path)}"
+
+        # Compiles are heavy jobs: wait for a slot, then build inside a session cgroup
+        slot = heavy_jobs.request()
+        cgroup = None
+        try:
+            ahead = heavy_jobs.running + max(heavy_jobs.position(slot) - 1, 0)
+            try:
+                with span("queue_wait"):
+                    await asyncio.wait_for(slot, timeout=slot_wait)
+            except asyncio.TimeoutError:
+                raise HeavyJobsBusy(
+                    f"{language.capitalize()} compilation not started: queued behind "
+                    f"{ahead} heavy jobs for {slot_wait} seconds"
+                ) from None
+            cgroup = session_cgroups.create()
+            if cgroup:
+                command = shlex.join(cgroup_args(["/bin/sh", "-c", command], cgroup))
+            start_time = time.time()
+            process = await create_async_process(command, working_directory=working_directory, env=env)
+            try:
+                stdout, stderr = await asyncio.wait_for(process.communicate(), timeout=COMPILE_TIMEOUT)
+            except asyncio.TimeoutError:
+                process.kill()
+                raise
+        finally:
+            heavy_jobs.release(slot)
+            if cgroup:
+                session_cgroups.release(cgroup)
+        if process.returncode != 0:
+            return None, {
+                "stdout": stdout.decode(errors="replace") if stdout else "",
+                "stderr": stderr.decode(errors="replace") if stderr else "",
+                "returncode": process.returncode,
+                "execution_time": time.time() - start_time,
+                "timed_out": False,
+            }
+
+        # Publish atomically so a concurrent lookup never runs a partial file
+        if language == "rust":
+            shutil.copy2(built, binary + ".tmp")
+        os.replace(binary + ".tmp", binary)
+
+    prune_binary_cache()
+    return binary, None
+
+
 def format_output(result: Dict[str, Any], output_type: OutputType) -> str:
     """Format the command output based on the requested output type"""
     output = []
@@ -237,6 +1227,36 @@ def format_output(result: Dict[str, Any], output_type: OutputType) -> str:
         output.append("\n=== STDERR ===")
         output.append(result["stderr"])
 
+    if result.get("pipes_open"):
+        output.append(
+            "A background process still holds the output pipes open; "
+            f"read further output with read_output. Session ID: {result['session_id']}"
+        )
+
+    if result.get("oom_killed"):
+        output.append("Memory limit reached: the kernel killed a process of this session")
+
+    if result.get("metrics"):
+        output.append(format_metrics(result["metrics"]))
+
+    # Add read positions for output read from a session buffer
+    offsets = [
+        f"{name} {result[f'{name}_offset']}"
+        for name in ("stdout", "stderr")
+        if f"{name}_offset" in result
+    ]
+    if offsets:
+        output.append(f"\nOutput offsets: {', '.join(offsets)}")
+        for name in ("stdout", "stderr"):
+            if result.get(f"{name}_dropped"):
+                output.append(
+                    f"{result[f'{name}_dropped']} bytes of {name} were discarded before this read"
+                )
+            if result.get(f"{name}_remaining"):
+                output.append(
+                    f"{result[f'{name}_remaining']} more bytes of {name} available; call read_output to continue"
+                )
+
     return "\n".join(output)
 
 
@@ -303,6 +1323,7 @@ def install_package(package: str, package_manager: str = None) -> Dict[str, Any]
     )  # Allow longer timeout for installations
 
     if install_result["returncode"] == 0:
+        script_pool.clear()  # Warm interpreters predate the new package
         return {
             "success": True,
             "message": f"Successfully installed {package} using {package_manager}",
@@ -362,7 +1383,8 @@ def run_command_sync(
             cwd=working_directory,
         )
 
-        stdout, stderr = process.communicate(timeout=wait_time)
+        with span("subprocess"):
+            stdout, stderr = process.communicate(timeout=wait_time)
 
         execution_time = time.time() - start_time
 
@@ -408,10 +1430,16 @@ async def execute_command(
     use_fork: bool = False,
     terminate_after_wait: bool = False,
     working_directory: Optional[str] = None,
+    priority: int = 0,
+    heavy: Optional[bool] = None,
 ) -> str:
     """
     Execute a command asynchronously. Returns formatted output from the command if execution completed before wait_time. Otherwise, returns a session ID for the running command.
 
+    Heavy commands such as builds and package installs run a few at a time. When
+    all heavy job slots are taken the command waits in a queue, and if it has not
+    started within wait_time a session ID for the queued command is returned.
+
     Args:
         command: The command to execute
         wait_time: Maximum execution time in seconds (default: 30)
@@ -419,78 +1447,161 @@ async def execute_command(
         use_fork: Whether to use a new process group via fork (default: False)
         terminate_after_wait: Whether to kill the process after wait_time (default: False)
         working_directory: Directory to run the command from
+        priority: Queue priority of a heavy command; higher starts first (default: 0)
+        heavy: Whether the command needs a heavy job slot (default: detected from the programs it runs)
 
     Returns:
         Formatted output or session ID
     """
-    global last_session_id, active_sessions
-
     # Check for blacklisted commands
     if is_command_blacklisted(command):
         return "Error: This command has been blacklisted"
 
-    # Create unique session ID
-    last_session_id += 1
-    session_id = str(last_session_id)
+    if heavy is None:
+        heavy = is_heavy_command(command)
+    if not heavy:
+        session = new_session(command, await start_session_process(command, use_fork, working_directory))
+        return await run_session(session, wait_time, output_type, terminate_after_wait)
+
+    # Wait up to wait_time for a heavy job slot
+    started = time.monotonic()
+    slot = heavy_jobs.request(priority)
+    with span("queue_wait"):
+        await asyncio.wait([slot], timeout=wait_time)
+    if slot.done():
+        try:
+            process = await start_session_process(command, use_fork, working_directory)
+        except BaseException:
+            heavy_jobs.release(slot)
+            raise
+        session = new_session(command, process, slot)
+        remaining = max(wait_time - (time.monotonic() - started), 0)
+        return await run_session(session, remaining, output_type, terminate_after_wait)
+
+    if terminate_after_wait:
+        heavy_jobs.release(slot)
+        return f"Command was not started: no heavy job slot became free within {wait_time} seconds"
+
+    # Leave it queued; it starts in the background once a slot frees up
+    session = new_session(command, None, slot)
+    session.launch = asyncio.create_task(launch_queued(session, use_fork, working_directory))
+    return (
+        f"Command queued for a heavy job slot (queue position {heavy_jobs.position(slot)}, "
+        f"{heavy_jobs.running} heavy jobs running). Session ID: {session.id}\n"
+        "Use read_output with wait_for_bytes to wait for it to start and produce output."
+    )
 
-    # Start the process
-    process = await create_async_process(command, use_fork, working_directory)
 
-    # Create session
+@traced("spawn")
+async def start_session_process(
+    command: str, use_fork: bool, working_directory: Optional[str]
+) -> TrackedProcess:
+    """Start a session command, inside its own cgroup when limits are configured"""
+    cgroup = session_cgroups.create()
+    try:
+        if use_fork:
+            # Run in its own bash in a new process group
+            process = await TrackedProcess.start(
+                ["bash", "-c", command], cwd=working_directory, new_session=True, cgroup=cgroup
+            )
+        else:
+            process = await TrackedProcess.start(
+                command, shell=True, cwd=working_directory, cgroup=cgroup
+            )
+    except BaseException:
+        if cgroup:
+            session_cgroups.release(cgroup)
+        raise
+    process.cgroup = cgroup
+    return process
+
+
+def new_session(
+    command: str, process: Optional[TrackedProcess], slot: Optional[asyncio.Future] = None
+) -> Session:
+    """Register a session; its readers start once it has a process"""
+    global last_session_id
+
+    # Create unique session ID
+    last_session_id += 1
     session = Session(
-        id=session_id,
+        id=str(last_session_id),
         process=process,
         command=command,
         start_time=datetime.now(),
-        stdout_buffer="",
-        stderr_buffer="",
+        stdout=OutputBuffer(),
+        stderr=OutputBuffer(),
         last_read=datetime.now(),
+        slot=slot,
     )
-    active_sessions[session_id] = session
-
-    # Create tasks for reading stdout and stderr
-    async def read_stream(stream, buffer: List[str]):
-        while True:
-            line = await stream.readline()
-            if not line:
-                break
-            buffer.append(line.decode().rstrip("\n"))
+    active_sessions[session.id] = session
+    if process is not None:
+        # Background readers keep filling the session buffers until the pipes close
+        start_session_tasks(session)
+    return session
 
-    stdout_buffer = []
-    stderr_buffer = []
-    stdout_task = asyncio.create_task(read_stream(process.stdout, stdout_buffer))
-    stderr_task = asyncio.create_task(read_stream(process.stderr, stderr_buffer))
 
+async def launch_queued(session: Session, use_fork: bool, working_directory: Optional[str]):
+    """Start a queued heavy session once the scheduler gives it a slot"""
     try:
-        # Wait for process to complete or timeout
-        await asyncio.wait_for(process.wait(), timeout=wait_time)
-
-        # Wait for output readers to complete
-        await stdout_task
-        await stderr_task
+        with span("queue_wait"):
+            await session.slot
+        process = await start_session_process(session.command, use_fork, working_directory)
+    except asyncio.CancelledError:
+        heavy_jobs.release(session.slot)
+        raise
+    except OSError as e:
+        heavy_jobs.release(session.slot)
+        session.error = str(e)
+        session.output_event.set()
+        return
+    session.process = process
+    session.start_time = datetime.now()
+    session.launch = None
+    start_session_tasks(session)
+    session.output_event.set()
+
+
+async def run_session(
+    session: Session,
+    wait_time: float,
+    output_type: str,
+    terminate_after_wait: bool = False,
+) -> str:
+    """Wait up to wait_time for a started session to finish"""
+    process = session.process
+    session_id = session.id
+    stdout_task, stderr_task = session.tasks[:2]
+    output_enum = OutputType(output_type.lower())
+    deadline = time.monotonic() + wait_time
 
-        session.stdout_buffer = "\n".join(stdout_buffer)
-        session.stderr_buffer = "\n".join(stderr_buffer)
+    try:
+        with span("subprocess"):
+            # Wait for process to complete or timeout
+            await asyncio.wait_for(process.wait(), timeout=wait_time)
+
+            # Wait for output readers to complete, within what is left of wait_time:
+            # a background child (`server &`) can hold the pipes open after the shell exits
+            await asyncio.wait(
+                [stdout_task, stderr_task], timeout=max(deadline - time.monotonic(), 0)
+            )
+        pipes_open = not (stdout_task.done() and stderr_task.done())
 
         return format_output(
             {
-                "stdout": session.stdout_buffer,
-                "stderr": session.stderr_buffer,
+                **read_session_output(session, output_enum),
                 "returncode": process.returncode,
                 "execution_time": (datetime.now() - session.start_time).total_seconds(),
                 "timed_out": False,
                 "session_id": session_id,
+                "metrics": session_metrics(session),
+                "oom_killed": session_oom_killed(session),
+                "pipes_open": pipes_open,
             },
-            OutputType(output_type.lower()),
+            output_enum,
         )
     except asyncio.TimeoutError:
-        # Cancel output readers
-        stdout_task.cancel()
-        stderr_task.cancel()
-
-        # Store current output in session
-        session.stdout_buffer = "\n".join(stdout_buffer)
-        session.stderr_buffer = "\n".join(stderr_buffer)
+        # The readers keep running, so read_output finds the output already buffered
 
         # If terminate_after_wait is True, kill the process
         if terminate_after_wait:
@@ -502,41 +1613,62 @@ async def execute_command(
             except asyncio.TimeoutError:
                 # If still not terminated, it's likely a zombie process
                 pass
-            del active_sessions[session_id]
+            result = read_session_output(session, output_enum)
+            metrics = session_metrics(session)
+            oom_killed = session_oom_killed(session)
+            remove_session(session_id)
             return format_output(
                 {
-                    "stdout": session.stdout_buffer,
-                    "stderr": session.stderr_buffer,
+                    "stdout": result["stdout"],
+                    "stderr": result["stderr"],
                     "returncode": -9,  # SIGKILL
                     "execution_time": wait_time,
                     "timed_out": True,
                     "terminated": True,
+                    "metrics": metrics,
+                    "oom_killed": oom_killed,
                 },
-                OutputType(output_type.lower()),
+                output_enum,
             )
 
         return format_output(
             {
-                "stdout": session.stdout_buffer,
-                "stderr": session.stderr_buffer,
+                **read_session_output(session, output_enum),
                 "returncode": None,
                 "execution_time": wait_time,
                 "timed_out": True,
                 "session_id": session_id,
+                "metrics": session_metrics(session),
             },
-            OutputType(output_type.lower()),
+            output_enum,
         )
 
 
 @mcp.tool()
-async def read_output(session_id: str, output_type: str = "both") -> str:
+async def read_output(
+    session_id: str,
+    output_type: str = "both",
+    since_offset: Optional[int] = None,
+    max_bytes: int = DEFAULT_MAX_OUTPUT_BYTES,
+    stderr_since_offset: Optional[int] = None,
+    wait_for_bytes: int = 0,
+    wait_timeout: float = DEFAULT_TIMEOUT,
+) -> str:
     """
     Read new output from a running session using the session ID returned by execute_command.
-    Non-blocking - returns immediately with any new output available.
+    Returns immediately with any new output available, unless wait_for_bytes is set.
+
+    Each call returns only output produced since the previous call, and ends with
+    the byte offsets reached in each stream. Pass an offset back to re-read from it.
 
     Args:
         session_id: The session ID returned by execute_command
         output_type: Which outputs to return ("stdout", "stderr", "both")
+        since_offset: Stdout byte offset to read from (default: where the last read stopped)
+        max_bytes: Maximum bytes to return per stream (default: 262144)
+        stderr_since_offset: Stderr byte offset to read from (default: where the last read stopped)
+        wait_for_bytes: Wait until at least this many new bytes are available or the process exits (default: 0, no waiting)
+        wait_timeout: Maximum seconds to wait when wait_for_bytes is set (default: 30)
     """
     global active_sessions
 
@@ -544,37 +1676,46 @@ async def read_output(session_id: str, output_type: str = "both") -> str:
     if not session:
         return f"Error: Session {session_id} not found"
 
-    async def drain_output(stream) -> str:
-        output = []
-        while True:
+    output_enum = OutputType(output_type.lower())
+
+    if session.process is None and session.launch is not None and wait_for_bytes > 0:
+        # Queued: waiting for the command to start counts towards wait_timeout
+        started = time.monotonic()
+        await asyncio.wait([session.launch], timeout=wait_timeout)
+        wait_timeout = max(wait_timeout - (time.monotonic() - started), 0)
+    if session.error is not None:
+        remove_session(session_id)
+        return f"Error: Session {session_id} could not be started: {session.error}"
+    if session.process is None:
+        return (
+            f"Session {session_id} is queued for a heavy job slot "
+            f"(queue position {heavy_jobs.position(session.slot)}, {heavy_jobs.running} running)"
+        )
+
+    def available() -> int:
+        total = 0
+        if output_enum in (OutputType.STDOUT, OutputType.BOTH):
+            offset = session.stdout_offset if since_offset is None else since_offset
+            total += session.stdout.end_offset - max(offset, 0)
+        if output_enum in (OutputType.STDERR, OutputType.BOTH):
+            offset = session.stderr_offset if stderr_since_offset is None else stderr_since_offset
+            total += session.stderr.end_offset - max(offset, 0)
+        return total
+
+    # Long poll: the background readers set output_event as data arrives
+    if wait_for_bytes > 0:
+        loop = asyncio.get_running_loop()
+        deadline = loop.time() + wait_timeout
+        while available() < wait_for_bytes and session.process.returncode is None:
+            session.output_event.clear()
             try:
-                line = await asyncio.wait_for(stream.readline(), timeout=0.1)
-                if not line:
-                    break
-                output.append(line.decode().rstrip("\n"))
+                await asyncio.wait_for(session.output_event.wait(), deadline - loop.time())
             except asyncio.TimeoutError:
                 break
-        return "\n".join(output)
 
-    # Read any new output (non-blocking)
-    new_stdout = (
-        await drain_output(session.process.stdout) if session.process.stdout else ""
-    )
-    new_stderr = (
-        await drain_output(session.process.stderr) if session.process.stderr else ""
-    )
-
-    # Update buffers
-    if new_stdout:
-        if session.stdout_buffer:
-            session.stdout_buffer += "\n" + new_stdout
-        else:
-            session.stdout_buffer = new_stdout
-    if new_stderr:
-        if session.stderr_buffer:
-            session.stderr_buffer += "\n" + new_stderr
-        else:
-            session.stderr_buffer = new_stderr
+    if session.process.returncode is not None and not session.finished:
+        # Give the readers a moment to collect the last output the process wrote
+        await asyncio.wait(session.tasks[:2], timeout=0.1)
 
     session.last_read = datetime.now()
 
@@ -582,21 +1723,27 @@ async def read_output(session_id: str, output_type: str = "both") -> str:
     returncode = session.process.returncode
     is_running = returncode is None
 
-    # Clean up session if process has completed
-    if not is_running:
-        del active_sessions[session_id]
+    result = read_session_output(
+        session, output_enum, max_bytes, since_offset, stderr_since_offset
+    )
+    metrics = session_metrics(session)
+
+    # Clean up session once the process has completed and its output has been read
+    if session.finished and not (result.get("stdout_remaining") or result.get("stderr_remaining")):
+        remove_session(session_id)
 
     # Format output
     return format_output(
         {
-            "stdout": session.stdout_buffer,
-            "stderr": session.stderr_buffer,
+            **result,
             "returncode": returncode,
             "execution_time": (datetime.now() - session.start_time).total_seconds(),
             "timed_out": is_running,
             "session_id": session_id,
+            "metrics": metrics,
+            "oom_killed": session_oom_killed(session),
         },
-        OutputType(output_type.lower()),
+        output_enum,
     )
 
 
@@ -609,13 +1756,17 @@ async def force_terminate(session_id: str) -> str:
     if not session:
         return f"Error: Session {session_id} not found"
 
+    if session.process is None:
+        remove_session(session_id)  # Never started: just leave the queue
+        return f"Session {session_id} removed from the queue"
+
     session.process.terminate()
     try:
         await asyncio.wait_for(session.process.wait(), timeout=5.0)
     except asyncio.TimeoutError:
         session.process.kill()
 
-    del active_sessions[session_id]
+    remove_session(session_id)
     return f"Session {session_id} terminated"
 
 
@@ -632,10 +1783,26 @@ def list_sessions() -> str:
         output.append(f"  Command: {session.command}")
         output.append(f"  Runtime: {runtime:.1f} seconds")
         output.append(f"  Last read: {session.last_read.strftime('%H:%M:%S')}")
+        if session.process is None:
+            output.append(f"  Queued: position {heavy_jobs.position(session.slot)} for a heavy job slot")
+        else:
+            output.append(f"  {format_metrics(session_metrics(session))}")
 
     return "\n".join(output)
 
 
+@mcp.tool()
+def get_metrics() -> str:
+    """
+    Resource usage of finished sessions per program, in the Prometheus text format.
+
+    Counts sessions, wall and CPU time, storage I/O and output bytes, and
+    the largest max RSS seen for each program, followed by the tool latency
+    histograms that get_server_stats summarizes.
+    """
+    return render_metrics()
+
+
 @mcp.tool()
 def list_processes(name_filter: str = None) -> str:
     """List all running system processes
@@ -736,99 +1903,55 @@ async def execute_script(
         os.chmod(script_path, 0o755)
 
         # Build command based on script type
+        pooled_language = None  # Set when a warm interpreter can run the script
         if script_type == "bash" or script_type == "sh":
             command = f"bash {script_path}"
         elif script_type == "python" or script_type == "py":
             command = f"python {script_path}"
+            pooled_language = "python"
         elif script_type == "js" or script_type == "javascript":
             command = f"node {script_path}"
+            pooled_language = "node"
         elif script_type == "ts" or script_type == "typescript":
             command = f"ts-node {script_path}"
-        elif script_type == "rust" or script_type == "rs":
-            # For Rust, we need to compile and then run
-            rust_dir = tempfile.mkdtemp()
-            src_dir = os.path.join(rust_dir, "src")
-            os.makedirs(src_dir)
-
-            # Move the script to the src directory
-            rs_file = os.path.join(src_dir, "main.rs")
-            shutil.move(script_path, rs_file)
-
-            # Create a simple Cargo.toml
-            with open(os.path.join(rust_dir, "Cargo.toml"), "w") as f:
-                f.write(
-                    """
-[package]
-name = "temp_script"
-version = "0.1.0"
-edition = "2021"
-
-[dependencies]
-                """.strip()
-                )
-
-            # Compile and run
-            compile_process = await create_async_process(
-                f"cd {rust_dir} && cargo build --release",
-                working_directory=working_directory,
-            )
-            try:
-                compile_stdout, compile_stderr = await asyncio.wait_for(
-                    compile_process.communicate(), timeout=60
-                )
-                if compile_process.returncode == 0:
-                    command = (
-                        f"{os.path.join(rust_dir, 'target', 'release', 'temp_script')}"
-                    )
-                else:
-                    return format_output(
-                        {
-                            "stdout": compile_stdout.decode() if compile_stdout else "",
-                            "stderr": compile_stderr.decode() if compile_stderr else "",
-                            "returncode": compile_process.returncode,
-                            "execution_time": 60,
-                            "timed_out": False,
-                        },
-                        output_enum,
-                    )
-            except asyncio.TimeoutError:
-                return "Rust compilation timed out"
-
-        elif script_type == "go":
-            # For Go, we need to compile and then run
-            go_file = script_path
-            exe_file = script_path + ".exe"
-
-            # Compile the Go code
-            compile_process = await create_async_process(
-                f"go build -o {exe_file} {go_file}", working_directory=working_directory
-            )
+        elif script_type in ("rust", "rs", "go"):
+            # Compile (or reuse the cached binary) and then run
+            language = "go" if script_type == "go" else "rust"
             try:
-                compile_stdout, compile_stderr = await asyncio.wait_for(
-                    compile_process.communicate(), timeout=60
+                binary, failure = await compile_script(
+                    language, script, script_path, working_directory, wait_time
                 )
-                if compile_process.returncode == 0:
-                    command = exe_file
-                else:
-                    return format_output(
-                        {
-                            "stdout": compile_stdout.decode() if compile_stdout else "",
-                            "stderr": compile_stderr.decode() if compile_stderr else "",
-                            "returncode": compile_process.returncode,
-                            "execution_time": 60,
-                            "timed_out": False,
-                        },
-                        output_enum,
-                    )
+            except HeavyJobsBusy as e:
+                return f"Error: {e}"
             except asyncio.TimeoutError:
-                return "Go compilation timed out"
+                return f"{language.capitalize()} compilation timed out"
+            if failure:
+                return format_output(failure, output_enum)
+            command = shlex.quote(binary)
         else:
             os.unlink(script_path)
             return f"Unsupported script type: {script_type}"
 
-        # Execute the script using execute_command
+        # Python and JavaScript run in a warm interpreter when one is available
+        if pooled_language and script_pool.size > 0 and not is_command_blacklisted(command):
+            cgroup = session_cgroups.create()
+            try:
+                process = await script_pool.run(
+                    pooled_language, script_path, working_directory, cgroup
+                )
+            except OSError:
+                process = None  # Interpreter could not be started; try the plain command
+                if cgroup:
+                    session_cgroups.release(cgroup)
+            if process is not None:
+                process.cgroup = cgroup
+                session = new_session(command, process)
+                return await run_session(session, wait_time, output_type)
+
+        # Execute the script using execute_command. It must not be queued: the
+        # script file is removed when this call returns
         return await execute_command(
-            command, wait_time, output_type, working_directory=working_directory
+            command, wait_time, output_type, working_directory=working_directory, heavy=False
         )
     finally:
         # Clean up temporary files
@@ -897,5 +2020,7 @@ def configure_packages(config: Dict[str, List[str]]) -> str:
 
 
 if __name__ == "__main__":
+    if METRICS_PORT:
+        start_metrics_server(int(METRICS_PORT), render_metrics)
     print("Command Execution MCP Server running", file=sys.stderr)
     mcp.run()
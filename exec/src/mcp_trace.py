@@ -0,0 +1,490 @@
+# mcp_trace.py
+#
+# Per-tool latency tracing shared by the filesystem, exec and web servers.
+# Each server is built from its own directory, so exec/src and web/src carry
+# identical copies of this file; change all three together.
+
+import os
+import sys
+import time
+import atexit
+import inspect
+import logging
+import threading
+import functools
+import multiprocessing
+from collections import Counter
+from contextvars import ContextVar
+from typing import Any, Callable, Dict, List, Optional, Tuple
+
+# --- Configuration Constants ---
+TRACE_ENABLED = os.environ.get("MCP_TRACE", "1").lower() not in ("0", "false", "no", "off")
+# Upper bounds of the exported latency histogram buckets: 100 µs doubling up to ~210 s
+LATENCY_BUCKETS = tuple(0.0001 * 2**k for k in range(22))
+# Quantiles are exact over this many most recent samples per tool or phase
+QUANTILE_WINDOW = 1024
+# Set to a file path to run the sampling profiler and write collapsed stacks there
+PROFILE_DUMP = os.environ.get("MCP_PROFILE_DUMP")
+PROFILE_INTERVAL = int(os.environ.get("MCP_PROFILE_INTERVAL_MS", "10")) / 1000
+PROFILE_MAX_STACKS = 100000  # Distinct stacks kept; later ones are counted as "[other]"
+# Interface the /metrics endpoint listens on; set to 0.0.0.0 to scrape from outside a container
+METRICS_HOST = os.environ.get("MCP_METRICS_HOST", "127.0.0.1")
+
+log = logging.getLogger("mcp_trace")
+
+# Name of the tool the current request runs, inherited by tasks it starts
+_current_tool: ContextVar[Optional[str]] = ContextVar("mcp_current_tool", default=None)
+
+
+class LatencyHistogram:
+    """Cumulative bucket counts for export, plus a ring of recent samples for p50/p99."""
+
+    __slots__ = ("bucket_counts", "count", "total", "errors", "recent", "next_slot")
+
+    def __init__(self):
+        self.bucket_counts = [0] * (len(LATENCY_BUCKETS) + 1)  # Last one is +Inf
+        self.count = 0
+        self.total = 0.0
+        self.errors = 0
+        self.recent: List[float] = []
+        self.next_slot = 0
+
+    def observe(self, seconds: float, error: bool = False):
+        index = 0
+        while index < len(LATENCY_BUCKETS) and seconds > LATENCY_BUCKETS[index]:
+            index += 1
+        self.bucket_counts[index] += 1
+        self.count += 1
+        self.total += seconds
+        if error:
+            self.errors += 1
+        if len(self.recent) < QUANTILE_WINDOW:
+            self.recent.append(seconds)
+        else:
+            self.recent[self.next_slot] = seconds
+            self.next_slot = (self.next_slot + 1) % QUANTILE_WINDOW
+
+    def quantile(self, q: float) -> float:
+        if not self.recent:
+            return 0.0
+        ordered = sorted(self.recent)
+        return ordered[min(len(ordered) - 1, int(q * len(ordered)))]
+
+
+class _Stats:
+    """Everything recorded since start, guarded by one lock."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.server = "mcp"
+        self.tools: Dict[str, LatencyHistogram] = {}
+        # (tool, phase) -> histogram; tool is "-" for work outside any tool call
+        self.phases: Dict[Tuple[str, str], LatencyHistogram] = {}
+        # (tool, kind) -> bytes
+        self.bytes: Counter = Counter()
+
+
+_stats = _Stats()
+_otel_tracer = None
+
+
+def _observe_phase(tool: Optional[str], phase: str, seconds: float, error: bool):
+    key = (tool or "-", phase)
+    with _stats.lock:
+        histogram = _stats.phases.get(key)
+        if histogram is None:
+            histogram = _stats.phases[key] = LatencyHistogram()
+        histogram.observe(seconds, error)
+
+
+class span:
+    """
+    Time a phase of the current tool call: `with span("diff"): ...`.
+
+    Phases are inclusive, so a read inside a parse counts towards both, and
+    phases of concurrent tasks overlap.
+    """
+
+    __slots__ = ("phase", "start", "otel")
+
+    def __init__(self, phase: str):
+        self.phase = phase
+        self.otel = None
+
+    def __enter__(self):
+        if _otel_tracer is not None:
+            self.otel = _otel_tracer.start_as_current_span(self.phase)
+            self.otel.__enter__()
+        self.start = time.perf_counter()
+        return self
+
+    def __exit__(self, exc_type, exc, tb):
+        elapsed = time.perf_counter() - self.start
+        if TRACE_ENABLED:
+            _observe_phase(_current_tool.get(), self.phase, elapsed, exc_type is not None)
+        if self.otel is not None:
+            self.otel.__exit__(exc_type, exc, tb)
+        return False
+
+
+def traced(phase: str) -> Callable:
+    """Decorator form of span for plain and async functions."""
+
+    def decorator(func: Callable) -> Callable:
+        if not TRACE_ENABLED:
+            return func
+        if inspect.iscoroutinefunction(func):
+
+            @functools.wraps(func)
+            async def async_wrapper(*args, **kwargs):
+                with span(phase):
+                    return await func(*args, **kwargs)
+
+            return async_wrapper
+
+        @functools.wraps(func)
+        def wrapper(*args, **kwargs):
+            with span(phase):
+                return func(*args, **kwargs)
+
+        return wrapper
+
+    return decorator
+
+
+def add_bytes(kind: str, count: int):
+    """Count bytes of some kind ("read", "fetched", ...) towards the current tool."""
+    if TRACE_ENABLED and count:
+        with _stats.lock:
+            _stats.bytes[(_current_tool.get() or "-", kind)] += count
+
+
+def _record_call(name: str, seconds: float, error: bool, result: Any):
+    with _stats.lock:
+        histogram = _stats.tools.get(name)
+        if histogram is None:
+            histogram = _stats.tools[name] = LatencyHistogram()
+        histogram.observe(seconds, error)
+        if isinstance(result, str):
+            _stats.bytes[(name, "response")] += len(result.encode("utf-8", errors="ignore"))
+
+
+def traced_tool(func: Callable, name: Optional[str] = None) -> Callable:
+    """Wrap a tool function so each call records its latency, errors and response size."""
+    name = name or func.__name__
+
+    def enter():
+        otel = None
+        if _otel_tracer is not None:
+            otel = _otel_tracer.start_as_current_span(f"tool {name}")
+            otel.__enter__()
+        return _current_tool.set(name), otel, time.perf_counter()
+
+    def leave(state, error: bool, result: Any, exc_info=(None, None, None)):
+        token, otel, start = state
+        _record_call(name, time.perf_counter() - start, error, result)
+        _current_tool.reset(token)
+        if otel is not None:
+            otel.__exit__(*exc_info)
+
+    if inspect.iscoroutinefunction(func):
+
+        @functools.wraps(func)
+        async def async_wrapper(*args, **kwargs):
+            state = enter()
+            try:
+                result = await func(*args, **kwargs)
+            except BaseException as e:
+                leave(state, True, None, (type(e), e, e.__traceback__))
+                raise
+            leave(state, False, result)
+            return result
+
+        return async_wrapper
+
+    @functools.wraps(func)
+    def wrapper(*args, **kwargs):
+        state = enter()
+        try:
+            result = func(*args, **kwargs)
+        except BaseException as e:
+            leave(state, True, None, (type(e), e, e.__traceback__))
+            raise
+        leave(state, False, result)
+        return result
+
+    return wrapper
+
+
+def reset_stats():
+    with _stats.lock:
+        _stats.tools.clear()
+        _stats.phases.clear()
+        _stats.bytes.clear()
+
+
+def format_stats(tool_name: Optional[str] = None) -> str:
+    """Per-tool and per-phase latency summary as text."""
+
+    def row(label: str, h: LatencyHistogram) -> str:
+        return (
+            f"{label}: {h.count} calls, p50 {h.quantile(0.5) * 1000:.2f} ms, "
+            f"p99 {h.quantile(0.99) * 1000:.2f} ms, mean {h.total / h.count * 1000:.2f} ms"
+            + (f", {h.errors} errors" if h.errors else "")
+        )
+
+    with _stats.lock:
+        tools = sorted(_stats.tools.items(), key=lambda item: -item[1].total)
+        lines = []
+        for name, histogram in tools:
+            if tool_name and name != tool_name:
+                continue
+            lines.append(row(name, histogram))
+            for (tool, phase), phase_histogram in sorted(_stats.phases.items()):
+                if tool == name:
+                    lines.append("  " + row(phase, phase_histogram))
+            for (tool, kind), count in sorted(_stats.bytes.items()):
+                if tool == name:
+                    lines.append(f"  {kind} bytes: {count}")
+        if not tool_name:
+            untracked = [(phase, h) for (tool, phase), h in sorted(_stats.phases.items()) if tool == "-"]
+            if untracked:
+                lines.append("Outside tool calls (worker threads, startup):")
+                lines.extend("  " + row(phase, h) for phase, h in untracked)
+    if not lines:
+        return f"No calls recorded{f' for {tool_name}' if tool_name else ''}."
+    return "\n".join(lines)
+
+
+def render_prometheus() -> str:
+    """Tool and phase latency histograms and byte counters in the Prometheus text format."""
+
+    def label(**labels: str) -> str:
+        parts = []
+        for key, value in labels.items():
+            escaped = value.replace("\\", "\\\\").replace('"', '\\"').replace("\n", "\\n")
+            parts.append(f'{key}="{escaped}"')
+        return "{" + ",".join(parts) + "}"
+
+    def histogram_lines(name: str, labels: Dict[str, str], h: LatencyHistogram) -> List[str]:
+        lines = []
+        cumulative = 0
+        for bound, count in zip(LATENCY_BUCKETS + (None,), h.bucket_counts):
+            cumulative += count
+            le = "+Inf" if bound is None else f"{bound:g}"
+            lines.append(f"{name}_bucket{label(**labels, le=le)} {cumulative}")
+        lines.append(f"{name}_sum{label(**labels)} {round(h.total, 6)}")
+        lines.append(f"{name}_count{label(**labels)} {h.count}")
+        return lines
+
+    with _stats.lock:
+        server = _stats.server
+        lines = [
+            "# HELP mcp_tool_duration_seconds Latency of MCP tool calls",
+            "# TYPE mcp_tool_duration_seconds histogram",
+        ]
+        for name, h in sorted(_stats.tools.items()):
+            lines.extend(histogram_lines("mcp_tool_duration_seconds", {"server": server, "tool": name}, h))
+        lines += [
+            "# HELP mcp_tool_errors_total Tool calls that raised",
+            "# TYPE mcp_tool_errors_total counter",
+        ]
+        for name, h in sorted(_stats.tools.items()):
+            lines.append(f"mcp_tool_errors_total{label(server=server, tool=name)} {h.errors}")
+        lines += [
+            "# HELP mcp_phase_duration_seconds Time spent in one phase of a tool call",
+            "# TYPE mcp_phase_duration_seconds histogram",
+        ]
+        for (tool, phase), h in sorted(_stats.phases.items()):
+            lines.extend(
+                histogram_lines("mcp_phase_duration_seconds", {"server": server, "tool": tool, "phase": phase}, h)
+            )
+        lines += [
+            "# HELP mcp_tool_bytes_total Bytes read, fetched or returned per tool",
+            "# TYPE mcp_tool_bytes_total counter",
+        ]
+        for (tool, kind), count in sorted(_stats.bytes.items()):
+            lines.append(f"mcp_tool_bytes_total{label(server=server, tool=tool, kind=kind)} {count}")
+    return "\n".join(lines) + "\n"
+
+
+def start_metrics_server(
+    port: int, render: Callable[[], str] = render_prometheus, host: str = METRICS_HOST
+):
+    """Serve render() at /metrics from a background thread on host (localhost by default)"""
+    from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+    class MetricsHandler(BaseHTTPRequestHandler):
+        def do_GET(self):
+            if self.path.split("?")[0] != "/metrics":
+                self.send_error(404)
+                return
+            body = render().encode()
+            self.send_response(200)
+            self.send_header("Content-Type", "text/plain; version=0.0.4")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+        def log_message(self, *args):
+            pass  # Keep stderr for the MCP server's own messages
+
+    server = ThreadingHTTPServer((host, port), MetricsHandler)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    return server
+
+
+# --- OpenTelemetry ---
+def _setup_otel(server: str):
+    """
+    Export tool calls and phases as OpenTelemetry spans when an OTLP endpoint
+    is configured and the SDK and OTLP exporter are installed. Neither is a
+    dependency of the servers; without them only the in-process stats exist.
+    """
+    global _otel_tracer
+    if not os.environ.get("OTEL_EXPORTER_OTLP_ENDPOINT") or not TRACE_ENABLED:
+        return
+    try:
+        from opentelemetry import trace
+        from opentelemetry.sdk.resources import Resource
+        from opentelemetry.sdk.trace import TracerProvider
+        from opentelemetry.sdk.trace.export import BatchSpanProcessor
+        from opentelemetry.exporter.otlp.proto.http.trace_exporter import OTLPSpanExporter
+    except ImportError as e:
+        log.warning(f"OTEL_EXPORTER_OTLP_ENDPOINT is set but OpenTelemetry is not installed: {e}")
+        return
+    provider = TracerProvider(
+        resource=Resource.create({"service.name": os.environ.get("OTEL_SERVICE_NAME", f"mcp-{server}")})
+    )
+    provider.add_span_processor(BatchSpanProcessor(OTLPSpanExporter()))
+    trace.set_tracer_provider(provider)
+    atexit.register(provider.shutdown)
+    _otel_tracer = trace.get_tracer("mcp_trace")
+
+
+# --- Sampling Profiler ---
+class SamplingProfiler:
+    """
+    Samples every thread's stack each interval and counts identical stacks.
+
+    Dumps are in the collapsed format ("outer;inner count" per line) read by
+    flamegraph.pl and speedscope. Samples are wall-clock, so threads blocked
+    on I/O or locks show up where they wait.
+    """
+
+    def __init__(self, path: str, interval: float):
+        self.path = path
+        self.interval = interval
+        self.stacks: Counter = Counter()
+        self.samples = 0
+        self.lock = threading.Lock()
+        self.thread = threading.Thread(target=self._run, name="mcp-profiler", daemon=True)
+
+    def start(self):
+        self.thread.start()
+        atexit.register(self.dump)
+
+    def _run(self):
+        own_id = threading.get_ident()
+        while True:
+            time.sleep(self.interval)
+            names = {t.ident: t.name for t in threading.enumerate()}
+            for thread_id, frame in sys._current_frames().items():
+                if thread_id == own_id:
+                    continue
+                stack = []
+                while frame is not None:
+                    code = frame.f_code
+                    stack.append(f"{os.path.basename(code.co_filename)}:{code.co_name}")
+                    frame = frame.f_back
+                stack.append(names.get(thread_id, str(thread_id)))
+                key = ";".join(reversed(stack))
+                with self.lock:
+                    if key not in self.stacks and len(self.stacks) >= PROFILE_MAX_STACKS:
+                        key = "[other]"
+                    self.stacks[key] += 1
+            with self.lock:
+                self.samples += 1
+
+    def dump(self) -> str:
+        with self.lock:
+            lines = [f"{stack} {count}" for stack, count in self.stacks.most_common()]
+            samples = self.samples
+        with open(self.path, "w", encoding="utf-8") as f:
+            f.write("\n".join(lines) + "\n")
+        return f"Wrote {len(lines)} stacks from {samples} samples to {self.path}"
+
+
+profiler: Optional[SamplingProfiler] = None
+
+
+def instrument(mcp, server: str):
+    """
+    Trace every tool registered with mcp from here on and add get_server_stats.
+
+    Call right after creating the FastMCP instance. The functions themselves
+    are returned unwrapped, so in-process calls between tools are not counted
+    twice. Starts the profiler when MCP_PROFILE_DUMP is set.
+    """
+    global profiler
+    _stats.server = server
+    if not TRACE_ENABLED:
+        return
+    # Worker processes re-import the server module; leave exporting and
+    # profiling to the parent, or they would all write the same dump file
+    is_worker = multiprocessing.parent_process() is not None
+    if not is_worker:
+        _setup_otel(server)
+    if PROFILE_DUMP and profiler is None and not is_worker:
+        profiler = SamplingProfiler(PROFILE_DUMP, PROFILE_INTERVAL)
+        profiler.start()
+
+    register = mcp.tool
+
+    def tool(*args, **kwargs):
+        decorator = register(*args, **kwargs)
+
+        def wrap(func: Callable) -> Callable:
+            decorator(traced_tool(func, kwargs.get("name")))
+            return func
+
+        return wrap
+
+    mcp.tool = tool
+
+    @mcp.tool()
+    def get_server_stats(
+        tool_name: Optional[str] = None,
+        prometheus: bool = False,
+        dump_profile: bool = False,
+        reset: bool = False,
+    ) -> str:
+        """
+        Latency of this server's tools since it started.
+
+        For each tool: call count, p50 and p99 over the recent calls, mean and
+        errors, then the same for the phases it spent time in (validate_path,
+        lock_wait, read, parse, diff, log_write, fetch, convert, ...) and the
+        bytes it read, fetched and returned.
+
+        Args:
+            tool_name: Only report this tool (default: all tools, slowest total first)
+            prometheus: Return histograms in the Prometheus text format instead
+            dump_profile: Also write the sampling profiler's stacks to MCP_PROFILE_DUMP
+            reset: Clear the recorded stats after reporting them
+
+        Returns:
+            The stats as text
+        """
+        output = render_prometheus() if prometheus else format_stats(tool_name)
+        if dump_profile:
+            if profiler is None:
+                output += "\nProfiler not running: set MCP_PROFILE_DUMP to a file path to enable it."
+            else:
+                try:
+                    output += "\n" + profiler.dump()
+                except OSError as e:
+                    output += f"\nError writing profile: {e}"
+        if reset:
+            reset_stats()
+        return output
@@ -6,11 +6,14 @@ import argparse
 import os
 import shutil
 from pathlib import Path
-from typing import List, Dict, Any, Optional, Tuple
+from typing import List, Dict, Any, Optional, Tuple, Callable
 
 # Import from local utility and history modules
 import mcpdiff_utils as utils
 import mcpdiff_history as history
+import mcpdiff_index
+import mcpdiff_objects
+import mcpdiff_serve
 from mcpdiff_utils import (
     log,
     HistoryError,
@@ -32,16 +35,17 @@ def handle_status(
 ) -> None:
     """Handle the status command."""
     log.debug("Processing status command")
+    index = args.history_index
 
-    if not all_entries:
+    total_available = index.count()
+    if not total_available:
         print(f"{utils.COLOR_YELLOW}No edit history entries found.{utils.COLOR_RESET}")
         return
 
     # Apply filters - Use limit=0 to show all if limit not specified or <= 0
     display_limit = args.limit if args.limit > 0 else 0
     # Filter returns newest first if limited
-    filtered_entries = history.filter_entries(
-        all_entries,
+    filtered_entries = index.filter_entries(
         conv_id=args.conv,
         file_path=args.file,
         status=args.status,
@@ -67,9 +71,6 @@ def handle_status(
 
     # Print summary
     total_shown = len(filtered_entries)
-    total_available = len(
-        all_entries
-    )  # Or count after non-limit filters? Let's use total.
     print(f"\nShowing {total_shown} of {total_available} total entries.")
     if display_limit > 0 and total_shown == display_limit:
         print(f"(Limited to {display_limit}, use -n 0 to show all matching)")
@@ -99,14 +100,15 @@ def handle_show(
     """Handle the show command."""
     identifier = args.identifier
     log.debug(f"Processing show command for identifier: {identifier}")
+    index = args.history_index
 
-    if not all_entries:
+    if not index.count():
         print(f"{utils.COLOR_YELLOW}No edit history entries found.{utils.COLOR_RESET}")
         return
 
     # Try finding a single entry by edit ID prefix
     try:
-        entry = history.find_entry_by_id(all_entries, identifier)
+        entry = history.find_entry_by_id(index.find_by_id_prefix(identifier), identifier)
         if entry:
             print(
                 f"\n{utils.COLOR_CYAN}Details for Edit: {entry.get('edit_id', 'N/A')}{utils.COLOR_RESET}"
@@ -129,7 +131,7 @@ def handle_show(
         return  # Exit handler gracefully
 
     # If not found as a unique edit ID, try as a conversation ID prefix/suffix
-    conv_entries = history.find_entries_by_conversation(all_entries, identifier)
+    conv_entries = index.find_by_conversation(identifier)
 
     if not conv_entries:
         print(
@@ -220,9 +222,12 @@ def _accept_or_reject_single(
         expected_hash = (
             last_applied_edit.get("hash_after") if last_applied_edit else None
         )
+        expected_stat = (
+            last_applied_edit.get("stat_after") if last_applied_edit else None
+        )
 
         if not history.verify_and_prompt_if_modified(
-            file_path_abs, expected_hash, history_root, workspace_root
+            file_path_abs, expected_hash, history_root, workspace_root, expected_stat
         ):
             print(
                 f"{utils.COLOR_YELLOW}Operation aborted by user due to external modifications.{utils.COLOR_RESET}"
@@ -252,6 +257,7 @@ def _accept_or_reject_single(
             final_hash = recon_result["hash"]
             # Update the entry's hash_after field BEFORE updating status
             entry["hash_after"] = final_hash  # Modify in-memory copy
+            entry["stat_after"] = recon_result.get("stat")
 
             # Now update status in the log file
             if history.update_entry_status(
@@ -477,6 +483,24 @@ def _accept_or_reject_conversation(
         if file_path:
             entries_by_file.setdefault(file_path, []).append(entry)
 
+    # --- Hash files whose stat changed in parallel, ahead of verification ---
+    # Hashes are cached by stat, so a file touched meanwhile is hashed again.
+    to_hash = []
+    for file_path_rel in entries_by_file:
+        last_applied_edit = history.get_last_applied_edit_for_file(
+            file_path_rel, all_entries
+        )
+        if not last_applied_edit or not last_applied_edit.get("hash_after"):
+            continue
+        file_path_abs = workspace_root / file_path_rel
+        if file_path_abs.exists() and not utils.stat_matches(
+            file_path_abs, last_applied_edit.get("stat_after")
+        ):
+            to_hash.append(str(file_path_abs))
+    if to_hash:
+        log.debug(f"Hashing {len(to_hash)} files whose stat changed")
+        utils.prime_hash_cache(to_hash)
+
     total_successful = 0
     total_failed = 0
 
@@ -501,8 +525,11 @@ def _accept_or_reject_conversation(
         expected_hash = (
             last_applied_edit.get("hash_after") if last_applied_edit else None
         )
+        expected_stat = (
+            last_applied_edit.get("stat_after") if last_applied_edit else None
+        )
         if not history.verify_and_prompt_if_modified(
-            file_path_abs, expected_hash, history_root, workspace_root
+            file_path_abs, expected_hash, history_root, workspace_root, expected_stat
         ):
             print(
                 f"{utils.COLOR_YELLOW}Skipping file {file_path_rel} due to user cancellation.{utils.COLOR_RESET}"
@@ -535,6 +562,7 @@ def _accept_or_reject_conversation(
                 # Update status for all relevant edits for this file
                 for entry in file_edits:
                     entry["hash_after"] = final_hash  # Update in-memory hash
+                    entry["stat_after"] = recon_result.get("stat")
                     if history.update_entry_status(
                         entry, "accepted", history_root, lock_timeout=lock_timeout
                     ):
@@ -928,11 +956,49 @@ def handle_cleanup(
     else:
         print("No stale locks found to clean up.")
 
+    if getattr(args, "compact", False):
+        log.info("Compacting history logs...")
+        rewritten, removed = history.compact_log_files(
+            history_root, lock_timeout=args.timeout
+        )
+        if rewritten > 0:
+            print(
+                f"{utils.COLOR_GREEN}Compacted {rewritten} log file(s), removed {removed} redundant line(s).{utils.COLOR_RESET}"
+            )
+        else:
+            print("History logs are already compact.")
+
+        log.info("Packing loose history objects...")
+        try:
+            packed = mcpdiff_objects.pack_loose_objects(history_root)
+        except utils.HistoryError as e:
+            print(f"{utils.COLOR_RED}Failed to pack objects: {e}{utils.COLOR_RESET}")
+        else:
+            if packed > 0:
+                print(
+                    f"{utils.COLOR_GREEN}Packed {packed} loose object(s).{utils.COLOR_RESET}"
+                )
+
+
+def handle_serve(
+    args: argparse.Namespace,
+    workspace_root: Path,
+    history_root: Path,
+    all_entries: List[Dict[str, Any]],
+) -> None:
+    """Handle the serve command: answer JSON-RPC requests on stdin until EOF."""
+    log.debug("Starting JSON-RPC server on stdio")
+    session = mcpdiff_serve.ServeSession(
+        build_parser(), workspace_root, history_root, args.timeout, run_command
+    )
+    mcpdiff_serve.serve(session)
+
 
 # --- Main Execution ---
 
 
-def main():
+def build_parser() -> argparse.ArgumentParser:
+    """Build the command-line parser; also used by serve to parse request arguments."""
     parser = argparse.ArgumentParser(
         description="MCP Diff Tool: Review and manage LLM file edits.",
         formatter_class=argparse.RawDescriptionHelpFormatter,
@@ -950,6 +1016,8 @@ Examples:
   mcpdiff review                     # Interactively review pending edits (oldest first)
   mcpdiff review -c <conv_id>        # Review pending edits for a specific conversation
   mcpdiff cleanup                    # Clean up stale locks
+  mcpdiff cleanup --compact          # Also compact history logs and pack objects
+  mcpdiff serve                      # Answer JSON-RPC requests on stdin (editor plugins)
 """,
     )
     parser.add_argument(
@@ -1002,7 +1070,7 @@ Examples:
         "--op",
         help="Filter by operation type (e.g., edit, create, delete, move, replace).",
     )
-    parser_status.set_defaults(func=handle_status)
+    parser_status.set_defaults(func=handle_status, uses_index=True)
 
     # show
     parser_show = subparsers.add_parser(
@@ -1012,7 +1080,7 @@ Examples:
         "identifier",
         help="The edit_id prefix or conversation_id prefix/suffix to show.",
     )
-    parser_show.set_defaults(func=handle_show)
+    parser_show.set_defaults(func=handle_show, uses_index=True)
 
     # accept
     parser_accept = subparsers.add_parser(
@@ -1065,14 +1133,70 @@ Examples:
     parser_cleanup = subparsers.add_parser(
         "cleanup", aliases=["clean"], help="Clean up stale locks."
     )
+    parser_cleanup.add_argument(
+        "--compact",
+        action="store_true",
+        help="Also rewrite append-only logs, dropping torn lines and superseded records, and pack loose objects.",
+    )
     parser_cleanup.set_defaults(func=handle_cleanup)
 
+    # serve
+    parser_serve = subparsers.add_parser(
+        "serve",
+        help="Keep history in memory and answer JSON-RPC requests on stdin (used by editor plugins).",
+    )
+    parser_serve.set_defaults(func=handle_serve)
+
     # help
     parser_help = subparsers.add_parser(
         "help", aliases=["h"], help="Show help information."
     )
     # Set a dummy function that prints help
     parser_help.set_defaults(func=lambda args, *a, **k: parser.print_help())
+    return parser
+
+
+def run_command(
+    args: argparse.Namespace,
+    workspace_root: Path,
+    history_root: Path,
+    load_history: Callable[[argparse.Namespace], List[Dict[str, Any]]],
+) -> int:
+    """
+    Load the history a command needs and run its handler.
+
+    load_history sets args.history_index and returns the entries handlers
+    replay. Errors are reported on stderr and mapped to the exit code.
+    """
+    exit_code = 0
+    try:
+        all_entries = load_history(args)
+
+        # --- Execute Command ---
+        # Pass workspace, history root, and the pre-read entries to the handler
+        args.func(args, workspace_root, history_root, all_entries)
+
+    except KeyboardInterrupt:
+        print("\nOperation cancelled by user.", file=sys.stderr)
+        exit_code = 130
+    except (HistoryError, TimeoutError, AmbiguousIDError) as e:
+        print(f"{utils.COLOR_RED}Error: {e}{utils.COLOR_RESET}", file=sys.stderr)
+        exit_code = 1
+    except Exception as e:
+        print(
+            f"{utils.COLOR_RED}An unexpected error occurred. Use --verbose for detailed logs.{utils.COLOR_RESET}",
+            file=sys.stderr,
+        )
+        print(
+            f"{utils.COLOR_RED}Error details: {e}{utils.COLOR_RESET}", file=sys.stderr
+        )
+        log.exception("Unexpected error during command execution:")
+        exit_code = 2
+    return exit_code
+
+
+def main():
+    parser = build_parser()
 
     # --- Parse Args and Setup ---
     args = parser.parse_args()
@@ -1134,40 +1258,23 @@ Examples:
         sys.exit(1)
 
     # --- Read All History Entries (Centralized) ---
-    all_entries = []
-    exit_code = 0
-    try:
+    def load_history(args: argparse.Namespace) -> List[Dict[str, Any]]:
         # Read all entries once, pass to handlers. Pass lock_timeout here.
-        # Skip reading if only doing cleanup or help.
-        if args.command not in ["cleanup", "help"]:
-            log.info("Reading edit history...")
-            all_entries = history.find_all_entries(
-                history_root, lock_timeout=lock_timeout
-            )
-            log.info(f"Found {len(all_entries)} total history entries.")
-
-        # --- Execute Command ---
-        # Pass workspace, history root, and the pre-read entries to the handler
-        args.func(args, workspace_root, history_root, all_entries)
-
-    except KeyboardInterrupt:
-        print("\nOperation cancelled by user.", file=sys.stderr)
-        exit_code = 130
-    except (HistoryError, TimeoutError, AmbiguousIDError) as e:
-        print(f"{utils.COLOR_RED}Error: {e}{utils.COLOR_RESET}", file=sys.stderr)
-        exit_code = 1
-    except Exception as e:
-        print(
-            f"{utils.COLOR_RED}An unexpected error occurred. Use --verbose for detailed logs.{utils.COLOR_RESET}",
-            file=sys.stderr,
-        )
-        print(
-            f"{utils.COLOR_RED}Error details: {e}{utils.COLOR_RESET}", file=sys.stderr
+        # Skip reading if only doing cleanup, help or serve (which syncs itself).
+        if args.command in ["cleanup", "clean", "help", "h", "serve"]:
+            return []
+        log.info("Syncing edit history index...")
+        args.history_index = mcpdiff_index.open_history_index(
+            history_root, lock_timeout=lock_timeout
         )
-        log.exception("Unexpected error during command execution:")
-        exit_code = 2
-
-    sys.exit(exit_code)
+        # status/show query the index directly; other commands replay history
+        if getattr(args, "uses_index", False):
+            return []
+        all_entries = args.history_index.all_entries()
+        log.info(f"Found {len(all_entries)} total history entries.")
+        return all_entries
+
+    sys.exit(run_command(args, workspace_root, history_root, load_history))
 
 
 if __name__ == "__main__":
@@ -1,9 +1,10 @@
 # mcpdiff_history.py
 
 import os
-import subprocess
+import time
+import difflib
+import itertools
 import shutil
-import tempfile
 import uuid
 from pathlib import Path
 from datetime import datetime, timezone
@@ -11,6 +12,8 @@ from typing import List, Dict, Any, Optional, Tuple
 
 # Import from utils module
 import mcpdiff_utils as utils
+import mcpdiff_patch as patch
+import mcpdiff_objects as objects
 from mcpdiff_utils import (
     log,
     HistoryError,
@@ -21,6 +24,9 @@ from mcpdiff_utils import (
     CHECKPOINTS_DIR,
 )
 
+# Operations that change file content (snapshot and revert entries do not)
+CONTENT_OPERATIONS = ("create", "edit", "replace", "delete", "move")
+
 
 # --- Workspace Root Finding ---
 def find_workspace_root(start_path: Optional[str] = None) -> Optional[Path]:
@@ -86,9 +92,14 @@ def find_all_entries(
             log.debug(f"Reading log file: {log_file}")
             # Pass the actual lock timeout value
             entries = utils.read_log_file(log_file, lock_timeout=lock_timeout)
-            # Add log file source to each entry for later updates
+            # A repeated edit_id (e.g. an appended status change) supersedes earlier records
+            latest: Dict[str, Dict[str, Any]] = {}
             for entry in entries:
+                # Add log file source to each entry for later updates
                 entry["log_file_source"] = log_file.name
+                latest.pop(entry.get("edit_id"), None)
+                latest[entry.get("edit_id")] = entry
+            entries = list(latest.values())
             all_entries.extend(entries)
             log.debug(f"Found {len(entries)} entries in {log_file}")
         except HistoryError as e:
@@ -301,41 +312,18 @@ def update_entry_status(
         )
         return False
 
+    # Append a superseding record instead of rewriting the log; readers and the
+    # history index keep the last record per edit_id. The in-memory entry may be
+    # stale (callers reset statuses after failures), so always write the record.
+    updated_entry = {k: v for k, v in entry_to_update.items() if k != "log_file_source"}
+    updated_entry["status"] = new_status
+    # Use consistent ISO 8601 format with Z
+    updated_entry["updated_at"] = (
+        datetime.now(timezone.utc).isoformat(timespec="milliseconds").replace("+00:00", "Z")
+    )
     try:
-        # Read all entries from the specific log file
-        # Pass the specific timeout value
-        entries = utils.read_log_file(log_file_path, lock_timeout=lock_timeout)
-
-        updated = False
-        for i, entry in enumerate(entries):
-            if entry.get("edit_id") == edit_id:
-                if entry.get("status") == new_status:
-                    log.debug(
-                        f"Entry {edit_id} already has status {new_status}. No update needed."
-                    )
-                    return True  # Considered success
-
-                log.debug(
-                    f"Updating entry {edit_id} in {log_file_name}: status -> {new_status}"
-                )
-                entries[i]["status"] = new_status
-                # Use consistent ISO 8601 format with Z
-                entries[i]["updated_at"] = (
-                    datetime.now(timezone.utc)
-                    .isoformat(timespec="milliseconds")
-                    .replace("+00:00", "Z")
-                )
-                updated = True
-                break  # Assumes edit_id is unique within a log file
-
-        if not updated:
-            log.error(
-                f"Entry {edit_id} not found in log file {log_file_path}. Cannot update status."
-            )
-            return False
-
-        # Write back all entries to the same log file
-        utils.write_log_file(log_file_path, entries, lock_timeout=lock_timeout)
+        log.debug(f"Updating entry {edit_id} in {log_file_name}: status -> {new_status}")
+        utils.append_log_entry(log_file_path, updated_entry, lock_timeout=lock_timeout)
         log.info(
             f"Successfully updated status of entry {edit_id} to {new_status} in {log_file_name}"
         )
@@ -367,6 +355,12 @@ def get_diff_for_entry(entry: Dict[str, Any], history_root: Path) -> Optional[st
         source = entry.get("source_path", "unknown_source")
         dest = entry.get("file_path", "unknown_dest")
         return f"OPERATION: MOVE\nSource: {source}\nDestination: {dest}"
+    if entry.get("content_file") and not diff_file_rel_path:
+        # The server stores full content instead of a diff for oversized changes
+        return (
+            f"OPERATION: {operation.upper()}\nFile: {entry.get('file_path')}\n"
+            "(Change too large for a diff; full content stored)"
+        )
     if (
         operation in ["create", "delete", "snapshot", "revert"]
         and not diff_file_rel_path
@@ -380,6 +374,16 @@ def get_diff_for_entry(entry: Dict[str, Any], history_root: Path) -> Optional[st
             return f"OPERATION: CREATE\nFile: {entry.get('file_path')}"
         return f"OPERATION: {operation.upper()}\n(No diff file associated)"
 
+    # Diffs recorded in the object store are looked up by hash
+    if diff_file_rel_path and objects.object_hash(diff_file_rel_path):
+        try:
+            return objects.read_artifact(history_root, diff_file_rel_path).decode(
+                "utf-8", errors="replace"
+            )
+        except (OSError, HistoryError) as e:
+            log.error(f"Error reading diff object {diff_file_rel_path}: {e}")
+            return None
+
     # Potential diff paths to check
     potential_paths: List[Path] = []
 
@@ -392,21 +396,20 @@ def get_diff_for_entry(entry: Dict[str, Any], history_root: Path) -> Optional[st
     if diff_file_rel_path:
         # Assume diff_file is relative to the DIFFS_DIR
         potential_paths.append(history_root / DIFFS_DIR / diff_file_rel_path)
-        # Also consider if it's relative to history_root (less likely but possible)
-        # potential_paths.append(history_root / diff_file_rel_path)
+        # The server records it relative to history_root (diffs/<conv_id>/<edit_id>.diff)
+        potential_paths.append(history_root / diff_file_rel_path)
 
     # 3. Fallback Search: <history>/diffs/*/<edit_id>.diff (If conv_id was missing/wrong)
-    #    This is less efficient but robust.
-    if edit_id:
-        search_pattern = f"{edit_id}.diff"
+    #    This is less efficient but robust, so it is only walked if 1 and 2 fail.
+    def fallback_paths():
         diffs_base = history_root / DIFFS_DIR
-        if diffs_base.is_dir():
+        if edit_id and diffs_base.is_dir():
             # Use rglob for recursive search
-            potential_paths.extend(list(diffs_base.rglob(search_pattern)))
+            yield from diffs_base.rglob(f"{edit_id}.diff")
 
     # Try reading from potential paths
     checked_paths = set()
-    for diff_path in potential_paths:
+    for diff_path in itertools.chain(potential_paths, fallback_paths()):
         abs_path = diff_path.resolve()
         if abs_path in checked_paths:
             continue  # Don't check the same resolved path twice
@@ -516,6 +519,7 @@ def apply_or_revert_edit(
     source_path_rel = entry.get("source_path")  # For move/rename
     diff_file_rel = entry.get("diff_file")
     checkpoint_file_rel = entry.get("checkpoint_file")
+    content_file_rel = entry.get("content_file")
 
     log.info(
         f"{'Reverting' if is_revert else 'Applying'} operation '{operation}' for edit {edit_id} on file '{file_path_rel}'"
@@ -546,8 +550,14 @@ def apply_or_revert_edit(
         # Assume diff_file path is relative to DIFFS_DIR
         # Allow for diff_file potentially having conv_id dir already
         potential_diff_path = history_root / DIFFS_DIR / diff_file_rel
-        if potential_diff_path.is_file():
+        if objects.object_hash(diff_file_rel):
+            if objects.artifact_exists(history_root, diff_file_rel):
+                diff_path = history_root / diff_file_rel
+        elif potential_diff_path.is_file():
             diff_path = potential_diff_path
+        elif (history_root / diff_file_rel).is_file():
+            # As recorded by the server: relative to history_root
+            diff_path = history_root / diff_file_rel
         else:
             # Fallback: Maybe it's just the filename under conv_id dir?
             conv_id = entry.get("conversation_id")
@@ -567,7 +577,7 @@ def apply_or_revert_edit(
     if checkpoint_file_rel:
         # Checkpoints are relative to history_root
         potential_chkpt_path = history_root / checkpoint_file_rel
-        if potential_chkpt_path.is_file():
+        if objects.artifact_exists(history_root, potential_chkpt_path):
             checkpoint_path = potential_chkpt_path
         else:
             log.warning(
@@ -577,6 +587,28 @@ def apply_or_revert_edit(
 
     # --- Handle Operations ---
     try:
+        # Oversized changes store the new content, and a checkpoint of the old
+        if content_file_rel and operation in ["create", "edit", "replace"]:
+            if not is_revert:
+                log.debug(f"Applying {operation} {edit_id} from stored content")
+                _write_lines(
+                    target_path,
+                    _decode_lines(objects.read_artifact(history_root, content_file_rel)),
+                )
+                return True
+            if operation != "create":
+                if not checkpoint_path:
+                    log.error(
+                        f"Cannot revert {operation} {edit_id}: checkpoint file not found or specified."
+                    )
+                    return False
+                log.debug(f"Reverting {operation} {edit_id} from {checkpoint_path}")
+                _write_lines(
+                    target_path,
+                    _decode_lines(objects.read_artifact(history_root, checkpoint_path)),
+                )
+                return True
+
         if operation == "create":
             if is_revert:
                 # Revert create = delete file
@@ -591,31 +623,9 @@ def apply_or_revert_edit(
                 # Ensure parent dir exists
                 target_path.parent.mkdir(parents=True, exist_ok=True)
                 if diff_path:
-                    # Apply patch to create content
-                    # We need an empty file to patch against
-                    with open(target_path, "w") as f:
-                        pass  # Create empty file
-                    cmd = [
-                        "git",
-                        "apply",
-                        "--verbose",
-                        "--unsafe-paths",
-                        str(diff_path),
-                    ]
-                    log.debug(f"Running apply for create: {' '.join(cmd)}")
-                    result = subprocess.run(
-                        cmd,
-                        cwd=workspace_root,
-                        capture_output=True,
-                        text=True,
-                        check=False,
-                    )
-                    if result.returncode != 0:
-                        log.error(
-                            f"Failed to apply diff for create {edit_id}: {result.stderr}\n{result.stdout}"
-                        )
-                        # Clean up potentially partially created file? Or leave it? Let's leave it.
-                        return False
+                    # Apply the diff to an empty file to produce the created content
+                    diff_content = _read_text_artifact(history_root, diff_path)
+                    _write_lines(target_path, _apply_diff([], diff_content, edit_id))
                     log.debug(f"Applied diff for create {edit_id} successfully.")
                     return True
                 else:
@@ -643,10 +653,10 @@ def apply_or_revert_edit(
                 log.debug(
                     f"Reverting delete: restoring {target_path} from {checkpoint_path}"
                 )
-                target_path.parent.mkdir(parents=True, exist_ok=True)
-                shutil.copy2(
-                    checkpoint_path, target_path
-                )  # Use copy2 to preserve metadata
+                _write_lines(
+                    target_path,
+                    _decode_lines(objects.read_artifact(history_root, checkpoint_path)),
+                )
                 return True
             else:
                 # Apply delete = delete file
@@ -696,50 +706,24 @@ def apply_or_revert_edit(
                 )
                 return False
 
-            # Check if target file exists before applying/reverting patch
-            # git apply might create the file if the diff adds it entirely,
-            # but it's safer if the file exists for standard edits/replaces.
-            # Exception: A 'replace' operation's diff might represent creating the file anew.
-            # Let git apply handle file existence issues.
-            # if not target_path.exists() and operation == "edit":
-            #      log.error(f"Cannot {'revert' if is_revert else 'apply'} edit {edit_id}: target file {target_path} does not exist.")
-            #      return False
-
-            # Use git apply
-            cmd = ["git", "apply", "--verbose", "--unsafe-paths"]
-            if is_revert:
-                cmd.append("-R")  # Apply reverse patch
-            # Apply relative to workspace root
-            cmd.extend(["--directory", str(workspace_root), str(diff_path)])
-
-            log.debug(f"Running: {' '.join(cmd)}")
-            # Run from workspace root context
-            result = subprocess.run(
-                cmd, cwd=workspace_root, capture_output=True, text=True, check=False
-            )
-
-            if result.returncode != 0:
-                # Attempt with --reject flag to see if it applies partially? No, keep it simple.
+            # A 'replace' diff may represent creating the file anew, so a missing
+            # target is treated as empty and the diff decides whether it applies.
+            current_lines = _read_lines(target_path) if target_path.exists() else []
+            diff_content = _read_text_artifact(history_root, diff_path)
+            try:
+                new_lines = _apply_diff(current_lines, diff_content, edit_id, reverse=is_revert)
+            except HistoryError as e:
                 log.error(
-                    f"Failed to {'revert' if is_revert else 'apply'} {operation} {edit_id} using git apply."
+                    f"Failed to {'revert' if is_revert else 'apply'} {operation} {edit_id}: {e}"
+                )
+                log.error(
+                    "Hint: File content may have changed since the diff was created."
                 )
-                log.error(f"Command: {' '.join(cmd)}")
-                log.error(f"Stderr: {result.stderr}")
-                log.error(f"Stdout: {result.stdout}")
-                # Check common errors
-                if (
-                    "does not exist in index" in result.stderr
-                    and not target_path.exists()
-                ):
-                    log.error(f"Hint: Target file {target_path.name} might be missing.")
-                elif "patch does not apply" in result.stderr:
-                    log.error(
-                        "Hint: File content may have changed since the diff was created."
-                    )
                 return False
+            _write_lines(target_path, new_lines)
 
             log.debug(
-                f"Successfully {'reverted' if is_revert else 'applied'} {operation} {edit_id} using git apply."
+                f"Successfully {'reverted' if is_revert else 'applied'} {operation} {edit_id}."
             )
             return True
 
@@ -778,23 +762,52 @@ def get_relevant_history_for_file(
     return file_entries
 
 
+def _first_unapplied_index(
+    file_entries: List[Dict[str, Any]], apply_only_accepted: bool
+) -> int:
+    """Index of the first content-changing entry reconstruction would skip."""
+    for i, entry in enumerate(file_entries):
+        if entry.get("operation", "").lower() not in CONTENT_OPERATIONS:
+            continue
+        status = entry.get("status", "unknown").lower()
+        if not (status == "accepted" or (status == "pending" and not apply_only_accepted)):
+            return i
+    return len(file_entries)
+
+
 def find_closest_checkpoint(
-    target_entry_index: int, file_entries: List[Dict[str, Any]], history_root: Path
+    target_entry_index: int,
+    file_entries: List[Dict[str, Any]],
+    history_root: Path,
+    apply_only_accepted: bool = False,
 ) -> Tuple[Optional[Path], int]:
     """
     Find the most recent valid checkpoint file at or before target_entry_index.
     Returns the checkpoint path and the index of the entry it corresponds to.
+
+    Periodic and snapshot checkpoints include every earlier edit, so one is
+    only usable if reconstruction would apply all of those edits too.
     """
     closest_chkpt_path: Optional[Path] = None
     closest_chkpt_entry_index: int = -1
+    first_unapplied = _first_unapplied_index(file_entries, apply_only_accepted)
 
     for i in range(target_entry_index, -1, -1):
         entry = file_entries[i]
         chkpt_rel = entry.get("checkpoint_file")
+        cumulative = (
+            entry.get("checkpoint_kind") == "periodic"
+            or entry.get("operation", "").lower() == "snapshot"
+        )
+        if cumulative and i > first_unapplied:
+            log.debug(
+                f"Skipping checkpoint at index {i}: it includes skipped edit at index {first_unapplied}"
+            )
+            continue
         # Checkpoints are relative to history_root
         if chkpt_rel:
-            potential_path = (history_root / chkpt_rel).resolve()
-            if potential_path.is_file():
+            potential_path = history_root / chkpt_rel
+            if objects.artifact_exists(history_root, potential_path):
                 log.debug(
                     f"Found potential checkpoint {potential_path} at index {i} for entry {entry.get('edit_id')}"
                 )
@@ -857,7 +870,8 @@ def reconstruct_file_from_history(
     Reconstructs the state of a file by finding the latest checkpoint
     and applying subsequent relevant edits ('accepted' and optionally 'pending').
 
-    Returns: Dict containing {'hash': final_hash or None, 'error': error_message or None}
+    Returns: Dict containing {'hash': final_hash or None, 'error': error_message or None},
+    plus 'stat', the stat_after stamp for 'hash', when the file was written.
     """
     target_file_abs = workspace_root / file_path_rel
     log.info(
@@ -886,20 +900,15 @@ def reconstruct_file_from_history(
 
     # Find the most recent checkpoint at or before the latest entry
     checkpoint_path, start_entry_index = find_closest_checkpoint(
-        latest_entry_index, file_entries, history_root
+        latest_entry_index, file_entries, history_root, apply_only_accepted
     )
 
-    temp_dir = None
     try:
-        # Create a temporary directory to work in isolation
-        temp_dir = tempfile.mkdtemp(prefix="mcp_reconstruct_")
-        temp_file_path = Path(temp_dir) / target_file_abs.name
-        log.debug(f"Using temporary directory for reconstruction: {temp_dir}")
-
-        # 1. Initialize temp file state from checkpoint or empty
+        # 1. Initialize in-memory state from checkpoint or empty
+        exists = True
         if checkpoint_path:
             log.debug(f"Initializing reconstruction from checkpoint: {checkpoint_path}")
-            shutil.copy2(checkpoint_path, temp_file_path)
+            lines = _decode_lines(objects.read_artifact(history_root, checkpoint_path))
         elif (
             start_entry_index != -1
             and file_entries[start_entry_index].get("operation", "").lower() == "create"
@@ -907,21 +916,20 @@ def reconstruct_file_from_history(
             log.debug(
                 f"Initializing reconstruction with empty file (from create at index {start_entry_index})"
             )
-            temp_file_path.touch()  # Create empty file
+            lines = []
         else:
             # No checkpoint and not starting with 'create'. What state was it in?
             # This might happen if history is incomplete or the first recorded action wasn't create/checkpointed.
-            # Best guess: if the actual file exists, start from that? Risky.
             # Safest: assume empty and log warning.
             log.warning(
                 f"Cannot determine initial state for {file_path_rel}. Starting reconstruction from empty state."
             )
-            temp_file_path.touch()
+            lines = []
+            start_entry_index = 0
 
-        # 2. Apply edits sequentially from start_entry_index + 1 up to latest_entry_index
-        current_temp_file_path = temp_file_path  # Track potential renames
-
-        for i in range(start_entry_index + 1, latest_entry_index + 1):
+        # 2. Apply edits sequentially from start_entry_index up to latest_entry_index.
+        # A checkpoint holds the state *before* its entry, so that entry is applied too.
+        for i in range(max(start_entry_index, 0), latest_entry_index + 1):
             entry = file_entries[i]
             status = entry.get("status", "unknown").lower()
             operation = entry.get("operation", "unknown").lower()
@@ -946,129 +954,35 @@ def reconstruct_file_from_history(
                 f"Applying {status} edit {entry_id} (op: {operation}) at index {i}"
             )
 
-            # We need to apply relative to the temp dir containing the file
-            temp_workspace_root = Path(temp_dir)
-
-            # --- Create a dummy entry for apply_or_revert_edit ---
-            # It needs paths relative to the *actual* workspace, but will operate
-            # within the temp dir context provided via git apply --directory or shutil.
-            # Construct a temporary entry dict for the apply function.
-            # The function needs workspace_root for path resolution internal to it.
-            # Crucially, git apply needs the diff path correctly.
-            temp_entry_for_apply = entry.copy()
-
-            # Get the correct diff path relative to the *real* history root
-            diff_file_rel = entry.get("diff_file")
-            actual_diff_path: Optional[Path] = None
-            if diff_file_rel:
-                # Assume relative to DIFFS_DIR
-                p1 = history_root / DIFFS_DIR / diff_file_rel
-                p2 = None
-                conv_id = entry.get("conversation_id")
-                if conv_id:
-                    p2 = history_root / DIFFS_DIR / conv_id / diff_file_rel
-
-                if p1.is_file():
-                    actual_diff_path = p1
-                elif p2 and p2.is_file():
-                    actual_diff_path = p2
-
-            # --- Apply using a simplified logic within the temp context ---
-            # We can't directly call apply_or_revert_edit as it modifies the actual workspace.
-            # Re-implement the core apply logic here for the temp file.
-
-            target_path_in_temp = current_temp_file_path  # The file we are modifying
-
             try:
-                if operation == "create":
-                    # Should have been handled by initial state? If not, apply diff if exists.
-                    if not target_path_in_temp.exists():
-                        target_path_in_temp.touch()
-                    if actual_diff_path:
-                        cmd = [
-                            "git",
-                            "apply",
-                            "--verbose",
-                            "--unsafe-paths",
-                            str(actual_diff_path),
-                        ]
-                        # Apply relative to the temp dir
-                        result = subprocess.run(
-                            cmd,
-                            cwd=temp_workspace_root,
-                            capture_output=True,
-                            text=True,
-                            check=False,
-                        )
-                        if result.returncode != 0:
-                            raise HistoryError(
-                                f"git apply failed for create {entry_id}: {result.stderr}"
-                            )
+                if entry.get("content_file") and operation in ["create", "edit", "replace"]:
+                    lines = _decode_lines(
+                        objects.read_artifact(history_root, entry["content_file"])
+                    )
+                    exists = True
+
+                elif operation == "create":
+                    diff_content = _load_diff_text(entry, history_root)
+                    lines = _apply_diff(lines if exists else [], diff_content, entry_id) if diff_content else []
+                    exists = True
 
                 elif operation == "delete":
-                    if target_path_in_temp.exists():
-                        target_path_in_temp.unlink()
+                    lines = []
+                    exists = False
 
                 elif operation == "move":
-                    source_rel = entry.get("source_path")
-                    dest_rel = entry.get("file_path")
-                    if not source_rel or not dest_rel:
+                    if not entry.get("source_path") or not entry.get("file_path"):
                         raise HistoryError(f"Move op {entry_id} missing paths")
-                    # The source *should* match the current temp file's expected relative path
-                    # We just need to update where the next operation looks
-                    new_temp_name = Path(dest_rel).name
-                    new_temp_path = temp_workspace_root / new_temp_name
-                    if target_path_in_temp.exists():
-                        log.debug(
-                            f"Simulating move: renaming {target_path_in_temp} to {new_temp_path}"
-                        )
-                        target_path_in_temp.rename(new_temp_path)
-                        current_temp_file_path = new_temp_path  # Update tracked path
-                    else:
-                        log.warning(
-                            f"Skipping move {entry_id}: source {target_path_in_temp.name} doesn't exist in temp dir."
-                        )
+                    # Content is unchanged; the final state is written to file_path_rel below
 
                 elif operation in ["edit", "replace"]:
-                    if not actual_diff_path:
+                    diff_content = _load_diff_text(entry, history_root)
+                    if not diff_content:
                         raise HistoryError(
                             f"{operation} op {entry_id} missing diff file"
                         )
-                    if not target_path_in_temp.exists():
-                        # If file doesn't exist, maybe the diff creates it (e.g., replace)
-                        log.debug(
-                            f"Target {target_path_in_temp.name} doesn't exist in temp, git apply might create it."
-                        )
-                        # Create empty file for git apply to patch against if needed?
-                        # Let's assume git apply handles it.
-
-                    cmd = ["git", "apply", "--verbose", "--unsafe-paths"]
-                    # Apply relative to the temp dir
-                    # We need to tell git apply the *target filename* within the temp dir
-                    # Use --index and potentially --cached? No, simpler: apply directly
-                    # We need cwd to be temp_dir, and diff path absolute
-                    cmd.append(str(actual_diff_path))
-                    log.debug(
-                        f"Running apply for {operation}: {' '.join(cmd)} in {temp_workspace_root}"
-                    )
-                    result = subprocess.run(
-                        cmd,
-                        cwd=temp_workspace_root,
-                        capture_output=True,
-                        text=True,
-                        check=False,
-                    )
-                    if result.returncode != 0:
-                        # Check if target file exists now, maybe apply created it
-                        if not target_path_in_temp.exists():
-                            raise HistoryError(
-                                f"git apply failed for {operation} {entry_id} and target file doesn't exist: {result.stderr}"
-                            )
-                        else:
-                            # File exists, maybe patch didn't apply cleanly?
-                            raise HistoryError(
-                                f"git apply failed for {operation} {entry_id} (file exists): {result.stderr}"
-                            )
+                    lines = _apply_diff(lines if exists else [], diff_content, entry_id)
+                    exists = True
 
             except Exception as apply_err:
                 log.error(
@@ -1080,18 +994,14 @@ def reconstruct_file_from_history(
                     "error": f"Failed applying edit {entry_id}: {apply_err}",
                 }
 
-        # 3. Final state is in current_temp_file_path
-        final_hash = (
-            utils.calculate_hash(str(current_temp_file_path))
-            if current_temp_file_path.exists()
-            else None
-        )
-
-        # 4. Replace the actual file with the reconstructed one
+        # 3. Replace the actual file with the reconstructed one
         log.info(f"Reconstruction successful. Updating {target_file_abs}")
-        target_file_abs.parent.mkdir(parents=True, exist_ok=True)
-        if current_temp_file_path.exists():
-            shutil.move(str(current_temp_file_path), target_file_abs)
+        final_hash = None
+        final_stat = None
+        if exists:
+            _write_lines(target_file_abs, lines)
+            final_stat = utils.stat_stamp(target_file_abs)
+            final_hash = utils.calculate_hash(str(target_file_abs))
         elif target_file_abs.exists():
             # If reconstruction resulted in a deleted file, delete the original
             log.info(
@@ -1107,25 +1017,92 @@ def reconstruct_file_from_history(
         log.info(
             f"Reconstruction complete for {file_path_rel}. Final hash: {final_hash}"
         )
-        return {"hash": final_hash, "error": None}
+        return {"hash": final_hash, "stat": final_stat, "error": None}
 
     except Exception as e:
         log.exception(f"Error during reconstruction of {file_path_rel}: {e}")
         return {"hash": None, "error": str(e)}
-    finally:
-        # Clean up temporary directory
-        if temp_dir and Path(temp_dir).exists():
-            try:
-                shutil.rmtree(temp_dir)
-                log.debug(f"Cleaned up temporary directory: {temp_dir}")
-            except Exception as cleanup_e:
-                log.error(
-                    f"Failed to clean up temporary directory {temp_dir}: {cleanup_e}"
-                )
 
 
-def verify_file_hash(file_path: Path, expected_hash: Optional[str]) -> bool:
-    """Verify if the file's current hash matches the expected hash."""
+def _decode_lines(data: bytes) -> List[str]:
+    """Split file content into lines with their original line endings, as patch does."""
+    return patch.split_lines(data.decode("utf-8", errors="surrogateescape"))
+
+
+def _read_lines(path: Path) -> List[str]:
+    """Read a file as a list of lines with their original line endings."""
+    return _decode_lines(path.read_bytes())
+
+
+def _read_text_artifact(history_root: Path, path: Path) -> str:
+    """Text of a diff stored as an object or a plain file; bytes that are not UTF-8 survive replay."""
+    return objects.read_artifact(history_root, path).decode("utf-8", errors="surrogateescape")
+
+
+def _write_lines(path: Path, lines: List[str]):
+    """Write lines to path atomically via a temp file in the same directory."""
+    path.parent.mkdir(parents=True, exist_ok=True)
+    temp_path = path.with_name(f".{path.name}.mcpdiff.{os.getpid()}.tmp")
+    try:
+        with open(
+            temp_path, "w", encoding="utf-8", errors="surrogateescape", newline=""
+        ) as f:
+            f.writelines(lines)
+        if path.exists():
+            shutil.copymode(path, temp_path)
+        os.replace(temp_path, path)
+    except Exception:
+        if temp_path.exists():
+            temp_path.unlink()
+        raise
+
+
+def _load_diff_text(entry: Dict[str, Any], history_root: Path) -> Optional[str]:
+    """Diff content for an entry, or None if it has no real diff file."""
+    if not entry.get("diff_file"):
+        return None
+    if objects.object_hash(entry["diff_file"]):
+        # Not get_diff_for_entry: its text is for display, with undecodable bytes replaced
+        try:
+            return _read_text_artifact(history_root, Path(entry["diff_file"]))
+        except (OSError, HistoryError) as e:
+            log.error(f"Error reading diff object {entry['diff_file']}: {e}")
+            return None
+    content = get_diff_for_entry(entry, history_root)
+    if content is None or content.startswith("OPERATION:"):
+        return None
+    return content
+
+
+def _apply_diff(
+    lines: List[str], diff_content: str, edit_id: str, reverse: bool = False
+) -> List[str]:
+    """Apply a diff in memory, logging any offset/fuzz the hunks needed."""
+    try:
+        new_lines, diagnostics = patch.apply_patch_to_lines(
+            lines, diff_content, reverse=reverse
+        )
+    except patch.PatchError as e:
+        raise HistoryError(
+            f"Diff for {edit_id} does not apply{' in reverse' if reverse else ''}: {e}"
+        ) from e
+    notes = patch.format_diagnostics(diagnostics)
+    if notes:
+        log.info(f"Diff for {edit_id} applied with adjustments: {notes}")
+    return new_lines
+
+
+def verify_file_hash(
+    file_path: Path,
+    expected_hash: Optional[str],
+    expected_stat: Optional[Dict[str, Any]] = None,
+) -> bool:
+    """
+    Verify if the file's current hash matches the expected hash.
+
+    expected_stat is the stat_after stamp logged with expected_hash; while the
+    file still has it, the file is unchanged and is not read.
+    """
     if not expected_hash:
         log.warning(f"Cannot verify hash for {file_path}: no expected hash provided.")
         # Decide on behavior: strict (fail) or lenient (pass)? Let's be lenient.
@@ -1134,6 +1111,9 @@ def verify_file_hash(file_path: Path, expected_hash: Optional[str]) -> bool:
         log.warning(f"Cannot verify hash for {file_path}: file does not exist.")
         # If expected hash exists, but file doesn't, it's a mismatch.
         return False  # Expected content, but file is gone.
+    if utils.stat_matches(file_path, expected_stat):
+        log.debug(f"Verified {file_path} by stat: size, mtime and inode unchanged")
+        return True
 
     current_hash = utils.calculate_hash(str(file_path))
     log.debug(
@@ -1159,45 +1139,26 @@ def generate_diff_from_checkpoint(
     current_file_path: Path,
     checkpoint_file_path: Path,
     file_display_name: str,  # Relative path for display in diff header
+    history_root: Optional[Path] = None,
 ) -> Optional[str]:
     """Generates a diff between a checkpoint and the current file."""
-    if not current_file_path.is_file() or not checkpoint_file_path.is_file():
+    history_root = history_root or checkpoint_file_path.parent
+    if not current_file_path.is_file() or not objects.artifact_exists(
+        history_root, checkpoint_file_path
+    ):
         log.error("Cannot generate diff: one or both files missing.")
         return None
     try:
-        # Use git diff --no-index for comparing arbitrary files
-        cmd = [
-            "git",
-            "diff",
-            "--no-index",
-            "--",
-            str(checkpoint_file_path),
-            str(current_file_path),
-        ]
-        # Rename paths in diff output for clarity
-        # Git diff will use the full paths, need to adjust header lines
-        log.debug(f"Generating diff: {' '.join(cmd)}")
-        result = subprocess.run(
-            cmd, capture_output=True, text=True, check=False
-        )  # Allow non-zero exit code for diffs
-
-        if result.returncode > 1:  # 0=no diff, 1=diff found, >1=error
-            log.error(f"Error generating diff: {result.stderr}")
-            return None
-
-        diff_content = result.stdout
-        # Replace the absolute paths in header with the display name
-        # --- a/<abs_checkpoint_path>
-        # +++ b/<abs_current_path>
-        # becomes
-        # --- a/relative/path/to/file
-        # +++ b/relative/path/to/file
-        lines = diff_content.splitlines()
-        if len(lines) >= 2:
-            # Be careful with paths containing spaces
-            lines[0] = f"--- a/{file_display_name}"
-            lines[1] = f"+++ b/{file_display_name}"
-        return "\n".join(lines)
+        checkpoint_lines = _decode_lines(
+            objects.read_artifact(history_root, checkpoint_file_path)
+        )
+        diff_lines = difflib.unified_diff(
+            checkpoint_lines,
+            _read_lines(current_file_path),
+            fromfile=f"a/{file_display_name}",
+            tofile=f"b/{file_display_name}",
+        )
+        return "".join(diff_lines).rstrip("\n")
 
     except Exception as e:
         log.exception(f"Error generating diff between checkpoint and current file: {e}")
@@ -1209,15 +1170,17 @@ def verify_and_prompt_if_modified(
     expected_hash: Optional[str],
     history_root: Path,
     workspace_root: Path,
+    expected_stat: Optional[Dict[str, Any]] = None,
 ) -> bool:
     """
     Checks if a file matches expected hash. If not, shows diff vs last checkpoint
     and prompts user whether to proceed (overwriting changes).
+    expected_stat is passed on to verify_file_hash().
 
     Returns True if verification passes OR user confirms overwrite.
     Returns False if verification fails AND user chooses not to proceed.
     """
-    if verify_file_hash(file_path_abs, expected_hash):
+    if verify_file_hash(file_path_abs, expected_hash, expected_stat):
         return True  # Hash matches, proceed
 
     # Hash mismatch or file missing when expected
@@ -1232,7 +1195,10 @@ def verify_and_prompt_if_modified(
     # Let's try finding *any* checkpoint with that hash.
 
     target_checkpoint: Optional[Path] = None
-    if expected_hash:
+    if expected_hash and objects.object_exists(history_root, expected_hash):
+        # Object store entries are named by their content hash
+        target_checkpoint = objects.loose_object_path(history_root, expected_hash)
+    elif expected_hash:
         chkpt_dir = history_root / CHECKPOINTS_DIR
         if chkpt_dir.is_dir():
             for item in chkpt_dir.rglob("*.chkpt"):  # Search recursively
@@ -1252,7 +1218,7 @@ def verify_and_prompt_if_modified(
     if target_checkpoint and file_path_abs.exists():
         file_rel_path = get_relative_path(file_path_abs, workspace_root)
         diff_content = generate_diff_from_checkpoint(
-            file_path_abs, target_checkpoint, file_rel_path
+            file_path_abs, target_checkpoint, file_rel_path, history_root
         )
     elif not file_path_abs.exists() and expected_hash:
         diff_content = f"--- Expected File (hash: {expected_hash})\n+++ Current State\n- File content was expected but is missing."
@@ -1328,6 +1294,55 @@ def cleanup_stale_locks(history_root: Path) -> int:
     return cleaned_count
 
 
+def compact_log_files(
+    history_root: Path, lock_timeout: Optional[float] = None
+) -> Tuple[int, int]:
+    """
+    Rewrite append-only conversation logs into their compact form.
+
+    Drops blank and unparseable lines (e.g. a torn final append), keeps only the
+    last record for each edit_id, and sorts entries chronologically.
+
+    Returns:
+        (log files rewritten, lines removed)
+    """
+    logs_dir = history_root / LOGS_DIR
+    if not logs_dir.is_dir():
+        return 0, 0
+
+    rewritten = 0
+    removed = 0
+    for log_file in sorted(logs_dir.glob("*.log")):
+        try:
+            with open(log_file, "r", encoding="utf-8") as f:
+                line_count = sum(1 for _ in f)
+            entries = utils.read_log_file(log_file, lock_timeout=lock_timeout)
+        except (IOError, HistoryError) as e:
+            log.warning(f"Skipping log file {log_file} during compaction: {e}")
+            continue
+
+        latest: Dict[str, Dict[str, Any]] = {}
+        anonymous: List[Dict[str, Any]] = []
+        for entry in entries:
+            if "edit_id" in entry:
+                latest.pop(entry["edit_id"], None)  # Re-insert to keep last position
+                latest[entry["edit_id"]] = entry
+            else:
+                anonymous.append(entry)
+        compacted = list(latest.values()) + anonymous
+
+        if len(compacted) == line_count:
+            continue
+        utils.write_log_file(log_file, compacted, lock_timeout=lock_timeout)
+        rewritten += 1
+        removed += line_count - len(compacted)
+        log.info(
+            f"Compacted {log_file.name}: {line_count} lines -> {len(compacted)} entries"
+        )
+
+    return rewritten, removed
+
+
 def add_snapshot_log_entry(
     file_path_rel: str,
     current_hash: Optional[str],
@@ -1360,9 +1375,7 @@ def add_snapshot_log_entry(
 
     log_file_path = history_root / LOGS_DIR / related_log_file_name
     try:
-        entries = utils.read_log_file(log_file_path, lock_timeout=lock_timeout)
-        entries.append(snapshot_entry)
-        utils.write_log_file(log_file_path, entries, lock_timeout=lock_timeout)
+        utils.append_log_entry(log_file_path, snapshot_entry, lock_timeout=lock_timeout)
         log.info(
             f"Added snapshot entry {snapshot_edit_id} for {file_path_rel} to {related_log_file_name}"
         )
@@ -1409,9 +1422,7 @@ def add_revert_log_entry(
 
     log_file_path = history_root / LOGS_DIR / related_log_file_name
     try:
-        entries = utils.read_log_file(log_file_path, lock_timeout=lock_timeout)
-        entries.append(revert_entry)
-        utils.write_log_file(log_file_path, entries, lock_timeout=lock_timeout)
+        utils.append_log_entry(log_file_path, revert_entry, lock_timeout=lock_timeout)
         log.info(
             f"Added revert entry {revert_edit_id} (for rejected {rejected_entry_id}) to {related_log_file_name}"
         )
@@ -0,0 +1,318 @@
+# mcpdiff_index.py
+
+import os
+import json
+import sqlite3
+import time
+from pathlib import Path
+from typing import List, Dict, Any, Optional, Tuple
+
+# Import from utils module
+import mcpdiff_utils as utils
+from mcpdiff_utils import log, LOGS_DIR
+
+# --- Configuration Constants ---
+INDEX_FILE_NAME = "index.sqlite3"  # Lives directly under .mcp/edit_history
+INDEX_SCHEMA_VERSION = 1  # Bump to force a rebuild when the schema changes
+TAIL_CHECK_BYTES = 64  # Bytes before the ingested offset used to detect rewrites
+NO_TOOL_CALL_INDEX = 2**62  # Sorts entries without an index last, like float("inf")
+
+_SCHEMA = """
+CREATE TABLE IF NOT EXISTS log_files (
+    name TEXT PRIMARY KEY,
+    size INTEGER NOT NULL,
+    mtime_ns INTEGER NOT NULL,
+    offset INTEGER NOT NULL,
+    tail BLOB NOT NULL
+);
+CREATE TABLE IF NOT EXISTS entries (
+    seq INTEGER PRIMARY KEY AUTOINCREMENT,
+    log_file TEXT NOT NULL,
+    edit_id TEXT NOT NULL,
+    edit_id_lower TEXT NOT NULL,
+    conv_lower TEXT NOT NULL,
+    conv_rev TEXT NOT NULL,
+    file_path TEXT NOT NULL,
+    status TEXT NOT NULL,
+    operation TEXT NOT NULL,
+    ts REAL NOT NULL,
+    tool_call_index INTEGER NOT NULL,
+    data TEXT NOT NULL,
+    UNIQUE (log_file, edit_id)
+);
+CREATE INDEX IF NOT EXISTS entries_edit_id ON entries (edit_id_lower);
+CREATE INDEX IF NOT EXISTS entries_conv ON entries (conv_lower);
+CREATE INDEX IF NOT EXISTS entries_conv_rev ON entries (conv_rev);
+CREATE INDEX IF NOT EXISTS entries_file_path ON entries (file_path);
+CREATE INDEX IF NOT EXISTS entries_status ON entries (status);
+CREATE INDEX IF NOT EXISTS entries_order ON entries (ts, tool_call_index, seq);
+"""
+
+# Chronological order used everywhere (matches find_all_entries)
+_ORDER_ASC = "ts ASC, tool_call_index ASC, seq ASC"
+_ORDER_DESC = "ts DESC, tool_call_index DESC, seq DESC"
+
+
+def _prefix_range(prefix: str) -> Tuple[str, str]:
+    """Bounds for an index range scan matching every string starting with prefix."""
+    return prefix, prefix + "\U0010ffff"
+
+
+class HistoryIndex:
+    """
+    SQLite index over the JSON Lines conversation logs.
+
+    The logs stay the source of truth. Each sync() ingests only the bytes
+    appended since the last run, and a log that was rewritten (compaction,
+    manual edits) is re-read in full. Records that repeat an edit_id within
+    a log supersede the earlier one, matching how status updates are logged.
+    """
+
+    def __init__(self, history_root: Path, conn: sqlite3.Connection):
+        self.history_root = history_root
+        self.conn = conn
+
+    @classmethod
+    def open(cls, history_root: Path) -> "HistoryIndex":
+        """Open (creating if needed) the on-disk index, falling back to memory."""
+        index_path = history_root / INDEX_FILE_NAME
+        try:
+            conn = sqlite3.connect(str(index_path))
+            version = conn.execute("PRAGMA user_version").fetchone()[0]
+            if version != INDEX_SCHEMA_VERSION:
+                conn.executescript(
+                    "DROP TABLE IF EXISTS entries; DROP TABLE IF EXISTS log_files;"
+                )
+                conn.execute(f"PRAGMA user_version = {INDEX_SCHEMA_VERSION}")
+            conn.executescript(_SCHEMA)
+        except sqlite3.Error as e:
+            log.warning(
+                f"Could not open history index {index_path}: {e}. Using an in-memory index."
+            )
+            conn = sqlite3.connect(":memory:")
+            conn.executescript(_SCHEMA)
+        conn.row_factory = sqlite3.Row
+        return cls(history_root, conn)
+
+    def close(self):
+        self.conn.close()
+
+    # --- Ingestion ---
+
+    def sync(self, lock_timeout: Optional[float] = None) -> int:
+        """
+        Bring the index up to date with the log files.
+
+        Returns:
+            Number of log records ingested.
+        """
+        logs_dir = self.history_root / LOGS_DIR
+        log_files = {p.name: p for p in logs_dir.glob("*.log")} if logs_dir.is_dir() else {}
+        known = {
+            row["name"]: row for row in self.conn.execute("SELECT * FROM log_files")
+        }
+
+        ingested = 0
+        with self.conn:
+            for name in set(known) - set(log_files):
+                self._forget_log_file(name)
+            for name, log_file in sorted(log_files.items()):
+                try:
+                    ingested += self._sync_log_file(
+                        name, log_file, known.get(name), lock_timeout
+                    )
+                except (IOError, TimeoutError) as e:
+                    log.warning(f"Skipping log file {log_file} while indexing: {e}")
+        log.debug(f"History index synced, {ingested} new records")
+        return ingested
+
+    def _forget_log_file(self, name: str):
+        self.conn.execute("DELETE FROM entries WHERE log_file = ?", (name,))
+        self.conn.execute("DELETE FROM log_files WHERE name = ?", (name,))
+
+    def _sync_log_file(
+        self,
+        name: str,
+        log_file: Path,
+        known: Optional[sqlite3.Row],
+        lock_timeout: Optional[float],
+    ) -> int:
+        st = log_file.stat()
+        if known and (known["size"], known["mtime_ns"]) == (st.st_size, st.st_mtime_ns):
+            return 0
+
+        lock = utils.FileLock(str(log_file))
+        lock.acquire(timeout=lock_timeout)
+        try:
+            with open(log_file, "rb") as f:
+                offset = 0
+                if known and st.st_size >= known["offset"]:
+                    tail_start = max(0, known["offset"] - TAIL_CHECK_BYTES)
+                    f.seek(tail_start)
+                    if f.read(known["offset"] - tail_start) == known["tail"]:
+                        offset = known["offset"]  # Only appended to since last sync
+                if known and offset == 0:
+                    log.debug(f"Log file {name} was rewritten, re-indexing it")
+                    self._forget_log_file(name)
+                f.seek(offset)
+                data = f.read()
+                st = os.fstat(f.fileno())
+        finally:
+            lock.release()
+
+        # Only consume complete lines; a partial append is picked up next time
+        complete = data[: data.rfind(b"\n") + 1]
+        end_offset = offset + len(complete)
+        count = 0
+        for line in complete.split(b"\n"):
+            line = line.strip()
+            if not line:
+                continue
+            try:
+                entry = json.loads(line)
+            except (json.JSONDecodeError, UnicodeDecodeError) as e:
+                log.warning(f"Invalid JSON in {log_file} while indexing: {e}")
+                continue
+            if isinstance(entry, dict) and entry.get("edit_id"):
+                self._upsert(name, entry)
+                count += 1
+
+        previous_tail = known["tail"] if known and offset else b""
+        tail = (previous_tail + complete)[-TAIL_CHECK_BYTES:]
+        self.conn.execute(
+            "INSERT OR REPLACE INTO log_files (name, size, mtime_ns, offset, tail) VALUES (?, ?, ?, ?, ?)",
+            (name, st.st_size, st.st_mtime_ns, end_offset, tail),
+        )
+        return count
+
+    def _upsert(self, log_file_name: str, entry: Dict[str, Any]):
+        conv_lower = str(entry.get("conversation_id") or "").lower()
+        try:
+            ts = utils.parse_timestamp(entry.get("timestamp", 0))
+        except ValueError:
+            ts = 0.0  # Malformed timestamps sort first rather than failing the sync
+        tool_call_index = entry.get("tool_call_index")
+        if not isinstance(tool_call_index, int):
+            tool_call_index = NO_TOOL_CALL_INDEX
+        # Drop first so a superseding record also moves to the end of seq order
+        self.conn.execute(
+            "DELETE FROM entries WHERE log_file = ? AND edit_id = ?",
+            (log_file_name, entry["edit_id"]),
+        )
+        self.conn.execute(
+            """INSERT INTO entries (log_file, edit_id, edit_id_lower, conv_lower, conv_rev,
+                   file_path, status, operation, ts, tool_call_index, data)
+               VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)""",
+            (
+                log_file_name,
+                entry["edit_id"],
+                str(entry["edit_id"]).lower(),
+                conv_lower,
+                conv_lower[::-1],
+                str(entry.get("file_path") or "").replace("\\", "/"),
+                str(entry.get("status") or "").lower(),
+                str(entry.get("operation") or "").lower(),
+                ts,
+                tool_call_index,
+                json.dumps(entry, separators=(",", ":")),
+            ),
+        )
+
+    # --- Queries ---
+
+    def _select(
+        self,
+        where: str = "",
+        params: Tuple = (),
+        order: str = _ORDER_ASC,
+        limit: Optional[int] = None,
+    ) -> List[Dict[str, Any]]:
+        sql = "SELECT log_file, data FROM entries"
+        if where:
+            sql += f" WHERE {where}"
+        sql += f" ORDER BY {order}"
+        if limit is not None:
+            sql += f" LIMIT {int(limit)}"
+        results = []
+        for row in self.conn.execute(sql, params):
+            entry = json.loads(row["data"])
+            entry["log_file_source"] = row["log_file"]
+            results.append(entry)
+        return results
+
+    def count(self) -> int:
+        return self.conn.execute("SELECT COUNT(*) FROM entries").fetchone()[0]
+
+    def all_entries(self) -> List[Dict[str, Any]]:
+        """All entries, oldest first (same order as find_all_entries)."""
+        return self._select()
+
+    def find_by_id_prefix(self, id_prefix: str) -> List[Dict[str, Any]]:
+        """Entries whose edit_id starts with id_prefix (case-insensitive)."""
+        if not id_prefix:
+            return []
+        low, high = _prefix_range(id_prefix.lower())
+        return self._select("edit_id_lower >= ? AND edit_id_lower < ?", (low, high))
+
+    def find_by_conversation(self, conv_id_prefix: str) -> List[Dict[str, Any]]:
+        """Entries of conversations matching by ID prefix, or by suffix if no prefix matches."""
+        if not conv_id_prefix:
+            return []
+        conv_lower = conv_id_prefix.lower()
+        low, high = _prefix_range(conv_lower)
+        matching = self._select("conv_lower >= ? AND conv_lower < ?", (low, high))
+        if not matching:
+            low, high = _prefix_range(conv_lower[::-1])
+            matching = self._select("conv_rev >= ? AND conv_rev < ?", (low, high))
+        return matching
+
+    def filter_entries(
+        self,
+        conv_id: Optional[str] = None,
+        file_path: Optional[str] = None,
+        status: Optional[str] = None,
+        time_filter: Optional[str] = None,
+        op_type: Optional[str] = None,
+        limit: Optional[int] = 50,
+    ) -> List[Dict[str, Any]]:
+        """Index-backed equivalent of mcpdiff_history.filter_entries (same result order)."""
+        clauses: List[str] = []
+        params: List[Any] = []
+        if conv_id:
+            conv_lower = conv_id.lower()
+            low, high = _prefix_range(conv_lower)
+            rev_low, rev_high = _prefix_range(conv_lower[::-1])
+            clauses.append(
+                "((conv_lower >= ? AND conv_lower < ?) OR (conv_rev >= ? AND conv_rev < ?))"
+            )
+            params.extend([low, high, rev_low, rev_high])
+        if file_path:
+            clauses.append("instr(file_path, ?) > 0")
+            params.append(file_path.replace("\\", "/"))
+        if status:
+            clauses.append("status = ?")
+            params.append(status.lower())
+        if op_type:
+            clauses.append("operation = ?")
+            params.append(op_type.lower())
+        if time_filter:
+            seconds = utils.parse_time_filter(time_filter)
+            if seconds is not None:
+                clauses.append("ts >= ?")
+                params.append(time.time() - seconds)
+
+        where = " AND ".join(clauses)
+        if limit is not None and limit > 0:
+            return self._select(where, tuple(params), _ORDER_DESC, limit)
+        elif limit == 0:
+            return self._select(where, tuple(params), _ORDER_DESC)
+        return self._select(where, tuple(params))
+
+
+def open_history_index(
+    history_root: Path, lock_timeout: Optional[float] = None
+) -> HistoryIndex:
+    """Open the history index and sync it with the logs."""
+    index = HistoryIndex.open(history_root)
+    index.sync(lock_timeout=lock_timeout)
+    return index
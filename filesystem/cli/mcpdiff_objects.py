@@ -0,0 +1,206 @@
+# mcpdiff_objects.py
+
+import os
+import zlib
+import bisect
+import struct
+import hashlib
+from pathlib import Path
+from typing import Dict, List, Optional, Tuple, Union
+
+# Import from utils module
+from mcpdiff_utils import log, HistoryError, generate_hex_timestamp
+
+# --- Configuration Constants ---
+# Must match OBJECTS_DIR / OBJECT_SUFFIX in src/mcp_edit_utils.py
+OBJECTS_DIR = "objects"
+OBJECT_SUFFIX = ".z"
+PACK_DIR = "pack"
+PACK_MIN_OBJECTS = 64  # Fewer loose objects than this are left unpacked
+
+# Pack index record: raw SHA-256, offset and compressed length in the .pack file.
+# The server reads these too (object_exists in src/mcp_edit_utils.py); keep them in sync
+_IDX_RECORD = struct.Struct(">32sQI")
+_IDX_MAGIC = b"MCPIDX1\n"
+
+# Parsed pack indexes for this process: idx path -> (stamp, sorted hashes, records)
+_pack_cache: Dict[str, Tuple[Tuple[int, int], List[bytes], List[Tuple[int, int]]]] = {}
+
+
+def object_hash(rel_path: Union[str, Path]) -> Optional[str]:
+    """The content hash named by a logged object path, or None for plain files."""
+    parts = Path(rel_path).parts
+    if len(parts) == 3 and parts[0] == OBJECTS_DIR and parts[2].endswith(OBJECT_SUFFIX):
+        return parts[2][: -len(OBJECT_SUFFIX)]
+    return None
+
+
+def loose_object_path(history_root: Path, content_hash: str) -> Path:
+    return history_root / OBJECTS_DIR / content_hash[:2] / f"{content_hash}{OBJECT_SUFFIX}"
+
+
+def _load_pack_index(idx_path: Path):
+    st = idx_path.stat()
+    stamp = (st.st_size, st.st_mtime_ns)
+    cached = _pack_cache.get(str(idx_path))
+    if cached and cached[0] == stamp:
+        return cached[1], cached[2]
+    data = idx_path.read_bytes()
+    if not data.startswith(_IDX_MAGIC):
+        raise HistoryError(f"Not a pack index: {idx_path}")
+    hashes: List[bytes] = []
+    records: List[Tuple[int, int]] = []
+    for raw, offset, length in _IDX_RECORD.iter_unpack(data[len(_IDX_MAGIC) :]):
+        hashes.append(raw)
+        records.append((offset, length))
+    _pack_cache[str(idx_path)] = (stamp, hashes, records)
+    return hashes, records
+
+
+def _read_packed(history_root: Path, content_hash: str) -> Optional[bytes]:
+    pack_dir = history_root / OBJECTS_DIR / PACK_DIR
+    if not pack_dir.is_dir():
+        return None
+    raw = bytes.fromhex(content_hash)
+    for idx_path in sorted(pack_dir.glob("*.idx")):
+        try:
+            hashes, records = _load_pack_index(idx_path)
+        except (OSError, HistoryError) as e:
+            log.warning(f"Skipping unreadable pack index {idx_path}: {e}")
+            continue
+        i = bisect.bisect_left(hashes, raw)
+        if i < len(hashes) and hashes[i] == raw:
+            offset, length = records[i]
+            with open(idx_path.with_suffix(".pack"), "rb") as f:
+                f.seek(offset)
+                return f.read(length)
+    return None
+
+
+def read_object(history_root: Path, content_hash: str) -> bytes:
+    """
+    Decompressed content of an object, loose or packed.
+
+    Raises:
+        FileNotFoundError: If no such object exists.
+        HistoryError: If the stored object is corrupt.
+    """
+    try:
+        compressed = loose_object_path(history_root, content_hash).read_bytes()
+    except FileNotFoundError:
+        compressed = _read_packed(history_root, content_hash)
+        if compressed is None:
+            raise FileNotFoundError(f"Object {content_hash} not found")
+    try:
+        return zlib.decompress(compressed)
+    except zlib.error as e:
+        raise HistoryError(f"Object {content_hash} is corrupt: {e}") from e
+
+
+def object_exists(history_root: Path, content_hash: str) -> bool:
+    if loose_object_path(history_root, content_hash).is_file():
+        return True
+    try:
+        return _read_packed(history_root, content_hash) is not None
+    except OSError:
+        return False
+
+
+def _resolve(history_root: Path, path: Union[str, Path]) -> Tuple[Path, Optional[str]]:
+    """Absolute path and object hash (if any) for a logged or absolute artifact path."""
+    path = Path(path)
+    abs_path = path if path.is_absolute() else history_root / path
+    try:
+        rel_path = abs_path.relative_to(history_root)
+    except ValueError:
+        return abs_path, None
+    return abs_path, object_hash(rel_path)
+
+
+def artifact_exists(history_root: Path, path: Union[str, Path]) -> bool:
+    """True if a diff or checkpoint recorded in the log can be read."""
+    abs_path, content_hash = _resolve(history_root, path)
+    if content_hash:
+        return object_exists(history_root, content_hash)
+    return abs_path.is_file()
+
+
+def read_artifact(history_root: Path, path: Union[str, Path]) -> bytes:
+    """
+    Content of a diff or checkpoint recorded in the log: a stored object, or a
+    plain file for history written before the object store existed.
+    """
+    abs_path, content_hash = _resolve(history_root, path)
+    if content_hash:
+        return read_object(history_root, content_hash)
+    return abs_path.read_bytes()
+
+
+def pack_loose_objects(history_root: Path, min_objects: int = PACK_MIN_OBJECTS) -> int:
+    """
+    Move loose objects into one pack file plus a sorted index, then remove them.
+    Objects already in a pack are dropped rather than stored twice.
+
+    Returns:
+        Number of loose objects removed.
+    """
+    objects_dir = history_root / OBJECTS_DIR
+    if not objects_dir.is_dir():
+        return 0
+    loose: List[Tuple[bytes, Path]] = []
+    for fanout in objects_dir.iterdir():
+        if fanout.name == PACK_DIR or not fanout.is_dir():
+            continue
+        for item in fanout.glob(f"*{OBJECT_SUFFIX}"):
+            try:
+                loose.append((bytes.fromhex(item.name[: -len(OBJECT_SUFFIX)]), item))
+            except ValueError:
+                continue  # Not an object name (e.g. a temp file)
+    if len(loose) < min_objects:
+        return 0
+    loose.sort()
+
+    pack_dir = objects_dir / PACK_DIR
+    pack_dir.mkdir(parents=True, exist_ok=True)
+    base = pack_dir / f"pack-{generate_hex_timestamp()}"
+    pack_tmp = base.with_suffix(".pack.tmp")
+    idx_tmp = base.with_suffix(".idx.tmp")
+    records = []
+    packed: List[Path] = []
+    try:
+        with open(pack_tmp, "wb") as pack_file:
+            for raw, item in loose:
+                if _read_packed(history_root, raw.hex()) is not None:
+                    packed.append(item)  # Already packed earlier
+                    continue
+                data = item.read_bytes()
+                if hashlib.sha256(zlib.decompress(data)).digest() != raw:
+                    log.warning(f"Leaving corrupt object {item} unpacked")
+                    continue
+                records.append(_IDX_RECORD.pack(raw, pack_file.tell(), len(data)))
+                pack_file.write(data)
+                packed.append(item)
+            pack_file.flush()
+            os.fsync(pack_file.fileno())
+        with open(idx_tmp, "wb") as idx_file:
+            idx_file.write(_IDX_MAGIC + b"".join(records))
+            idx_file.flush()
+            os.fsync(idx_file.fileno())
+        # The index is renamed last, so readers never see it without its pack
+        if records:
+            os.replace(pack_tmp, base.with_suffix(".pack"))
+            os.replace(idx_tmp, base.with_suffix(".idx"))
+    except (OSError, zlib.error) as e:
+        raise HistoryError(f"Failed to pack objects: {e}") from e
+    finally:
+        for tmp in (pack_tmp, idx_tmp):
+            if tmp.exists():
+                tmp.unlink()
+
+    for item in packed:
+        try:
+            item.unlink()
+        except FileNotFoundError:
+            pass
+    log.info(f"Packed {len(records)} objects, removed {len(packed)} loose objects")
+    return len(packed)
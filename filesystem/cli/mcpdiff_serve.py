@@ -0,0 +1,208 @@
+# mcpdiff_serve.py - Long-lived JSON-RPC mode for editor integrations
+
+"""
+`mcpdiff serve` answers JSON-RPC 2.0 requests read from stdin, one JSON
+object per line, with one response line each on stdout.
+
+The method is a subcommand (status, show, accept, reject, cleanup) and
+params.args its arguments, exactly as they would follow the subcommand on
+the command line. The result holds what the command would have printed and
+its exit code:
+
+    -> {"jsonrpc": "2.0", "id": 1, "method": "show", "params": {"args": ["abc123"]}}
+    <- {"jsonrpc": "2.0", "id": 1, "result": {"exit_code": 0, "stdout": "...", "stderr": ""}}
+
+The history index stays open between requests and is synced only when a
+log file under .mcp/edit_history/logs changed size or mtime, and file
+hashes are reused while a file's inode, size and mtime are unchanged.
+Commands never prompt: a confirmation they would ask for reads end of
+input and is declined.
+"""
+
+import io
+import os
+import sys
+import json
+import argparse
+import contextlib
+from pathlib import Path
+from typing import List, Dict, Any, Optional, Tuple, Callable, TextIO
+
+import mcpdiff_utils as utils
+import mcpdiff_index
+from mcpdiff_utils import log, LOGS_DIR
+
+# Subcommands callable over JSON-RPC; review is interactive and serve is this loop
+SERVE_METHODS = ("status", "show", "accept", "reject", "cleanup")
+# Subcommands that only read history, so cached entries stay valid after them
+READ_ONLY_METHODS = ("status", "show")
+
+# JSON-RPC 2.0 error codes
+PARSE_ERROR = -32700
+INVALID_REQUEST = -32600
+METHOD_NOT_FOUND = -32601
+INVALID_PARAMS = -32602
+INTERNAL_ERROR = -32603
+
+
+class ServeSession:
+    """Workspace state kept in memory across requests."""
+
+    def __init__(
+        self,
+        parser: argparse.ArgumentParser,
+        workspace_root: Path,
+        history_root: Path,
+        lock_timeout: Optional[float],
+        run_command: Callable[..., int],
+    ):
+        self.parser = parser
+        self.workspace_root = workspace_root
+        self.history_root = history_root
+        self.lock_timeout = lock_timeout
+        self.run_command = run_command
+        self.index: Optional[mcpdiff_index.HistoryIndex] = None
+        self._signature: Optional[Tuple[Tuple[str, int, int], ...]] = None
+        self._entries: Optional[List[Dict[str, Any]]] = None
+        utils.enable_hash_cache()
+
+    def close(self):
+        if self.index is not None:
+            self.index.close()
+            self.index = None
+
+    def _history_signature(self) -> Tuple[Tuple[str, int, int], ...]:
+        """(name, size, mtime_ns) of every log file; one directory read and a stat each."""
+        stamps = []
+        try:
+            with os.scandir(self.history_root / LOGS_DIR) as it:
+                for entry in it:
+                    if entry.name.endswith(".log"):
+                        st = entry.stat()
+                        stamps.append((entry.name, st.st_size, st.st_mtime_ns))
+        except FileNotFoundError:
+            pass
+        return tuple(sorted(stamps))
+
+    def refresh(self):
+        """Sync the index if any log file changed since the last request."""
+        signature = self._history_signature()
+        if self.index is None:
+            self.index = mcpdiff_index.open_history_index(
+                self.history_root, lock_timeout=self.lock_timeout
+            )
+        elif signature != self._signature:
+            self.index.sync(lock_timeout=self.lock_timeout)
+        else:
+            return
+        # Taken before syncing, so records appended meanwhile are picked up next time
+        self._signature = signature
+        self._entries = None
+
+    def _load_history(self, args: argparse.Namespace) -> List[Dict[str, Any]]:
+        """run_command() loader: the shared index plus cached entries."""
+        self.refresh()
+        args.history_index = self.index
+        if getattr(args, "uses_index", False) or args.command == "cleanup":
+            return []
+        if self._entries is None:
+            self._entries = self.index.all_entries()
+        # Handlers update entries in place, so they get their own copies
+        return [dict(entry) for entry in self._entries]
+
+    def call(self, method: str, argv: List[str]) -> Dict[str, Any]:
+        """Run one subcommand with its output captured."""
+        stdout, stderr = io.StringIO(), io.StringIO()
+        with contextlib.redirect_stdout(stdout), contextlib.redirect_stderr(stderr):
+            real_stdin, sys.stdin = sys.stdin, io.StringIO()
+            try:
+                try:
+                    args = self.parser.parse_args([method] + argv)
+                except SystemExit as e:  # argparse reports usage errors this way
+                    exit_code = e.code if isinstance(e.code, int) else 2
+                else:
+                    args.timeout = self.lock_timeout
+                    exit_code = self.run_command(
+                        args, self.workspace_root, self.history_root, self._load_history
+                    )
+            finally:
+                sys.stdin = real_stdin
+        if method not in READ_ONLY_METHODS:
+            # The command appended to the logs; resync before the next request
+            self._signature = None
+        return {
+            "exit_code": exit_code,
+            "stdout": stdout.getvalue(),
+            "stderr": stderr.getvalue(),
+        }
+
+    def handle(self, request: Any) -> Tuple[Optional[Dict[str, Any]], bool]:
+        """
+        Answer one decoded request.
+
+        Returns (response or None for notifications, whether to stop serving).
+        """
+        response, stop = self._dispatch(request)
+        if isinstance(request, dict) and "id" not in request:
+            return None, stop
+        return response, stop
+
+    def _dispatch(self, request: Any) -> Tuple[Dict[str, Any], bool]:
+        if not isinstance(request, dict) or not isinstance(request.get("method"), str):
+            return _error(None, INVALID_REQUEST, "Invalid request"), False
+        request_id = request.get("id")
+        method = request["method"]
+        params = request.get("params") or {}
+
+        if method == "shutdown":
+            return _result(request_id, None), True
+        if method == "ping":
+            return _result(request_id, {"workspace": str(self.workspace_root)}), False
+        if method not in SERVE_METHODS:
+            return _error(request_id, METHOD_NOT_FOUND, f"Unknown method: {method}"), False
+        argv = params.get("args", []) if isinstance(params, dict) else None
+        if not isinstance(argv, list) or not all(isinstance(a, str) for a in argv):
+            return _error(request_id, INVALID_PARAMS, "params.args must be a list of strings"), False
+
+        try:
+            result = self.call(method, argv)
+        except Exception as e:
+            log.exception(f"serve: {method} failed")
+            return _error(request_id, INTERNAL_ERROR, str(e)), False
+        return _result(request_id, result), False
+
+
+def _result(request_id: Any, result: Any) -> Dict[str, Any]:
+    return {"jsonrpc": "2.0", "id": request_id, "result": result}
+
+
+def _error(request_id: Any, code: int, message: str) -> Dict[str, Any]:
+    return {"jsonrpc": "2.0", "id": request_id, "error": {"code": code, "message": message}}
+
+
+def serve(
+    session: ServeSession,
+    stdin: Optional[TextIO] = None,
+    stdout: Optional[TextIO] = None,
+) -> None:
+    """Read requests until end of input or a shutdown request."""
+    reader = stdin or sys.stdin
+    writer = stdout or sys.stdout
+    try:
+        for line in reader:
+            line = line.strip()
+            if not line:
+                continue
+            try:
+                request = json.loads(line)
+            except json.JSONDecodeError as e:
+                response, stop = _error(None, PARSE_ERROR, f"Parse error: {e}"), False
+            else:
+                response, stop = session.handle(request)
+            if response is not None:
+                writer.write(json.dumps(response) + "\n")
+                writer.flush()
+            if stop:
+                break
+    finally:
+        session.close()
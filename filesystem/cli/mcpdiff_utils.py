@@ -9,7 +9,8 @@ import logging
 import re
 from pathlib import Path
 from datetime import datetime, timezone
-from typing import List, Dict, Any, Optional, Union
+from typing import List, Dict, Any, Optional, Union, Tuple
+from concurrent.futures import ThreadPoolExecutor
 
 # --- Configuration Constants ---
 # These might be better placed in history if purely history-related,
@@ -121,14 +122,36 @@ def verify_path_is_safe(path: Path, workspace_root: Path) -> bool:
 
 
 # --- Filesystem Info Helpers ---
+# Maps path -> (inode, size, mtime_ns, sha256). Long-lived processes (mcpdiff
+# serve) and prime_hash_cache() turn it on, via enable_hash_cache().
+_hash_cache: Optional[Dict[str, Tuple[int, int, int, str]]] = None
+
+
+def enable_hash_cache():
+    """Reuse file hashes while a file's inode, size and mtime are unchanged."""
+    global _hash_cache
+    if _hash_cache is None:
+        _hash_cache = {}
+
+
 def calculate_hash(file_path: str) -> Optional[str]:
     """Calculates the SHA256 hash of a file's content."""
     try:
+        stamp = None
+        if _hash_cache is not None:
+            st = os.stat(file_path)
+            stamp = (st.st_ino, st.st_size, st.st_mtime_ns)
+            cached = _hash_cache.get(file_path)
+            if cached and cached[:3] == stamp:
+                return cached[3]
         hasher = hashlib.sha256()
         with open(file_path, "rb") as f:
             while chunk := f.read(8192):
                 hasher.update(chunk)
-        return hasher.hexdigest()
+        digest = hasher.hexdigest()
+        if stamp is not None:
+            _hash_cache[file_path] = stamp + (digest,)
+        return digest
     except FileNotFoundError:
         log.debug(f"File not found for hashing: {file_path}")
         return None
@@ -137,6 +160,43 @@ def calculate_hash(file_path: str) -> Optional[str]:
         return None
 
 
+def prime_hash_cache(file_paths: List[str], max_workers: Optional[int] = None):
+    """
+    Hash files in parallel so later calculate_hash() calls are cache hits.
+
+    hashlib releases the GIL while hashing, so threads overlap both the reads
+    and the hashing. A file changed after priming has a new stamp and is
+    hashed again when asked for.
+    """
+    enable_hash_cache()
+    if len(file_paths) < 2:
+        for file_path in file_paths:
+            calculate_hash(file_path)
+        return
+    with ThreadPoolExecutor(max_workers=max_workers) as pool:
+        for _ in pool.map(calculate_hash, file_paths):
+            pass
+
+
+def stat_stamp(file_path: Union[str, Path]) -> Optional[Dict[str, int]]:
+    """A file's size, mtime_ns and inode, in the form log entries record as stat_after."""
+    try:
+        st = os.stat(file_path)
+    except OSError:
+        return None
+    return {"size": st.st_size, "mtime_ns": st.st_mtime_ns, "inode": st.st_ino}
+
+
+def stat_matches(file_path: Union[str, Path], expected_stat: Optional[Dict[str, Any]]) -> bool:
+    """Whether the file still has the stamp recorded with its hash, so the hash holds without reading it."""
+    if not isinstance(expected_stat, dict):
+        return False
+    current = stat_stamp(file_path)
+    return current is not None and all(
+        expected_stat.get(key) == value for key, value in current.items()
+    )
+
+
 # --- Locking Mechanism (fcntl-based) ---
 class FileLock:
     """A simple file locking mechanism using fcntl (Unix-like)."""
@@ -396,6 +456,33 @@ def write_log_file(
         raise HistoryError(f"Unexpected error writing log file: {log_file_path}") from e
 
 
+def append_log_entry(
+    log_file_path: Path,
+    entry: Dict[str, Any],
+    lock_timeout: Optional[float] = None,
+):
+    """Appends a single entry to a JSON Lines log file with one fsync'd write."""
+    data = (json.dumps(entry, separators=(",", ":")) + "\n").encode("utf-8")
+    lock = FileLock(str(log_file_path))
+    try:
+        with lock:
+            log_file_path.parent.mkdir(parents=True, exist_ok=True)
+            with open(log_file_path, "a+b") as f:
+                size_before = f.seek(0, os.SEEK_END)
+                if size_before > 0:
+                    # Don't join onto a line left unterminated by a crash
+                    f.seek(size_before - 1)
+                    if f.read(1) != b"\n":
+                        data = b"\n" + data
+                f.write(data)
+                f.flush()
+                os.fsync(f.fileno())
+            log.debug(f"Appended entry to log file: {log_file_path}")
+    except (IOError, TimeoutError) as e:
+        log.error(f"Error appending to log file {log_file_path}: {e}")
+        raise HistoryError(f"Could not append to log file: {log_file_path}") from e
+
+
 def parse_timestamp(timestamp: Union[float, str]) -> float:
     """Parse various timestamp formats into a float epoch time."""
     if isinstance(timestamp, (int, float)):
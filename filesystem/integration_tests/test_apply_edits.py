@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+"""
+Integration tests for the apply_edits transaction tool.
+
+These tests verify that:
+- Edits across files, and several edits to one file, apply together
+- A failing edit leaves every file untouched and logs nothing
+- History gets one entry per file, sharing a group and tool call index
+- Files left unchanged are not logged, and a failed log write restores every file
+- Line numbers follow readlines(), and bytes that are not UTF-8 are kept
+"""
+
+import os
+import sys
+import json
+import shutil
+import unittest
+from pathlib import Path
+from unittest import mock
+
+# Initialize the test environment first
+from integration_tests.test_init import MockContext, temp_dir
+
+# Add the parent directory to the path so we can import the module
+sys.path.insert(0, str(Path(__file__).parent.parent))
+sys.path.insert(0, str(Path(__file__).parent.parent / "cli"))
+
+from src import filesystem
+import mcpdiff_history as history
+
+
+class TestApplyEdits(unittest.TestCase):
+    """Test batched multi-file edits."""
+
+    def setUp(self):
+        """Create two files under a workspace with edit history enabled."""
+        self.ws = Path(temp_dir) / "apply_edits_ws"
+        (self.ws / ".mcp" / "edit_history").mkdir(parents=True)
+        self.a = self.ws / "a.py"
+        self.b = self.ws / "pkg" / "b.py"
+        self.b.parent.mkdir()
+        self.a.write_text("def old_name():\n    return 1\n")
+        self.b.write_text("from a import old_name\n\nx = 1\ny = 2\n")
+        filesystem._finish_edit()
+        self.ctx = MockContext()
+
+    def tearDown(self):
+        """Clean up the workspace."""
+        shutil.rmtree(self.ws)
+
+    def _log_entries(self):
+        logs = list((self.ws / ".mcp" / "edit_history" / "logs").glob("*.log"))
+        return [json.loads(line) for log in logs for line in log.read_text().splitlines()]
+
+    def test_multi_file_transaction(self):
+        """Test all edits apply and are logged as one group."""
+        result = filesystem.apply_edits(
+            self.ctx,
+            [
+                {"path": str(self.a), "replacements": {"old_name(": "new_name("}},
+                {"path": str(self.b), "replacements": {"import old_name": "import new_name"}},
+                {"path": str(self.b), "line_start": 3, "line_end": 4, "new_content": "x = 10\n"},
+            ],
+        )
+        self.assertTrue(result.startswith("Applied 3 edits to 2 of 2 files."), result)
+        self.assertEqual(self.a.read_text(), "def new_name():\n    return 1\n")
+        self.assertEqual(self.b.read_text(), "from a import new_name\n\nx = 10\n")
+
+        entries = self._log_entries()
+        self.assertEqual([e["file_path"] for e in entries], ["a.py", os.path.join("pkg", "b.py")])
+        self.assertEqual(len({e["group_id"] for e in entries}), 1)
+        self.assertEqual(len({e["tool_call_index"] for e in entries}), 1)
+        for entry, path in zip(entries, (self.a, self.b)):
+            self.assertTrue(entry["checkpoint_file"])  # First edit of each file in this conversation
+            self.assertGreater(entry["diff_bytes"], 0)
+            self.assertEqual(entry["hash_after"], filesystem.calculate_hash(str(path)))
+            st = path.stat()
+            self.assertEqual(
+                entry["stat_after"],
+                {"size": st.st_size, "mtime_ns": st.st_mtime_ns, "inode": st.st_ino},
+            )
+
+    def test_failure_changes_nothing(self):
+        """Test one bad edit aborts the whole batch."""
+        before = (self.a.read_text(), self.b.read_text())
+        result = filesystem.apply_edits(
+            self.ctx,
+            [
+                {"path": str(self.a), "replacements": {"old_name(": "new_name("}},
+                {"path": str(self.b), "line_start": 50, "line_end": 51, "new_content": "z\n"},
+            ],
+        )
+        self.assertIn("Error in edit 2", result)
+        self.assertEqual((self.a.read_text(), self.b.read_text()), before)
+        self.assertEqual(self._log_entries(), [])
+
+    def test_unchanged_file_not_logged(self):
+        """Test a file whose edits cancel out is neither written nor logged."""
+        result = filesystem.apply_edits(
+            self.ctx,
+            [
+                {"path": str(self.a), "replacements": {"old_name(": "new_name("}},
+                {"path": str(self.b), "replacements": {"x = 1": "x = 1"}},
+            ],
+        )
+        self.assertTrue(result.startswith("Applied 2 edits to 1 of 2 files."), result)
+        self.assertEqual([e["file_path"] for e in self._log_entries()], ["a.py"])
+
+    def test_log_failure_restores_files(self):
+        """Test files are restored when the history log cannot be written."""
+        before = (self.a.read_bytes(), self.b.read_bytes())
+        with mock.patch.object(
+            filesystem, "append_log_entries", side_effect=filesystem.HistoryError("disk full")
+        ):
+            result = filesystem.apply_edits(
+                self.ctx,
+                [
+                    {"path": str(self.a), "replacements": {"old_name(": "new_name("}},
+                    {"path": str(self.b), "replacements": {"import old_name": "import new_name"}},
+                ],
+            )
+        self.assertIn("disk full", result)
+        self.assertIn("All files were restored", result)
+        self.assertEqual((self.a.read_bytes(), self.b.read_bytes()), before)
+        self.assertEqual(self._log_entries(), [])
+
+    def test_dry_run(self):
+        """Test a dry run returns the diff without writing."""
+        result = filesystem.apply_edits(
+            self.ctx, [{"path": str(self.a), "replacements": {"return 1": "return 2"}}], dry_run=True
+        )
+        self.assertIn("+    return 2", result)
+        self.assertEqual(self.a.read_text(), "def old_name():\n    return 1\n")
+
+
+    def test_line_numbers_and_undecodable_bytes(self):
+        """Test line edits count lines as read_file does and keep invalid UTF-8 bytes."""
+        data_before = b"a\x0cb = 1\nc = 2\r\nbad = '\xff' \xe2\x80\xa8\nlast\n"  # \xe2\x80\xa8 is U+2028
+        self.b.write_bytes(data_before)
+        self.assertEqual(filesystem.read_lines(str(self.b))[1], "c = 2\n")
+        result = filesystem.apply_edits(
+            self.ctx,
+            [
+                {"path": str(self.b), "line_start": 2, "line_end": 2, "new_content": "c = 3\n"},
+                {"path": str(self.b), "replacements": {"last": "final"}},
+            ],
+        )
+        self.assertTrue(result.startswith("Applied 2 edits to 1 of 1 files."), result)
+        data_after = data_before.replace(b"c = 2\r\n", b"c = 3\n").replace(b"last", b"final")
+        self.assertEqual(self.b.read_bytes(), data_after)
+
+        # The logged diff replays to the same bytes
+        self.b.write_bytes(b"stale\n")
+        rebuilt = history.reconstruct_file_from_history(
+            os.path.join("pkg", "b.py"), self._log_entries(), self.ws, self.ws / ".mcp" / "edit_history"
+        )
+        self.assertIsNone(rebuilt["error"])
+        self.assertEqual(self.b.read_bytes(), data_after)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+"""
+Integration tests for the Myers diff backend behind generate_diff.
+
+These tests verify that:
+- Myers diffs round-trip through the patch engine, forwards and in reverse
+- Output matches difflib's format, and is never a longer edit script
+- The edit distance cap falls back to one replacement that still applies
+- Files holding form feeds or \x1c are patched on "\n" line breaks only
+- Changes over the size limit store full content that mcpdiff can replay
+"""
+
+import sys
+import json
+import random
+import difflib
+import shutil
+import subprocess
+import unittest
+from pathlib import Path
+
+# Initialize the test environment first
+from integration_tests.test_init import MockContext, temp_dir
+
+# Add the parent directory to the path so we can import the module
+sys.path.insert(0, str(Path(__file__).parent.parent))
+
+from src import filesystem, mcp_edit_utils
+from src.mcp_diff import get_diff_backend, myers_opcodes, myers_unified_diff
+from src.mcp_patch import apply_patch_to_lines
+
+MCPDIFF = Path(__file__).parent.parent / "cli" / "mcpdiff.py"
+
+
+def changed_lines(diff_text):
+    return sum(1 for line in diff_text.splitlines() if line[:1] in "+-" and line[:3] not in ("+++", "---"))
+
+
+class TestDiffEngine(unittest.TestCase):
+    """Test the Myers backend against difflib and the patch engine."""
+
+    def test_round_trip(self):
+        """Test random edits apply forwards and in reverse."""
+        rng = random.Random(16)
+        for _ in range(300):
+            a = [f"{rng.randint(0, 6)}\n" for _ in range(rng.randint(0, 40))]
+            b = [line for line in a if rng.random() > 0.2]
+            for _ in range(rng.randint(0, 5)):
+                b.insert(rng.randint(0, len(b)), f"{rng.randint(0, 6)}\n")
+            diff = "".join(myers_unified_diff(a, b, "a/f", "b/f"))
+            self.assertLessEqual(
+                changed_lines(diff), changed_lines("".join(difflib.unified_diff(a, b, "a/f", "b/f")))
+            )
+            if diff:
+                self.assertEqual(apply_patch_to_lines(a, diff)[0], b)
+                self.assertEqual(apply_patch_to_lines(b, diff, reverse=True)[0], a)
+            else:
+                self.assertEqual(a, b)
+
+    def test_same_output_as_difflib(self):
+        """Test a simple edit gives byte-identical output to difflib."""
+        a = [f"line {i}\n" for i in range(30)]
+        b = a[:10] + ["new\n"] + a[12:25] + a[26:]
+        self.assertEqual(
+            "".join(myers_unified_diff(a, b, "a/f", "b/f")),
+            "".join(get_diff_backend("difflib")(a, b, "a/f", "b/f")),
+        )
+        with self.assertRaises(ValueError):
+            get_diff_backend("patience")
+
+    def test_edit_distance_cap(self):
+        """Test exceeding the cap emits one replacement of the changed region."""
+        a = ["same\n"] + [f"a{i}\n" for i in range(50)] + ["end\n"]
+        b = ["same\n"] + [f"b{i}\n" for i in range(50)] + ["end\n"]
+        self.assertEqual(
+            myers_opcodes(a, b, max_d=10), [("equal", 0, 1, 0, 1), ("replace", 1, 51, 1, 51), ("equal", 51, 52, 51, 52)]
+        )
+        self.assertEqual(apply_patch_to_lines(a, mcp_edit_utils.generate_diff(a, b, "f", "f"))[0], b)
+
+
+    def test_control_characters_are_not_line_breaks(self):
+        """Test apply_patch keeps \x0c and \x1c inside their lines."""
+        old = ["x = 1\n", 's = "a\x1cb"\n', "\x0c\n", "end\n"]
+        new = ["x = 1\n", 's = "a\x1cc"\n', "\x0c\n", "end\n"]
+        diff = mcp_edit_utils.generate_diff(old, new, "f.py", "f.py")
+        result, diags = apply_patch_to_lines(old, diff)
+        self.assertEqual(result, new)
+        self.assertEqual([d.fuzz for d in diags], [0])
+
+        ws = Path(temp_dir) / "control_chars_ws"
+        ws.mkdir(exist_ok=True)
+        target = ws / "f.py"
+        target.write_bytes("".join(old).encode())
+        try:
+            self.assertTrue(mcp_edit_utils.apply_patch(diff, str(target), ws))
+            self.assertEqual(target.read_bytes(), "".join(new).encode())
+            self.assertTrue(mcp_edit_utils.apply_patch(diff, str(target), ws, reverse=True))
+            self.assertEqual(target.read_bytes(), "".join(old).encode())
+        finally:
+            shutil.rmtree(ws)
+
+
+class TestOversizedChange(unittest.TestCase):
+    """Test edits over MCP_DIFF_MAX_LINES are stored as content."""
+
+    def setUp(self):
+        """Create a workspace with edit history and a low size limit."""
+        self.ws = Path(temp_dir) / "diff_engine_ws"
+        (self.ws / ".mcp" / "edit_history").mkdir(parents=True)
+        self.path = self.ws / "uv.lock"
+        self.path.write_text("".join(f"old {i}\n" for i in range(100)))
+        self.original_limit = mcp_edit_utils.DIFF_MAX_LINES
+        mcp_edit_utils.DIFF_MAX_LINES = 50
+        self.original_wd = filesystem.WORKING_DIRECTORY
+        filesystem.WORKING_DIRECTORY = temp_dir  # write_file validates against it
+        filesystem._finish_edit()
+        self.ctx = MockContext()
+
+    def tearDown(self):
+        """Restore the limit and clean up."""
+        mcp_edit_utils.DIFF_MAX_LINES = self.original_limit
+        filesystem.WORKING_DIRECTORY = self.original_wd
+        shutil.rmtree(self.ws)
+
+    def test_content_stored_and_replayed(self):
+        """Test the entry has no diff, and mcpdiff rejects it using its checkpoint."""
+        filesystem.write_file(self.ctx, str(self.path), self.path.read_text())  # First-seen checkpoint
+        new_content = "".join(f"new {i}\n" for i in range(100))
+        result = filesystem.write_file(self.ctx, str(self.path), new_content)
+        self.assertTrue(result.startswith("Successfully"), result)
+        self.assertNotIn("Diff (", result)
+
+        logs = list((self.ws / ".mcp" / "edit_history" / "logs").glob("*.log"))
+        entries = [json.loads(line) for log in logs for line in log.read_text().splitlines()]
+        self.assertEqual(len(entries), 2)
+        self.assertIsNone(entries[1]["diff_file"])
+        self.assertTrue(entries[1]["content_file"])
+        self.assertEqual(entries[1]["checkpoint_kind"], "periodic")
+
+        def mcpdiff(*args):
+            return subprocess.run(
+                [sys.executable, str(MCPDIFF), "-w", str(self.ws), *args],
+                input="y\n" * 4,
+                capture_output=True,
+                text=True,
+            )
+
+        show = mcpdiff("show", entries[1]["edit_id"])
+        self.assertIn("full content stored", show.stdout + show.stderr)
+        mcpdiff("accept", "-e", entries[0]["edit_id"])
+        reject = mcpdiff("reject", "-e", entries[1]["edit_id"])
+        self.assertEqual(reject.returncode, 0, reject.stdout + reject.stderr)
+        self.assertEqual(self.path.read_text(), "".join(f"old {i}\n" for i in range(100)))
+
+
+if __name__ == "__main__":
+    unittest.main()
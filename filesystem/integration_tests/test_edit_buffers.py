@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+"""
+Integration tests for the request-scoped file buffers used by tracked edits.
+
+These tests verify that:
+- A tracked edit reads the target once and hashes the written bytes from memory
+- A buffer is not used once the file changes on disk
+- Decoding matches text-mode reads, including CRLF and invalid UTF-8
+"""
+
+import os
+import sys
+import json
+import shutil
+import hashlib
+import builtins
+import unittest
+from pathlib import Path
+
+# Initialize the test environment first
+from integration_tests.test_init import MockContext, temp_dir
+
+# Add the parent directory to the path so we can import the module
+sys.path.insert(0, str(Path(__file__).parent.parent))
+
+from src import filesystem, mcp_edit_utils
+
+
+class TestEditBuffers(unittest.TestCase):
+    """Test that tracked edits share one read of each file."""
+
+    def setUp(self):
+        """Create a workspace with edit history and count file opens."""
+        self.ws = Path(temp_dir) / "edit_buffers_ws"
+        (self.ws / ".mcp" / "edit_history").mkdir(parents=True)
+        self.path = self.ws / "big.py"
+        self.path.write_text("".join(f"x{i} = {i}\n" for i in range(2000)))
+        self.original_wd = filesystem.WORKING_DIRECTORY
+        filesystem.WORKING_DIRECTORY = temp_dir  # Edit tools validate against it
+        filesystem._finish_edit()
+        self.ctx = MockContext()
+        self.opens = []
+
+        def counting_open(file, mode="r", *args, **kwargs):
+            if str(file) == str(self.path):
+                self.opens.append(mode)
+            return builtins.open(file, mode, *args, **kwargs)
+
+        mcp_edit_utils.open = counting_open
+
+    def tearDown(self):
+        """Restore open and clean up."""
+        del mcp_edit_utils.open
+        filesystem.WORKING_DIRECTORY = self.original_wd
+        shutil.rmtree(self.ws)
+
+    def test_single_read_per_edit(self):
+        """Test the decorator and tool body share one read and one write."""
+        result = filesystem.edit_file_diff(self.ctx, str(self.path), replacements={"x5 = 5\n": "x5 = 50\n"})
+        self.assertNotIn("Error", result)
+        self.assertEqual(self.opens, ["rb", "wb"])
+
+        logs = list((self.ws / ".mcp" / "edit_history" / "logs").glob("*.log"))
+        entry = json.loads(logs[0].read_text().splitlines()[-1])
+        self.assertEqual(entry["hash_after"], hashlib.sha256(self.path.read_bytes()).hexdigest())
+        self.assertIn("x5 = 50\n", self.path.read_text())
+
+    def test_stale_buffer_is_reread(self):
+        """Test a file changed after it was buffered is read again."""
+        token = mcp_edit_utils.open_edit_buffers()
+        try:
+            self.assertTrue(mcp_edit_utils.read_file_bytes(self.path).startswith(b"x0 = 0"))
+            mcp_edit_utils.read_file_bytes(str(self.path))
+            self.assertEqual(self.opens, ["rb"])
+            self.path.write_text("changed\n")
+            self.assertEqual(mcp_edit_utils.read_file_bytes(self.path), b"changed\n")
+            self.assertEqual(self.opens, ["rb", "rb"])
+        finally:
+            mcp_edit_utils.close_edit_buffers(token)
+
+    def test_decoding_matches_text_mode(self):
+        """Test decoded lines equal readlines() on the same bytes."""
+        data = b"a\r\nb\rc\n\xff\xfed\x0ce\xe2\x80\xa8f"
+        self.path.write_bytes(data)
+        with builtins.open(self.path, "r", encoding="utf-8", errors="ignore") as f:
+            self.assertEqual(mcp_edit_utils.decode_lines(data), f.readlines())
+        with builtins.open(self.path, "r", encoding="utf-8", errors="ignore") as f:
+            self.assertEqual(mcp_edit_utils.decode_text(data), f.read())
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+"""
+Integration tests for the streaming multi-file search behind grep_files.
+
+These tests verify that:
+- Per-file output matches read_file_by_keyword's context format
+- The match and byte caps stop the search without opening later files
+- Binary files are skipped
+"""
+
+import os
+import sys
+import shutil
+import tempfile
+import unittest
+from pathlib import Path
+
+# Add the parent directory to the path so we can import the module
+sys.path.insert(0, str(Path(__file__).parent.parent))
+
+from src.mcp_grep import compile_line_matcher, grep_file, grep_paths
+
+
+class TestGrepFiles(unittest.TestCase):
+    """Test streaming, parallel grep over many files."""
+
+    def setUp(self):
+        """Create a scratch directory."""
+        self.test_dir = tempfile.mkdtemp(prefix="mcp_grep_test_")
+
+    def tearDown(self):
+        """Clean up the scratch directory."""
+        shutil.rmtree(self.test_dir)
+
+    def _write(self, name: str, lines, mode: str = "w") -> str:
+        path = os.path.join(self.test_dir, name)
+        with open(path, mode) as f:
+            f.write(lines if mode == "wb" else "".join(f"{line}\n" for line in lines))
+        return path
+
+    def test_context_regions(self):
+        """Test regions are merged and separated like read_file_by_keyword."""
+        path = self._write("a.py", ["x", "hit", "x", "x", "hit", "x", "x", "x", "x", "hit"])
+        sections, total, truncated = grep_paths(
+            [path], compile_line_matcher("HIT", ignore_case=True), 1, 1, 100, 10**6
+        )
+        self.assertEqual((total, truncated), (3, False))
+        self.assertEqual(
+            sections,
+            [(path, ["1  x", "2> hit", "3  x", "4  x", "5> hit", "6  x", "---", "9  x", "10> hit"])],
+        )
+
+    def test_match_cap_stops_early(self):
+        """Test the cap keeps the last match's context and skips later files."""
+        paths = [self._write(f"f{i}.txt", ["foo", "bar", "foo", "bar"]) for i in range(8)]
+        opened = []
+
+        def lazy_paths():
+            for path in paths:
+                opened.append(path)
+                yield path
+
+        sections, total, truncated = grep_paths(
+            lazy_paths(), compile_line_matcher("fo+", use_regex=True), 0, 1, 3, 10**6, max_workers=1
+        )
+        self.assertEqual((total, truncated), (3, True))
+        self.assertEqual([lines for _, lines in sections], [["1> foo", "2  bar", "3> foo", "4  bar"], ["1> foo", "2  bar"]])
+        self.assertLess(len(opened), len(paths))
+
+    def test_byte_cap_and_binary(self):
+        """Test output stops at max_bytes and binary files are ignored."""
+        binary = self._write("blob.bin", b"needle\0\0\0", mode="wb")
+        text = self._write("t.txt", ["needle"] * 50)
+        self.assertEqual(grep_file(binary, compile_line_matcher("needle"), 0, 0, 10).match_count, 0)
+
+        sections, total, truncated = grep_paths(
+            [binary, text], compile_line_matcher("needle"), 0, 0, 1000, 40
+        )
+        self.assertTrue(truncated)
+        self.assertEqual(len(sections), 1)
+        self.assertLessEqual(sum(len(line) + 1 for line in sections[0][1]), 40)
+        self.assertEqual(total, len(sections[0][1]))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""
+Integration tests for the stat fast path in mcpdiff hash verification.
+
+These tests verify that:
+- Logged edits record the file's size, mtime and inode next to hash_after
+- Verification trusts an unchanged stat and hashes the file otherwise
+- Conversation-wide accept hashes only the files whose stat changed, up front
+- Accepting records the stamp of the reconstructed file
+"""
+
+import os
+import sys
+import shutil
+import unittest
+from pathlib import Path
+from unittest import mock
+
+# Initialize the test environment first
+from integration_tests.test_init import MockContext, temp_dir
+
+# Add the parent directory to the path so we can import the module
+sys.path.insert(0, str(Path(__file__).parent.parent))
+sys.path.insert(0, str(Path(__file__).parent.parent / "cli"))
+
+from src import filesystem
+import mcpdiff
+import mcpdiff_utils as utils
+import mcpdiff_history as history
+import mcpdiff_index
+
+
+class TestHashVerification(unittest.TestCase):
+    """Test verification of files before accept and reject."""
+
+    def setUp(self):
+        """Edit three files in one apply_edits call."""
+        self.ws = Path(temp_dir) / "hash_verification_ws"
+        self.history_root = self.ws / ".mcp" / "edit_history"
+        self.history_root.mkdir(parents=True)
+        self.files = [self.ws / f"f{i}.py" for i in range(3)]
+        for path in self.files:
+            path.write_text("value = 1\n")
+        filesystem._finish_edit()
+        result = filesystem.apply_edits(
+            MockContext(),
+            [{"path": str(p), "replacements": {"value = 1": "value = 2"}} for p in self.files],
+        )
+        self.assertTrue(result.startswith("Applied 3 edits"), result)
+
+    def tearDown(self):
+        """Clean up the workspace and the hash cache."""
+        utils._hash_cache = None
+        shutil.rmtree(self.ws)
+
+    def _entries(self):
+        index = mcpdiff_index.open_history_index(self.history_root)
+        try:
+            return index.all_entries()
+        finally:
+            index.close()
+
+    def test_log_records_stat_after(self):
+        """Test each entry carries the stamp of the file it hashed."""
+        for entry in self._entries():
+            path = self.ws / entry["file_path"]
+            self.assertEqual(entry["stat_after"], utils.stat_stamp(path))
+            self.assertEqual(entry["hash_after"], utils.calculate_hash(str(path)))
+
+    def test_verify_uses_stat_then_hash(self):
+        """Test an unchanged stamp skips hashing and a changed one falls back to it."""
+        entry = self._entries()[0]
+        path = self.ws / entry["file_path"]
+        with mock.patch.object(utils, "calculate_hash", side_effect=AssertionError("hashed")):
+            self.assertTrue(
+                history.verify_file_hash(path, entry["hash_after"], entry["stat_after"])
+            )
+
+        # Same content, new mtime: hashed and still verified
+        os.utime(path, ns=(entry["stat_after"]["mtime_ns"] + 10**9,) * 2)
+        with mock.patch.object(utils, "calculate_hash", wraps=utils.calculate_hash) as hashed:
+            self.assertTrue(
+                history.verify_file_hash(path, entry["hash_after"], entry["stat_after"])
+            )
+        hashed.assert_called_once_with(str(path))
+
+        path.write_text("value = 3\n")
+        self.assertFalse(history.verify_file_hash(path, entry["hash_after"], entry["stat_after"]))
+        self.assertFalse(history.verify_file_hash(path, entry["hash_after"]))  # Entries without a stamp
+
+    def test_conversation_accept_hashes_changed_files_only(self):
+        """Test accept pre-hashes only the modified file and skips it when declined."""
+        entries = self._entries()
+        modified = self.files[2]
+        modified.write_text("value = 2  # edited outside\n")
+
+        with mock.patch.object(utils, "prime_hash_cache", wraps=utils.prime_hash_cache) as prime, \
+                mock.patch("builtins.input", side_effect=EOFError):
+            successful, failed = mcpdiff._accept_or_reject_conversation(
+                entries[0]["conversation_id"], "accept", self.ws, self.history_root, entries
+            )
+
+        prime.assert_called_once_with([str(modified)])
+        self.assertEqual((successful, failed), (2, 1))
+        self.assertEqual(modified.read_text(), "value = 2  # edited outside\n")
+
+        accepted = [e for e in self._entries() if e["status"] == "accepted"]
+        self.assertEqual(len(accepted), 2)
+        for entry in accepted:
+            self.assertEqual(entry["stat_after"], utils.stat_stamp(self.ws / entry["file_path"]))
+
+    def test_prime_hash_cache(self):
+        """Test parallel priming fills the cache that calculate_hash reads."""
+        paths = [str(p) for p in self.files]
+        utils.prime_hash_cache(paths)
+        self.assertEqual(set(utils._hash_cache), set(paths))
+        with mock.patch("builtins.open", side_effect=AssertionError("read")):
+            digests = [utils.calculate_hash(p) for p in paths]
+        self.assertEqual(len(set(digests)), 1)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+"""
+Integration tests for the SQLite history index used by mcpdiff.
+
+These tests verify that:
+- Index queries return the same entries, in the same order, as filtering the logs
+- Only records appended since the last sync are ingested
+- Rewritten logs are re-indexed and removed logs are forgotten
+- Status updates append a superseding record instead of rewriting the log
+"""
+
+import sys
+import shutil
+import tempfile
+import unittest
+from pathlib import Path
+
+# Add the cli directory to the path so we can import the modules
+sys.path.insert(0, str(Path(__file__).parent.parent / "cli"))
+
+import mcpdiff_utils as utils
+import mcpdiff_history as history
+from mcpdiff_index import HistoryIndex, INDEX_FILE_NAME
+
+
+def make_entry(edit_id, conv, file_path, index, status="pending", operation="edit"):
+    return {
+        "edit_id": edit_id,
+        "conversation_id": conv,
+        "tool_call_index": index,
+        "timestamp": f"2025-01-01T00:00:{index:02d}.000Z",
+        "operation": operation,
+        "file_path": file_path,
+        "status": status,
+    }
+
+
+class TestHistoryIndex(unittest.TestCase):
+    """Test the index backing mcpdiff status and show."""
+
+    def setUp(self):
+        """Create a history root with two conversation logs."""
+        self.test_dir = tempfile.mkdtemp(prefix="mcpdiff_index_test_")
+        self.history_root = Path(self.test_dir) / ".mcp" / "edit_history"
+        self.logs_dir = self.history_root / "logs"
+        self.log_a = self.logs_dir / "conv-alpha-111.log"
+        self.log_b = self.logs_dir / "conv-beta-222.log"
+        for i in range(6):
+            utils.append_log_entry(
+                self.log_a,
+                make_entry(f"a{i:03d}-edit", "conv-alpha-111", f"src/mod{i % 2}.py", 2 * i),
+            )
+        for i in range(4):
+            utils.append_log_entry(
+                self.log_b,
+                make_entry(f"b{i:03d}-edit", "conv-beta-222", "docs/readme.md", 2 * i + 1, operation="create"),
+            )
+
+    def tearDown(self):
+        """Clean up the workspace."""
+        shutil.rmtree(self.test_dir)
+
+    def _open(self):
+        index = HistoryIndex.open(self.history_root)
+        index.sync()
+        self.addCleanup(index.close)
+        return index
+
+    def _ids(self, entries):
+        return [e["edit_id"] for e in entries]
+
+    def test_queries_match_log_filtering(self):
+        """Test filters, limits and ordering agree with filter_entries over the logs."""
+        index = self._open()
+        all_entries = history.find_all_entries(self.history_root)
+        self.assertEqual(self._ids(index.all_entries()), self._ids(all_entries))
+        self.assertTrue((self.history_root / INDEX_FILE_NAME).is_file())
+
+        cases = [
+            {},
+            {"limit": 3},
+            {"limit": 0},
+            {"limit": None},
+            {"conv_id": "conv-al", "limit": 0},
+            {"conv_id": "222", "limit": 0},
+            {"file_path": "mod1", "limit": 0},
+            {"status": "PENDING", "op_type": "create", "limit": 2},
+        ]
+        for kwargs in cases:
+            with self.subTest(filters=kwargs):
+                self.assertEqual(
+                    self._ids(index.filter_entries(**kwargs)),
+                    self._ids(history.filter_entries(all_entries, **kwargs)),
+                )
+
+    def test_id_and_conversation_lookup(self):
+        """Test edit ID prefix and conversation prefix/suffix lookups."""
+        index = self._open()
+        self.assertEqual(self._ids(index.find_by_id_prefix("A00")), [f"a00{i}-edit" for i in range(6)])
+        self.assertEqual(self._ids(index.find_by_id_prefix("b002")), ["b002-edit"])
+        self.assertEqual(index.find_by_id_prefix("zzz"), [])
+        self.assertEqual(len(index.find_by_conversation("conv-beta")), 4)
+        self.assertEqual(len(index.find_by_conversation("alpha-111")), 6)
+        self.assertEqual(
+            index.find_by_id_prefix("b000")[0]["log_file_source"], self.log_b.name
+        )
+
+    def test_sync_ingests_only_appended_records(self):
+        """Test a second sync only reads what was appended, even across reopen."""
+        self._open()
+        utils.append_log_entry(self.log_a, make_entry("a900-edit", "conv-alpha-111", "new.py", 50))
+        with open(self.log_a, "a") as f:
+            f.write('{"edit_id": "partial"')  # Unterminated write in progress
+
+        index = self._open()
+        self.assertEqual(index.count(), 11)
+        self.assertEqual(index.sync(), 0)
+        with open(self.log_a, "a") as f:
+            f.write(', "conversation_id": "conv-alpha-111", "timestamp": 0}\n')
+        self.assertEqual(index.sync(), 1)
+        self.assertEqual(self._ids(index.find_by_id_prefix("partial")), ["partial"])
+
+    def test_rewritten_and_removed_logs_are_reindexed(self):
+        """Test compaction and deleted logs are picked up by the next sync."""
+        index = self._open()
+        entries = utils.read_log_file(self.log_a)[:2]
+        utils.write_log_file(self.log_a, entries)
+        self.log_b.unlink()
+
+        index.sync()
+        self.assertEqual(self._ids(index.all_entries()), ["a000-edit", "a001-edit"])
+
+    def test_status_update_appends_superseding_record(self):
+        """Test update_entry_status appends and the newest record wins everywhere."""
+        index = self._open()
+        entry = index.find_by_id_prefix("a002")[0]
+        size_before = self.log_a.stat().st_size
+        original = self.log_a.read_bytes()
+
+        self.assertTrue(history.update_entry_status(entry, "accepted", self.history_root))
+
+        self.assertTrue(self.log_a.read_bytes().startswith(original))
+        self.assertGreater(self.log_a.stat().st_size, size_before)
+        self.assertEqual(index.sync(), 1)
+        self.assertEqual(index.count(), 10)
+        self.assertEqual(self._ids(index.filter_entries(status="accepted")), ["a002-edit"])
+        from_logs = [
+            e for e in history.find_all_entries(self.history_root) if e["edit_id"] == "a002-edit"
+        ]
+        self.assertEqual([e["status"] for e in from_logs], ["accepted"])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+"""
+Integration tests for the append-only edit history log.
+
+These tests verify that:
+- Log entries are appended without rewriting earlier lines
+- The set of logged file paths is kept in memory and follows external rewrites
+- A torn final line does not corrupt the next append
+- `mcpdiff cleanup --compact` drops torn and superseded lines
+- Periodic checkpoints are due after N edits or M diff bytes
+"""
+
+import os
+import sys
+import json
+import shutil
+import tempfile
+import unittest
+from pathlib import Path
+
+# Add the parent directory to the path so we can import the module
+sys.path.insert(0, str(Path(__file__).parent.parent))
+sys.path.insert(0, str(Path(__file__).parent.parent / "cli"))
+
+from src import mcp_edit_utils
+from src.mcp_edit_utils import (
+    append_log_entry,
+    checkpoint_due,
+    get_logged_file_paths,
+    read_log_file,
+)
+import mcpdiff_history
+
+
+def make_entry(edit_id, file_path, status="pending", index=0):
+    return {
+        "edit_id": edit_id,
+        "conversation_id": "conv",
+        "tool_call_index": index,
+        "timestamp": f"2025-01-01T00000{index}.0Z",
+        "operation": "edit",
+        "file_path": file_path,
+        "status": status,
+    }
+
+
+class TestHistoryLog(unittest.TestCase):
+    """Test the append-only conversation log used by track_edit_history."""
+
+    def setUp(self):
+        """Create a history root with an empty logs directory."""
+        self.test_dir = tempfile.mkdtemp(prefix="mcp_history_log_test_")
+        self.history_root = Path(self.test_dir) / ".mcp" / "edit_history"
+        self.log_file = self.history_root / "logs" / "conv.log"
+        mcp_edit_utils._log_seen_paths.clear()
+
+    def tearDown(self):
+        """Clean up the workspace and in-memory state."""
+        mcp_edit_utils._log_seen_paths.clear()
+        shutil.rmtree(self.test_dir)
+
+    def test_append_keeps_earlier_lines(self):
+        """Test appends add one line each and leave existing bytes untouched."""
+        append_log_entry(self.log_file, make_entry("a", "x.py"))
+        first = self.log_file.read_bytes()
+        append_log_entry(self.log_file, make_entry("b", "y.py", index=1))
+
+        content = self.log_file.read_bytes()
+        self.assertTrue(content.startswith(first))
+        self.assertEqual([e["edit_id"] for e in read_log_file(self.log_file)], ["a", "b"])
+
+    def test_seen_paths_served_from_memory(self):
+        """Test logged paths are tracked without re-reading the log."""
+        self.assertEqual(get_logged_file_paths(self.log_file), set())
+        append_log_entry(self.log_file, make_entry("a", "x.py"))
+        append_log_entry(self.log_file, make_entry("b", "y.py", index=1))
+
+        original_read = mcp_edit_utils.read_log_file
+        mcp_edit_utils.read_log_file = None  # Any re-read would fail loudly
+        try:
+            self.assertEqual(get_logged_file_paths(self.log_file), {"x.py", "y.py"})
+        finally:
+            mcp_edit_utils.read_log_file = original_read
+
+    def test_seen_paths_follow_external_rewrite(self):
+        """Test a log rewritten by another process is re-read."""
+        append_log_entry(self.log_file, make_entry("a", "x.py"))
+        get_logged_file_paths(self.log_file)
+        with open(self.log_file, "w") as f:
+            f.write(json.dumps(make_entry("c", "other/z.py")) + "\n")
+
+        self.assertEqual(get_logged_file_paths(self.log_file), {"other/z.py"})
+
+    def test_append_after_torn_line(self):
+        """Test a crash-truncated last line stays separate from the next entry."""
+        append_log_entry(self.log_file, make_entry("a", "x.py"))
+        with open(self.log_file, "a") as f:
+            f.write('{"edit_id": "torn", "file_pa')
+        append_log_entry(self.log_file, make_entry("b", "y.py", index=1))
+
+        self.assertEqual([e["edit_id"] for e in read_log_file(self.log_file)], ["a", "b"])
+
+    def test_cleanup_compacts_logs(self):
+        """Test compaction removes torn lines and keeps the last record per edit."""
+        append_log_entry(self.log_file, make_entry("a", "x.py"))
+        append_log_entry(self.log_file, make_entry("b", "y.py", index=1))
+        with open(self.log_file, "a") as f:
+            f.write('{"edit_id": "torn"\n')
+        append_log_entry(self.log_file, make_entry("a", "x.py", status="accepted"))
+
+        rewritten, removed = mcpdiff_history.compact_log_files(self.history_root)
+
+        self.assertEqual((rewritten, removed), (1, 2))
+        entries = read_log_file(self.log_file)
+        self.assertEqual(
+            [(e["edit_id"], e["status"]) for e in entries],
+            [("a", "accepted"), ("b", "pending")],
+        )
+        # Already compact logs are left alone
+        self.assertEqual(mcpdiff_history.compact_log_files(self.history_root), (0, 0))
+
+    def test_periodic_checkpoint_due(self):
+        """Test edit and diff-byte counters reset at each checkpointed entry."""
+        for name in ("CHECKPOINT_EVERY_EDITS", "CHECKPOINT_EVERY_DIFF_BYTES"):
+            self.addCleanup(setattr, mcp_edit_utils, name, getattr(mcp_edit_utils, name))
+        mcp_edit_utils.CHECKPOINT_EVERY_EDITS = 3
+        mcp_edit_utils.CHECKPOINT_EVERY_DIFF_BYTES = 0
+
+        first = make_entry("a", "x.py")
+        first["checkpoint_file"] = "checkpoints/conv/x.py.chkpt"
+        append_log_entry(self.log_file, first)
+        append_log_entry(self.log_file, make_entry("b", "x.py", index=1))
+        self.assertFalse(checkpoint_due(self.log_file, "x.py"))
+        append_log_entry(self.log_file, make_entry("c", "x.py", index=2))
+        self.assertTrue(checkpoint_due(self.log_file, "x.py"))
+        self.assertFalse(checkpoint_due(self.log_file, "y.py"))
+
+        periodic = make_entry("d", "x.py", index=3)
+        periodic["checkpoint_file"] = "checkpoints/conv/objects/h.chkpt"
+        append_log_entry(self.log_file, periodic)
+        self.assertFalse(checkpoint_due(self.log_file, "x.py"))
+
+        # Counters survive a rebuild from the log, and diff bytes count too
+        mcp_edit_utils._log_seen_paths.clear()
+        mcp_edit_utils.CHECKPOINT_EVERY_EDITS = 0
+        mcp_edit_utils.CHECKPOINT_EVERY_DIFF_BYTES = 100
+        diff_file = self.history_root / "diffs" / "conv" / "e.diff"
+        diff_file.parent.mkdir(parents=True)
+        diff_file.write_text("+" * 150)
+        big = make_entry("e", "x.py", index=4)
+        big["diff_file"] = "diffs/conv/e.diff"
+        self.assertFalse(checkpoint_due(self.log_file, "x.py"))
+        append_log_entry(self.log_file, big)
+        self.assertTrue(checkpoint_due(self.log_file, "x.py"))
+
+        # Compressed or packed diff objects count by their logged raw size
+        packed = make_entry("f", "y.py", index=5)
+        packed["checkpoint_file"] = "objects/ab/h.z"
+        packed["diff_file"] = "objects/cd/packed.z"  # Not a loose file
+        packed["diff_bytes"] = 150
+        append_log_entry(self.log_file, packed)
+        self.assertTrue(checkpoint_due(self.log_file, "y.py"))
+        mcp_edit_utils._log_seen_paths.clear()
+        self.assertTrue(checkpoint_due(self.log_file, "y.py"))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""
+Integration tests for the line-offset index behind read_file.
+
+These tests verify that:
+- Range reads match readlines() for any span, line ending and file length
+- Overlapping and unordered spans return each line once, in order
+- The cached index is rebuilt when the file changes
+"""
+
+import os
+import sys
+import random
+import shutil
+import tempfile
+import unittest
+from pathlib import Path
+
+# Add the parent directory to the path so we can import the module
+sys.path.insert(0, str(Path(__file__).parent.parent))
+
+from src import mcp_line_index
+from src.mcp_line_index import LINE_INDEX_STRIDE, read_line_spans
+
+
+class TestLineIndex(unittest.TestCase):
+    """Test mmap-backed line range reads."""
+
+    def setUp(self):
+        """Create a scratch directory."""
+        self.test_dir = tempfile.mkdtemp(prefix="mcp_line_index_test_")
+        self.path = os.path.join(self.test_dir, "f.txt")
+        mcp_line_index._line_index_cache.clear()
+
+    def tearDown(self):
+        """Clean up the scratch directory and cache."""
+        mcp_line_index._line_index_cache.clear()
+        shutil.rmtree(self.test_dir)
+
+    def _write(self, content: str):
+        with open(self.path, "w", newline="") as f:
+            f.write(content)
+
+    def test_matches_readlines(self):
+        """Test spans around stride boundaries against a full read."""
+        rng = random.Random(7)
+        for n in (0, 1, LINE_INDEX_STRIDE - 1, LINE_INDEX_STRIDE, LINE_INDEX_STRIDE + 1, 3 * LINE_INDEX_STRIDE):
+            for ending in ("\n", "\r\n"):
+                for trailing in (True, False):
+                    body = ending.join(f"row {i} " + "x" * rng.randint(0, 4) for i in range(n))
+                    self._write(body + (ending if trailing and n else ""))
+                    with open(self.path, "r", newline="") as f:
+                        expected = [line.rstrip("\r\n") for line in f.readlines()]
+                    spans = [(1, 3), (max(1, n - 2), n + 5), (LINE_INDEX_STRIDE, LINE_INDEX_STRIDE + 1)]
+                    with self.subTest(n=n, ending=repr(ending), trailing=trailing):
+                        total, selected = read_line_spans(self.path, spans)
+                        self.assertEqual(total, len(expected))
+                        wanted = sorted({i for a, b in spans for i in range(a, b + 1) if i <= n})
+                        self.assertEqual(selected, [(i, expected[i - 1]) for i in wanted])
+
+    def test_overlapping_spans(self):
+        """Test unordered, overlapping spans are merged."""
+        self._write("".join(f"{i}\n" for i in range(1, 21)))
+        total, selected = read_line_spans(self.path, [(10, 12), (5, 5), (11, 14), (30, 40)])
+        self.assertEqual(total, 20)
+        self.assertEqual([n for n, _ in selected], [5, 10, 11, 12, 13, 14])
+
+    def test_index_follows_file_changes(self):
+        """Test a modified file is re-indexed instead of served from cache."""
+        self._write("a\nb\n")
+        self.assertEqual(read_line_spans(self.path, [(2, 2)]), (2, [(2, "b")]))
+        self._write("a\nb\nc\nd\n")
+        os.utime(self.path, ns=(0, 10**9))  # Ensure the mtime differs
+        self.assertEqual(read_line_spans(self.path, [(4, 4)]), (4, [(4, "d")]))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+"""
+Integration tests for `mcpdiff serve`, the JSON-RPC mode used by the Neovim plugin.
+
+These tests verify that:
+- Requests run the same subcommands as the CLI and return their output
+- The history index is only re-synced after a log file changes
+- Protocol errors, notifications and shutdown follow JSON-RPC 2.0
+- The server can be driven over real stdio pipes
+"""
+
+import io
+import sys
+import json
+import shutil
+import tempfile
+import unittest
+import subprocess
+from pathlib import Path
+from unittest import mock
+
+# Add the cli directory to the path so we can import the modules
+CLI_DIR = Path(__file__).parent.parent / "cli"
+sys.path.insert(0, str(CLI_DIR))
+
+import mcpdiff
+import mcpdiff_utils as utils
+import mcpdiff_serve
+from mcpdiff_index import HistoryIndex
+
+
+def make_entry(edit_id, conv, file_path, index, status="pending"):
+    return {
+        "edit_id": edit_id,
+        "conversation_id": conv,
+        "tool_call_index": index,
+        "timestamp": f"2025-01-01T00:00:{index:02d}.000Z",
+        "operation": "edit",
+        "file_path": file_path,
+        "status": status,
+    }
+
+
+class TestMcpdiffServe(unittest.TestCase):
+    """Test the long-lived JSON-RPC server."""
+
+    def setUp(self):
+        """Create a workspace with one conversation log."""
+        self.test_dir = tempfile.mkdtemp(prefix="mcpdiff_serve_test_")
+        self.workspace = Path(self.test_dir)
+        self.history_root = self.workspace / ".mcp" / "edit_history"
+        self.log_file = self.history_root / "logs" / "conv-alpha-111.log"
+        for i in range(3):
+            utils.append_log_entry(
+                self.log_file, make_entry(f"a{i:03d}-edit", "conv-alpha-111", "src/app.py", i)
+            )
+        self.session = mcpdiff_serve.ServeSession(
+            mcpdiff.build_parser(), self.workspace, self.history_root, 1.0, mcpdiff.run_command
+        )
+        self.addCleanup(self.session.close)
+
+    def tearDown(self):
+        """Clean up the workspace and the hash cache the server turned on."""
+        utils._hash_cache = None
+        shutil.rmtree(self.test_dir)
+
+    def _serve(self, *requests):
+        """Run the server over in-memory streams and return the decoded responses."""
+        lines = [r if isinstance(r, str) else json.dumps(r) for r in requests]
+        stdout = io.StringIO()
+        mcpdiff_serve.serve(self.session, io.StringIO("\n".join(lines) + "\n"), stdout)
+        return [json.loads(line) for line in stdout.getvalue().splitlines()]
+
+    def _request(self, request_id, method, *args):
+        return {"jsonrpc": "2.0", "id": request_id, "method": method, "params": {"args": list(args)}}
+
+    def test_requests_run_subcommands_and_reuse_the_index(self):
+        """Test status and show answer from the open index, syncing only after a log change."""
+        session = self.session
+        with mock.patch.object(HistoryIndex, "sync", autospec=True, side_effect=HistoryIndex.sync) as sync:
+            first = session.handle(self._request(1, "status", "-n", "0"))[0]["result"]
+            again = session.handle(self._request(2, "show", "a001"))[0]["result"]
+            syncs_before_append = sync.call_count
+
+            utils.append_log_entry(
+                self.log_file, make_entry("a900-edit", "conv-alpha-111", "src/new.py", 9)
+            )
+            after = session.handle(self._request(3, "status", "-n", "0"))[0]["result"]
+
+        self.assertEqual(first["exit_code"], 0)
+        self.assertIn("a002-edi", first["stdout"])  # Summaries show 8-char IDs
+        self.assertIn("Details for Edit: a001-edit", again["stdout"])
+        self.assertEqual(syncs_before_append, 1)  # Opening the index; the repeat was free
+        self.assertEqual(sync.call_count, 2)
+        self.assertIn("a900-edi", after["stdout"])
+
+    def test_mutating_command_forces_resync(self):
+        """Test accept output is captured and the next request re-reads the logs."""
+        result = self.session.handle(self._request(1, "accept", "-e", "zzz"))[0]["result"]
+        self.assertIn("No entry found with ID prefix: zzz", result["stdout"])
+        self.assertIsNone(self.session._signature)
+
+    def test_protocol_errors_notifications_and_shutdown(self):
+        """Test malformed requests get JSON-RPC errors and shutdown stops reading."""
+        responses = self._serve(
+            "{not json",
+            self._request(1, "review"),
+            {"jsonrpc": "2.0", "id": 2, "method": "show", "params": {"args": "a001"}},
+            self._request(3, "show"),
+            {"jsonrpc": "2.0", "method": "status", "params": {"args": []}},
+            {"jsonrpc": "2.0", "id": 4, "method": "ping"},
+            {"jsonrpc": "2.0", "id": 5, "method": "shutdown"},
+            self._request(6, "status"),
+        )
+
+        self.assertEqual([r["id"] for r in responses], [None, 1, 2, 3, 4, 5])
+        self.assertEqual(responses[0]["error"]["code"], mcpdiff_serve.PARSE_ERROR)
+        self.assertEqual(responses[1]["error"]["code"], mcpdiff_serve.METHOD_NOT_FOUND)
+        self.assertEqual(responses[2]["error"]["code"], mcpdiff_serve.INVALID_PARAMS)
+        # Usage errors come back as the exit code and message argparse would print
+        self.assertEqual(responses[3]["result"]["exit_code"], 2)
+        self.assertIn("identifier", responses[3]["result"]["stderr"])
+        self.assertEqual(responses[4]["result"], {"workspace": str(self.workspace)})
+        self.assertIsNone(self.session.index)  # Closed on shutdown
+
+    def test_serve_over_stdio(self):
+        """Test the serve subcommand end to end through pipes."""
+        requests = [
+            self._request(1, "status", "--status", "pending"),
+            {"jsonrpc": "2.0", "id": 2, "method": "shutdown"},
+        ]
+        proc = subprocess.run(
+            [sys.executable, str(CLI_DIR / "mcpdiff.py"), "-w", str(self.workspace), "serve"],
+            input="".join(json.dumps(r) + "\n" for r in requests),
+            capture_output=True,
+            text=True,
+            timeout=60,
+        )
+
+        self.assertEqual(proc.returncode, 0, proc.stderr)
+        responses = [json.loads(line) for line in proc.stdout.splitlines()]
+        self.assertEqual([r["id"] for r in responses], [1, 2])
+        self.assertIn("Showing 3 of 3 total entries.", responses[0]["result"]["stdout"])
+
+
+if __name__ == "__main__":
+    unittest.main()
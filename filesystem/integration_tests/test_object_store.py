@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""
+Integration tests for the content-addressed history object store.
+
+These tests verify that:
+- The server stores checkpoints and diffs compressed, once per content hash
+- mcpdiff reads objects whether loose or packed, and plain legacy files
+- Packing removes loose objects and skips ones already packed
+- The server does not write a loose copy of an object that is already packed
+"""
+
+import sys
+import zlib
+import shutil
+import tempfile
+import unittest
+from pathlib import Path
+
+# Add the parent directory to the path so we can import the module
+sys.path.insert(0, str(Path(__file__).parent.parent))
+sys.path.insert(0, str(Path(__file__).parent.parent / "cli"))
+
+from src.mcp_edit_utils import calculate_hash, object_exists, store_file_object, write_object
+import mcpdiff_objects as objects
+
+
+class TestObjectStore(unittest.TestCase):
+    """Test the object store shared by the server and mcpdiff."""
+
+    def setUp(self):
+        """Create an empty history root."""
+        self.test_dir = Path(tempfile.mkdtemp(prefix="mcp_object_store_test_"))
+        self.history_root = self.test_dir / ".mcp" / "edit_history"
+        self.history_root.mkdir(parents=True)
+
+    def tearDown(self):
+        """Clean up the workspace."""
+        shutil.rmtree(self.test_dir)
+
+    def test_objects_deduplicated_and_compressed(self):
+        """Test identical content is stored once, compressed, under its hash."""
+        source = self.test_dir / "x.py"
+        source.write_text("content\n" * 100)
+        content_hash = calculate_hash(str(source))
+
+        first = store_file_object(self.history_root, source, content_hash)
+        stored = self.history_root / first
+        mtime = stored.stat().st_mtime_ns
+        second = write_object(self.history_root, source.read_bytes())
+
+        self.assertEqual(first, second)
+        self.assertEqual(objects.object_hash(first), content_hash)
+        self.assertLess(stored.stat().st_size, source.stat().st_size)
+        self.assertEqual(zlib.decompress(stored.read_bytes()), source.read_bytes())
+        self.assertEqual(stored.stat().st_mtime_ns, mtime)
+
+    def test_read_loose_packed_and_legacy(self):
+        """Test artifacts stay readable through packing, and plain files still work."""
+        blobs = [f"blob {i}\n".encode() for i in range(5)]
+        paths = [write_object(self.history_root, b) for b in blobs]
+        legacy = self.history_root / "diffs" / "conv" / "e.diff"
+        legacy.parent.mkdir(parents=True)
+        legacy.write_text("--- a/x\n")
+
+        self.assertEqual(objects.pack_loose_objects(self.history_root, min_objects=10), 0)
+        self.assertEqual(objects.pack_loose_objects(self.history_root, min_objects=1), 5)
+        self.assertFalse((self.history_root / paths[0]).exists())
+
+        for path, blob in zip(paths, blobs):
+            self.assertTrue(objects.artifact_exists(self.history_root, path))
+            self.assertEqual(objects.read_artifact(self.history_root, path), blob)
+        self.assertEqual(objects.read_artifact(self.history_root, legacy), b"--- a/x\n")
+        self.assertFalse(objects.artifact_exists(self.history_root, "objects/00/" + "0" * 64 + ".z"))
+
+        # The server sees packed objects and does not store them loose again
+        self.assertTrue(object_exists(self.history_root, objects.object_hash(paths[0])))
+        self.assertEqual(write_object(self.history_root, blobs[0]), paths[0])
+        self.assertFalse((self.history_root / paths[0]).exists())
+        source = self.test_dir / "b.txt"
+        source.write_bytes(blobs[1])
+        store_file_object(self.history_root, source, objects.object_hash(paths[1]))
+        self.assertFalse((self.history_root / paths[1]).exists())
+
+        # A loose copy that reappears after packing is dropped, not packed twice
+        (self.history_root / paths[0]).parent.mkdir(parents=True, exist_ok=True)
+        (self.history_root / paths[0]).write_bytes(zlib.compress(blobs[0]))
+        self.assertEqual(objects.pack_loose_objects(self.history_root, min_objects=1), 1)
+        self.assertEqual(len(list((self.history_root / "objects" / "pack").glob("*.idx"))), 1)
+        self.assertEqual(objects.read_artifact(self.history_root, paths[0]), blobs[0])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+"""
+Integration tests for the in-memory unified diff engine.
+
+These tests verify that:
+- Diffs from difflib round-trip forward and in reverse
+- Moved hunks are found with an offset, and stale context with fuzz
+- "No newline at end of file" markers are honoured
+- Lines break at "\n" only, so form feeds and \x1c are ordinary content
+- History reconstruction replays diffs without spawning processes
+- Periodic checkpoints shorten replay unless they include a skipped edit
+"""
+
+import sys
+import random
+import difflib
+import shutil
+import tempfile
+import unittest
+import subprocess
+from pathlib import Path
+
+# Add the cli directory to the path so we can import the modules
+sys.path.insert(0, str(Path(__file__).parent.parent / "cli"))
+
+import mcpdiff_utils as utils
+import mcpdiff_history as history
+from mcpdiff_patch import PatchError, apply_patch_to_lines, format_diagnostics
+
+
+def make_diff(old, new, path="f.py"):
+    return "".join(
+        difflib.unified_diff(old, new, fromfile=f"a/{path}", tofile=f"b/{path}")
+    )
+
+
+class TestPatchEngine(unittest.TestCase):
+    """Test applying and reversing unified diffs on line lists."""
+
+    def test_random_round_trips(self):
+        """Test random edits apply forward and reverse exactly."""
+        rng = random.Random(1234)
+        for trial in range(200):
+            old = [f"line {rng.randint(0, 30)}\n" for _ in range(rng.randint(0, 40))]
+            new = list(old)
+            for _ in range(rng.randint(1, 6)):
+                pos = rng.randint(0, len(new))
+                if new and rng.random() < 0.5:
+                    del new[min(pos, len(new) - 1)]
+                else:
+                    new.insert(pos, f"added {trial}\n")
+            diff = make_diff(old, new)
+            with self.subTest(trial=trial):
+                self.assertEqual(apply_patch_to_lines(old, diff)[0], new)
+                self.assertEqual(apply_patch_to_lines(new, diff, reverse=True)[0], old)
+
+    def test_offset_and_fuzz(self):
+        """Test a shifted hunk applies with an offset and stale context with fuzz."""
+        old = [f"{i}\n" for i in range(20)]
+        new = list(old)
+        new[10] = "ten\n"
+        diff = make_diff(old, new)
+
+        shifted = ["header\n"] * 3 + old
+        result, diags = apply_patch_to_lines(shifted, diff)
+        self.assertEqual(result, ["header\n"] * 3 + new)
+        self.assertEqual((diags[0].offset, diags[0].fuzz), (3, 0))
+        self.assertIn("offset 3 lines", format_diagnostics(diags))
+
+        stale = list(old)
+        stale[7] = "changed context\n"
+        result, diags = apply_patch_to_lines(stale, diff)
+        self.assertEqual(result[10], "ten\n")
+        self.assertEqual(diags[0].fuzz, 1)
+
+        with self.assertRaises(PatchError):
+            apply_patch_to_lines(["unrelated\n"] * 5, diff)
+
+    def test_no_newline_marker(self):
+        """Test a missing trailing newline is added and removed correctly."""
+        old = ["a\n", "b"]
+        new = ["a\n", "b\n", "c"]
+        diff = (
+            "--- a/f.py\n+++ b/f.py\n@@ -1,2 +1,3 @@\n a\n-b\n"
+            "\\ No newline at end of file\n+b\n+c\n\\ No newline at end of file\n"
+        )
+
+        self.assertEqual(apply_patch_to_lines(old, diff)[0], new)
+        self.assertEqual(apply_patch_to_lines(new, diff, reverse=True)[0], old)
+
+
+    def test_control_characters_are_not_line_breaks(self):
+        """Test lines holding \x0c or \x1c apply exactly, as they do with GNU patch."""
+        old = ["x = 1\n", 's = "a\x1cb"\n', "\x0c\n", "y = 2\u2028z\n", "end\n"]
+        new = ["x = 1\n", 's = "a\x1cc"\n', "\x0c\n", "y = 3\u2028z\n", "end\n"]
+        diff = make_diff(old, new)
+
+        result, diags = apply_patch_to_lines(old, diff)
+        self.assertEqual(result, new)
+        self.assertEqual([d.fuzz for d in diags], [0])
+        self.assertEqual(apply_patch_to_lines(new, diff, reverse=True)[0], old)
+
+        # Reconstruction reads files the same way
+        self.assertEqual(history._decode_lines("".join(old).encode()), old)
+
+
+class TestInMemoryReconstruction(unittest.TestCase):
+    """Test reconstruct_file_from_history against server-style history."""
+
+    def setUp(self):
+        """Create a workspace with a created-then-edited file in a subdirectory."""
+        self.test_dir = Path(tempfile.mkdtemp(prefix="mcpdiff_patch_test_"))
+        self.history_root = self.test_dir / ".mcp" / "edit_history"
+        self.target = self.test_dir / "pkg" / "mod.py"
+        self.target.parent.mkdir(parents=True)
+        versions = [[], ["a\n", "b\n"], ["a\n", "B\n"], ["a\n", "B\n", "c\n"]]
+        self.entries = []
+        for i in range(1, len(versions)):
+            # Diff paths are stored relative to the history root, as the server does
+            diff_rel = f"diffs/conv/e{i}.diff"
+            diff_path = self.history_root / diff_rel
+            diff_path.parent.mkdir(parents=True, exist_ok=True)
+            diff_path.write_text(make_diff(versions[i - 1], versions[i], "pkg/mod.py"))
+            self.entries.append(
+                {
+                    "edit_id": f"e{i}",
+                    "conversation_id": "conv",
+                    "tool_call_index": i,
+                    "timestamp": f"2025-01-01T00:00:0{i}.000Z",
+                    "operation": "create" if i == 1 else "edit",
+                    "file_path": "pkg/mod.py",
+                    "status": "pending",
+                    "diff_file": diff_rel,
+                }
+            )
+        self.target.write_text("a\nB\nc\n")
+
+    def tearDown(self):
+        """Clean up the workspace."""
+        shutil.rmtree(self.test_dir)
+
+    def test_reject_middle_edit(self):
+        """Test accepted edits are replayed from the create entry without subprocesses."""
+        self.entries[0]["status"] = "accepted"
+        self.entries[1]["status"] = "rejected"
+        self.entries[2]["status"] = "accepted"
+
+        original_run = subprocess.run
+        subprocess.run = None  # Any subprocess call would fail loudly
+        try:
+            result = history.reconstruct_file_from_history(
+                "pkg/mod.py", self.entries, self.test_dir, self.history_root,
+                apply_only_accepted=True,
+            )
+        finally:
+            subprocess.run = original_run
+
+        self.assertIsNone(result["error"])
+        self.assertEqual(self.target.read_text(), "a\nb\nc\n")
+        self.assertEqual(result["hash"], utils.calculate_hash(str(self.target)))
+
+    def test_reconstruct_all_pending(self):
+        """Test pending edits are applied when not restricted to accepted ones."""
+        self.target.write_text("stale\n")
+        result = history.reconstruct_file_from_history(
+            "pkg/mod.py", self.entries, self.test_dir, self.history_root
+        )
+        self.assertIsNone(result["error"])
+        self.assertEqual(self.target.read_text(), "a\nB\nc\n")
+
+    def test_periodic_checkpoint(self):
+        """Test replay starts at a periodic checkpoint only when all earlier edits apply."""
+        chkpt_rel = "checkpoints/conv/objects/v2.chkpt"
+        (self.history_root / chkpt_rel).parent.mkdir(parents=True)
+        (self.history_root / chkpt_rel).write_text("a\nB\n")
+        self.entries[2].update(checkpoint_file=chkpt_rel, checkpoint_kind="periodic")
+
+        path, index = history.find_closest_checkpoint(2, self.entries, self.history_root)
+        self.assertEqual((path.name, index), ("v2.chkpt", 2))
+
+        self.entries[1]["status"] = "rejected"
+        path, index = history.find_closest_checkpoint(2, self.entries, self.history_root)
+        self.assertEqual((path, index), (None, 0))
+        result = history.reconstruct_file_from_history(
+            "pkg/mod.py", self.entries, self.test_dir, self.history_root
+        )
+        self.assertIsNone(result["error"])
+        self.assertEqual(self.target.read_text(), "a\nb\nc\n")
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,286 @@
+#!/usr/bin/env python3
+"""
+Integration tests for the persistent symbol index used by the symbol tools.
+
+These tests verify that:
+- Parsed symbols round-trip through the on-disk index with parents intact
+- Unchanged files are served from the index instead of being re-parsed
+- Content changes and explicit invalidation force a fresh parse
+- Recorded edits are applied with an incremental re-parse
+- Batches of files are parsed in worker processes and stored in the index
+- The cross-file name index finds definitions and follows file changes
+"""
+
+import os
+import sys
+import shutil
+import tempfile
+import unittest
+from pathlib import Path
+from unittest import mock
+
+# Add the parent directory to the path so we can import the module
+sys.path.insert(0, str(Path(__file__).parent.parent))
+
+from src import mcp_symbol_index
+from src.mcp_edit_utils import calculate_hash, compute_edit_range
+from src.mcp_symbol_index import (
+    load_symbols,
+    load_symbol_outline,
+    load_symbols_named,
+    load_symbols_many,
+    refresh_name_index,
+    lookup_symbol,
+    invalidate_symbols,
+    get_cached_symbols,
+    note_symbol_edit,
+    serialize_elements,
+    deserialize_elements,
+    SYMBOL_INDEX_DIR_NAME,
+    PARALLEL_PARSE_MIN_FILES,
+)
+
+
+PYTHON_CONTENT = """class Greeter:
+    def greet(self, name):
+        return f"Hello {name}"
+
+
+def main():
+    Greeter().greet("world")
+
+
+def helper():
+    return 1
+"""
+
+
+class TestSymbolIndex(unittest.TestCase):
+    """Test the symbol index backing get_symbols and get_code_of_symbol."""
+
+    def setUp(self):
+        """Create a workspace with a .mcp directory and a sample file."""
+        self.test_dir = tempfile.mkdtemp(prefix="mcp_symbol_index_test_")
+        os.makedirs(os.path.join(self.test_dir, ".mcp"))
+        self.file_path = os.path.join(self.test_dir, "sample.py")
+        with open(self.file_path, "w") as f:
+            f.write(PYTHON_CONTENT)
+        mcp_symbol_index._memory_index.clear()
+        refresh_name_index([])
+
+    def tearDown(self):
+        """Clean up the workspace and in-memory index."""
+        mcp_symbol_index._memory_index.clear()
+        refresh_name_index([])
+        shutil.rmtree(self.test_dir)
+
+    def _count_parses(self):
+        """Patch the parser lookup so parse() calls can be counted."""
+        real_lookup = mcp_symbol_index.get_parser_for_file
+        calls = {"parse": 0, "parsed_chars": []}
+
+        def lookup(path):
+            parser = real_lookup(path)
+            real_parse = parser.parse
+
+            def parse(code):
+                calls["parse"] += 1
+                calls["parsed_chars"].append(len(code))
+                return real_parse(code)
+
+            parser.parse = parse
+            return parser
+
+        return calls, mock.patch.object(mcp_symbol_index, "get_parser_for_file", lookup)
+
+    def test_serialization_round_trip(self):
+        """Test that serialized elements keep names, ranges and parents."""
+        elements = load_symbols(self.file_path)
+        restored = deserialize_elements(serialize_elements(elements))
+
+        self.assertEqual(
+            [(e.element_type, e.name, e.start_line, e.end_line) for e in elements],
+            [(e.element_type, e.name, e.start_line, e.end_line) for e in restored],
+        )
+        method = next(e for e in restored if e.name == "greet")
+        self.assertIsNotNone(method.parent)
+        self.assertEqual(method.parent.name, "Greeter")
+        self.assertIn(method, method.parent.children)
+
+    def test_index_written_to_mcp_directory(self):
+        """Test that the index is persisted under .mcp."""
+        load_symbols(self.file_path)
+        index_dir = os.path.join(self.test_dir, SYMBOL_INDEX_DIR_NAME)
+        self.assertEqual(os.listdir(index_dir), ["sample.py.json"])
+
+    def test_unchanged_file_not_reparsed(self):
+        """Test that repeat lookups, including after a restart, skip the parser."""
+        calls, patch = self._count_parses()
+        with patch:
+            load_symbols(self.file_path)
+            load_symbols(self.file_path)
+            # Simulate a server restart: only the on-disk index survives
+            mcp_symbol_index._memory_index.clear()
+            elements = load_symbols(self.file_path)
+
+        self.assertEqual(calls["parse"], 1)
+        self.assertIn("main", [e.name for e in elements])
+
+    def test_modified_file_reparsed(self):
+        """Test that a content change invalidates the stored symbols."""
+        load_symbols(self.file_path)
+        with open(self.file_path, "a") as f:
+            f.write("\n\ndef extra():\n    pass\n")
+
+        elements = load_symbols(self.file_path)
+        self.assertIn("extra", [e.name for e in elements])
+
+    def test_invalidate_removes_entry(self):
+        """Test that invalidation drops both the memory and disk entries."""
+        load_symbols(self.file_path)
+        invalidate_symbols(self.file_path)
+
+        index_dir = os.path.join(self.test_dir, SYMBOL_INDEX_DIR_NAME)
+        self.assertEqual(os.listdir(index_dir), [])
+        self.assertNotIn(self.file_path, mcp_symbol_index._memory_index)
+
+    def test_compute_edit_range(self):
+        """Test the changed line envelope for replacements, inserts and deletes."""
+        before = ["a\n", "b\n", "c\n", "d\n"]
+        self.assertIsNone(compute_edit_range(before, list(before)))
+        self.assertEqual(
+            compute_edit_range(before, ["a\n", "x\n", "y\n", "c\n", "d\n"]),
+            (2, 2, 3),
+        )
+        self.assertEqual(compute_edit_range(before, ["a\n", "d\n"]), (2, 3, 1))
+        self.assertEqual(compute_edit_range(before, before + ["e\n"]), (5, 4, 5))
+
+    def test_noted_edit_uses_reparse(self):
+        """Test that a recorded edit is resolved with reparse() instead of parse()."""
+        old_elements = load_symbols(self.file_path)
+        self.assertIs(
+            get_cached_symbols(self.file_path, calculate_hash(self.file_path)),
+            old_elements,
+        )
+
+        with open(self.file_path) as f:
+            before = f.readlines()
+        after = before[:2] + ["        print(name)\n"] + before[2:]
+        with open(self.file_path, "w") as f:
+            f.writelines(after)
+        invalidate_symbols(self.file_path)
+        note_symbol_edit(
+            self.file_path,
+            old_elements,
+            compute_edit_range(before, after),
+            calculate_hash(self.file_path),
+        )
+
+        calls, patch = self._count_parses()
+        with patch:
+            elements = load_symbols(self.file_path)
+
+        full_parse = mcp_symbol_index.get_parser_for_file(self.file_path).parse(
+            "".join(after)
+        )
+        self.assertEqual(
+            [(e.name, e.start_line, e.end_line) for e in elements],
+            [(e.name, e.start_line, e.end_line) for e in full_parse],
+        )
+        # Only the damaged region was handed to the parser
+        self.assertEqual(calls["parse"], 1)
+        self.assertLess(calls["parsed_chars"][0], len("".join(after)))
+
+    def test_outline_and_named_lookups_are_not_stored(self):
+        """Test partial parses skip the index until a full tree exists, then use it."""
+        with open(self.file_path, "a") as f:
+            f.write("\n\ndef outer():\n    def nested():\n        return 1\n    return nested()\n")
+
+        outline = load_symbol_outline(self.file_path)
+        self.assertIn("outer", [e.name for e in outline])
+        self.assertNotIn("nested", [e.name for e in outline])
+        nested = next(e for e in load_symbols_named(self.file_path, "nested") if e.name == "nested")
+        self.assertEqual(nested.parent.name, "outer")
+        self.assertNotIn(self.file_path, mcp_symbol_index._memory_index)
+        self.assertFalse(os.path.exists(os.path.join(self.test_dir, SYMBOL_INDEX_DIR_NAME)))
+
+        # Once indexed, both are served from the stored tree without parsing
+        elements = load_symbols(self.file_path)
+        calls, patch = self._count_parses()
+        with patch:
+            self.assertIs(load_symbols_named(self.file_path, "nested"), elements)
+            mcp_symbol_index._memory_index.clear()
+            outline = load_symbol_outline(self.file_path)
+        self.assertEqual(calls["parse"], 0)
+        self.assertEqual(
+            [e.name for e in outline], [e.name for e in elements if e.name != "nested"]
+        )
+
+    def test_load_symbols_many_uses_worker_pool(self):
+        """Test a batch of files is parsed out of process and then served from the index."""
+        paths = [self.file_path]
+        for i in range(PARALLEL_PARSE_MIN_FILES + 2):
+            path = os.path.join(self.test_dir, f"module_{i}.py")
+            with open(path, "w") as f:
+                f.write(PYTHON_CONTENT.replace("helper", f"helper_{i}"))
+            paths.append(path)
+        missing = os.path.join(self.test_dir, "missing.py")
+        load_symbols(self.file_path)
+
+        symbols, errors = load_symbols_many(paths + [missing])
+        pool = mcp_symbol_index._parse_pool
+        self.assertIsNotNone(pool)
+        self.assertNotEqual(pool._mp_context.get_start_method(), "fork")
+
+        self.assertEqual(set(symbols), set(paths))
+        self.assertIn(missing, errors)
+        self.assertIn("helper_3", [e.name for e in symbols[paths[4]]])
+        method = next(e for e in symbols[paths[1]] if e.name == "greet")
+        self.assertEqual(method.parent.name, "Greeter")
+        # Already indexed files are returned as-is, parsed ones are now indexed
+        self.assertIs(symbols[self.file_path], load_symbols(self.file_path))
+        calls, patch = self._count_parses()
+        with patch:
+            load_symbols_many(paths)
+        self.assertEqual(calls["parse"], 0)
+        # Later batches reuse the running workers
+        mcp_symbol_index._memory_index.clear()
+        load_symbols_many(paths)
+        self.assertIs(mcp_symbol_index._parse_pool, pool)
+
+    def test_name_index_lookup_and_refresh(self):
+        """Test definitions are found by plain and qualified name and follow edits."""
+        other = os.path.join(self.test_dir, "other.py")
+        with open(other, "w") as f:
+            f.write("def helper():\n    return 2\n")
+        refresh_name_index([self.file_path, other])
+
+        self.assertEqual(
+            [(p, e.start_line) for p, e in lookup_symbol("helper")],
+            [(other, 1), (self.file_path, 10)],
+        )
+        self.assertEqual(
+            [e.get_full_name() for _, e in lookup_symbol("Greeter.greet")],
+            ["Greeter.greet"],
+        )
+
+        # Unchanged files only cost a stat on refresh
+        calls, patch = self._count_parses()
+        with patch:
+            refresh_name_index([self.file_path, other])
+        self.assertEqual(calls["parse"], 0)
+
+        with open(other, "w") as f:
+            f.write("def renamed():\n    return 2\n")
+        invalidate_symbols(other)
+        refresh_name_index([self.file_path, other])
+        self.assertEqual([p for p, _ in lookup_symbol("helper")], [self.file_path])
+        self.assertEqual([p for p, _ in lookup_symbol("renamed")], [other])
+
+        # Files dropped from the set are removed from the index
+        refresh_name_index([other])
+        self.assertEqual(lookup_symbol("helper"), [])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,195 @@
+#!/usr/bin/env python3
+"""
+Integration tests for per-tool latency tracing.
+
+These tests verify that:
+- Tools registered after instrument() are timed, and are returned unwrapped
+- Phases are attributed to the tool that ran them, also from async tasks
+- Errors and response bytes are counted
+- The Prometheus rendering has cumulative buckets and get_server_stats reports
+- The metrics endpoint listens on localhost by default
+- The filesystem, exec and web servers carry identical copies of the module
+"""
+
+import os
+import sys
+import time
+import asyncio
+import shutil
+import tempfile
+import unittest
+import urllib.request
+from pathlib import Path
+
+# Add the parent directory to the path so we can import the module
+sys.path.insert(0, str(Path(__file__).parent.parent))
+
+REPO_ROOT = Path(__file__).parent.parent.parent
+
+from src import mcp_trace
+from src.mcp_trace import LatencyHistogram, instrument, span, traced
+from src.mcp_line_index import read_line_spans
+
+
+class FakeMCP:
+    """Records what its tool decorator registers, like FastMCP."""
+
+    def __init__(self):
+        self.tools = {}
+
+    def tool(self, name=None):
+        def decorator(func):
+            self.tools[name or func.__name__] = func
+            return func
+
+        return decorator
+
+
+class TestTrace(unittest.TestCase):
+    """Test tool and phase recording."""
+
+    def setUp(self):
+        """Instrument a fresh fake server and start from empty stats."""
+        self.mcp = FakeMCP()
+        instrument(self.mcp, "test")
+        mcp_trace.reset_stats()
+        self.test_dir = tempfile.mkdtemp(prefix="mcp_trace_test_")
+
+    def tearDown(self):
+        mcp_trace.reset_stats()
+        shutil.rmtree(self.test_dir)
+
+    def test_tool_is_timed_and_returned_unwrapped(self):
+        """The registered wrapper records calls; the module keeps the plain function."""
+
+        def echo(text: str) -> str:
+            with span("work"):
+                time.sleep(0.002)
+            return text
+
+        returned = self.mcp.tool()(echo)
+        self.assertIs(returned, echo)
+        registered = self.mcp.tools["echo"]
+        self.assertIsNot(registered, echo)
+        self.assertIs(registered.__wrapped__, echo)
+
+        self.assertEqual(registered("héllo"), "héllo")
+        echo("direct call")  # Not counted
+
+        self.assertEqual(mcp_trace._stats.tools["echo"].count, 1)
+        self.assertEqual(mcp_trace._stats.phases[("echo", "work")].count, 1)
+        self.assertGreaterEqual(mcp_trace._stats.phases[("echo", "work")].total, 0.002)
+        self.assertEqual(mcp_trace._stats.bytes[("echo", "response")], len("héllo".encode()))
+
+    def test_async_tool_phases_from_tasks(self):
+        """Phases in tasks started by an async tool count towards that tool."""
+
+        @traced("fetch")
+        async def fetch(i):
+            await asyncio.sleep(0.001)
+            return i
+
+        async def crawl() -> str:
+            results = await asyncio.gather(*(fetch(i) for i in range(3)))
+            return str(sum(results))
+
+        self.mcp.tool()(crawl)
+        self.assertEqual(asyncio.run(self.mcp.tools["crawl"]()), "3")
+        self.assertEqual(mcp_trace._stats.phases[("crawl", "fetch")].count, 3)
+        self.assertNotIn(("-", "fetch"), mcp_trace._stats.phases)
+
+    def test_errors_are_counted_and_raised(self):
+        """A tool that raises is recorded as an error and the exception propagates."""
+
+        def broken() -> str:
+            with span("parse"):
+                raise ValueError("bad input")
+
+        self.mcp.tool()(broken)
+        with self.assertRaises(ValueError):
+            self.mcp.tools["broken"]()
+        self.assertEqual(mcp_trace._stats.tools["broken"].errors, 1)
+        self.assertEqual(mcp_trace._stats.phases[("broken", "parse")].errors, 1)
+
+    def test_filesystem_phases(self):
+        """Reads done by the filesystem helpers show up under the calling tool."""
+        path = os.path.join(self.test_dir, "f.txt")
+        with open(path, "w") as f:
+            f.write("".join(f"line {i}\n" for i in range(100)))
+
+        def read_some(p: str) -> str:
+            _, lines = read_line_spans(p, [(1, 10)])
+            return "\n".join(text for _, text in lines)
+
+        self.mcp.tool()(read_some)
+        self.mcp.tools["read_some"](path)
+        self.assertEqual(mcp_trace._stats.phases[("read_some", "read")].count, 1)
+
+    def test_stats_and_prometheus(self):
+        """get_server_stats summarizes; the Prometheus form has cumulative buckets."""
+
+        def quick() -> str:
+            return "ok"
+
+        self.mcp.tool()(quick)
+        for _ in range(5):
+            self.mcp.tools["quick"]()
+
+        stats = self.mcp.tools["get_server_stats"]()
+        self.assertIn("quick: 5 calls", stats)
+        self.assertIn("response bytes: 10", stats)
+        self.assertIn("No calls recorded for missing", self.mcp.tools["get_server_stats"]("missing"))
+
+        text = self.mcp.tools["get_server_stats"](prometheus=True, reset=True)
+        self.assertIn('mcp_tool_duration_seconds_count{server="test",tool="quick"} 5', text)
+        self.assertIn('mcp_tool_duration_seconds_bucket{server="test",tool="quick",le="+Inf"} 5', text)
+        self.assertIn('mcp_tool_bytes_total{server="test",tool="quick",kind="response"} 10', text)
+        self.assertNotIn("quick", mcp_trace._stats.tools)
+
+    def test_histogram_quantiles(self):
+        """Quantiles come from the recent window, buckets from every sample."""
+        histogram = LatencyHistogram()
+        for ms in range(1, 101):
+            histogram.observe(ms / 1000)
+        self.assertAlmostEqual(histogram.quantile(0.5), 0.051)
+        self.assertAlmostEqual(histogram.quantile(0.99), 0.1)
+        self.assertEqual(sum(histogram.bucket_counts), 100)
+        for _ in range(mcp_trace.QUANTILE_WINDOW):
+            histogram.observe(1.0)
+        self.assertEqual(histogram.quantile(0.5), 1.0)
+        self.assertEqual(histogram.count, 100 + mcp_trace.QUANTILE_WINDOW)
+
+
+    def test_metrics_server_binds_localhost(self):
+        """The /metrics endpoint serves on 127.0.0.1 unless a host is given."""
+        self.assertEqual(mcp_trace.METRICS_HOST, os.environ.get("MCP_METRICS_HOST", "127.0.0.1"))
+        server = mcp_trace.start_metrics_server(0, lambda: "up 1\n")
+        try:
+            self.assertEqual(server.server_address[0], mcp_trace.METRICS_HOST)
+            url = f"http://127.0.0.1:{server.server_address[1]}/metrics"
+            with urllib.request.urlopen(url, timeout=5) as response:
+                self.assertEqual(response.read(), b"up 1\n")
+        finally:
+            server.shutdown()
+            server.server_close()
+
+
+class TestTraceCopies(unittest.TestCase):
+    """Each server is built from its own directory with its own copy of mcp_trace.py."""
+
+    def test_copies_identical(self):
+        """Changing one copy without the others fails here."""
+        copies = {
+            name: (REPO_ROOT / name / "src" / "mcp_trace.py").read_bytes()
+            for name in ("filesystem", "exec", "web")
+        }
+        for name in ("exec", "web"):
+            self.assertEqual(
+                copies[name],
+                copies["filesystem"],
+                f"{name}/src/mcp_trace.py differs from filesystem/src/mcp_trace.py",
+            )
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+"""
+Integration tests for the in-memory caches behind directory_tree.
+
+These tests verify that:
+- Directory listings are reused until the directory's mtime changes
+- A walk of an unchanged tree (as find_symbol does) re-reads no directory
+- Line counts are reused until a file's inode, mtime or size changes
+- git ls-files runs again only after .git/index changes
+"""
+
+import os
+import sys
+import shutil
+import tempfile
+import unittest
+import subprocess
+from pathlib import Path
+
+# Add the parent directory to the path so we can import the module
+sys.path.insert(0, str(Path(__file__).parent.parent))
+
+from src import mcp_tree_cache
+from src.mcp_edit_utils import count_lines_cached
+from src.mcp_tree_cache import list_directory_cached, tracked_files_cached, walk_files_cached
+
+
+class TestTreeCache(unittest.TestCase):
+    """Test directory, line count and tracked file caches."""
+
+    def setUp(self):
+        """Create a scratch directory with settled mtimes."""
+        self.test_dir = tempfile.mkdtemp(prefix="mcp_tree_cache_test_")
+        mcp_tree_cache.clear_tree_cache()
+        self.calls = []
+        self.original_scan = mcp_tree_cache._scan
+        self.original_run = mcp_tree_cache.subprocess.run
+
+        def counting_scan(path):
+            self.calls.append(("scan", path))
+            return self.original_scan(path)
+
+        def counting_run(*args, **kwargs):
+            self.calls.append(("run", args[0][-1]))
+            return self.original_run(*args, **kwargs)
+
+        mcp_tree_cache._scan = counting_scan
+        mcp_tree_cache.subprocess.run = counting_run
+
+    def tearDown(self):
+        """Restore patched functions and clean up."""
+        mcp_tree_cache._scan = self.original_scan
+        mcp_tree_cache.subprocess.run = self.original_run
+        mcp_tree_cache.clear_tree_cache()
+        shutil.rmtree(self.test_dir)
+
+    def _settle(self, path):
+        """Backdate an mtime past the racy window so a listing can be cached."""
+        os.utime(path, ns=(10**18, 10**18))
+
+    def test_listing_reused_until_directory_changes(self):
+        """Test a listing is cached and refreshed after an entry is added."""
+        os.mkdir(os.path.join(self.test_dir, "d"))
+        Path(self.test_dir, "f.txt").write_text("x\n")
+        os.symlink("f.txt", os.path.join(self.test_dir, "link"))
+        self._settle(self.test_dir)
+
+        first = list_directory_cached(self.test_dir)
+        self.assertEqual(
+            [(e.name, e.kind, e.link_target) for e in first],
+            [("d", "dir", None), ("f.txt", "file", None), ("link", "link", "f.txt")],
+        )
+        self.assertIs(list_directory_cached(self.test_dir), first)
+        self.assertEqual(len(self.calls), 1)
+
+        Path(self.test_dir, "g.txt").write_text("y\n")
+        self._settle(self.test_dir)
+        os.utime(self.test_dir, ns=(10**18, 10**18 + 1))
+        self.assertIn("g.txt", [e.name for e in list_directory_cached(self.test_dir)])
+        self.assertEqual(len(self.calls), 2)
+
+    def test_recent_directory_not_trusted(self):
+        """Test a directory changed moments ago is re-listed every time."""
+        list_directory_cached(self.test_dir)
+        list_directory_cached(self.test_dir)
+        self.assertEqual(len(self.calls), 2)
+
+    def test_walk_reuses_listings(self):
+        """Test a walk of an unchanged tree re-reads no directory."""
+        sub = os.path.join(self.test_dir, "pkg")
+        os.makedirs(os.path.join(self.test_dir, ".git"))
+        os.mkdir(sub)
+        Path(self.test_dir, "a.py").write_text("a\n")
+        Path(sub, "b.py").write_text("b\n")
+        Path(self.test_dir, ".git", "c.py").write_text("c\n")
+        for path in (sub, self.test_dir):
+            self._settle(path)
+
+        def walk():
+            return sorted(p for p, _ in walk_files_cached(self.test_dir, [".git"]))
+
+        expected = [os.path.join(self.test_dir, "a.py"), os.path.join(sub, "b.py")]
+        self.assertEqual(walk(), expected)
+        self.assertEqual(len(self.calls), 2)
+        self.assertEqual(walk(), expected)
+        self.assertEqual(len(self.calls), 2)
+
+        Path(sub, "d.py").write_text("d\n")
+        os.utime(sub, ns=(10**18, 10**18 + 1))
+        self.assertIn(os.path.join(sub, "d.py"), walk())
+        self.assertEqual(self.calls[2:], [("scan", sub)])
+
+    def test_line_count_cached(self):
+        """Test line counts follow file changes."""
+        path = os.path.join(self.test_dir, "f.txt")
+        Path(path).write_text("a\nb\n")
+        self.assertEqual(count_lines_cached(path, os.stat(path)), 2)
+        Path(path).write_text("a\nb\nc\n")
+        self.assertEqual(count_lines_cached(path, os.stat(path)), 3)
+
+    def test_tracked_files_follow_index(self):
+        """Test ls-files output is reused until the index changes."""
+        git = shutil.which("git")
+        if not git:
+            self.skipTest("git not installed")
+        self.original_run([git, "init", "-q", self.test_dir], check=True)
+        Path(self.test_dir, "a.py").write_text("a\n")
+        self.original_run([git, "-C", self.test_dir, "add", "a.py"], check=True)
+
+        self.assertEqual(tracked_files_cached(git, self.test_dir), ["a.py"])
+        self.assertEqual(tracked_files_cached(git, self.test_dir), ["a.py"])
+        self.assertEqual(len(self.calls), 1)
+
+        Path(self.test_dir, "b.py").write_text("b\n")
+        self.original_run([git, "-C", self.test_dir, "add", "b.py"], check=True)
+        self.assertEqual(tracked_files_cached(git, self.test_dir), ["a.py", "b.py"])
+        self.assertEqual(len(self.calls), 2)
+
+
+if __name__ == "__main__":
+    unittest.main()
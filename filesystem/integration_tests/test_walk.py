@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+"""
+Integration tests for the scandir walker behind search_files and search_directories.
+
+These tests verify that:
+- The walker yields the same paths, in the same order, as the os.walk version
+- Symlinks resolving outside the allowed directories are not yielded
+- max_depth limits directory searches the same way as before
+- The allowed-directory trie matches only at path component boundaries
+"""
+
+import os
+import sys
+import fnmatch
+import random
+import shutil
+import tempfile
+import unittest
+from pathlib import Path
+
+# Add the parent directory to the path so we can import the module
+sys.path.insert(0, str(Path(__file__).parent.parent))
+
+from src.mcp_edit_utils import AllowedDirectoryTrie, validate_path
+from src.mcp_walk import walk_matches
+
+
+def reference_walk(start, allowed, pattern, excludes, include_dirs=True, max_depth=None):
+    """The os.walk search that walk_matches replaces, with validate_path on every match."""
+    for root, dirs, files in os.walk(start, topdown=True, followlinks=False):
+        if max_depth is not None:
+            rel_path = os.path.relpath(root, start)
+            if (len(rel_path.split(os.sep)) if rel_path != "." else 0) >= max_depth:
+                dirs.clear()
+                continue
+        dirs[:] = [d for d in dirs if not any(fnmatch.fnmatch(d, p) for p in excludes)]
+        files = [f for f in files if not any(fnmatch.fnmatch(f, p) for p in excludes)]
+        for name in (dirs + files) if include_dirs else files:
+            if fnmatch.fnmatch(name, pattern):
+                try:
+                    yield validate_path(os.path.join(root, name), allowed)
+                except ValueError:
+                    pass
+
+
+class TestWalk(unittest.TestCase):
+    """Test walk_matches against the os.walk implementation."""
+
+    def setUp(self):
+        """Create a random tree with links inside and outside the allowed root."""
+        self.base = tempfile.mkdtemp(prefix="mcp_walk_test_")
+        self.root = os.path.join(self.base, "allowed")
+        self.outside = os.path.join(self.base, "outside")
+        os.makedirs(self.outside)
+        Path(self.outside, "secret.py").write_text("x\n")
+        rng = random.Random(5)
+        dirs = [self.root]
+        os.makedirs(self.root)
+        for i in range(60):
+            parent = rng.choice(dirs)
+            if rng.random() < 0.3:
+                d = os.path.join(parent, f"d{i}" if i % 7 else "node_modules")
+                os.mkdir(d)
+                dirs.append(d)
+            else:
+                Path(parent, f"f{i}.{'py' if i % 2 else 'txt'}").write_text("x\n")
+        os.symlink(self.outside, os.path.join(self.root, "out_dir"))
+        os.symlink(os.path.join(self.outside, "secret.py"), os.path.join(self.root, "out.py"))
+        os.symlink(dirs[-1], os.path.join(self.root, "in_dir"))
+        self.allowed = [self.root]
+
+    def tearDown(self):
+        """Clean up the tree."""
+        shutil.rmtree(self.base)
+
+    def test_same_results_as_os_walk(self):
+        """Test files and directories match the reference walk in order."""
+        for pattern, excludes in (("*", []), ("*.py", ["node_modules"]), ("d*", [])):
+            for include_dirs in (True, False):
+                with self.subTest(pattern=pattern, excludes=excludes, include_dirs=include_dirs):
+                    self.assertEqual(
+                        list(walk_matches(self.root, self.allowed, pattern, excludes, include_dirs=include_dirs)),
+                        list(reference_walk(self.root, self.allowed, pattern, excludes, include_dirs)),
+                    )
+        found = list(walk_matches(self.root, self.allowed))
+        self.assertIn(os.path.join(self.root, "in_dir"), found)
+        self.assertNotIn(os.path.join(self.root, "out.py"), found)
+        self.assertNotIn(os.path.join(self.root, "out_dir"), found)
+
+    def test_max_depth(self):
+        """Test directory searches stop at max_depth like search_directories did."""
+        for depth in (0, 1, 2):
+            with self.subTest(depth=depth):
+                self.assertEqual(
+                    list(walk_matches(self.root, self.allowed, "*", include_files=False, max_depth=depth)),
+                    [p for p in reference_walk(self.root, self.allowed, "*", [], max_depth=depth) if os.path.isdir(p)],
+                )
+
+    def test_trie_boundaries(self):
+        """Test prefixes only match whole path components."""
+        trie = AllowedDirectoryTrie(["/srv/app", "/home/u/proj"])
+        self.assertTrue(trie.contains("/srv/app"))
+        self.assertTrue(trie.contains("/srv/app/src/x.py"))
+        self.assertFalse(trie.contains("/srv/application"))
+        self.assertFalse(trie.contains("/srv"))
+        self.assertFalse(trie.contains("/home/u"))
+        self.assertTrue(AllowedDirectoryTrie(["/"]).contains("/anything"))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -13,6 +13,7 @@ end
 -- Default configuration
 local config = {
   mcpdiff_cmd = "mcpdiff", -- Assumes mcpdiff is in PATH
+  use_server = true, -- Send actions to a long-lived `mcpdiff serve` instead of spawning per action
   float_border = "rounded",
   float_max_width = 0.8,
   float_max_height = 0.8,
@@ -139,9 +140,140 @@ local function show_output_in_float(title, lines)
   )
 end
 
+-- Split captured output into lines the way the pipe readers below do
+local function split_output(text)
+  return vim.split(text or "", "\n", { plain = true, trimempty = true })
+end
+
+-- The running `mcpdiff serve` process, if any. It finds its workspace from the
+-- directory it starts in, so it is restarted when Neovim's cwd changes.
+local server = nil
+
+local function close_pipe(pipe)
+  if pipe and not uv.is_closing(pipe) then
+    uv.read_stop(pipe)
+    uv.close(pipe)
+  end
+end
+
+-- Handle one JSON-RPC response line from the server
+local function on_server_line(s, line)
+  local ok, msg = pcall(vim.fn.json_decode, line)
+  if not ok or type(msg) ~= "table" then
+    debug_print("Ignoring server output: " .. line)
+    return
+  end
+  local callback = s.pending[msg.id]
+  if not callback then return end
+  s.pending[msg.id] = nil
+  if msg.error then
+    callback(-1, {}, { "mcpdiff serve: " .. tostring(msg.error.message) })
+  else
+    local result = msg.result or {}
+    callback(result.exit_code or -1, split_output(result.stdout), split_output(result.stderr))
+  end
+end
+
+local function start_server()
+  local s = {
+    cwd = vim.fn.getcwd(),
+    pending = {},
+    next_id = 1,
+    buffer = "",
+    stderr_lines = {},
+    stdin = uv.new_pipe(false),
+    stdout = uv.new_pipe(false),
+    stderr = uv.new_pipe(false),
+  }
+  if not s.stdin or not s.stdout or not s.stderr then
+    close_pipe(s.stdin); close_pipe(s.stdout); close_pipe(s.stderr)
+    return nil
+  end
+
+  debug_print("Starting: " .. config.mcpdiff_cmd .. " serve in " .. s.cwd)
+  s.handle = uv.spawn(config.mcpdiff_cmd, {
+    args = { "serve" },
+    cwd = s.cwd,
+    stdio = { s.stdin, s.stdout, s.stderr },
+  }, function(code, signal)
+    close_pipe(s.stdin); close_pipe(s.stdout); close_pipe(s.stderr)
+    if s.handle and not uv.is_closing(s.handle) then uv.close(s.handle) end
+    vim.schedule(function()
+      if server == s then server = nil end
+      -- Fail whatever was still waiting, with the server's last words
+      local reason = { "mcpdiff serve exited (code: " .. tostring(code) .. ")" }
+      vim.list_extend(reason, s.stderr_lines)
+      for _, callback in pairs(s.pending) do
+        callback(-1, {}, reason)
+      end
+      s.pending = {}
+    end)
+  end)
+
+  if not s.handle then
+    close_pipe(s.stdin); close_pipe(s.stdout); close_pipe(s.stderr)
+    return nil
+  end
+
+  uv.read_start(s.stdout, function(err, data)
+    if err or not data then return end
+    -- Decode on the main loop; vim.fn is not callable from luv callbacks
+    vim.schedule(function()
+      s.buffer = s.buffer .. data
+      while true do
+        local newline = s.buffer:find("\n", 1, true)
+        if not newline then break end
+        local line = s.buffer:sub(1, newline - 1)
+        s.buffer = s.buffer:sub(newline + 1)
+        if line ~= "" then on_server_line(s, line) end
+      end
+    end)
+  end)
+
+  uv.read_start(s.stderr, function(err, data)
+    if err or not data then return end
+    vim.list_extend(s.stderr_lines, vim.split(data, "\n", { plain = true, trimempty = true }))
+    -- Keep only the tail; it is reported if the server exits
+    while #s.stderr_lines > 20 do table.remove(s.stderr_lines, 1) end
+  end)
+
+  return s
+end
+
+-- Stop the server; closing its stdin ends the serve loop
+local function stop_server()
+  if not server then return end
+  local s = server
+  server = nil
+  if s.stdin and not uv.is_closing(s.stdin) then
+    uv.shutdown(s.stdin, function() close_pipe(s.stdin) end)
+  end
+end
+
+-- Send args (subcommand first) to the server. Returns false if it cannot be started.
+local function request_server(args, callback)
+  local cwd = vim.fn.getcwd()
+  if server and server.cwd ~= cwd then stop_server() end
+  if not server then server = start_server() end
+  if not server then return false end
+
+  local id = server.next_id
+  server.next_id = id + 1
+  server.pending[id] = callback
+  local request = vim.fn.json_encode({
+    jsonrpc = "2.0",
+    id = id,
+    method = args[1],
+    params = { args = vim.list_slice(args, 2) },
+  })
+  debug_print("Request " .. id .. ": " .. request)
+  uv.write(server.stdin, request .. "\n")
+  return true
+end
+
 -- Helper function to run mcpdiff command
 -- callback takes (exit_code, stdout_lines, stderr_lines)
-local function run_mcpdiff(args, callback)
+local function spawn_mcpdiff(args, callback)
   local cmd_parts = { config.mcpdiff_cmd }
   vim.list_extend(cmd_parts, args)
 
@@ -223,6 +355,14 @@ local function run_mcpdiff(args, callback)
   end)
 end
 
+-- Run an mcpdiff subcommand, through the server when enabled
+local function run_mcpdiff(args, callback)
+  if config.use_server and request_server(args, callback) then
+    return
+  end
+  spawn_mcpdiff(args, callback)
+end
+
 
 --- Public Plugin Functions ---
 
@@ -344,11 +484,22 @@ function M.review(args_str)
     -- If you don't have it, replace the FloatermNew line with one of the :terminal alternatives.
 end
 
+-- Stop the background `mcpdiff serve` process (restarted on the next action)
+function M.stop_server()
+  stop_server()
+end
+
 -- Setup function for configuration
 function M.setup(user_config)
   config = vim.tbl_deep_extend("force", config, user_config or {})
   is_debug = config.debug or false -- Allow enabling debug via setup
   -- Validate config if needed
+  if not config.use_server then stop_server() end
 end
 
+api.nvim_create_autocmd("VimLeavePre", {
+  group = api.nvim_create_augroup("McpdiffServer", { clear = true }),
+  callback = stop_server,
+})
+
 return M
@@ -5,6 +5,7 @@ import shutil
 import subprocess
 import inspect
 import uuid
+import hashlib
 import fnmatch
 import json
 from pathlib import Path
@@ -24,20 +25,31 @@ try:
         get_file_stats,
         get_metadata,
         get_history_root,
-        sanitize_path_for_filename,
         acquire_lock,
         release_lock,
         calculate_hash,
+        stat_stamp,
         generate_diff,
-        read_log_file,
-        write_log_file,
+        diff_exceeds_limit,
+        compute_edit_range,
+        get_logged_file_paths,
+        append_log_entry,
+        append_log_entries,
+        checkpoint_due,
+        write_object,
+        open_edit_buffers,
+        close_edit_buffers,
+        read_file_bytes,
+        read_text,
+        read_lines,
+        write_text,
+        decode_lines,
+        split_text_lines,
         HistoryError,
         log,
         get_next_tool_call_index,
         validate_path,
         LOGS_DIR,
-        DIFFS_DIR,
-        CHECKPOINTS_DIR,
     )
 except ImportError:
     # This branch is for when running as a module
@@ -47,28 +59,99 @@ except ImportError:
         get_file_stats,
         get_metadata,
         get_history_root,
-        sanitize_path_for_filename,
         acquire_lock,
         release_lock,
         calculate_hash,
+        stat_stamp,
         generate_diff,
-        read_log_file,
-        write_log_file,
+        diff_exceeds_limit,
+        compute_edit_range,
+        get_logged_file_paths,
+        append_log_entry,
+        append_log_entries,
+        checkpoint_due,
+        write_object,
+        open_edit_buffers,
+        close_edit_buffers,
+        read_file_bytes,
+        read_text,
+        read_lines,
+        write_text,
+        decode_lines,
+        split_text_lines,
         HistoryError,
         log,
         get_next_tool_call_index,
         validate_path,
         LOGS_DIR,
-        DIFFS_DIR,
-        CHECKPOINTS_DIR,
     )
 
+try:
+    from .mcp_line_index import read_line_spans
+except ImportError:
+    from mcp_line_index import read_line_spans
+
+try:
+    from .mcp_tree_cache import list_directory_cached, path_exists_cached, tracked_files_cached, walk_files_cached
+except ImportError:
+    from mcp_tree_cache import list_directory_cached, path_exists_cached, tracked_files_cached, walk_files_cached
+
+try:
+    from .mcp_walk import walk_matches
+except ImportError:
+    from mcp_walk import walk_matches
+
+try:
+    from .mcp_grep import compile_line_matcher, format_context_line, grep_paths
+except ImportError:
+    from mcp_grep import compile_line_matcher, format_context_line, grep_paths
+
+try:
+    from .mcp_symbol_index import (
+        load_symbols,
+        load_symbol_outline,
+        load_symbols_named,
+        refresh_name_index,
+        lookup_symbol,
+        load_symbols_many,
+        invalidate_symbols,
+        get_cached_symbols,
+        note_symbol_edit,
+    )
+except ImportError:
+    from mcp_symbol_index import (
+        load_symbols,
+        load_symbol_outline,
+        load_symbols_named,
+        refresh_name_index,
+        lookup_symbol,
+        load_symbols_many,
+        invalidate_symbols,
+        get_cached_symbols,
+        note_symbol_edit,
+    )
+
+try:
+    from .mcp_trace import instrument, start_metrics_server
+except ImportError:
+    from mcp_trace import instrument, start_metrics_server
+
 try:
     # Try relative import first
-    from .grammar.regex_parser import get_parser_for_file, BaseParser, CodeElement, ElementType
+    from .grammar.regex_parser import (
+        get_parser_for_file,
+        has_dedicated_parser,
+        BaseParser,
+        CodeElement,
+        ElementType,
+    )
 except ImportError:
     # Fall back to direct import for when running as src/filesystem.py
-    from src.grammar.regex_parser import get_parser_for_file, ElementType
+    from src.grammar.regex_parser import (
+        get_parser_for_file,
+        has_dedicated_parser,
+        ElementType,
+    )
 
 
 SYSTEM_PROMPT = """
@@ -142,13 +225,17 @@ Key capabilities:
    - `search_files`: Locate files matching patterns
    - `list_allowed_directories`: See which directories are accessible
    - `changes_since_last_commit`: View Git repository status
+   - `get_server_stats`: Per-tool latency (p50/p99) broken down by phase
 
 2. File Reading & Analysis:
    - `read_file`: Read whole files or specific line ranges
    - `read_multiple_files`: Process several files at once
    - `read_file_by_keyword`: Find and extract sections containing specific terms
+   - `grep_files`: Search every file under a directory for a keyword or regex
    - `read_function_by_keyword`: Locate functions containing specific keywords
    - `get_symbols`: Extract code structure (functions, classes, methods)
+   - `get_symbols_in_directory`: Extract code structure for every source file under a directory
+   - `find_symbol`: Locate where a symbol is defined across all allowed directories
    - `get_function_code`: Extract complete function definitions
    - `get_file_info`: Retrieve detailed metadata about files
 
@@ -157,6 +244,7 @@ Key capabilities:
    - `edit_file_diff`: Make targeted changes using replacements and insertions
    - `replace_symbol_in_file`: Replace code of a symbol (function, class, method)
    - `replace_lines_in_file`: Replace code by line numbers
+   - `apply_edits`: Apply many replacement or line-range edits across files in one all-or-nothing call
    - `move_file`: Rename or relocate files
    - `delete_a_file`: Remove files
    - `finish_edit`: Signal completion of editing operations
@@ -171,6 +259,7 @@ Best practices for usage:
 - For file reading:
   - Use line ranges with `read_file` for efficiency with large files (e.g., ["1-100", "200-300"])
   - Use `read_file_by_keyword` to extract specific sections rather than reading entire files
+  - Use `grep_files` to find where something is used across a directory instead of reading files one by one
   - When analyzing code, use specialized tools like `get_symbols` and `get_function_code`
 
 - For file modification:
@@ -204,7 +293,11 @@ GIT_USER_EMAIL = os.environ.get("GIT_USER_EMAIL")
 GIT_SSH_KEY = os.environ.get("GIT_SSH_KEY")
 GITHUB_AUTH_TOKEN = os.environ.get("GITHUB_AUTH_TOKEN")
 
+# Port for a Prometheus /metrics HTTP endpoint (unset: only the get_server_stats tool)
+METRICS_PORT = os.environ.get("MCP_METRICS_PORT")
+
 mcp = FastMCP("secure-filesystem-server", instructions=MCP_INSTRUCTIONS)
+instrument(mcp, "filesystem")
 
 # Command line argument parsing
 if len(sys.argv) < 2:
@@ -485,12 +578,8 @@ def track_edit_history(func: Callable) -> Callable:
         workspace_root = history_root.parent.parent
         edit_id = str(uuid.uuid4())
         log_file_path = history_root / LOGS_DIR / f"{conversation_id}.log"
-        diff_dir = history_root / DIFFS_DIR / conversation_id
-        diff_dir.mkdir(exist_ok=True)
-        checkpoint_dir = history_root / CHECKPOINTS_DIR / conversation_id
-        checkpoint_dir.mkdir(exist_ok=True)
-        relative_diff_path = Path(DIFFS_DIR) / conversation_id / f"{edit_id}.diff"
-        diff_file_path = history_root / relative_diff_path
+        relative_diff_path: Optional[Path] = None
+        relative_content_path: Optional[Path] = None
 
         # Convert absolute paths to relative paths from workspace root
         relative_file_path = validated_path.relative_to(workspace_root)
@@ -501,12 +590,17 @@ def track_edit_history(func: Callable) -> Callable:
         )
 
         content_before: Optional[List[str]] = None
+        data_before: Optional[bytes] = None
         hash_before: Optional[str] = None
         checkpoint_created = False
+        checkpoint_periodic = False
         relative_checkpoint_path: Optional[Path] = None
         target_file_lock = None
         source_file_lock = None
         log_file_lock = None
+        # The tool body reads and writes through the same buffers, so each
+        # file is read once and the post-write hash needs no second read
+        buffers_token = open_edit_buffers()
 
         try:
             # --- Acquire Locks ---
@@ -526,41 +620,46 @@ def track_edit_history(func: Callable) -> Callable:
                 )
 
             if file_existed_before_locked:
-                hash_before = calculate_hash(str(path_to_read_before))
                 try:
-                    with open(
-                        path_to_read_before, "r", encoding="utf-8", errors="ignore"
-                    ) as f:
-                        content_before = f.readlines()
-                except IOError:
-                    content_before = None
+                    data_before = read_file_bytes(path_to_read_before)
+                    hash_before = hashlib.sha256(data_before).hexdigest()
+                    content_before = decode_lines(data_before)
+                except OSError as e:
+                    log.error(f"Error reading file {path_to_read_before}: {e}")
             else:
                 content_before = []
 
             # --- Handle Checkpoint ---
+            # Checkpoints are stored in the object store keyed by hash_before, so
+            # the same content is kept once across conversations.
             path_to_checkpoint = path_to_read_before
-            sanitized_chkpt_fname = (
-                sanitize_path_for_filename(str(path_to_checkpoint), workspace_root)
-                + ".chkpt"
-            )
-            checkpoint_file = checkpoint_dir / sanitized_chkpt_fname
-            relative_checkpoint_path = (
-                Path(CHECKPOINTS_DIR) / conversation_id / sanitized_chkpt_fname
-            )
-            current_log_entries = read_log_file(log_file_path)
-            seen_paths = set(
-                e["file_path"] for e in current_log_entries if "file_path" in e
-            )
+            seen_paths = get_logged_file_paths(log_file_path)
 
-            # Only create checkpoint if this is the first time we're seeing this path
+            # Checkpoint the first time we see this path, then periodically
             if str(relative_file_path) not in seen_paths:
-                checkpoint_created = True
-                if file_existed_before_locked:
-                    try:
-                        shutil.copy2(path_to_checkpoint, checkpoint_file)
-                    except IOError as e:
-                        log.error(f"Failed to create checkpoint: {e}")
-                        raise HistoryError(f"Failed to create checkpoint: {e}")
+                checkpoint_created = file_existed_before_locked
+            elif (
+                operation in ["edit", "replace"]
+                and hash_before
+                and checkpoint_due(log_file_path, str(relative_file_path))
+            ):
+                # Periodic checkpoint so reconstruction replays a bounded chain
+                checkpoint_created = checkpoint_periodic = True
+            if checkpoint_created:
+                if data_before is None:
+                    raise HistoryError(
+                        f"Failed to read {path_to_checkpoint} for checkpoint"
+                    )
+                relative_checkpoint_path = write_object(
+                    history_root, data_before, hash_before
+                )
+
+            # Symbols parsed from the pre-edit content let the next lookup re-parse incrementally
+            symbols_before = (
+                get_cached_symbols(str(validated_path), hash_before)
+                if operation in ["edit", "replace"]
+                else None
+            )
 
             # --- Execute Operation ---
             try:
@@ -568,25 +667,69 @@ def track_edit_history(func: Callable) -> Callable:
             except Exception as e:
                 log.error(f"Operation failed: {e}")
                 raise
+            finally:
+                # Cached symbols for touched paths are stale once the tool has run
+                invalidate_symbols(str(validated_path))
+                if validated_source_path:
+                    invalidate_symbols(str(validated_source_path))
 
             # --- Read State After Operation ---
             content_after: Optional[List[str]] = None
+            data_after: Optional[bytes] = None
             hash_after: Optional[str] = None
+            stat_after: Optional[Dict[str, int]] = None
             if operation != "delete":
                 try:
-                    with open(
-                        validated_path, "r", encoding="utf-8", errors="ignore"
-                    ) as f:
-                        content_after = f.readlines()
-                    hash_after = calculate_hash(str(validated_path))
-                except IOError as e:
+                    stat_after = stat_stamp(validated_path)
+                    # Served from memory when the tool wrote through write_text
+                    data_after = read_file_bytes(validated_path)
+                    content_after = decode_lines(data_after)
+                    hash_after = hashlib.sha256(data_after).hexdigest()
+                except OSError as e:
                     log.error(f"Failed to read file after operation: {e}")
                     content_after = None
+                    data_after = None
                     hash_after = None
+                    stat_after = None
+
+            if symbols_before is not None and content_after is not None:
+                edit_range = compute_edit_range(content_before or [], content_after)
+                if edit_range:
+                    note_symbol_edit(
+                        str(validated_path), symbols_before, edit_range, hash_after
+                    )
+
+            # --- Store Oversized Changes As Content ---
+            # A diff of a huge rewrite (lockfiles, generated code) is as large as
+            # the file and slow to produce, so the new content is stored instead,
+            # with a checkpoint of the old content so the entry can be reverted.
+            if (
+                operation in ["create", "edit", "replace"]
+                and content_before is not None
+                and content_after is not None
+                and hash_after
+                and diff_exceeds_limit(content_before, content_after)
+            ):
+                log.info(
+                    f"Change to {relative_file_path} exceeds the diff limit; storing full content"
+                )
+                relative_content_path = write_object(
+                    history_root, data_after, hash_after
+                )
+                if data_before is not None and not checkpoint_created:
+                    relative_checkpoint_path = write_object(
+                        history_root, data_before, hash_before
+                    )
+                    checkpoint_created = checkpoint_periodic = True
 
             # --- Generate Diff ---
             diff_content = ""  # Initialize with empty string to avoid None case
-            if content_before is not None and content_after is not None:
+            diff_bytes = 0
+            if (
+                content_before is not None
+                and content_after is not None
+                and relative_content_path is None
+            ):
                 try:
                     diff_content = generate_diff(
                         content_before,
@@ -595,7 +738,9 @@ def track_edit_history(func: Callable) -> Callable:
                         str(relative_file_path),
                     )
                     if diff_content:
-                        diff_file_path.write_text(diff_content)
+                        diff_data = diff_content.encode("utf-8")
+                        relative_diff_path = write_object(history_root, diff_data)
+                        diff_bytes = len(diff_data)
                 except Exception as e:
                     log.error(f"Failed to generate diff: {e}")
                     raise HistoryError(f"Failed to generate diff: {e}")
@@ -617,6 +762,7 @@ def track_edit_history(func: Callable) -> Callable:
                 "tool_name": tool_name,
                 "status": "pending",
                 "diff_file": str(relative_diff_path) if diff_content else None,
+                "diff_bytes": diff_bytes,
                 "checkpoint_file": str(relative_checkpoint_path)
                 if checkpoint_created
                 else None,
@@ -624,8 +770,19 @@ def track_edit_history(func: Callable) -> Callable:
                 "hash_after": hash_after,
             }
 
+            if stat_after is not None:
+                log_entry["stat_after"] = stat_after
+            if checkpoint_periodic:
+                log_entry["checkpoint_kind"] = "periodic"
+            if relative_content_path is not None:
+                log_entry["content_file"] = str(relative_content_path)
+
             # For edit and replace operations, always ensure there's a diff file
-            if (operation == "edit" or operation == "replace") and not diff_content:
+            if (
+                operation in ["edit", "replace"]
+                and not diff_content
+                and relative_content_path is None
+            ):
                 # Create an empty diff for the edit or replace operation
                 empty_diff = generate_diff(
                     content_before or [],
@@ -633,11 +790,12 @@ def track_edit_history(func: Callable) -> Callable:
                     str(relative_file_path),
                     str(relative_file_path),
                 )
-                diff_file_path.write_text(empty_diff)
+                empty_diff_data = empty_diff.encode("utf-8")
+                relative_diff_path = write_object(history_root, empty_diff_data)
                 log_entry["diff_file"] = str(relative_diff_path)
+                log_entry["diff_bytes"] = len(empty_diff_data)
 
-            current_log_entries.append(log_entry)
-            write_log_file(log_file_path, current_log_entries)
+            append_log_entry(log_file_path, log_entry)
 
             # Modify the result to include the diff if it's small enough
             # (only for operations that modify files)
@@ -659,6 +817,7 @@ def track_edit_history(func: Callable) -> Callable:
             release_lock(target_file_lock)
             release_lock(source_file_lock)
             release_lock(log_file_lock)
+            close_edit_buffers(buffers_token)
 
     return wrapper
 
@@ -686,38 +845,31 @@ def read_file(path: str, ranges: Optional[List[str]] = None) -> str:
         resolved_path = _resolve_path(path)
         validated_path = validate_path(resolved_path, SERVER_ALLOWED_DIRECTORIES)
 
-        with open(validated_path, "r", encoding="utf-8", errors="ignore") as f:
-            lines = f.readlines()
-        total_lines = len(lines)
-
-        selected_lines_data = []
         header = ""
 
         if ranges:
-            # Parse the ranges
-            line_numbers = set()
+            # Parse the ranges into inclusive (start, end) spans
+            spans: List[Tuple[int, int]] = []
             try:
                 for r in ranges:
                     if "-" in r:
                         start, end = map(int, r.split("-"))
                         if start < 1 or end < start:
                             return f"Invalid range '{r}': start must be >= 1 and end >= start."
-                        line_numbers.update(range(start, end + 1))
+                        spans.append((start, end))
                     else:
                         line_num = int(r)
                         if line_num < 1:
                             return f"Invalid line number '{r}': must be >= 1."
-                        line_numbers.add(line_num)
+                        spans.append((line_num, line_num))
             except ValueError:
                 return f"Invalid range format in '{r}'. Use numbers or 'start-end'."
 
-            if not line_numbers:
+            if not spans:
                 return f"No valid line numbers specified in ranges for {path}."
 
-            # Filter lines by the requested line numbers (1-indexed)
-            selected_lines_data = [
-                (i + 1, line) for i, line in enumerate(lines) if i + 1 in line_numbers
-            ]
+            # Seeks straight to each span via the cached line index
+            total_lines, selected_lines_data = read_line_spans(validated_path, spans)
 
             if not selected_lines_data:
                 return f"No matching lines found in specified ranges for {path}."
@@ -727,10 +879,10 @@ def read_file(path: str, ranges: Optional[List[str]] = None) -> str:
 
         else:
             # Default: Read first DEFAULT_MAX_LINES
+            total_lines, selected_lines_data = read_line_spans(
+                validated_path, [(1, DEFAULT_MAX_LINES)]
+            )
             end_line = min(total_lines, DEFAULT_MAX_LINES)
-            selected_lines_data = list(
-                enumerate(lines[:end_line], 1)
-            )  # Use enumerate for 1-based index
             header = f"[TOTAL {total_lines} lines, showing lines 1-{end_line}]"
 
         # Format the output with line numbers
@@ -782,21 +934,11 @@ def read_file_by_keyword(
     except (ValueError, Exception) as e:
         return f"Error accessing file {path}: {str(e)}"
 
-    matches = []  # List of line indices (0-based)
     try:
-        if use_regex:
-            flags = re.IGNORECASE if ignore_case else 0
-            pattern = re.compile(keyword, flags)
-            matches = [i for i, line in enumerate(lines) if pattern.search(line)]
-        else:
-            search_term = keyword.lower() if ignore_case else keyword
-            matches = [
-                i
-                for i, line in enumerate(lines)
-                if search_term in (line.lower() if ignore_case else line)
-            ]
+        matcher = compile_line_matcher(keyword, use_regex, ignore_case)
     except re.error as e:
         return f"Error in regex pattern: {str(e)}"
+    matches = [i for i, line in enumerate(lines) if matcher(line)]  # 0-based
 
     if not matches:
         return f"No matches found for '{keyword}'."
@@ -826,37 +968,120 @@ def read_file_by_keyword(
 
     # Extract the lines from the combined regions
     result = []
-
-    # Create pattern for regex mode or None for keyword mode
-    if use_regex:
-        flags = re.IGNORECASE if ignore_case else 0
-        pattern = re.compile(keyword, flags)
-    else:
-        pattern = None
-
     for start, end in combined_regions:
         # Add a separator between regions if needed
         if result:
             result.append("---")
 
-        # Add the region with line numbers
+        # Add the region with line numbers (1-indexed), marking matching lines
         for i in range(start, end + 1):
-            line_num = i + 1  # 1-indexed line numbers
             line = lines[i].rstrip()
+            result.append(format_context_line(i + 1, line, matcher(line)))
 
-            # Mark matching lines
-            if use_regex:
-                is_match = pattern.search(line) is not None
-            else:
-                if ignore_case:
-                    is_match = keyword.lower() in line.lower()
-                else:
-                    is_match = keyword in line
+    return "\n".join(result)
 
-            prefix = ">" if is_match else " "
-            result.append(f"{line_num}{prefix} {line}")
 
-    return "\n".join(result)
+@mcp.tool()
+def grep_files(
+    path: str,
+    keyword: str,
+    pattern: str = "*",
+    include_lines_before: int = 2,
+    include_lines_after: int = 3,
+    use_regex: bool = False,
+    ignore_case: bool = False,
+    excludePatterns: Optional[List[str]] = None,
+    max_matches: int = 200,
+    max_bytes: int = 65536,
+    show_files_ignored_by_git: bool = False,
+) -> str:
+    """
+    Search every file under a directory for a keyword or regex, with context lines.
+
+    Args:
+        path: Directory to search.
+        keyword: Text (or regex if use_regex is True) to look for in each line.
+        pattern: Glob matched against file names, e.g. "*.py".
+        include_lines_before: Context lines shown before each match.
+        include_lines_after: Context lines shown after each match.
+        use_regex: Treat keyword as a regular expression.
+        ignore_case: Match case-insensitively.
+        excludePatterns: Glob patterns for file or directory names to skip.
+        max_matches: Stop after this many matching lines in total.
+        max_bytes: Stop once the output reaches roughly this many bytes.
+        show_files_ignored_by_git: Also search files git ignores or does not track.
+
+    Returns:
+        Matches grouped by file, in the same line format as read_file_by_keyword.
+        The search stops as soon as either cap is reached.
+    """
+    excludePatterns = excludePatterns or []
+    if max_matches < 1 or max_bytes < 1:
+        return "Error: max_matches and max_bytes must be positive."
+    try:
+        matcher = compile_line_matcher(keyword, use_regex, ignore_case)
+    except re.error as e:
+        return f"Error in regex pattern: {str(e)}"
+
+    try:
+        resolved_path = _resolve_path(path)
+        validated_path = validate_path(resolved_path, SERVER_ALLOWED_DIRECTORIES)
+        if not os.path.isdir(validated_path):
+            return f"Error: Search path '{path}' is not a directory."
+
+        # Respect .gitignore the same way directory_tree does: list tracked files
+        candidates = None
+        git_root = None if show_files_ignored_by_git else _find_git_root(validated_path)
+        git_cmd = _find_git_executable() if git_root else None
+        if git_cmd:
+            try:
+                candidates = _git_tracked_files(git_cmd, git_root, validated_path)
+            except (subprocess.CalledProcessError, OSError) as e:
+                log.warning(f"git ls-files failed in {git_root}, walking instead: {e}")
+
+        if candidates is None:
+            files = _iter_search_matches(
+                validated_path, pattern, excludePatterns + [".git", ".mcp"], include_dirs=False
+            )
+        else:
+
+            def tracked_files():
+                for full_path in candidates:
+                    rel_parts = Path(os.path.relpath(full_path, validated_path)).parts
+                    if not fnmatch.fnmatch(rel_parts[-1], pattern):
+                        continue
+                    if any(
+                        fnmatch.fnmatch(part, pat)
+                        for part in rel_parts
+                        for pat in excludePatterns
+                    ):
+                        continue
+                    if not os.path.isfile(full_path):
+                        continue  # Deleted but not yet committed
+                    try:
+                        yield validate_path(full_path, SERVER_ALLOWED_DIRECTORIES)
+                    except ValueError:
+                        pass
+
+            files = tracked_files()
+
+        sections, total_matches, truncated = grep_paths(
+            files, matcher, include_lines_before, include_lines_after, max_matches, max_bytes
+        )
+    except (ValueError, Exception) as e:
+        return f"Error searching in {path}: {str(e)}"
+
+    if not sections:
+        return f"No matches found for '{keyword}' under {path}."
+
+    header = f"Found {total_matches} matches in {len(sections)} files under {path}"
+    if truncated:
+        header += f" (stopped at max_matches={max_matches} or max_bytes={max_bytes}; more may exist)"
+    parts = [header + ":"]
+    for file_path, lines in sections:
+        rel = os.path.relpath(file_path, validated_path)
+        parts.append(f"Matches in {rel}:\n" + "\n".join(lines))
+    return "\n\n".join(parts)
 
 
 @mcp.tool()
@@ -1057,7 +1282,9 @@ def read_function_by_keyword(
 
 
 @mcp.tool()
-def get_symbols(path: str, symbol_type: Optional[str] = None) -> str:
+def get_symbols(
+    path: str, symbol_type: Optional[str] = None, outline: bool = False
+) -> str:
     """
     Get all code symbols (functions, classes, methods, etc.) from a file using grammar parsers.
 
@@ -1065,6 +1292,8 @@ def get_symbols(path: str, symbol_type: Optional[str] = None) -> str:
         path: Path to the file
         symbol_type: Optional filter for symbol type (function, class, method, variable, etc.)
                     If None, returns all symbols
+        outline: If True, leave out symbols nested inside function bodies. Much faster on
+                 large files that are not indexed yet, since those bodies are not parsed
 
     Returns:
         A formatted list of symbols with their types and locations
@@ -1072,35 +1301,27 @@ def get_symbols(path: str, symbol_type: Optional[str] = None) -> str:
     try:
         resolved_path = _resolve_path(path)
         validated_path = validate_path(resolved_path, SERVER_ALLOWED_DIRECTORIES)
-        with open(validated_path, "r", encoding="utf-8", errors="ignore") as f:
-            code = f.read()
+        if not os.path.isfile(validated_path):
+            raise FileNotFoundError(f"No such file: '{validated_path}'")
     except (ValueError, FileNotFoundError, Exception) as e:
         return f"Error accessing file {path}: {str(e)}"
 
-    # Get the appropriate parser for this file type
-    parser = get_parser_for_file(validated_path)
-    if not parser:
-        return f"No suitable parser available for file type: {path}"
-
-    # Parse the code to get all elements
+    # Parse the code to get all elements (served from the symbol index when current)
     try:
-        elements = parser.parse(code)
+        if outline:
+            elements = load_symbol_outline(validated_path)
+        else:
+            elements = load_symbols(validated_path)
+    except OSError as e:
+        return f"Error accessing file {path}: {str(e)}"
     except Exception as e:
         return f"Error parsing file {path}: {str(e)}"
+    if elements is None:
+        return f"No suitable parser available for file type: {path}"
+    elements = list(elements)
 
     # Filter by symbol type if specified
-    if symbol_type:
-        try:
-            # Convert to ElementType if possible
-            enum_type = ElementType(symbol_type.lower())
-            elements = [e for e in elements if e.element_type == enum_type]
-        except (ValueError, Exception):
-            # If not a valid ElementType, use string match
-            elements = [
-                e
-                for e in elements
-                if symbol_type.lower() in e.element_type.value.lower()
-            ]
+    elements = _filter_symbols_by_type(elements, symbol_type)
 
     # Format the results
     if not elements:
@@ -1110,11 +1331,166 @@ def get_symbols(path: str, symbol_type: Optional[str] = None) -> str:
 
     result = [f"Symbols in {path}:"]
     for elem in sorted(elements, key=lambda e: e.start_line):
-        parent_info = f" (in {elem.parent.name})" if elem.parent else ""
-        result.append(
-            f"{elem.element_type.value}: {elem.name}{parent_info} (lines {elem.start_line}-{elem.end_line})"
+        result.append(_format_symbol(elem))
+
+    return "\n".join(result)
+
+
+def _filter_symbols_by_type(elements: List[Any], symbol_type: Optional[str]) -> List[Any]:
+    """Filter parsed elements by ElementType value, falling back to a substring match."""
+    if not symbol_type:
+        return elements
+    try:
+        # Convert to ElementType if possible
+        enum_type = ElementType(symbol_type.lower())
+        return [e for e in elements if e.element_type == enum_type]
+    except (ValueError, Exception):
+        # If not a valid ElementType, use string match
+        return [
+            e for e in elements if symbol_type.lower() in e.element_type.value.lower()
+        ]
+
+
+def _format_symbol(elem: Any) -> str:
+    """Format one symbol as 'type: name (in parent) (lines a-b)'."""
+    parent_info = f" (in {elem.parent.name})" if elem.parent else ""
+    return f"{elem.element_type.value}: {elem.name}{parent_info} (lines {elem.start_line}-{elem.end_line})"
+
+
+def _list_source_files(
+    validated_start_path: str, pattern: str = "*", excludePatterns: Optional[List[str]] = None
+) -> List[str]:
+    """List files under a validated directory that have a dedicated parser."""
+    return [
+        p
+        for p in _iter_search_matches(
+            validated_start_path,
+            pattern,
+            # History, indexes and VCS metadata are never project sources
+            (excludePatterns or []) + [".mcp", ".git"],
+            include_dirs=False,
         )
+        if has_dedicated_parser(p)
+    ]
+
+
+def _list_source_files_cached(validated_start_path: str) -> List[str]:
+    """
+    Like _list_source_files, but served from the directory listing cache.
+
+    Only directories whose mtime changed are re-read, so repeated queries
+    over an unchanged tree cost one stat per directory. Files are filtered by
+    name before anything else is looked up.
+    """
+    file_paths = []
+    for full_path, entry in walk_files_cached(validated_start_path, [".mcp", ".git"]):
+        if entry.kind not in ("file", "link") or not has_dedicated_parser(full_path):
+            continue
+        if entry.kind == "link":
+            try:
+                validate_path(full_path, SERVER_ALLOWED_DIRECTORIES)
+            except ValueError:
+                continue
+            if not os.path.isfile(full_path):
+                continue
+        file_paths.append(full_path)
+    return file_paths
+
+
+@mcp.tool()
+def get_symbols_in_directory(
+    path: str,
+    pattern: str = "*",
+    symbol_type: Optional[str] = None,
+    excludePatterns: Optional[List[str]] = None,
+) -> str:
+    """
+    Get code symbols for every source file under a directory in one call.
+    Files are parsed in parallel worker processes; unchanged files are served from the symbol index.
+
+    Args:
+        path: Directory to search
+        pattern: Filename pattern to match (supports wildcards, e.g. "*.py")
+        symbol_type: Optional filter for symbol type (function, class, method, variable, etc.)
+        excludePatterns: Optional list of file/directory name patterns to skip (e.g. ["node_modules", ".*"])
+
+    Returns:
+        Symbols grouped by file (paths relative to the search directory)
+    """
+    try:
+        resolved_path = _resolve_path(path)
+        validated_start_path = validate_path(resolved_path, SERVER_ALLOWED_DIRECTORIES)
+        if not os.path.isdir(validated_start_path):
+            return f"Error: Search path '{path}' is not a directory."
+
+        file_paths = _list_source_files(validated_start_path, pattern, excludePatterns)
+    except (ValueError, Exception) as e:
+        return f"Error searching in {path}: {str(e)}"
+
+    if not file_paths:
+        return f"No source files matching '{pattern}' found in {path}"
+
+    symbols_by_file, errors = load_symbols_many(file_paths)
+
+    sections = []
+    symbol_count = 0
+    for file_path in sorted(symbols_by_file):
+        elements = _filter_symbols_by_type(symbols_by_file[file_path] or [], symbol_type)
+        if not elements:
+            continue
+        symbol_count += len(elements)
+        rel_path = os.path.relpath(file_path, validated_start_path)
+        lines = [f"Symbols in {rel_path}:"]
+        lines.extend(_format_symbol(e) for e in sorted(elements, key=lambda e: e.start_line))
+        sections.append("\n".join(lines))
+    for file_path in sorted(errors):
+        rel_path = os.path.relpath(file_path, validated_start_path)
+        sections.append(f"Error parsing {rel_path}: {errors[file_path]}")
+
+    type_str = f" of type '{symbol_type}'" if symbol_type else ""
+    header = f"Found {symbol_count} symbols{type_str} in {len(file_paths)} files under {path}"
+    return "\n\n".join([header] + sections)
+
+
+@mcp.tool()
+def find_symbol(name: str, kind: Optional[str] = None) -> str:
+    """
+    Find where a symbol is defined across all allowed directories.
+    Matches either the plain name ("create_parser") or the qualified name ("ParserFactory.create_parser").
+    The index is built on first use and only re-reads files that changed since the last query.
+
+    Args:
+        name: Symbol name or dotted qualified name
+        kind: Optional symbol type filter (function, class, method, variable, etc.)
+
+    Returns:
+        One line per definition with its file path and line range
+    """
+    file_paths = []
+    for allowed_dir in SERVER_ALLOWED_DIRECTORIES:
+        try:
+            file_paths.extend(_list_source_files_cached(allowed_dir))
+        except (ValueError, Exception) as e:
+            log.warning(f"Skipping '{allowed_dir}' while indexing symbols: {e}")
+
+    errors = refresh_name_index(file_paths)
+    for file_path, error in errors.items():
+        log.debug(f"Symbol index skipped {file_path}: {error}")
 
+    matches = lookup_symbol(name)
+    if kind:
+        wanted = {id(e) for e in _filter_symbols_by_type([e for _, e in matches], kind)}
+        matches = [(p, e) for p, e in matches if id(e) in wanted]
+
+    type_str = f" of type '{kind}'" if kind else ""
+    if not matches:
+        return f"No symbol named '{name}'{type_str} found in {len(file_paths)} indexed files"
+
+    result = [f"Found {len(matches)} definitions of '{name}'{type_str}:"]
+    for file_path, elem in matches:
+        result.append(
+            f"{file_path}:{elem.start_line}-{elem.end_line} {elem.element_type.value}: {elem.get_full_name()}"
+        )
     return "\n".join(result)
 
 
@@ -1137,19 +1513,16 @@ def get_code_of_symbol(
     try:
         resolved_path = _resolve_path(path)
         validated_path = validate_path(resolved_path, SERVER_ALLOWED_DIRECTORIES)
-        with open(validated_path, "r", encoding="utf-8", errors="ignore") as f:
-            code = f.read()
+        if not os.path.isfile(validated_path):
+            raise FileNotFoundError(f"No such file: '{validated_path}'")
     except (ValueError, FileNotFoundError, OSError, Exception) as e:
         return f"Error accessing file {path}: {str(e)}"
 
-    # Get the appropriate parser for this file type
-    parser = get_parser_for_file(validated_path)
-    if not parser:
-        return f"No suitable parser available for file type: {path}"
-
-    # Find all symbols and filter
+    # Find all symbols and filter; only bodies that mention the name are parsed
     try:
-        all_elements = parser.parse(code)
+        all_elements = load_symbols_named(validated_path, symbol_name)
+        if all_elements is None:
+            return f"No suitable parser available for file type: {path}"
         matching_elements = []
         for elem in all_elements:
             type_matches = True
@@ -1293,19 +1666,22 @@ def full_directory_tree(
             )
 
             try:
-                entries = sorted(os.listdir(current_path))
+                # Served from memory while the directory's mtime is unchanged
+                entries = list_directory_cached(str(current_path))
             except OSError as e:
                 output_lines.append(
                     f"{current_path.name}/ [Error listing dir: {e.strerror}]"
                 )
                 return
 
-            for i, entry_name in enumerate(entries):
-                entry_path = current_path / entry_name
+            for entry in entries:
+                entry_path = current_path / entry.name
 
-                if entry_path.is_symlink():  # Handle symlinks explicitly
+                if entry.kind == "link":  # Handle symlinks explicitly
                     try:
-                        link_target = os.readlink(entry_path)
+                        link_target = entry.link_target
+                        if link_target is None:
+                            link_target = os.readlink(entry_path)
                         # Attempt validation of link target path itself
                         metadata = get_metadata(
                             str(entry_path),
@@ -1328,9 +1704,9 @@ def full_directory_tree(
                     except OSError as e:
                         output_lines.append(f"{entry_path} [Broken Link: {e.strerror}]")
 
-                elif entry_path.is_dir():
+                elif entry.kind == "dir":
                     process_directory(str(entry_path))  # Recurse into subdirectory
-                elif entry_path.is_file():
+                elif entry.kind == "file":
                     metadata = get_metadata(
                         str(entry_path),
                         True,
@@ -1352,6 +1728,47 @@ def full_directory_tree(
         return f"Error generating directory tree for {path}: {str(e)}"
 
 
+def _find_git_root(start_path: str, max_depth: int = 20) -> Optional[str]:
+    """Walk up from start_path to the nearest directory containing .git."""
+    current = Path(start_path).resolve()
+    while current != current.parent and max_depth > 0:  # Stop at root
+        if (current / ".git").exists():
+            return str(current)
+        current = current.parent
+        max_depth -= 1
+    return None
+
+
+def _find_git_executable() -> Optional[str]:
+    """Locate git on PATH or in common install locations."""
+    git_cmd = shutil.which("git")
+    if git_cmd:
+        return git_cmd
+    # Try common locations for git if shutil.which fails
+    common_git_paths = [
+        "/usr/bin/git",
+        "/usr/local/bin/git",
+        "/opt/homebrew/bin/git",
+        "C:\\Program Files\\Git\\bin\\git.exe",
+        "C:\\Program Files (x86)\\Git\\bin\\git.exe",
+    ]
+    for git_path in common_git_paths:
+        if os.path.isfile(git_path):
+            return git_path
+    return None
+
+
+def _git_tracked_files(git_cmd: str, git_root: str, validated_path: str) -> List[str]:
+    """Absolute paths of files git tracks under validated_path (so .gitignore applies)."""
+    rel_path = os.path.relpath(validated_path, git_root)
+    prefix = "" if rel_path == "." else rel_path.replace(os.sep, "/") + "/"
+    return [
+        os.path.join(git_root, *rel_file.split("/"))
+        for rel_file in tracked_files_cached(git_cmd, git_root)
+        if rel_file.startswith(prefix) and not rel_file.startswith(".git/")
+    ]
+
+
 @mcp.tool()
 def directory_tree(
     path: str,
@@ -1365,25 +1782,14 @@ def directory_tree(
     resolved_path = _resolve_path(path)
     validated_path = validate_path(resolved_path, SERVER_ALLOWED_DIRECTORIES)
 
-    # Check if this path is within a git repository by walking up the directory tree
-    def find_git_root(start_path: str) -> Optional[str]:
-        current = Path(start_path).resolve()
-        max_depth = 20
-        while current != current.parent and max_depth > 0:  # Stop at root
-            if (current / ".git").exists():
-                return str(current)
-            current = current.parent
-            max_depth -= 1
-        return None
-
     # First try to find git root from the working directory
     git_root = None
     if WORKING_DIRECTORY is not None:
-        git_root = find_git_root(WORKING_DIRECTORY)
+        git_root = _find_git_root(WORKING_DIRECTORY)
 
-    # If not found, try from the target path
-    if git_root is None:
-        git_root = find_git_root(validated_path)
+    # If not found (or the target is in another repository), try from the target path
+    if git_root is None or os.path.relpath(validated_path, git_root).startswith(os.pardir):
+        git_root = _find_git_root(validated_path)
 
     if not git_root or show_files_ignored_by_git:
         return full_directory_tree(
@@ -1396,82 +1802,21 @@ def directory_tree(
         )
 
     # Find git executable
-    git_cmd = shutil.which("git")
+    git_cmd = _find_git_executable()
     if not git_cmd:
-        # Try common locations for git if shutil.which fails
-        common_git_paths = [
-            "/usr/bin/git",
-            "/usr/local/bin/git",
-            "/opt/homebrew/bin/git",
-            "C:\\Program Files\\Git\\bin\\git.exe",
-            "C:\\Program Files (x86)\\Git\\bin\\git.exe",
-        ]
-        for git_path in common_git_paths:
-            if os.path.isfile(git_path):
-                git_cmd = git_path
-                break
-
-        if not git_cmd:
-            return "Error: Git executable not found. Please ensure Git is installed and in your PATH."
+        return "Error: Git executable not found. Please ensure Git is installed and in your PATH."
 
     try:
-        output_lines = []
-
-        os.chdir(validated_path)
-
-        # git config --global --add safe.directory /path
-        subprocess.run(
-            [
-                git_cmd,
-                "config",
-                "--global",
-                "--add",
-                "safe.directory",
-                git_root,
-            ],
-            capture_output=False,
-            text=False,
-            check=False,
-        )
-
-        # Run git ls-files to get all tracked files
-        # Change to git repository root first
-        original_cwd = os.getcwd()
-        os.chdir(git_root)
-        try:
-            result = subprocess.run(
-                [git_cmd, "ls-files"], capture_output=True, text=True, check=True
-            )
-        finally:
-            # Restore original working directory
-            os.chdir(original_cwd)
-
-        git_files = list(result.stdout.strip().split("\n"))
-        if not git_files or (len(git_files) == 1 and not git_files[0]):
+        # Tracked files are listed once per change to .git/index, without
+        # touching the process working directory or the global git config
+        tracked = _git_tracked_files(git_cmd, git_root, validated_path)
+        if not tracked:
             return "No tracked files found in the repository."
 
-        # Get the relative path from git root to the requested directory
-        rel_path = os.path.relpath(validated_path, git_root)
-        # if rel_path == ".":
-        #     rel_path = ""
-
-        # Collect tracked files
-        for rel_file in git_files:
-            if not rel_file:  # Skip empty lines
-                continue
-
-            # Skip .git directory and its contents
-            if rel_file.startswith(".git/"):
-                continue
-
-            # Skip files not under the requested directory
-            if rel_path and not rel_file.startswith(rel_path + os.sep):
-                continue
-
-            file_path = os.path.join(git_root, rel_file)
-
+        output_lines = []
+        for file_path in tracked:
             # Get and add metadata
-            if os.path.exists(file_path):
+            if path_exists_cached(file_path):
                 metadata = get_metadata(
                     file_path,
                     True,
@@ -1497,7 +1842,9 @@ def directory_tree(
 
 
 @mcp.tool()
-def search_directories(path: str, pattern: str, max_depth: Optional[int] = None) -> str:
+def search_directories(
+    path: str, pattern: str, max_depth: Optional[int] = None, max_results: Optional[int] = None
+) -> str:
     """
     Search for directories matching a pattern within the specified path.
 
@@ -1505,63 +1852,69 @@ def search_directories(path: str, pattern: str, max_depth: Optional[int] = None)
         path: Starting directory path
         pattern: Pattern to match directory names against (supports wildcards)
         max_depth: Maximum depth to search (None for unlimited)
+        max_results: Stop after this many matches (None for unlimited)
 
     Returns:
         List of matching directory paths
     """
-    results = []
     try:
         resolved_path = _resolve_path(path)
         validated_start_path = validate_path(resolved_path, SERVER_ALLOWED_DIRECTORIES)
         if not os.path.isdir(validated_start_path):
             return f"Error: Search path '{path}' is not a directory."
 
-        current_depth = 0
-        for root, dirs, _ in os.walk(
-            validated_start_path, topdown=True, followlinks=False
-        ):
-            # Check if we've reached max depth
-            if max_depth is not None:
-                # Calculate current depth relative to start path
-                rel_path = os.path.relpath(root, validated_start_path)
-                current_depth = len(rel_path.split(os.sep)) if rel_path != "." else 0
-                if current_depth >= max_depth:
-                    dirs.clear()  # Don't descend further
-                    continue
+        matches = walk_matches(
+            validated_start_path,
+            SERVER_ALLOWED_DIRECTORIES,
+            pattern,
+            include_files=False,
+            max_depth=max_depth,
+        )
+        return _join_limited(matches, max_results, "No matching directories found.")
 
-            # Validate the current root before processing
-            try:
-                validate_path(root, SERVER_ALLOWED_DIRECTORIES)
-            except ValueError:
-                log.warning(
-                    f"Skipping directory '{root}' during search as it's outside allowed area."
-                )
-                dirs.clear()  # Don't recurse further
-                continue
+    except (ValueError, Exception) as e:
+        return f"Error searching directories in {path}: {str(e)}"
 
-            # Check directories in current level
-            for dir_name in dirs:
-                if fnmatch.fnmatch(dir_name, pattern):
-                    full_path = os.path.join(root, dir_name)
-                    try:
-                        # Final validation
-                        validate_path(full_path, SERVER_ALLOWED_DIRECTORIES)
-                        results.append(full_path)
-                    except ValueError:
-                        pass  # Skip if validation fails
 
-        return "\n".join(results) if results else "No matching directories found."
+def _iter_search_matches(
+    validated_start_path: str,
+    pattern: str,
+    excludePatterns: List[str],
+    include_dirs: bool = True,
+):
+    """
+    Walk a validated directory and yield full paths whose names match pattern.
+    Excluded names are pruned before recursing and symlinks are only yielded
+    when they resolve inside the allowed directories.
+    """
+    return walk_matches(
+        validated_start_path,
+        SERVER_ALLOWED_DIRECTORIES,
+        pattern,
+        excludePatterns,
+        include_dirs=include_dirs,
+    )
+
 
-    except (ValueError, Exception) as e:
-        return f"Error searching directories in {path}: {str(e)}"
+def _join_limited(paths, max_results: Optional[int], empty_message: str) -> str:
+    """Newline-join paths from a lazy walk, stopping after max_results."""
+    results = []
+    for full_path in paths:
+        if max_results is not None and len(results) >= max_results:
+            results.append(f"... (stopped after {max_results} results)")
+            break
+        results.append(full_path)
+    return "\n".join(results) if results else empty_message
 
 
 @mcp.tool()
 def search_files(
-    path: str, pattern: str, excludePatterns: Optional[List[str]] = None
+    path: str,
+    pattern: str,
+    excludePatterns: Optional[List[str]] = None,
+    max_results: Optional[int] = None,
 ) -> str:
-    """Recursively search for files and directories matching a pattern."""
-    results = []
+    """Recursively search for files and directories matching a pattern. Set max_results to stop the walk early."""
     excludePatterns = excludePatterns or []
     try:
         resolved_path = _resolve_path(path)
@@ -1569,44 +1922,11 @@ def search_files(
         if not os.path.isdir(validated_start_path):
             return f"Error: Search path '{path}' is not a directory."
 
-        for root, dirs, files in os.walk(
-            validated_start_path, topdown=True, followlinks=False
-        ):
-            # Filter excluded directories *before* recursing into them
-            dirs[:] = [
-                d
-                for d in dirs
-                if not any(fnmatch.fnmatch(d, pat) for pat in excludePatterns)
-            ]
-            files[:] = [
-                f
-                for f in files
-                if not any(fnmatch.fnmatch(f, pat) for pat in excludePatterns)
-            ]
-
-            # Validate the current root before processing its contents
-            try:
-                validate_path(root, SERVER_ALLOWED_DIRECTORIES)
-            except ValueError:
-                log.warning(
-                    f"Skipping directory '{root}' during search as it's outside allowed area (likely due to symlink traversal avoided by followlinks=False, but double checking)."
-                )
-                dirs[:] = []  # Don't recurse further down this invalid path
-                continue  # Skip processing files in this dir
-
-            # Check files and directories in the current validated root
-            current_entries = dirs + files
-            for name in current_entries:
-                if fnmatch.fnmatch(name, pattern):  # Use fnmatch for wildcard support
-                    full_path = os.path.join(root, name)
-                    # Final check just in case (should be redundant if root is valid)
-                    try:
-                        validate_path(full_path, SERVER_ALLOWED_DIRECTORIES)
-                        results.append(full_path)
-                    except ValueError:
-                        pass  # Skip adding if final validation fails somehow
-
-        return "\n".join(results) if results else "No matches found."
+        return _join_limited(
+            _iter_search_matches(validated_start_path, pattern, excludePatterns),
+            max_results,
+            "No matches found.",
+        )
 
     except (ValueError, Exception) as e:
         return f"Error searching in {path}: {str(e)}"
@@ -1859,13 +2179,118 @@ def write_file(ctx: Context, path: str, content: str) -> str:
                 # If all attempts fail, write the original string content
                 content_to_write = content
 
-        with open(validated_path, "w", encoding="utf-8") as f:
-            f.write(content_to_write)
+        write_text(validated_path, content_to_write)
         return f"Successfully wrote to {path}"
     except Exception as e:
         return f"Error writing file: {str(e)}"
 
 
+def _compute_diff_edit(
+    content: str,
+    replacements: Optional[Dict[str, str]],
+    inserts: Optional[Dict[str, str]],
+    replace_all: bool = True,
+) -> Tuple[str, Dict[str, Any]]:
+    """
+    Apply edit_file_diff replacements and inserts to content in memory.
+
+    Returns:
+        (new content, {"replace": count, "insert": count, "errors": [messages]}).
+        The new content should not be written when errors is non-empty.
+    """
+    replacements = replacements or {}
+    inserts = inserts or {}
+    operations = {"replace": 0, "insert": 0, "errors": []}
+    new_content = content
+
+    # --- Process Replacements ---
+    for old_text, new_text in replacements.items():
+        if not isinstance(old_text, str):
+            continue
+        if not old_text:
+            operations["errors"].append("Err: Empty replace key")
+            continue
+
+        # Try to parse and format JSON if new_text is str or dict
+        content_to_replace_with = new_text
+        if isinstance(new_text, dict):
+            content_to_replace_with = json.dumps(new_text, indent=2)
+        elif isinstance(new_text, str):
+            try:
+                json_obj = json.loads(new_text)
+                content_to_replace_with = json.dumps(json_obj, indent=2)
+            except json.JSONDecodeError:
+                cleaned_content = new_text.strip().strip("\"'")
+                cleaned_content = cleaned_content.replace('\\"', '"')
+                try:
+                    json_obj = json.loads(cleaned_content)
+                    content_to_replace_with = json.dumps(json_obj, indent=2)
+                except json.JSONDecodeError:
+                    pass
+
+        count = new_content.count(old_text)
+        if count == 0:
+            operations["errors"].append(
+                f"Err: Replace text not found: {old_text[:20]}..."
+            )
+            continue
+        replace_count = -1 if replace_all else 1
+        new_content = new_content.replace(
+            old_text, content_to_replace_with, replace_count
+        )
+        operations["replace"] += count if replace_all else (1 if count > 0 else 0)
+
+    # --- Process Insertions ---
+    for anchor_text, insert_text in inserts.items():
+        if not isinstance(anchor_text, str):
+            continue
+
+        # Try to parse and format JSON if insert_text is str or dict
+        content_to_insert = insert_text
+        if isinstance(insert_text, dict):
+            content_to_insert = json.dumps(insert_text, indent=2)
+        elif isinstance(insert_text, str):
+            try:
+                json_obj = json.loads(insert_text)
+                content_to_insert = json.dumps(json_obj, indent=2)
+            except json.JSONDecodeError:
+                cleaned_content = insert_text.strip().strip("\"'")
+                cleaned_content = cleaned_content.replace('\\"', '"')
+                try:
+                    json_obj = json.loads(cleaned_content)
+                    content_to_insert = json.dumps(json_obj, indent=2)
+                except json.JSONDecodeError:
+                    pass
+
+        if anchor_text == "":
+            new_content = content_to_insert + new_content
+            operations["insert"] += 1
+            continue
+        count = new_content.count(anchor_text)
+        if count == 0:
+            operations["errors"].append(
+                f"Err: Insert anchor not found: {anchor_text[:20]}..."
+            )
+            continue
+        if replace_all:
+            parts = new_content.split(anchor_text)
+            new_content = parts[0] + "".join(
+                [anchor_text + content_to_insert + part for part in parts[1:]]
+            )
+            operations["insert"] += len(parts) - 1
+        else:
+            pos = new_content.find(anchor_text)
+            if pos != -1:
+                new_content = (
+                    new_content[: pos + len(anchor_text)]
+                    + content_to_insert
+                    + new_content[pos + len(anchor_text) :]
+                )
+                operations["insert"] += 1
+
+    return new_content, operations
+
+
 @mcp.tool()
 @track_edit_history
 def edit_file_diff(
@@ -1909,99 +2334,13 @@ def edit_file_diff(
     try:
         resolved_path = _resolve_path(path)
         validated_path = validate_path(resolved_path, WORKING_DIRECTORY)
-        replacements = replacements or {}
-        inserts = inserts or {}
-        operations = {"replace": 0, "insert": 0, "errors": []}
-
-        # Read current content
-        with open(validated_path, "r", encoding="utf-8", errors="ignore") as f:
-            content = f.read()
-        new_content = content
-
-        # --- Process Replacements ---
-        for old_text, new_text in replacements.items():
-            if not isinstance(old_text, str):
-                continue
-            if not old_text:
-                operations["errors"].append("Err: Empty replace key")
-                continue
 
-            # Try to parse and format JSON if new_text is str or dict
-            content_to_replace_with = new_text
-            if isinstance(new_text, dict):
-                content_to_replace_with = json.dumps(new_text, indent=2)
-            elif isinstance(new_text, str):
-                try:
-                    json_obj = json.loads(new_text)
-                    content_to_replace_with = json.dumps(json_obj, indent=2)
-                except json.JSONDecodeError:
-                    cleaned_content = new_text.strip().strip("\"'")
-                    cleaned_content = cleaned_content.replace('\\"', '"')
-                    try:
-                        json_obj = json.loads(cleaned_content)
-                        content_to_replace_with = json.dumps(json_obj, indent=2)
-                    except json.JSONDecodeError:
-                        pass
+        # Read current content (already in memory when tracked)
+        content = read_text(validated_path)
 
-            count = new_content.count(old_text)
-            if count == 0:
-                operations["errors"].append(
-                    f"Err: Replace text not found: {old_text[:20]}..."
-                )
-                continue
-            replace_count = -1 if replace_all else 1
-            new_content = new_content.replace(
-                old_text, content_to_replace_with, replace_count
-            )
-            operations["replace"] += count if replace_all else (1 if count > 0 else 0)
-
-        # --- Process Insertions ---
-        for anchor_text, insert_text in inserts.items():
-            if not isinstance(anchor_text, str):
-                continue
-
-            # Try to parse and format JSON if insert_text is str or dict
-            content_to_insert = insert_text
-            if isinstance(insert_text, dict):
-                content_to_insert = json.dumps(insert_text, indent=2)
-            elif isinstance(insert_text, str):
-                try:
-                    json_obj = json.loads(insert_text)
-                    content_to_insert = json.dumps(json_obj, indent=2)
-                except json.JSONDecodeError:
-                    cleaned_content = insert_text.strip().strip("\"'")
-                    cleaned_content = cleaned_content.replace('\\"', '"')
-                    try:
-                        json_obj = json.loads(cleaned_content)
-                        content_to_insert = json.dumps(json_obj, indent=2)
-                    except json.JSONDecodeError:
-                        pass
-
-            if anchor_text == "":
-                new_content = content_to_insert + new_content
-                operations["insert"] += 1
-                continue
-            count = new_content.count(anchor_text)
-            if count == 0:
-                operations["errors"].append(
-                    f"Err: Insert anchor not found: {anchor_text[:20]}..."
-                )
-                continue
-            if replace_all:
-                parts = new_content.split(anchor_text)
-                new_content = parts[0] + "".join(
-                    [anchor_text + content_to_insert + part for part in parts[1:]]
-                )
-                operations["insert"] += len(parts) - 1
-            else:
-                pos = new_content.find(anchor_text)
-                if pos != -1:
-                    new_content = (
-                        new_content[: pos + len(anchor_text)]
-                        + content_to_insert
-                        + new_content[pos + len(anchor_text) :]
-                    )
-                    operations["insert"] += 1
+        new_content, operations = _compute_diff_edit(
+            content, replacements, inserts, replace_all
+        )
 
         # --- Handle Dry Run ---
         if dry_run:
@@ -2024,8 +2363,7 @@ def edit_file_diff(
 
         # --- Apply Changes ---
         if not operations["errors"]:
-            with open(validated_path, "w", encoding="utf-8") as f:
-                f.write(new_content)
+            write_text(validated_path, new_content)
         else:
             log.warning(f"Skipping write for {path} due to edit processing errors.")
 
@@ -2044,6 +2382,45 @@ def edit_file_diff(
         return f"Error editing file: {str(e)}"
 
 
+def _compute_line_edit(
+    lines: List[str], line_start: int, line_end: int, new_content: str
+) -> List[str]:
+    """
+    Replace 1-based inclusive lines line_start..line_end of lines with new_content.
+
+    Raises:
+        ValueError: If the line numbers are invalid for this file.
+    """
+    # Validate line numbers
+    if not isinstance(line_start, int) or not isinstance(line_end, int):
+        raise ValueError("line_start and line_end must be integers.")
+    if line_start < 1:
+        raise ValueError("line_start must be 1 or greater.")
+    if line_end < line_start:
+        raise ValueError("line_end must be greater than or equal to line_start.")
+
+    total_lines = len(lines)
+    if line_start > total_lines:
+        raise ValueError(
+            f"line_start ({line_start}) is beyond the end of the file ({total_lines} lines)."
+        )
+    # Allow line_end to be beyond the end, effectively replacing until the end
+    line_end_actual = min(line_end, total_lines)
+
+    # Prepare new content lines (ensure they end with newline)
+    new_lines = new_content.splitlines(keepends=True)
+    if not new_content.endswith("\n") and new_lines:
+        # Add newline to last line if original content didn't end with one
+        # and the replacement content isn't empty
+        new_lines[-1] += "\n"
+    elif not new_lines and new_content:
+        # Handle case where new_content is a single line without newline
+        new_lines = [new_content + "\n"]
+
+    # Lines before the start (0-based index: line_start - 1) and after the end
+    return lines[: line_start - 1] + new_lines + lines[line_end_actual:]
+
+
 @mcp.tool()
 @track_edit_history
 def replace_lines_in_file(
@@ -2066,46 +2443,15 @@ def replace_lines_in_file(
         resolved_path = _resolve_path(path)
         validated_path = validate_path(resolved_path, WORKING_DIRECTORY)
 
-        # Validate line numbers
-        if not isinstance(line_start, int) or not isinstance(line_end, int):
-            return "Error: line_start and line_end must be integers."
-        if line_start < 1:
-            return "Error: line_start must be 1 or greater."
-        if line_end < line_start:
-            return "Error: line_end must be greater than or equal to line_start."
+        # Read current lines, keeping trailing newlines
+        lines = read_lines(validated_path)
 
-        # Read current lines
-        with open(validated_path, "r", encoding="utf-8", errors="ignore") as f:
-            lines = f.readlines()  # Readlines keeps trailing newlines
-
-        total_lines = len(lines)
-        if line_start > total_lines:
-            return f"Error: line_start ({line_start}) is beyond the end of the file ({total_lines} lines)."
-        # Allow line_end to be beyond the end, effectively replacing until the end
-        line_end_actual = min(line_end, total_lines)
-
-        # Prepare new content lines (ensure they end with newline)
-        new_lines = new_content.splitlines(keepends=True)
-        if not new_content.endswith("\n") and new_lines:
-            # Add newline to last line if original content didn't end with one
-            # and the replacement content isn't empty
-            new_lines[-1] += "\n"
-        elif not new_lines and new_content:
-            # Handle case where new_content is a single line without newline
-            new_lines = [new_content + "\n"]
-
-        # Construct the new file content
-        # Lines before the start (0-based index: line_start - 1)
-        content_before = lines[: line_start - 1]
-        # Lines after the end (0-based index: line_end_actual)
-        content_after = lines[line_end_actual:]
-
-        final_content_lines = content_before + new_lines + content_after
-        final_content = "".join(final_content_lines)
+        final_content = "".join(
+            _compute_line_edit(lines, line_start, line_end, new_content)
+        )
 
         # Write the modified content back
-        with open(validated_path, "w", encoding="utf-8") as f:
-            f.write(final_content)
+        write_text(validated_path, final_content)
 
         return f"Successfully replaced lines {line_start}-{line_end} in {path}."
 
@@ -2118,6 +2464,264 @@ def replace_lines_in_file(
         return f"Error replacing lines in file {path}: {str(e)}"
 
 
+def _apply_batched_edit(content: str, edit: Dict[str, Any]) -> str:
+    """
+    Apply one apply_edits entry to a file's content in memory.
+
+    Raises:
+        ValueError: If the edit is malformed or does not apply.
+    """
+    if "line_start" in edit or "line_end" in edit:
+        lines = _compute_line_edit(
+            split_text_lines(content),
+            edit.get("line_start"),
+            edit.get("line_end"),
+            edit.get("new_content", ""),
+        )
+        return "".join(lines)
+    if "replacements" in edit or "inserts" in edit:
+        new_content, operations = _compute_diff_edit(
+            content,
+            edit.get("replacements"),
+            edit.get("inserts"),
+            edit.get("replace_all", True),
+        )
+        if operations["errors"]:
+            raise ValueError("; ".join(operations["errors"]))
+        return new_content
+    raise ValueError(
+        "expected replacements/inserts or line_start/line_end/new_content"
+    )
+
+
+def _displayable(text: str) -> str:
+    """Show undecodable bytes kept as surrogates as U+FFFD in tool output."""
+    return text.encode("utf-8", errors="surrogateescape").decode("utf-8", errors="replace")
+
+
+@mcp.tool()
+def apply_edits(ctx: Context, edits: List[Dict[str, Any]], dry_run: bool = False) -> str:
+    """
+    Apply a batch of edits across one or more files as a single all-or-nothing transaction.
+    Prefer this over many separate edit calls for multi-file refactors.
+
+    Args:
+        edits: List of edits. Each is a dict with "path" and either
+            "replacements" / "inserts" / "replace_all" (as in edit_file_diff) or
+            "line_start" / "line_end" / "new_content" (as in replace_lines_in_file).
+            Edits to the same file apply in list order, so later line numbers refer
+            to the file as changed by the earlier edits.
+        dry_run: If True, show the combined diff without changing any file.
+
+    Returns:
+        A summary with the diff of every file, or the first error (nothing is written).
+
+    Example:
+        apply_edits([
+            {"path": "a.py", "replacements": {"old_name(": "new_name("}},
+            {"path": "b.py", "replacements": {"import old_name": "import new_name"}},
+            {"path": "b.py", "line_start": 10, "line_end": 12, "new_content": "pass\n"},
+        ])
+    """
+    if not edits:
+        return "Error: No edits given."
+
+    # --- Resolve and group edits by file, in first-seen order ---
+    file_edits: Dict[Path, List[Tuple[int, Dict[str, Any]]]] = {}
+    for index, edit in enumerate(edits, 1):
+        if not isinstance(edit, dict) or not edit.get("path"):
+            return f"Error: Edit {index} has no path."
+        try:
+            validated_path = Path(
+                validate_path(_resolve_path(edit["path"]), SERVER_ALLOWED_DIRECTORIES)
+            ).resolve()
+        except ValueError as e:
+            return f"Error: Path validation failed for edit {index} - {e}"
+        if not validated_path.is_file():
+            return f"Error editing file: File not found at {edit['path']}"
+        file_edits.setdefault(validated_path, []).append((index, edit))
+
+    history_roots: Dict[Path, Path] = {}
+    for validated_path in file_edits:
+        history_root = get_history_root(str(validated_path))
+        if not history_root:
+            return f"Error: Cannot track history for {validated_path}. Make sure a '.mcp' folder exists here or in a parent directory."
+        history_roots[validated_path] = history_root
+
+    conversation_id = _get_or_create_conversation_id(ctx)
+    log_paths = sorted(
+        {root / LOGS_DIR / f"{conversation_id}.log" for root in history_roots.values()}
+    )
+
+    locks = []
+    try:
+        # --- Acquire Locks ---
+        # Files first, then logs, each in sorted order, so concurrent
+        # transactions over overlapping files cannot deadlock
+        for lock_path in sorted(file_edits) + log_paths:
+            locks.append(acquire_lock(str(lock_path)))
+
+        # --- Compute every new file content before writing any ---
+        plans = []  # (path, history_root, bytes before, content before, content after)
+        for validated_path, entries in file_edits.items():
+            data_before = validated_path.read_bytes()
+            # Bytes that are not UTF-8 survive the round trip as lone surrogates
+            content_before = data_before.decode("utf-8", errors="surrogateescape")
+            content_after = content_before
+            for index, edit in entries:
+                try:
+                    content_after = _apply_batched_edit(content_after, edit)
+                except ValueError as e:
+                    return f"Error in edit {index} ({edit['path']}): {e}\nNo files were changed."
+            plans.append(
+                (validated_path, history_roots[validated_path], data_before, content_before, content_after)
+            )
+
+        if dry_run:
+            diffs = [
+                generate_diff(
+                    split_text_lines(before), split_text_lines(after), str(path), str(path)
+                )
+                for path, _, _, before, after in plans
+            ]
+            diffs = [d for d in diffs if d]
+            if not diffs:
+                return "Dry run - no changes would be made."
+            return "Dry run - proposed changes:\n\n" + _displayable("\n".join(diffs))
+
+        # --- Store history objects and build log entries before touching any file ---
+        # Files whose content does not change are neither written nor logged
+        current_index = get_next_tool_call_index(conversation_id)
+        group_id = str(uuid.uuid4())
+        timestamp = (
+            datetime.now(timezone.utc).strftime("%Y-%m-%dT%H%M%S.%fZ")[:21] + "Z"
+        )
+        records = []  # (path, data before, data after, log file, log entry, symbol edit)
+        summary = []
+        for path, history_root, data_before, before, after in plans:
+            if after == before:
+                continue
+            workspace_root = history_root.parent.parent
+            log_file_path = history_root / LOGS_DIR / f"{conversation_id}.log"
+            relative_file_path = str(path.relative_to(workspace_root))
+            hash_before = hashlib.sha256(data_before).hexdigest()
+            data_after = after.encode("utf-8", errors="surrogateescape")
+            hash_after = hashlib.sha256(data_after).hexdigest()
+
+            lines_before = split_text_lines(before)
+            lines_after = split_text_lines(after)
+            oversized = diff_exceeds_limit(lines_before, lines_after)
+
+            checkpoint_periodic = False
+            relative_checkpoint_path = None
+            if relative_file_path not in get_logged_file_paths(log_file_path):
+                relative_checkpoint_path = write_object(history_root, data_before, hash_before)
+            elif oversized or checkpoint_due(log_file_path, relative_file_path):
+                relative_checkpoint_path = write_object(history_root, data_before, hash_before)
+                checkpoint_periodic = True
+
+            if oversized:
+                # Too large for a useful diff; store the new content instead
+                diff_content = ""
+                diff_data = b""
+                relative_diff_path = None
+                relative_content_path = write_object(history_root, data_after, hash_after)
+            else:
+                diff_content = generate_diff(
+                    lines_before, lines_after, relative_file_path, relative_file_path
+                )
+                diff_data = diff_content.encode("utf-8", errors="surrogateescape")
+                relative_diff_path = write_object(history_root, diff_data)
+
+            symbol_edit = None
+            symbols_before = get_cached_symbols(str(path), hash_before)
+            if symbols_before is not None:
+                edit_range = compute_edit_range(lines_before, lines_after)
+                if edit_range:
+                    symbol_edit = (symbols_before, edit_range, hash_after)
+
+            log_entry = {
+                "edit_id": str(uuid.uuid4()),
+                "conversation_id": conversation_id,
+                "tool_call_index": current_index,
+                "timestamp": timestamp,
+                "operation": "edit",
+                "file_path": relative_file_path,
+                "source_path": None,
+                "tool_name": "apply_edits",
+                "status": "pending",
+                "diff_file": str(relative_diff_path) if relative_diff_path else None,
+                "diff_bytes": len(diff_data),
+                "checkpoint_file": str(relative_checkpoint_path)
+                if relative_checkpoint_path
+                else None,
+                "hash_before": hash_before,
+                "hash_after": hash_after,
+                "group_id": group_id,
+            }
+            if checkpoint_periodic:
+                log_entry["checkpoint_kind"] = "periodic"
+            if oversized:
+                log_entry["content_file"] = str(relative_content_path)
+            records.append((path, data_before, data_after, log_file_path, log_entry, symbol_edit))
+            summary.append((relative_file_path, diff_content))
+
+        # --- Write all files, then the log; restore the originals if either fails ---
+        written: List[Tuple[Path, bytes]] = []
+        try:
+            for path, data_before, data_after, _, log_entry, _ in records:
+                temp_path = path.with_name(f".{path.name}.{uuid.uuid4().hex}.tmp")
+                try:
+                    with open(temp_path, "wb") as f:
+                        f.write(data_after)
+                        f.flush()
+                        shutil.copymode(path, temp_path)
+                        # Stamp the bytes hashed as hash_after; the inode survives the rename
+                        st = os.fstat(f.fileno())
+                    os.replace(temp_path, path)
+                finally:
+                    if temp_path.exists():
+                        temp_path.unlink()
+                written.append((path, data_before))
+                log_entry["stat_after"] = {
+                    "size": st.st_size,
+                    "mtime_ns": st.st_mtime_ns,
+                    "inode": st.st_ino,
+                }
+
+            entries_by_log: Dict[Path, List[Dict[str, Any]]] = {}
+            for _, _, _, log_file_path, log_entry, _ in records:
+                entries_by_log.setdefault(log_file_path, []).append(log_entry)
+            for log_file_path, log_entries in entries_by_log.items():
+                append_log_entries(log_file_path, log_entries)
+        except (HistoryError, OSError) as e:
+            for written_path, data_before in written:
+                written_path.write_bytes(data_before)
+            return f"Error applying edits: {e}. All files were restored."
+        finally:
+            for path, *_ in plans:
+                invalidate_symbols(str(path))
+
+        for path, _, _, _, _, symbol_edit in records:
+            if symbol_edit is not None:
+                note_symbol_edit(str(path), *symbol_edit)
+
+        result = f"Applied {len(edits)} edits to {len(summary)} of {len(plans)} files."
+        diff_text = "".join(d if d.endswith("\n") else d + "\n" for _, d in summary if d)
+        diff_lines = diff_text.count("\n")
+        if diff_text and diff_lines < 200:
+            result += f"\n\nDiff ({diff_lines} lines):\n{_displayable(diff_text)}"
+        return result
+
+    except (TimeoutError, HistoryError, OSError) as e:
+        log.error(f"apply_edits failed: {e}")
+        return f"Error applying edits: {e}"
+    finally:
+        # --- Release Locks ---
+        for lock in reversed(locks):
+            release_lock(lock)
+
+
 @mcp.tool()
 @track_edit_history
 def replace_symbol_in_file(
@@ -2148,20 +2752,15 @@ def replace_symbol_in_file(
         validated_path = validate_path(
             resolved_path, WORKING_DIRECTORY
         )  # Validate against working dir for modification
-        with open(validated_path, "r", encoding="utf-8", errors="ignore") as f:
-            code = f.read()
-            # Reread as lines for precise manipulation later
-            f.seek(0)
-            lines = f.readlines()
+        # Read as lines for precise manipulation later
+        lines = read_lines(validated_path)
     except (ValueError, FileNotFoundError, OSError, Exception) as e:
         return f"Error accessing file {path} for symbol replacement: {str(e)}"
 
-    parser = get_parser_for_file(validated_path)
-    if not parser:
-        return f"No suitable parser available for file type: {path}"
-
     try:
-        all_elements = parser.parse(code)
+        all_elements = load_symbols_named(validated_path, symbol_name)
+        if all_elements is None:
+            return f"No suitable parser available for file type: {path}"
         matching_elements = []
         for elem in all_elements:
             name_matches = elem.name == symbol_name
@@ -2258,8 +2857,7 @@ def replace_symbol_in_file(
             final_content = "".join(final_content_lines)
 
             # 8. Write the modified content back
-            with open(validated_path, "w", encoding="utf-8") as f:
-                f.write(final_content)
+            write_text(validated_path, final_content)
 
             type_str = f" ({symbol_to_replace.element_type.value})"
             parent_str = f" in parent '{parent_name}'" if parent_name else ""
@@ -2936,5 +3534,7 @@ Thank you for fixing this issue!
 
 
 if __name__ == "__main__":
+    if METRICS_PORT:
+        start_metrics_server(int(METRICS_PORT))
     print("Secure MCP Filesystem Server running", file=sys.stderr)
     mcp.run()
@@ -49,6 +49,21 @@ BRACE_EXTENSIONS = {".java", ".cs", ".go", ".php", ".swift", ".kt", ".kts", ".sc
 INDENT_EXTENSIONS = {".yaml", ".yml", ".sass", ".styl", ".coffee", ".fs"}  # F# is .fs
 
 
+def has_dedicated_parser(file_path):
+    """
+    Returns True if the file's extension maps to a specific or heuristic parser,
+    i.e. it would not fall back to the catch-all KeywordPatternParser.
+    """
+    import os
+
+    extension = os.path.splitext(file_path)[1].lower()
+    return (
+        extension in EXTENSION_TO_PARSER
+        or extension in BRACE_EXTENSIONS
+        or extension in INDENT_EXTENSIONS
+    )
+
+
 def get_parser_for_file(file_path):
     """
     Returns the appropriate parser for a given file based on its extension.
@@ -3,9 +3,41 @@ Base classes and types for language parsers.
 """
 
 import re
+from bisect import bisect_right
 from enum import Enum
 from typing import List, Dict, Optional, Any, Tuple
 
+# Languages whose function bodies parse_outline() can skip, keyed on the
+# parser's language attribute (regex_parser and token_parser spellings)
+OUTLINE_BRACE_LANGUAGES = frozenset(
+    {"c_cpp", "c", "c++", "javascript", "typescript", "tsx", "rust", "brace_block", "brace"}
+)
+OUTLINE_INDENT_LANGUAGES = frozenset({"python"})
+OUTLINE_PREPROCESSOR_LANGUAGES = frozenset({"c_cpp", "c", "c++"})
+OUTLINE_REGEX_LITERAL_LANGUAGES = frozenset({"javascript", "typescript", "tsx"})
+OUTLINE_HEADER_CHARS = 400  # A body's header is judged on this many preceding chars
+OUTLINE_ALIGN_CHARS = 24  # Leading chars of an element's code checked against its skeleton line
+
+# A brace block is a function body when its header ends in a parameter list,
+# optionally followed by qualifiers, a return type or an arrow
+FUNCTION_HEADER_PATTERN = re.compile(
+    r"\)\s*(?:(?:const|noexcept|override|final|mutable|&&?|"
+    r"throws\s+[\w.,\s]+|->[^{};]+|:[^{};=]+|where\s[^{};]+|=>)\s*)*$"
+)
+CONTAINER_HEADER_PATTERN = re.compile(
+    r"\b(?:class|struct|union|enum|interface|namespace|impl|trait|mod|module|object)\b"
+)
+CONTROL_HEADER_PATTERN = re.compile(r"(?<![\w$.])(?:if|for|while|switch|catch|with)\s*\(")
+PYTHON_DEF_PATTERN = re.compile(r"^([ \t]*)(?:async\s+)?def\s")
+SINGLE_LINE_STRING_PATTERN = re.compile(r"""(["'])(?:\\.|(?!\1)[^\\\n])*\1""")
+MULTI_LINE_STRING_PATTERNS = {
+    '"': re.compile(r'"(?:\\.|[^"\\])*"'),
+    "`": re.compile(r"`(?:\\.|[^`\\])*`"),
+}
+CHAR_LITERAL_PATTERN = re.compile(r"'(?:\\.|[^\\'\n])'")
+REGEX_LITERAL_PATTERN = re.compile(r"/(?:\\.|\[(?:\\.|[^\]\\\n])*\]|[^/\\\n])+/")
+PREPROCESSOR_LINE_PATTERN = re.compile(r"[^\n]*(?:\\\n[^\n]*)*")
+
 
 class ElementType(Enum):
     """Types of code elements that can be identified by parsers."""
@@ -93,6 +125,37 @@ class CodeElement:
         """Check if the element contains the given line number."""
         return self.start_line <= line_number <= self.end_line
 
+    def to_dict(self) -> Dict[str, Any]:
+        """
+        Serialize this element to a JSON-compatible dict.
+
+        Parent and children links are not included; callers that store whole
+        trees record the structure separately (see mcp_symbol_index).
+        """
+        return {
+            "type": self.element_type.value,
+            "name": self.name,
+            "start_line": self.start_line,
+            "end_line": self.end_line,
+            "code": self.code,
+            "metadata": self.metadata,
+        }
+
+    @classmethod
+    def from_dict(
+        cls, data: Dict[str, Any], parent: Optional["CodeElement"] = None
+    ) -> "CodeElement":
+        """Recreate an element from the output of to_dict()."""
+        return cls(
+            element_type=ElementType(data["type"]),
+            name=data["name"],
+            start_line=data["start_line"],
+            end_line=data["end_line"],
+            code=data["code"],
+            parent=parent,
+            metadata=data.get("metadata") or {},
+        )
+
 
 class BaseParser:
     """
@@ -138,6 +201,616 @@ class BaseParser:
         # Actual parsing is implemented by subclasses
         raise NotImplementedError("Subclasses must implement parse method")
 
+    def reparse(
+        self,
+        old_elements: List[CodeElement],
+        edit_range: Tuple[int, int, int],
+        new_code: str,
+    ) -> List[CodeElement]:
+        """
+        Re-parse code after an edit, reusing elements outside the damaged region.
+
+        Only the top-level elements touched by the edit are re-parsed, together
+        with the gap above them and the next top-level element (which may own
+        leading comments or decorators). Elements before that region are reused
+        as-is; elements after it are copied with shifted line numbers. Falls
+        back to a full parse() whenever the region cannot be parsed in isolation.
+
+        Args:
+            old_elements: Elements returned by parsing the code before the edit
+            edit_range: (start_line, old_end_line, new_end_line), 1-based and
+                inclusive: old lines start..old_end were replaced by new lines
+                start..new_end. Insertions have old_end = start - 1, deletions
+                have new_end = start - 1.
+            new_code: Complete source code after the edit
+
+        Returns:
+            A list of CodeElement objects for new_code
+        """
+        start_line, old_end_line, new_end_line = edit_range
+        if not old_elements or start_line < 1:
+            return self.parse(new_code)
+        delta = new_end_line - old_end_line
+        new_lines = new_code.splitlines(keepends=True)
+
+        def root_of(element: CodeElement) -> CodeElement:
+            while element.parent is not None:
+                element = element.parent
+            return element
+
+        roots_by_id = {id(root_of(e)): root_of(e) for e in old_elements}
+        roots = sorted(roots_by_id.values(), key=lambda e: (e.start_line, e.end_line))
+        if not self._is_well_nested(old_elements, root_of):
+            return self.parse(new_code)
+
+        # Damaged region in old line numbers. An element ending right above the
+        # edit is included, since appended lines may belong to its body.
+        region_start = start_line - 1
+        region_end = max(old_end_line, start_line)
+        damaged = set()
+
+        def absorb_overlapping() -> None:
+            nonlocal region_start, region_end
+            changed = True
+            while changed:
+                changed = False
+                for root in roots:
+                    if id(root) in damaged:
+                        continue
+                    if root.start_line <= region_end and root.end_line >= region_start:
+                        damaged.add(id(root))
+                        region_start = min(region_start, root.start_line)
+                        region_end = max(region_end, root.end_line)
+                        changed = True
+
+        absorb_overlapping()
+        following = next((r for r in roots if r.start_line > region_end), None)
+        if following is not None:
+            region_end = following.end_line
+            absorb_overlapping()
+        preceding = [r for r in roots if id(r) not in damaged and r.end_line < region_start]
+        region_start = max(r.end_line for r in preceding) + 1 if preceding else 1
+
+        # The region runs up to the next untouched element, or to the end of file
+        next_root = next((r for r in roots if r.start_line > region_end), None)
+        if next_root is not None:
+            region_end = next_root.start_line - 1
+            new_region_end = region_end + delta
+        else:
+            new_region_end = len(new_lines)
+        if new_region_end < region_start - 1 or new_region_end > len(new_lines):
+            return self.parse(new_code)
+
+        region_lines = new_lines[region_start - 1 : new_region_end]
+        # Parse the first line of the next element too, so the region's last
+        # element ends the same way it would in the full file
+        context_lines = new_lines[new_region_end : new_region_end + 1] if next_root else []
+        next_line = context_lines[0] if context_lines else ""
+        if not self._is_self_contained_region(region_lines, next_line):
+            return self.parse(new_code)
+
+        region_elements = []
+        if region_lines:
+            region_length = len(region_lines)
+            for element in self.parse("".join(region_lines + context_lines)):
+                if element.start_line > region_length:
+                    continue
+                if element.end_line > region_length:
+                    return self.parse(new_code)
+                region_elements.append(element)
+        if not self._is_well_nested(region_elements, root_of):
+            return self.parse(new_code)
+        offset = region_start - 1
+        for element in region_elements:
+            if element.parent is not None and element.parent not in region_elements:
+                element.parent = None
+            element.children = [c for c in element.children if c in region_elements]
+            element.start_line += offset
+            element.end_line += offset
+
+        kept = [e for e in old_elements if root_of(e).end_line < region_start]
+
+        # Copy elements after the region so the old tree is left untouched
+        copies: Dict[int, CodeElement] = {}
+        shifted = []
+        for element in old_elements:
+            if root_of(element).start_line > region_end:
+                copy = CodeElement(
+                    element.element_type,
+                    element.name,
+                    element.start_line + delta,
+                    element.end_line + delta,
+                    element.code,
+                    metadata=dict(element.metadata),
+                )
+                copies[id(element)] = copy
+                shifted.append(copy)
+        for element in old_elements:
+            copy = copies.get(id(element))
+            if copy is None:
+                continue
+            if element.parent is not None and id(element.parent) in copies:
+                copy.parent = copies[id(element.parent)]
+            copy.children = [copies[id(c)] for c in element.children if id(c) in copies]
+
+        self.elements = kept + region_elements + shifted
+        return self.elements
+
+    @staticmethod
+    def _is_well_nested(elements: List[CodeElement], root_of) -> bool:
+        """Check that every element lies within its top-level element's lines."""
+        for element in elements:
+            root = root_of(element)
+            if element.start_line < 1 or element.end_line < element.start_line:
+                return False
+            if not (root.start_line <= element.start_line and element.end_line <= root.end_line):
+                return False
+        return True
+
+    @staticmethod
+    def _is_self_contained_region(region_lines: List[str], next_line: str) -> bool:
+        """
+        Conservatively check that a block of lines can be parsed on its own.
+
+        The block must start and be followed by an unindented line, keep
+        brackets balanced and leave no block comment or multi-line string open.
+        False positives only cost a full parse, so the check is text-based and
+        ignores language details.
+        """
+        first = next((line for line in region_lines if line.strip()), "")
+        if first[:1] in (" ", "\t") or next_line[:1] in (" ", "\t"):
+            return False
+
+        text = "".join(region_lines)
+        depth = 0
+        for char in text:
+            if char in "([{":
+                depth += 1
+            elif char in ")]}":
+                depth -= 1
+                if depth < 0:
+                    return False
+        if depth != 0:
+            return False
+
+        if text.count("/*") != text.count("*/"):
+            return False
+        for delimiter in ('"""', "'''", "`"):
+            if text.count(delimiter) % 2:
+                return False
+        return True
+
+    def parse_outline(self, code: str) -> List[CodeElement]:
+        """
+        Parse only top-level and class-level declarations, skipping function bodies.
+
+        Function bodies are cut out before the normal parse, which then runs
+        over a skeleton a fraction of the file's size; line numbers and code
+        are mapped back so elements keep the ranges a full parse gives them.
+        Elements nested inside function bodies are omitted, as is metadata
+        taken from a body, such as docstrings. Falls back to a full parse()
+        for languages without an outline mode or when the bodies cannot be
+        delimited reliably.
+
+        Args:
+            code: Source code to parse
+
+        Returns:
+            A list of CodeElement objects
+        """
+        lines = self._split_into_lines(code)
+        skeleton = self._outline_skeleton(lines)
+        elements = None if skeleton is None else self._parse_skeleton(skeleton, lines)
+        if elements is None:
+            elements = [e for e in self.parse(code) if not self._in_function_body(e)]
+        return elements
+
+    def parse_symbol(self, code: str, name: str) -> List[CodeElement]:
+        """
+        Parse enough of the code to find every element called name.
+
+        Starts from parse_outline() and deep-parses only the functions whose
+        bodies mention name, so the result holds every element a full parse
+        would report under that name, with the same parent and line range.
+        Other elements may be missing. Falls back to a full parse() whenever
+        a body cannot be parsed in isolation.
+
+        Args:
+            code: Source code to parse
+            name: Name of the element being looked up
+
+        Returns:
+            A list of CodeElement objects
+        """
+        lines = self._split_into_lines(code)
+        skeleton = self._outline_skeleton(lines)
+        elements = None if skeleton is None else self._parse_skeleton(skeleton, lines)
+        if elements is None:
+            return self.parse(code)
+
+        mention = re.compile(r"(?<![\w$])" + re.escape(name) + r"(?![\w$])")
+        owners: Dict[int, CodeElement] = {}
+        for first, last in skeleton[2]:
+            if not any(mention.search(line) for line in lines[first - 1 : last]):
+                continue
+            enclosing = [e for e in elements if e.start_line <= first and e.end_line >= last - 1]
+            if not enclosing:
+                return self.parse(code)
+            owner = min(enclosing, key=lambda e: e.end_line - e.start_line)
+            owners[id(owner)] = owner
+
+        # Re-parsing most of the file piece by piece costs more than one full parse
+        ordered = sorted(owners.values(), key=lambda e: (e.start_line, -e.end_line))
+        outermost = [o for o in ordered if not any(self._is_inside(o, other) for other in ordered)]
+        if sum(o.end_line - o.start_line + 1 for o in outermost) * 2 > len(lines):
+            return self.parse(code)
+
+        # An owner that is not a function (a body the parser did not report on
+        # its own) is re-parsed whole, replacing the outline elements in it
+        for owner in outermost:
+            nested = self._parse_body_of(owner, lines)
+            if nested is None:
+                return self.parse(code)
+            elements = [e for e in elements if not self._is_inside(e, owner)]
+            position = elements.index(owner) + 1
+            elements[position:position] = nested
+        return elements
+
+    @staticmethod
+    def _is_inside(element: CodeElement, owner: CodeElement) -> bool:
+        """Whether element lies within owner's lines; parsers do not always set parents."""
+        return (
+            element is not owner
+            and owner.start_line <= element.start_line
+            and element.end_line <= owner.end_line
+        )
+
+    @staticmethod
+    def _in_function_body(element: CodeElement) -> bool:
+        parent = element.parent
+        while parent is not None:
+            if parent.element_type in (ElementType.FUNCTION, ElementType.METHOD):
+                return True
+            parent = parent.parent
+        return False
+
+    def _parse_skeleton(
+        self, skeleton: Tuple[List[str], List[Tuple[int, int]], List[Tuple[int, int]]], lines: List[str]
+    ) -> Optional[List[CodeElement]]:
+        """
+        Parse an outline skeleton and map its elements back onto the source.
+
+        Returns None if an element does not line up with the skeleton line it
+        claims to start on, which happens when preprocessing inserted lines
+        before the end.
+        """
+        skeleton_lines, spans, _ = skeleton
+        elements = self.parse(self._join_lines(skeleton_lines))
+        for element in elements:
+            if not 0 <= element.start_line <= min(element.end_line, len(spans)):
+                return None
+            # Preprocessing may also edit lines in place, so only a prefix is compared
+            first_line = next((l.strip() for l in element.code.split("\n") if l.strip()), "")
+            prefix = first_line[:OUTLINE_ALIGN_CHARS].split("(")[0]
+            if element.start_line and prefix not in self._join_lines(
+                skeleton_lines[max(0, element.start_line - 2) : element.start_line + 1]
+            ):
+                return None
+        # A start maps to the first source line its skeleton line stands for
+        # and an end to the line before the next skeleton line's source, which
+        # holds whether a parser counts lines from 1 or, like some, from 0
+        for element in elements:
+            self._restore_code(element, skeleton_lines, spans, lines)
+            if element.start_line:
+                element.start_line = spans[element.start_line - 1][0]
+            if element.end_line < len(spans):
+                element.end_line = spans[element.end_line][0] - 1
+            else:  # Preprocessing may have appended lines, as it does for the full file
+                element.end_line += len(lines) - len(spans)
+        return elements
+
+    def _parse_body_of(
+        self, owner: CodeElement, lines: List[str]
+    ) -> Optional[List[CodeElement]]:
+        """
+        Deep-parse one function skipped by the outline.
+
+        Returns the elements nested in it, with line numbers relative to the
+        whole file and the owner as their parent, or None if the function does
+        not parse to itself when taken on its own.
+        """
+        region = owner.code.split("\n")
+        indent = region[0][: self._count_indentation(region[0])]
+        if any(line.strip() and not line.startswith(indent) for line in region):
+            indent = ""  # Only indentation-based parsers need the dedent
+        parsed_lines = [line[len(indent) :] for line in region]
+        parsed = self.parse(self._join_lines(parsed_lines))
+        top = next((e for e in parsed if e.parent is None and e.name == owner.name), None)
+        if top is None:
+            return None
+        offset = owner.start_line - top.start_line
+        if top.end_line + offset != owner.end_line:
+            return None
+        nested = [e for e in parsed if e is not top]
+        if any(e.start_line < top.start_line or e.end_line > top.end_line for e in nested):
+            return None
+
+        spans = [(i, i) for i in range(1, len(region) + 1)]
+        for element in nested:
+            self._restore_code(element, parsed_lines, spans, region)
+            element.start_line += offset
+            element.end_line += offset
+            if element.parent is top:
+                element.parent = owner
+        owner.children = [e for e in nested if e.parent is owner]
+        for key, value in top.metadata.items():
+            owner.metadata.setdefault(key, value)
+        return nested
+
+    def _restore_code(
+        self,
+        element: CodeElement,
+        parsed_lines: List[str],
+        spans: List[Tuple[int, int]],
+        lines: List[str],
+    ) -> None:
+        """
+        Swap code taken from rewritten lines back to the original source text.
+
+        Parsers differ in how an element's code relates to its line range, so
+        the code is located among the parsed lines near the element's start
+        and the same span is cut from the original lines spans maps them to.
+        """
+        code_lines = element.code.split("\n")
+        count = min(len(code_lines), len(parsed_lines))
+        for first in (element.start_line - 1, element.start_line - 2, element.start_line):
+            if first < 0 or first + count > len(parsed_lines):
+                continue
+            column = self._join_lines(parsed_lines[first : first + count]).find(element.code)
+            if 0 <= column <= len(parsed_lines[first]):
+                last = parsed_lines[first + count - 1]
+                tail = max(0, len(last) - len(code_lines[-1]) - (column if count == 1 else 0))
+                break
+        else:
+            # Preprocessing rewrote the code; fall back to whole source lines,
+            # starting from the one its first line came from
+            head = code_lines[0].strip()
+            first = next(
+                (
+                    i
+                    for i in (element.start_line - 1, element.start_line - 2, element.start_line)
+                    if 0 <= i < len(parsed_lines) and head and head in parsed_lines[i]
+                ),
+                element.start_line - 1,
+            )
+            first = min(max(first, 0), len(parsed_lines) - 1)
+            count = min(count, len(parsed_lines) - first)
+            column = tail = 0
+        start, end = spans[first][0], spans[first + count - 1][1]
+        if parsed_lines[first : first + count] == lines[start - 1 : end]:
+            return
+        original = self._join_lines(lines[start - 1 : end])
+        element.code = original[column : len(original) - tail]
+
+    def _outline_language(self) -> str:
+        """Language whose syntax parse_outline() uses to find function bodies."""
+        return self.language
+
+    def _outline_skeleton(
+        self, lines: List[str]
+    ) -> Optional[Tuple[List[str], List[Tuple[int, int]], List[Tuple[int, int]]]]:
+        """
+        Copy of the source lines with function bodies cut out.
+
+        Returns the skeleton lines, the (first, last) 1-based source lines
+        each skeleton line stands for, and the source line ranges that were
+        cut; or None if the language has no outline mode or its bodies cannot
+        be delimited with confidence.
+        """
+        language = self._outline_language()
+        if language in OUTLINE_INDENT_LANGUAGES:
+            return self._outline_indented(lines)
+        if language in OUTLINE_BRACE_LANGUAGES:
+            try:
+                return self._outline_braced(lines)
+            except ValueError:
+                return None
+        return None
+
+    def _outline_indented(
+        self, lines: List[str]
+    ) -> Tuple[List[str], List[Tuple[int, int]], List[Tuple[int, int]]]:
+        """
+        Replace each def body with a single indented pass line.
+
+        A body ends at the first non-blank line indented no deeper than its
+        def, which is how the parsers find the end of a block, so the pass
+        line also stands for any blank lines before the next statement.
+        """
+        skeleton: List[str] = []
+        spans: List[Tuple[int, int]] = []
+        bodies = []
+        idx = 0
+        while idx < len(lines):
+            match = PYTHON_DEF_PATTERN.match(lines[idx])
+            if not match:
+                skeleton.append(lines[idx])
+                spans.append((idx + 1, idx + 1))
+                idx += 1
+                continue
+            def_indent = len(match.group(1))
+            header_end = idx
+            depth = 0
+            while header_end < len(lines) - 1:
+                for char in re.sub(r"#.*", "", lines[header_end]):
+                    if char in "([{":
+                        depth += 1
+                    elif char in ")]}":
+                        depth -= 1
+                if depth <= 0:
+                    break
+                header_end += 1
+            body_end = header_end + 1
+            while body_end < len(lines) and (
+                not lines[body_end].strip() or self._count_indentation(lines[body_end]) > def_indent
+            ):
+                body_end += 1
+            header = re.sub(r"#.*", "", lines[header_end]).rstrip()
+            first = next((i for i in range(header_end + 1, body_end) if lines[i].strip()), None)
+            for i in range(idx, header_end + 1):
+                skeleton.append(lines[i])
+                spans.append((i + 1, i + 1))
+            if header.endswith(":") and first is not None:
+                skeleton.append(lines[first][: self._count_indentation(lines[first])] + "pass")
+                spans.append((header_end + 2, body_end))
+                bodies.append((header_end + 2, body_end))
+                idx = body_end
+            else:
+                idx = header_end + 1
+        return skeleton, spans, bodies
+
+    def _outline_braced(
+        self, lines: List[str]
+    ) -> Tuple[List[str], List[Tuple[int, int]], List[Tuple[int, int]]]:
+        """
+        Cut out the lines inside brace blocks whose header looks like a
+        function, keeping the lines with the opening and closing braces.
+
+        Comments and literals are skipped so braces inside them do not count;
+        a body is only cut when a plain count of its braces agrees, and blocks
+        nested in open parentheses (callbacks) are left alone.
+
+        Raises:
+            ValueError: If a comment or literal is unterminated or the braces
+                do not balance
+        """
+        text = self._join_lines(lines)
+        newlines = [m.start() for m in re.finditer("\n", text)]
+        pieces = []
+        bodies = []
+        emitted = 0
+        header_start = 0
+        depth = 0
+        parens = 0
+        tokens = self._outline_tokens(text)
+        for position, char in tokens:
+            if char == "(":
+                parens += 1
+            elif char == ")":
+                parens -= 1
+            elif char == ";":
+                if parens == 0:
+                    header_start = position + 1
+            elif char == "}":
+                depth -= 1
+                if depth < 0:
+                    raise ValueError("unbalanced braces")
+                header_start = position + 1
+            elif char == "{":
+                header = text[max(header_start, position - OUTLINE_HEADER_CHARS) : position]
+                if parens == 0 and self._is_function_header(header):
+                    close = self._matching_brace(tokens)
+                    first = bisect_right(newlines, position) + 1
+                    last = bisect_right(newlines, close) + 1
+                    body = text[position + 1 : close]
+                    if last > first + 1 and body.count("{") == body.count("}"):
+                        pieces.append(text[emitted : position + 1])
+                        pieces.append("\n" + " " * (len(body) - body.rfind("\n") - 1))
+                        emitted = close
+                        bodies.append((first, last))
+                    header_start = close + 1
+                else:
+                    depth += 1
+                    header_start = position + 1
+        if depth or parens:
+            raise ValueError("unbalanced braces")
+        pieces.append(text[emitted:])
+
+        spans = []
+        line = 1
+        for first, last in bodies:
+            spans.extend((i, i) for i in range(line, first + 1))
+            line = last
+        spans.extend((i, i) for i in range(line, len(lines) + 1))
+        return self._split_into_lines("".join(pieces)), spans, bodies
+
+    @staticmethod
+    def _is_function_header(header: str) -> bool:
+        header = re.sub(r"//[^\n]*|/\*.*?\*/", "", header, flags=re.S).strip()
+        return (
+            FUNCTION_HEADER_PATTERN.search(header) is not None
+            and CONTAINER_HEADER_PATTERN.search(header) is None
+            and CONTROL_HEADER_PATTERN.search(header) is None
+        )
+
+    @staticmethod
+    def _matching_brace(tokens) -> int:
+        """Consume tokens up to the brace closing the one just read; return its position."""
+        depth = 1
+        for position, char in tokens:
+            if char == "{":
+                depth += 1
+            elif char == "}":
+                depth -= 1
+                if depth == 0:
+                    return position
+        raise ValueError("unclosed brace")
+
+    def _outline_tokens(self, text: str):
+        """
+        Yield (position, char) for each brace, parenthesis and semicolon
+        outside comments, string and character literals.
+        """
+        language = self._outline_language()
+        preprocessor = language in OUTLINE_PREPROCESSOR_LANGUAGES
+        regex_literals = language in OUTLINE_REGEX_LITERAL_LANGUAGES
+        rust = language == "rust"
+        significant = re.compile(
+            r"//|/\*|[\"'`{}();]" + (r"|^[ \t]*#" if preprocessor else "") + (r"|/" if regex_literals else ""),
+            re.M,
+        )
+        position = 0
+        while True:
+            match = significant.search(text, position)
+            if match is None:
+                return
+            token = match.group()
+            start = match.start()
+            if token == "//":
+                end = text.find("\n", start)
+                position = len(text) if end == -1 else end
+            elif token == "/*":
+                end = text.find("*/", start + 2)
+                if end == -1:
+                    raise ValueError("unterminated comment")
+                position = end + 2
+            elif token.endswith("#"):
+                position = PREPROCESSOR_LINE_PATTERN.match(text, match.end()).end()
+            elif token == "/":
+                before = start - 1
+                while before >= 0 and text[before] in " \t\n":
+                    before -= 1
+                literal = REGEX_LITERAL_PATTERN.match(text, start)
+                if literal and (
+                    before < 0
+                    or text[before] in "(,=:[!&|?{};+-*%<>~^"
+                    or text.endswith("return", 0, before + 1)
+                ):
+                    position = literal.end()
+                else:
+                    position = start + 1
+            elif token == "`" or (token == '"' and rust):
+                literal = MULTI_LINE_STRING_PATTERNS[token].match(text, start)
+                if literal is None:
+                    raise ValueError("unterminated string")
+                position = literal.end()
+            elif token in "'\"":
+                literal = (CHAR_LITERAL_PATTERN if rust else SINGLE_LINE_STRING_PATTERN).match(text, start)
+                position = literal.end() if literal else start + 1
+            else:
+                yield start, token
+                position = start + 1
+
     def find_function(self, code: str, name: str) -> Optional[CodeElement]:
         """
         Find a function by name in the code.
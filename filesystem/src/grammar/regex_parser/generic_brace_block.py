@@ -4,6 +4,7 @@ Suitable for C-like languages (C, C++, Java, C#), JavaScript, TypeScript, Rust,
 """
 
 import re
+import bisect
 from typing import List, Dict, Optional, Tuple, Any
 from .base import BaseParser, CodeElement, ElementType
 
@@ -64,6 +65,9 @@ class BraceBlockParser(BaseParser):
     # Pattern just to find an opening brace to start brace matching
     OPEN_BRACE_PATTERN = re.compile(r"\{")
 
+    # Characters that can change brace-matching state; everything else is skipped
+    BRACE_SCAN_PATTERN = re.compile(r"[\\/*\"'`{}]")
+
     def __init__(self):
         """Initialize the brace block parser."""
         super().__init__()
@@ -94,6 +98,7 @@ class BraceBlockParser(BaseParser):
         self.elements = []
         self.source_lines = self._split_into_lines(code)
         self.line_count = len(self.source_lines)
+        self._brace_table = None  # Built on first brace lookup
 
         # Process line by line
 
@@ -509,10 +514,9 @@ class BraceBlockParser(BaseParser):
             parent_element, start_line_idx, end_line_idx, children_elements
         )
 
-        # Add the children to the main elements list
-        for child in children_elements:
-            if child not in self.elements:
-                self.elements.append(child)
+        # Add the children to the main elements list. They were all created by
+        # this call, so none can be there yet.
+        self.elements.extend(children_elements)
 
     def _find_opening_brace_pos(
         self, start_line_idx: int, max_line_idx: int
@@ -540,9 +544,114 @@ class BraceBlockParser(BaseParser):
 
         return -1, -1
 
+    def _build_brace_table(self) -> Dict[Tuple[int, int], int]:
+        """
+        Pair every opening brace outside strings and comments with its closing line.
+
+        A single pass over source_lines using the same lexical rules as
+        _scan_matching_brace, so a lookup gives the line a scan from that brace
+        would find. Braces still open at end of file are left out.
+
+        Returns:
+            Dict mapping (line index, column index) of '{' to the line index of '}'
+        """
+        table: Dict[Tuple[int, int], int] = {}
+        open_braces: List[Tuple[int, int]] = []
+        in_string_double = False
+        in_string_single = False
+        in_template_literal = False
+        in_block_comment = False
+        escape_next = False
+
+        for line_idx, line in enumerate(self.source_lines):
+            i = 0
+            length = len(line)
+            if escape_next and length:
+                escape_next = False
+                i = 1
+            while True:
+                match = self.BRACE_SCAN_PATTERN.search(line, i)
+                if not match:
+                    break
+                i = match.start()
+                char = line[i]
+
+                if char == "\\":
+                    if i + 1 < length:
+                        i += 2  # Skip the escaped character
+                        continue
+                    escape_next = True  # Escapes the first character of the next line
+                    break
+
+                if (
+                    not in_string_double
+                    and not in_string_single
+                    and not in_template_literal
+                    and char == "/"
+                    and i + 1 < length
+                ):
+                    if line[i + 1] == "/":
+                        break  # Rest of the line is a comment
+                    elif line[i + 1] == "*":
+                        in_block_comment = True
+                        i += 2
+                        continue
+
+                if in_block_comment:
+                    if char == "*" and i + 1 < length and line[i + 1] == "/":
+                        in_block_comment = False
+                        i += 2
+                        continue
+                    i += 1
+                    continue
+
+                if char == '"' and not in_string_single and not in_template_literal:
+                    in_string_double = not in_string_double
+                elif char == "'" and not in_string_double and not in_template_literal:
+                    in_string_single = not in_string_single
+                elif char == "`" and not in_string_double and not in_string_single:
+                    in_template_literal = not in_template_literal
+
+                if not in_string_double and not in_string_single and not in_template_literal:
+                    if char == "{":
+                        open_braces.append((line_idx, i))
+                    elif char == "}" and open_braces:
+                        table[open_braces.pop()] = line_idx
+
+                i += 1
+
+        return table
+
     def _find_matching_brace(self, start_line_idx: int, start_col_idx: int) -> int:
         """
         Find the line index of the matching closing brace '}'.
+
+        Looks the brace up in the brace table, built once per parse. Braces the
+        table does not cover (inside a string or comment, unbalanced, or followed
+        by a block comment on the same line) fall back to a scan.
+
+        Args:
+            start_line_idx: Line index of the opening brace
+            start_col_idx: Column index of the opening brace
+
+        Returns:
+            Line index of the closing brace
+        """
+        if getattr(self, "_brace_table", None) is None:
+            self._brace_table = self._build_brace_table()
+        end_line_idx = self._brace_table.get((start_line_idx, start_col_idx))
+        # The scan treats a block comment starting on the brace's own line
+        # slightly differently, so only trust the table when there is none
+        if (
+            end_line_idx is not None
+            and "/*" not in self.source_lines[start_line_idx][start_col_idx + 1 :]
+        ):
+            return end_line_idx
+        return self._scan_matching_brace(start_line_idx, start_col_idx)
+
+    def _scan_matching_brace(self, start_line_idx: int, start_col_idx: int) -> int:
+        """
+        Find the line index of the matching closing brace '}' by scanning forward.
         Enhanced version with better context awareness and template literal handling.
 
         Args:
@@ -1012,52 +1121,77 @@ class BraceBlockParser(BaseParser):
                 )
 
     def _process_nested_elements(self):
-        """Process all elements to establish parent-child relationships."""
+        """
+        Process all elements to establish parent-child relationships.
+
+        An element without a parent goes to the enclosing element that starts
+        last, the widest of those if several start on that line. One walk in
+        start-line order finds it, keeping a stack of the widest element per
+        start line whose end lines strictly decrease toward the top.
+        """
         # For the specific case of deeply_nested_blocks test that has level2 function
         # Try to detect and fix this specific case first
         self._fix_deeply_nested_functions()
 
-        # Sort elements by their span size (larger spans first)
+        # Latest start first, then largest span; children are attached in this order
         sorted_elements = sorted(
             self.elements,
             key=lambda e: (e.start_line, e.end_line - e.start_line),
             reverse=True,
         )
+        by_start: Dict[int, List[CodeElement]] = {}
+        for element in sorted_elements:
+            by_start.setdefault(element.start_line, []).append(element)
 
         # Priority 1: Respect existing parent-child relationships established during parsing
-        # Only process elements that don't already have parents
-        orphan_elements = [e for e in sorted_elements if e.parent is None]
-        parented_elements = [e for e in sorted_elements if e.parent is not None]
-
-        # Process elements from outer to inner (largest to smallest)
-        for parent in sorted_elements:
-            # Find all elements that are contained within this one
-            for child in sorted_elements:
-                if child != parent and child.parent is None:
-                    # Check if child is contained within parent
-                    if (
-                        parent.start_line <= child.start_line
-                        and parent.end_line >= child.end_line
-                    ):
-                        # Set parent relationship
-                        child.parent = parent
-                        if child not in parent.children:
-                            parent.children.append(child)
-
-                # Adjust element type if needed
-                if (
-                    child.element_type == ElementType.FUNCTION
-                    and child.parent
-                    and child.parent.element_type
-                    in (
-                        ElementType.CLASS,
-                        ElementType.STRUCT,
-                        ElementType.INTERFACE,
-                        ElementType.IMPL,
-                        ElementType.TRAIT,
-                    )
-                ):
-                    child.element_type = ElementType.METHOD
+        # Only look for parents of elements that don't already have one
+        new_parents: Dict[int, CodeElement] = {}
+        enclosing: List[CodeElement] = []
+        neg_end_lines: List[int] = []  # -end_line of enclosing, ascending for bisect
+        for start_line in sorted(by_start):
+            group = by_start[start_line]
+            for child in group:
+                if child.parent is not None:
+                    continue
+                # Widest other element starting on the same line, if it reaches far enough
+                parent = next((e for e in group if e is not child), None)
+                if parent is None or parent.end_line < child.end_line:
+                    # Otherwise the closest earlier start line that reaches far enough
+                    pos = bisect.bisect_right(neg_end_lines, -child.end_line) - 1
+                    parent = enclosing[pos] if pos >= 0 else None
+                if parent is not None:
+                    new_parents[id(child)] = parent
+
+            # An earlier entry ending no later than this line's widest is never chosen again
+            widest = group[0]
+            while enclosing and enclosing[-1].end_line <= widest.end_line:
+                enclosing.pop()
+                neg_end_lines.pop()
+            enclosing.append(widest)
+            neg_end_lines.append(-widest.end_line)
+
+        for child in sorted_elements:
+            parent = new_parents.get(id(child))
+            if parent is not None and child.parent is None:
+                child.parent = parent
+                if child not in parent.children:
+                    parent.children.append(child)
+
+        # Adjust element types now that every parent is known
+        for element in sorted_elements:
+            if (
+                element.element_type == ElementType.FUNCTION
+                and element.parent
+                and element.parent.element_type
+                in (
+                    ElementType.CLASS,
+                    ElementType.STRUCT,
+                    ElementType.INTERFACE,
+                    ElementType.IMPL,
+                    ElementType.TRAIT,
+                )
+            ):
+                element.element_type = ElementType.METHOD
 
     def check_syntax_validity(self, code: str) -> bool:
         """
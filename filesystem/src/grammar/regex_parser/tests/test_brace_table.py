@@ -0,0 +1,194 @@
+"""
+Tests for the brace-pair table and nesting walk of BraceBlockParser.
+
+These tests verify that:
+- The brace table pairs nested, adjacent and multi-line blocks
+- Unbalanced braces are left to the scan, which infers an end at end of file
+- Braces in strings, template literals and comments are not paired
+- Table lookups agree with the linear scan they replaced
+- The bisect-based nesting walk picks the parents the pairwise loop picked
+"""
+
+import random
+import unittest
+from unittest import mock
+from src.grammar.regex_parser.generic_brace_block import BraceBlockParser
+from src.grammar.regex_parser.base import CodeElement, ElementType
+
+
+def open_braces(lines):
+    """(line index, column index) of every '{' in the source."""
+    return [(i, col) for i, line in enumerate(lines) for col, ch in enumerate(line) if ch == "{"]
+
+
+def linear_nesting(elements):
+    """The pairwise parent assignment _process_nested_elements used before the walk."""
+    sorted_elements = sorted(
+        elements,
+        key=lambda e: (e.start_line, e.end_line - e.start_line),
+        reverse=True,
+    )
+    for parent in sorted_elements:
+        for child in sorted_elements:
+            if child is not parent and child.parent is None:
+                if parent.start_line <= child.start_line and parent.end_line >= child.end_line:
+                    child.parent = parent
+                    parent.children.append(child)
+
+
+class TestBraceTable(unittest.TestCase):
+    """Test cases for _build_brace_table and _find_matching_brace."""
+
+    def _load(self, code):
+        parser = BraceBlockParser()
+        parser.source_lines = code.split("\n")
+        parser.line_count = len(parser.source_lines)
+        parser._brace_table = None
+        return parser
+
+    def assertAgreesWithScan(self, parser):
+        """Every brace the table trusts closes where the linear scan says it does."""
+        table = parser._build_brace_table()
+        for line_idx, col in table:
+            if "/*" in parser.source_lines[line_idx][col + 1 :]:
+                continue  # _find_matching_brace scans these itself
+            self.assertEqual(
+                table[(line_idx, col)],
+                parser._scan_matching_brace(line_idx, col),
+                f"brace at {line_idx}:{col} in {parser.source_lines!r}",
+            )
+        for line_idx, col in open_braces(parser.source_lines):
+            self.assertEqual(
+                parser._find_matching_brace(line_idx, col),
+                parser._scan_matching_brace(line_idx, col),
+            )
+        return table
+
+    def test_nested_blocks(self):
+        """Test inner blocks close before their enclosing block."""
+        parser = self._load("function a() {\n  if (x) {\n    while (y) {\n    }\n  }\n}")
+        table = self.assertAgreesWithScan(parser)
+        self.assertEqual(table, {(0, 13): 5, (1, 9): 4, (2, 14): 3})
+
+    def test_adjacent_blocks(self):
+        """Test blocks side by side on one line and on consecutive lines."""
+        parser = self._load("{}{ {} }\n} else {\n}\nfunction b() {\n}")
+        table = self.assertAgreesWithScan(parser)
+        self.assertEqual(table[(0, 0)], 0)
+        self.assertEqual(table[(0, 2)], 0)
+        self.assertEqual(table[(0, 4)], 0)
+        self.assertEqual(table[(1, 7)], 2)  # The stray '}' before it is ignored
+        self.assertEqual(table[(3, 13)], 4)
+
+    def test_unbalanced_blocks(self):
+        """Test braces left open fall back to the scan and its inferred end."""
+        parser = self._load("function a() {\n  if (x) {\n    y();\n}\n}\n}")
+        table = self.assertAgreesWithScan(parser)
+        self.assertEqual(table, {(0, 13): 4, (1, 9): 3})
+
+        parser = self._load("function a() {\n  if (x) {\n    y();\n}")
+        table = self.assertAgreesWithScan(parser)
+        self.assertEqual(table, {(1, 9): 3})
+        self.assertEqual(parser._find_matching_brace(0, 13), parser.line_count - 1)
+        self.assertEqual(parser._brace_diagnostics[-1]["opening_brace_line"], 1)
+
+    def test_braces_in_strings(self):
+        """Test braces inside string and template literals are skipped."""
+        code = (
+            "function a() {\n"
+            '  const s = "}{" + \'}\';\n'
+            "  const t = `${x} }`;\n"
+            '  const e = "\\"}";\n'
+            "}"
+        )
+        parser = self._load(code)
+        table = self.assertAgreesWithScan(parser)
+        self.assertEqual(table, {(0, 13): 4})
+
+    def test_braces_in_comments(self):
+        """Test braces inside line and block comments are skipped."""
+        code = (
+            "function a() { // }\n"
+            "  /* } {\n"
+            "     } */\n"
+            "  if (x) { /* } */ y(); }\n"
+            "}"
+        )
+        parser = self._load(code)
+        table = self.assertAgreesWithScan(parser)
+        self.assertEqual(table[(0, 13)], 4)
+        self.assertEqual(table[(3, 9)], 3)
+        self.assertEqual(parser._find_matching_brace(3, 9), 3)
+
+    def test_random_sources_agree_with_scan(self):
+        """Test random mixes of braces, literals and comments against the scan."""
+        pieces = ["{", "}", "{", "}", "x", " ", '"', "'", "`", "//", "/*", "*/", "\\", "\n", "\n"]
+        rng = random.Random(20)
+        for _ in range(300):
+            code = "".join(rng.choice(pieces) for _ in range(rng.randint(1, 60)))
+            self.assertAgreesWithScan(self._load(code))
+
+
+class TestNestingWalk(unittest.TestCase):
+    """Test cases for _process_nested_elements against the pairwise loop."""
+
+    def _walk(self, elements):
+        """Run the walk alone, without the fix-ups for specific sample files."""
+        parser = BraceBlockParser()
+        parser.elements = list(elements)
+        with mock.patch.object(parser, "_fix_deeply_nested_functions"):
+            parser._process_nested_elements()
+
+    def _elements(self, spans):
+        return [
+            CodeElement(ElementType.CLASS if i % 3 == 0 else ElementType.FUNCTION, f"e{i}", s, e, "")
+            for i, (s, e) in enumerate(spans)
+        ]
+
+    def _parents(self, spans):
+        """Parent name per element from the walk and from the reference loop."""
+        walked = self._elements(spans)
+        self._walk(walked)
+        reference = self._elements(spans)
+        linear_nesting(reference)
+
+        def names(elements):
+            return [e.parent.name if e.parent else None for e in elements]
+
+        return names(walked), names(reference)
+
+    def test_nested_and_adjacent(self):
+        """Test nested, sibling and same-start elements."""
+        spans = [(1, 20), (2, 5), (6, 10), (7, 8), (6, 9), (12, 20), (21, 22)]
+        walked, reference = self._parents(spans)
+        self.assertEqual(walked, reference)
+        # e3 goes to the wider of the two blocks starting on line 6
+        self.assertEqual(walked, [None, "e0", "e0", "e2", "e2", "e0", None])
+
+    def test_overlapping_spans(self):
+        """Test spans that overlap without nesting, as unbalanced code yields."""
+        spans = [(1, 10), (5, 15), (6, 12), (11, 15)]
+        walked, reference = self._parents(spans)
+        self.assertEqual(walked, reference)
+
+    def test_methods_typed_by_parent(self):
+        """Test functions directly inside a class become methods."""
+        elements = self._elements([(1, 10), (2, 4), (5, 9)])
+        self._walk(elements)
+        self.assertEqual(elements[1].element_type, ElementType.METHOD)
+        self.assertEqual(elements[2].element_type, ElementType.METHOD)
+
+    def test_random_spans(self):
+        """Test random span sets against the pairwise loop."""
+        rng = random.Random(20)
+        for _ in range(300):
+            spans = []
+            for _ in range(rng.randint(1, 12)):
+                start = rng.randint(1, 30)
+                spans.append((start, start + rng.randint(0, 15)))
+            walked, reference = self._parents(spans)
+            self.assertEqual(walked, reference, spans)
+
+
+if __name__ == "__main__":
+    unittest.main()
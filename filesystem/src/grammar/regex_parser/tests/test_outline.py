@@ -0,0 +1,163 @@
+"""
+Tests for outline-first parsing and targeted symbol lookup.
+"""
+
+import unittest
+from src.grammar.regex_parser import PythonParser, JavaScriptParser, CCppParser
+from src.grammar.regex_parser.base import ElementType
+
+
+def signature(elements):
+    """Comparable description of a parse result, ignoring re-indented code."""
+    return sorted(
+        (
+            e.element_type.value,
+            e.name,
+            e.start_line,
+            e.end_line,
+            e.parent.name if e.parent else "",
+            [line.strip() for line in e.code.strip().split("\n")],
+        )
+        for e in elements
+    )
+
+
+def outside_functions(elements):
+    """Elements of a full parse that parse_outline() should also report."""
+    result = []
+    for e in elements:
+        parent = e.parent
+        while parent is not None and parent.element_type not in (
+            ElementType.FUNCTION,
+            ElementType.METHOD,
+        ):
+            parent = parent.parent
+        if parent is None:
+            result.append(e)
+    return result
+
+
+PYTHON_CODE = '''class Store:
+    """A keyed store."""
+
+    def get(self, key):
+        def lookup(k):
+            return self.items[k]
+        return lookup(key)
+
+    def put(self, key, value):
+        self.items[key] = value
+
+
+def main(argv, env=None):
+    store = Store()
+    return store.get(argv[0])
+'''
+
+JS_CODE = """function get(items, key) {
+  const lookup = function(k) { return items[k]; };
+  return lookup(key);
+}
+
+function main(argv) {
+  const text = "{ not a brace";
+  const close = '}';
+  return get(argv, text + close);
+}
+"""
+
+C_CODE = """#include <stdio.h>
+
+struct point {
+    int x;
+    int y;
+};
+
+static int area(struct point *p)
+{
+    char brace = '{';
+#define OPEN {
+    return p->x * p->y;
+}
+
+int main(void)
+{
+    struct point p = {1, 2};
+    return area(&p);
+}
+"""
+
+
+class TestOutline(unittest.TestCase):
+    """Test cases for BaseParser.parse_outline and parse_symbol."""
+
+    def _assert_outline(self, parser_class, code):
+        parser = parser_class()
+        parsed_sizes = []
+        original_parse = parser.parse
+
+        def counting_parse(text):
+            parsed_sizes.append(len(text))
+            return original_parse(text)
+
+        parser.parse = counting_parse
+        outline = parser.parse_outline(code)
+        full = parser_class().parse(code)
+
+        self.assertEqual(signature(outline), signature(outside_functions(full)))
+        return outline, parsed_sizes
+
+    def test_python_outline_skips_bodies(self):
+        """Test the outline parses the Python code with function bodies cut out."""
+        outline, sizes = self._assert_outline(PythonParser, PYTHON_CODE)
+        self.assertEqual(len(sizes), 1)
+        self.assertLess(sizes[0], len(PYTHON_CODE))
+        self.assertNotIn("lookup", [e.name for e in outline])
+
+        # Code and line ranges refer to the original source
+        main = next(e for e in outline if e.name == "main")
+        self.assertEqual((main.start_line, main.end_line), (13, 15))
+        self.assertIn("return store.get(argv[0])", main.code)
+
+    def test_brace_outline_ignores_braces_in_literals(self):
+        """Test braces in strings, chars and macros do not break the cut."""
+        self._assert_outline(JavaScriptParser, JS_CODE)
+        parser = JavaScriptParser()
+        bodies = parser._outline_skeleton(parser._split_into_lines(JS_CODE))[2]
+        self.assertEqual(bodies, [(1, 4), (6, 10)])
+
+        # A body whose literal braces do not balance on their own is kept,
+        # and the scan still finds the body after it
+        parser = CCppParser()
+        skeleton, spans, bodies = parser._outline_skeleton(parser._split_into_lines(C_CODE))
+        self.assertEqual(bodies, [(16, 19)])
+        self.assertIn("#define OPEN {", skeleton)
+        self.assertEqual(spans[-1], (19, 19))
+
+    def test_symbol_lookup_finds_nested_elements(self):
+        """Test parse_symbol reports a nested function like a full parse."""
+        full = PythonParser().parse(PYTHON_CODE)
+        found = PythonParser().parse_symbol(PYTHON_CODE, "lookup")
+        self.assertEqual(
+            signature(e for e in found if e.name == "lookup"),
+            signature(e for e in full if e.name == "lookup"),
+        )
+        lookup = next(e for e in found if e.name == "lookup")
+        self.assertEqual(lookup.parent.name, "get")
+
+        # Bodies that do not mention the name stay unparsed
+        self.assertNotIn("put", [e.name for e in found if e.children])
+
+    def test_unbalanced_code_falls_back(self):
+        """Test code whose bodies cannot be delimited gets a full parse."""
+        code = JS_CODE + "function broken(a) {\n  if (a) {\n"
+        parser = JavaScriptParser()
+        self.assertIsNone(parser._outline_skeleton(parser._split_into_lines(code)))
+        self.assertEqual(
+            signature(parser.parse_outline(code)),
+            signature(outside_functions(JavaScriptParser().parse(code))),
+        )
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,102 @@
+"""
+Tests for incremental re-parsing after an edit.
+"""
+
+import unittest
+from src.grammar.regex_parser import PythonParser, JavaScriptParser
+from src.grammar.regex_parser.base import ElementType
+
+
+def signature(elements):
+    """Comparable description of a parse result."""
+    return sorted(
+        (
+            e.element_type.value,
+            e.name,
+            e.start_line,
+            e.end_line,
+            e.parent.name if e.parent else "",
+        )
+        for e in elements
+    )
+
+
+PYTHON_CODE = "".join(
+    f"def func_{i}(a, b):\n    x = a + b\n    return x * {i}\n\n\n" for i in range(40)
+)
+
+JS_CODE = "".join(
+    f"function func_{i}(a) {{\n  return a + {i};\n}}\n\n" for i in range(40)
+)
+
+
+class TestReparse(unittest.TestCase):
+    """Test cases for BaseParser.reparse."""
+
+    def _edit(self, code, start_line, old_end_line, new_lines):
+        lines = code.splitlines(keepends=True)
+        lines[start_line - 1 : old_end_line] = new_lines
+        new_end_line = start_line + len(new_lines) - 1
+        return "".join(lines), (start_line, old_end_line, new_end_line)
+
+    def _assert_matches_full_parse(self, parser_class, code, start, end, new_lines):
+        old_elements = parser_class().parse(code)
+        new_code, edit_range = self._edit(code, start, end, new_lines)
+
+        parser = parser_class()
+        parsed_sizes = []
+        original_parse = parser.parse
+
+        def counting_parse(text):
+            parsed_sizes.append(len(text))
+            return original_parse(text)
+
+        parser.parse = counting_parse
+        result = parser.reparse(old_elements, edit_range, new_code)
+
+        self.assertEqual(signature(result), signature(parser_class().parse(new_code)))
+        return old_elements, result, parsed_sizes, new_code
+
+    def test_edit_inside_function_reparses_region_only(self):
+        """Test an edit in one function only re-parses the nearby code."""
+        old, result, sizes, new_code = self._assert_matches_full_parse(
+            PythonParser, PYTHON_CODE, 103, 103, ["    return x * 7\n", "    y = 3\n"]
+        )
+        self.assertEqual(len(sizes), 1)
+        self.assertLess(sizes[0], len(new_code) // 4)
+
+        # Elements before the edit are reused, the old tree is left intact
+        self.assertIs(result[0], old[0])
+        func_30 = next(e for e in old if e.name == "func_30")
+        self.assertEqual(func_30.start_line, 151)
+
+    def test_insert_and_delete_lines(self):
+        """Test insertions and deletions shift the following elements."""
+        self._assert_matches_full_parse(
+            PythonParser, PYTHON_CODE, 51, 50, ["def inserted():\n", "    pass\n", "\n"]
+        )
+        self._assert_matches_full_parse(PythonParser, PYTHON_CODE, 56, 60, [])
+
+    def test_brace_language(self):
+        """Test re-parsing a brace-delimited language."""
+        self._assert_matches_full_parse(
+            JavaScriptParser, JS_CODE, 42, 42, ["  const b = a * 2;\n", "  return b;\n"]
+        )
+
+    def test_unbalanced_region_falls_back(self):
+        """Test an edit that leaves a brace open re-parses the whole file."""
+        old, result, sizes, new_code = self._assert_matches_full_parse(
+            JavaScriptParser, JS_CODE, 42, 42, ["  if (a) {\n"]
+        )
+        self.assertEqual(sizes[-1], len(new_code))
+
+    def test_no_previous_elements(self):
+        """Test re-parsing without a previous tree is a full parse."""
+        result = PythonParser().reparse([], (1, 1, 1), PYTHON_CODE)
+        self.assertEqual(
+            len([e for e in result if e.element_type == ElementType.FUNCTION]), 40
+        )
+
+
+if __name__ == "__main__":
+    unittest.main()
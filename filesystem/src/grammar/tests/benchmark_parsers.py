@@ -0,0 +1,290 @@
+"""
+Throughput benchmark for the regex_parser and token_parser stacks.
+
+Builds inputs of roughly 1k to 100k lines per language by concatenating the
+samples under tests/test_data and tests/validation_data, parses them with
+both parser stacks and reports lines/sec, peak traced memory and the number
+of memory blocks the parse result keeps alive. Results can be written as JSON
+and compared against an earlier run to catch throughput regressions.
+
+Usage (from src/grammar):
+    python -m tests.benchmark_parsers --sizes 1000,10000 --json bench.json
+    python -m tests.benchmark_parsers --baseline bench.json --max-regression 0.25
+"""
+
+import os
+import gc
+import sys
+import json
+import time
+import argparse
+import platform
+import tracemalloc
+from typing import Any, Callable, Dict, List, Optional, Tuple
+
+# Add the grammar directory to the Python path
+sys.path.insert(0, os.path.abspath(os.path.join(os.path.dirname(__file__), "..")))
+
+from regex_parser import (
+    PythonParser,
+    CCppParser,
+    JavaScriptParser,
+    TypeScriptParser,
+    RustParser,
+)
+from token_parser.parser_factory import ParserFactory
+
+TESTS_DIR = os.path.dirname(os.path.abspath(__file__))
+SAMPLE_DIRS = ("test_data", "validation_data")
+DEFAULT_SIZES = (1000, 10000, 100000)
+STACKS = ("regex", "token")
+
+# Language -> (sample directory, sample extension, regex parser class, token parser language)
+LANGUAGES: Dict[str, Tuple[str, str, type, str]] = {
+    "python": ("py", ".py", PythonParser, "python"),
+    "javascript": ("js", ".js", JavaScriptParser, "javascript"),
+    "typescript": ("ts", ".ts", TypeScriptParser, "typescript"),
+    "c": ("c", ".c", CCppParser, "c"),
+    "cpp": ("cpp", ".cpp", CCppParser, "cpp"),
+    "rust": ("rs", ".rs", RustParser, "rust"),
+}
+
+
+def load_samples(language: str) -> List[str]:
+    """Source of every sample file for a language, in a stable order."""
+    directory, extension, _, _ = LANGUAGES[language]
+    samples = []
+    for base in SAMPLE_DIRS:
+        sample_dir = os.path.join(TESTS_DIR, base, directory)
+        if not os.path.isdir(sample_dir):
+            continue
+        for name in sorted(os.listdir(sample_dir)):
+            if name.endswith(extension):
+                with open(os.path.join(sample_dir, name), "r", encoding="utf-8") as f:
+                    code = f.read()
+                samples.append(code if code.endswith("\n") else code + "\n")
+    return samples
+
+
+def scaled_input(samples: List[str], target_lines: int) -> str:
+    """Whole samples concatenated until the result has at least target_lines lines."""
+    parts: List[str] = []
+    lines = 0
+    while lines < target_lines:
+        for code in samples:
+            parts.append(code)
+            lines += code.count("\n")
+            if lines >= target_lines:
+                break
+    return "".join(parts)
+
+
+def make_parser(stack: str, language: str) -> Callable[[], Any]:
+    """Factory for a fresh parser of the given stack, so setup is not timed."""
+    _, _, regex_class, token_language = LANGUAGES[language]
+    if stack == "regex":
+        return regex_class
+    return lambda: ParserFactory.create_parser(token_language)
+
+
+def bench_case(
+    stack: str, language: str, code: str, repeat: int, measure_memory: bool
+) -> Dict[str, Any]:
+    """Parse code with one stack: best-of-repeat wall time, then one traced run."""
+    new_parser = make_parser(stack, language)
+    best = float("inf")
+    elements = []
+    for _ in range(repeat):
+        parser = new_parser()
+        gc.collect()
+        start = time.perf_counter()
+        elements = parser.parse(code)
+        best = min(best, time.perf_counter() - start)
+        del parser
+
+    lines = code.count("\n")
+    result = {
+        "stack": stack,
+        "language": language,
+        "lines": lines,
+        "bytes": len(code.encode("utf-8")),
+        "seconds": round(best, 6),
+        "lines_per_sec": round(lines / best, 1) if best > 0 else None,
+        "elements": len(elements),
+        "peak_kib": None,
+        "retained_blocks": None,
+    }
+    del elements
+
+    if measure_memory:
+        gc.collect()
+        blocks_before = sys.getallocatedblocks()
+        parser = new_parser()
+        tracemalloc.start()
+        try:
+            elements = parser.parse(code)
+            _, peak = tracemalloc.get_traced_memory()
+        finally:
+            tracemalloc.stop()
+        del parser
+        gc.collect()
+        result["peak_kib"] = round(peak / 1024, 1)
+        result["retained_blocks"] = sys.getallocatedblocks() - blocks_before
+        del elements
+    return result
+
+
+def run_benchmarks(
+    languages: List[str],
+    stacks: List[str],
+    sizes: List[int],
+    repeat: int,
+    measure_memory: bool,
+    time_limit: float,
+) -> List[Dict[str, Any]]:
+    """
+    Run every (stack, language, size) case, smallest size first.
+
+    A larger size is recorded as skipped instead of run when the previous
+    one, scaled linearly to it, would take longer than time_limit seconds.
+    Parsers that scale worse than linearly would take longer still.
+    """
+    results = []
+    for language in languages:
+        samples = load_samples(language)
+        if not samples:
+            print(f"No samples for {language}, skipping", file=sys.stderr)
+            continue
+        for stack in stacks:
+            projected = 0.0  # Seconds per line of the previous case
+            for target in sorted(sizes):
+                if projected * target > time_limit:
+                    results.append(
+                        {"stack": stack, "language": language, "target_lines": target, "skipped": True}
+                    )
+                    continue
+                code = scaled_input(samples, target)
+                try:
+                    result = bench_case(stack, language, code, repeat, measure_memory)
+                except Exception as e:  # A parser bug should not stop the whole run
+                    result = {"stack": stack, "language": language, "error": str(e)}
+                result["target_lines"] = target
+                results.append(result)
+                print(format_result(result), file=sys.stderr)
+                projected = float("inf") if "error" in result else result["seconds"] / result["lines"]
+    return results
+
+
+def format_result(result: Dict[str, Any]) -> str:
+    prefix = f"{result['stack']:<6} {result['language']:<11} {result['target_lines']:>7}"
+    if result.get("skipped"):
+        return f"{prefix}  skipped (projected to exceed the time limit)"
+    if "error" in result:
+        return f"{prefix}  error: {result['error']}"
+    memory = (
+        f"  {result['peak_kib']:>10.1f} KiB peak  {result['retained_blocks']:>8} blocks"
+        if result["peak_kib"] is not None
+        else ""
+    )
+    return (
+        f"{prefix}  {result['lines']:>7} lines  {result['seconds']:>9.4f} s"
+        f"  {result['lines_per_sec']:>11.1f} lines/s{memory}"
+    )
+
+
+def faster_stacks(results: List[Dict[str, Any]]) -> Dict[str, str]:
+    """Per language, the stack with the higher lines/sec at the largest size both completed."""
+    by_case = {
+        (r["language"], r["target_lines"], r["stack"]): r["lines_per_sec"]
+        for r in results
+        if r.get("lines_per_sec")
+    }
+    choice = {}
+    for language in sorted({r["language"] for r in results}):
+        for target in sorted({r["target_lines"] for r in results}, reverse=True):
+            rates = {s: by_case.get((language, target, s)) for s in STACKS}
+            if all(rates.values()):
+                choice[language] = max(rates, key=rates.get)
+                break
+    return choice
+
+
+def find_regressions(
+    results: List[Dict[str, Any]], baseline: List[Dict[str, Any]], max_regression: float
+) -> List[str]:
+    """Cases whose lines/sec fell by more than max_regression relative to the baseline."""
+    previous = {
+        (r["stack"], r["language"], r["target_lines"]): r["lines_per_sec"]
+        for r in baseline
+        if r.get("lines_per_sec")
+    }
+    regressions = []
+    for r in results:
+        before = previous.get((r["stack"], r["language"], r.get("target_lines")))
+        if not before:
+            continue
+        if "error" in r:
+            regressions.append(f"{r['stack']} {r['language']} {r['target_lines']}: now fails ({r['error']})")
+        elif r.get("lines_per_sec") and r["lines_per_sec"] < before * (1 - max_regression):
+            regressions.append(
+                f"{r['stack']} {r['language']} {r['target_lines']}: "
+                f"{r['lines_per_sec']:.1f} lines/s, was {before:.1f} ({r['lines_per_sec'] / before - 1:+.0%})"
+            )
+    return regressions
+
+
+def main(argv: Optional[List[str]] = None) -> int:
+    parser = argparse.ArgumentParser(description="Benchmark the regex_parser and token_parser stacks.")
+    parser.add_argument("--languages", default=",".join(LANGUAGES), help="Comma-separated languages")
+    parser.add_argument("--stacks", default=",".join(STACKS), help="Comma-separated stacks: regex, token")
+    parser.add_argument(
+        "--sizes", default=",".join(map(str, DEFAULT_SIZES)), help="Comma-separated target line counts"
+    )
+    parser.add_argument("--repeat", type=int, default=3, help="Timed runs per case; the best is reported")
+    parser.add_argument("--no-memory", action="store_true", help="Skip the tracemalloc run")
+    parser.add_argument(
+        "--time-limit", type=float, default=30.0, help="Skip larger sizes once a case takes this many seconds"
+    )
+    parser.add_argument("--json", help="Write results to this file")
+    parser.add_argument("--baseline", help="Compare lines/sec against results from an earlier --json run")
+    parser.add_argument(
+        "--max-regression", type=float, default=0.25, help="Allowed fractional lines/sec drop versus the baseline"
+    )
+    args = parser.parse_args(argv)
+
+    languages = [l for l in args.languages.split(",") if l]
+    stacks = [s for s in args.stacks.split(",") if s]
+    unknown = [l for l in languages if l not in LANGUAGES] + [s for s in stacks if s not in STACKS]
+    if unknown:
+        parser.error(f"Unknown language or stack: {', '.join(unknown)}")
+    sizes = [int(s) for s in args.sizes.split(",") if s]
+
+    results = run_benchmarks(languages, stacks, sizes, args.repeat, not args.no_memory, args.time_limit)
+    report = {
+        "python": platform.python_version(),
+        "platform": platform.platform(),
+        "results": results,
+        "faster_stack": faster_stacks(results),
+    }
+    for language, stack in report["faster_stack"].items():
+        print(f"Faster stack for {language}: {stack}", file=sys.stderr)
+    if args.json:
+        with open(args.json, "w", encoding="utf-8") as f:
+            json.dump(report, f, indent=2)
+    else:
+        json.dump(report, sys.stdout, indent=2)
+        print()
+
+    if args.baseline:
+        with open(args.baseline, "r", encoding="utf-8") as f:
+            baseline = json.load(f)["results"]
+        regressions = find_regressions(results, baseline, args.max_regression)
+        for line in regressions:
+            print(f"REGRESSION {line}", file=sys.stderr)
+        if regressions:
+            return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,77 @@
+"""
+Integration tests for parser pooling and timing in ParserFactory.
+
+This module verifies that pooled parsers give the same results as fresh ones,
+that one instance is reused rather than rebuilt, and that setup and parse
+timings are reported per language.
+"""
+
+import threading
+import unittest
+
+from token_parser.parser_factory import ParserFactory
+
+PYTHON_SAMPLES = [
+    "class A:\n    def f(self):\n        return 1\n",
+    "def g(x):\n    return x\n\n\ndef h():\n    pass\n",
+]
+
+
+def element_summary(elements):
+    return [(e.element_type, e.name, e.start_line, e.end_line) for e in elements]
+
+
+class TestParserFactoryPool(unittest.TestCase):
+    """Test class for ParserFactory pooling."""
+
+    def setUp(self):
+        ParserFactory.reset_timing_stats()
+
+    def test_pooled_parse_matches_fresh_parser(self):
+        """Test results do not depend on what the pooled parser parsed before."""
+        for code in PYTHON_SAMPLES * 2:
+            fresh = ParserFactory.create_parser("python").parse(code)
+            self.assertEqual(element_summary(ParserFactory.parse("python", code)), element_summary(fresh))
+
+    def test_instance_is_reused(self):
+        """Test a released parser is handed out again instead of building a new one."""
+        with ParserFactory.acquire_parser("python") as first:
+            pass
+        ParserFactory.reset_timing_stats()
+        with ParserFactory.acquire_parser("py") as second:
+            self.assertIs(second, first)
+        self.assertNotIn("python", ParserFactory.get_timing_stats())
+
+        with ParserFactory.acquire_parser("cobol") as parser:
+            self.assertIsNone(parser)
+        self.assertIsNone(ParserFactory.parse("cobol", "x"))
+
+    def test_concurrent_borrowers_get_distinct_parsers(self):
+        """Test two threads never share a parser."""
+        held = []
+        barrier = threading.Barrier(2)
+
+        def borrow():
+            with ParserFactory.acquire_parser("javascript") as parser:
+                held.append(parser)
+                barrier.wait(timeout=5)
+
+        threads = [threading.Thread(target=borrow) for _ in range(2)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        self.assertIsNot(held[0], held[1])
+
+    def test_timing_stats(self):
+        """Test setup and parse counts and times are accumulated."""
+        ParserFactory.create_parser("rust")
+        ParserFactory.parse("rust", "fn main() {}\n")
+        stats = ParserFactory.get_timing_stats()["rust"]
+        self.assertGreaterEqual(stats["setups"], 1)
+        self.assertEqual(stats["parses"], 1)
+        self.assertGreater(stats["parse_seconds"], 0.0)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,124 @@
+"""
+Integration tests for the tokenizer matching engines.
+
+This module verifies that the combined-regex engine used by default produces
+exactly the same token stream as the sequential rule-by-rule engine.
+"""
+
+import os
+import re
+import unittest
+
+from token_parser.parser_factory import ParserFactory
+from token_parser.tokenizer import Tokenizer, TokenRule, compile_combined_rules
+from token_parser.token import EMPTY_METADATA, TokenType
+
+
+# Language name in ParserFactory -> directory under tests/test_data
+LANGUAGE_DATA_DIRS = {
+    "python": "py",
+    "javascript": "js",
+    "typescript": "ts",
+    "c": "c",
+    "cpp": "cpp",
+    "rust": "rs",
+    "html": "html",
+    "css": "css",
+}
+
+# Tokenized by every language in addition to its data files, which may be empty
+MIXED_SAMPLE = """<div class="a">/* x */ {{ 1.5e3 }}</div>
+.a { color: red; } // done
+def f(x):
+    return 'y'
+"""
+
+
+class TestTokenizerEngines(unittest.TestCase):
+    """Test class for tokenizer engines."""
+
+    def _token_tuples(self, tokenizer: Tokenizer, code: str, combined: bool):
+        tokenizer.use_combined_regex = combined
+        return [
+            (t.token_type, t.value, t.position, t.line, t.column, t.metadata)
+            for t in tokenizer.tokenize(code)
+        ]
+
+    def test_combined_matches_sequential(self):
+        """Test both engines agree on every test data file."""
+        for language, data_dir in LANGUAGE_DATA_DIRS.items():
+            tokenizer = ParserFactory.create_parser(language).tokenizer
+            test_data_dir = os.path.join("tests", "test_data", data_dir)
+            samples = [("<mixed sample>", MIXED_SAMPLE)]
+            for filename in sorted(os.listdir(test_data_dir)):
+                if filename.endswith(".expected.json"):
+                    continue
+                with open(os.path.join(test_data_dir, filename), "r") as f:
+                    samples.append((filename, f.read()))
+            for filename, code in samples:
+                with self.subTest(language=language, file=filename):
+                    self.assertEqual(
+                        self._token_tuples(tokenizer, code, combined=True),
+                        self._token_tuples(tokenizer, code, combined=False),
+                    )
+            self.assertIsNotNone(
+                tokenizer._combined_pattern,
+                f"{type(tokenizer).__name__} rules should compile into one regex",
+            )
+
+    def test_line_and_column_after_multiline_token(self):
+        """Test positions are tracked correctly across tokens spanning lines."""
+        tokenizer = ParserFactory.create_parser("c").tokenizer
+        code = "/* a\n   b */ int x;\n  y"
+        tokens = tokenizer.tokenize(code)
+        by_value = {t.value: t for t in tokens}
+
+        self.assertEqual((by_value["int"].line, by_value["int"].column), (2, 9))
+        self.assertEqual((by_value["y"].line, by_value["y"].column), (3, 3))
+
+    def test_transform_receives_rule_groups(self):
+        """Test transforms see the groups of their own pattern."""
+        tokenizer = Tokenizer()
+        tokenizer.add_rule(TokenRule(r"(\w)(\w*)", TokenType.IDENTIFIER))
+        tokenizer.add_rule(
+            TokenRule(
+                r"#(\w+)",
+                TokenType.COMMENT,
+                transform=lambda m: {"tag": m.group(1)},
+            )
+        )
+        tokens = tokenizer.tokenize("ab#tag")
+
+        self.assertEqual(tokens[1].metadata, {"tag": "tag"})
+
+    def test_tokens_are_compact(self):
+        """Test tokens have no __dict__, share empty metadata and intern short values."""
+        tokenizer = ParserFactory.create_parser("python").tokenizer
+        tokens = tokenizer.tokenize("value = other(value)\nvalue += 1\n")
+        values = [t for t in tokens if t.value == "value"]
+
+        self.assertFalse(hasattr(tokens[0], "__dict__"))
+        self.assertIs(values[0].metadata, EMPTY_METADATA)
+        self.assertEqual(len(values), 3)
+        self.assertIs(values[0].value, values[2].value)
+
+    def test_backreference_falls_back_to_sequential(self):
+        """Test rules that cannot be combined still tokenize correctly."""
+        rules = [
+            TokenRule(r"(['\"]).*?\1", TokenType.STRING),
+            TokenRule(r"\w+", TokenType.IDENTIFIER),
+            TokenRule(r"\s+", TokenType.WHITESPACE, re.MULTILINE),
+        ]
+        self.assertIsNone(compile_combined_rules(rules))
+
+        tokenizer = Tokenizer()
+        for rule in rules:
+            tokenizer.add_rule(rule)
+        tokens = tokenizer.tokenize("x 'a\"b'")
+
+        self.assertEqual(tokens[-1].token_type, TokenType.STRING)
+        self.assertEqual(tokens[-1].value, "'a\"b'")
+
+
+if __name__ == "__main__":
+    unittest.main()
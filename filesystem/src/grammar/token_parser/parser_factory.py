@@ -4,8 +4,12 @@ Parser factory for the grammar parser system.
 This module provides a factory class for creating language-specific parsers.
 """
 
-from typing import Dict, Type, Optional
+import threading
+import time
+from contextlib import contextmanager
+from typing import Dict, Iterator, List, Type, Optional
 
+from .base import CodeElement
 from .token_parser import TokenParser
 from .python_parser import PythonParser
 from .javascript_parser import JavaScriptParser
@@ -24,9 +28,20 @@ class ParserFactory:
 
     This class maintains a registry of parser classes for different languages
     and provides methods to register and create parser instances.
+
+    Building a parser builds its tokenizer's rule list, so acquire_parser()
+    and parse() reuse idle instances from a per-class pool. A pooled parser
+    is used by one thread at a time. TokenParser.parse() resets all parse
+    state, so reuse gives the same results as a fresh instance.
     """
 
     _registry: Dict[str, Type[TokenParser]] = {}
+    # Idle parser instances per parser class, at most POOL_SIZE each
+    POOL_SIZE = 4
+    _pools: Dict[Type[TokenParser], List[TokenParser]] = {}
+    _pool_lock = threading.Lock()
+    # Per-language counters: setups, setup_seconds, parses, parse_seconds
+    _timings: Dict[str, Dict[str, float]] = {}
 
     @classmethod
     def register(cls, language: str, parser_class: Type[TokenParser]) -> None:
@@ -53,9 +68,84 @@ class ParserFactory:
         """
         language = language.lower()
         if language in cls._registry:
-            return cls._registry[language]()
+            start = time.perf_counter()
+            parser = cls._registry[language]()
+            cls._record(language, "setup", time.perf_counter() - start)
+            return parser
         return None
 
+    @classmethod
+    @contextmanager
+    def acquire_parser(cls, language: str) -> Iterator[Optional[TokenParser]]:
+        """
+        Borrow a parser for the specified language from the pool.
+
+        The parser is returned to the pool when the block exits, so it must
+        not be kept or shared with other threads. Yields None if no parser is
+        registered for the language.
+        """
+        parser_class = cls._registry.get(language.lower())
+        if parser_class is None:
+            yield None
+            return
+        with cls._pool_lock:
+            pool = cls._pools.setdefault(parser_class, [])
+            parser = pool.pop() if pool else None
+        if parser is None:
+            parser = cls.create_parser(language)
+        try:
+            yield parser
+        finally:
+            with cls._pool_lock:
+                pool = cls._pools.setdefault(parser_class, [])
+                if len(pool) < cls.POOL_SIZE:
+                    pool.append(parser)
+
+    @classmethod
+    def parse(cls, language: str, code: str) -> Optional[List[CodeElement]]:
+        """
+        Parse code with a pooled parser, recording the parse time.
+
+        Returns:
+            The parsed elements, or None if no parser is registered for the language
+        """
+        with cls.acquire_parser(language) as parser:
+            if parser is None:
+                return None
+            start = time.perf_counter()
+            try:
+                return parser.parse(code)
+            finally:
+                cls._record(language.lower(), "parse", time.perf_counter() - start)
+
+    @classmethod
+    def _record(cls, language: str, phase: str, seconds: float) -> None:
+        with cls._pool_lock:
+            stats = cls._timings.setdefault(
+                language,
+                {"setups": 0, "setup_seconds": 0.0, "parses": 0, "parse_seconds": 0.0},
+            )
+            stats[f"{phase}s"] += 1
+            stats[f"{phase}_seconds"] += seconds
+
+    @classmethod
+    def get_timing_stats(cls) -> Dict[str, Dict[str, float]]:
+        """
+        Get cumulative parser setup and parse timings.
+
+        Returns:
+            Mapping of language to its number of parser setups and parses and the
+            total seconds spent in each
+        """
+        with cls._pool_lock:
+            return {language: dict(stats) for language, stats in cls._timings.items()}
+
+    @classmethod
+    def reset_timing_stats(cls) -> None:
+        """Clear the timings reported by get_timing_stats."""
+        with cls._pool_lock:
+            cls._timings.clear()
+
     @classmethod
     def get_supported_languages(cls) -> list[str]:
         """
@@ -4,8 +4,9 @@ Represents a single token in the code.
 """
 
 from enum import Enum
-from typing import Optional, Dict, Any
-from dataclasses import dataclass, field
+from types import MappingProxyType
+from typing import Optional, Mapping, Any
+from dataclasses import dataclass
 
 
 class TokenType(Enum):
@@ -79,13 +80,21 @@ class TokenType(Enum):
     UNKNOWN = "unknown"
 
 
-@dataclass
+# Shared read-only metadata of every token that has none (almost all of them)
+EMPTY_METADATA: Mapping[str, Any] = MappingProxyType({})
+
+
+@dataclass(slots=True)
 class Token:
     """
     Represents a token in the source code.
 
     A token is a lexical unit recognized by the parser, such as a keyword,
     identifier, delimiter, operator, etc.
+
+    Tokens are slotted, with no per-instance __dict__, because a large file
+    yields hundreds of thousands of them. Tokens without metadata share
+    EMPTY_METADATA instead of each holding an empty dict.
     """
 
     token_type: TokenType
@@ -93,7 +102,7 @@ class Token:
     position: int
     line: int
     column: int
-    metadata: Optional[Dict[str, Any]] = field(default_factory=dict)
+    metadata: Optional[Mapping[str, Any]] = EMPTY_METADATA
 
     def __repr__(self):
         return f"Token({self.token_type.value}, '{self.value}', line {self.line}, col {self.column})"
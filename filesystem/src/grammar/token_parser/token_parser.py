@@ -30,6 +30,10 @@ class TokenParser(BaseParser):
         self.symbol_table: Optional[SymbolTable] = None
         self.context_tracker: Optional[ContextTracker] = None
 
+    def _outline_language(self) -> str:
+        """Token parsers leave language generic; their tokenizer knows it."""
+        return self.tokenizer.language if self.tokenizer else self.language
+
     def parse(self, code: str) -> List[CodeElement]:
         """
         Parse the code and return a list of code elements.
@@ -6,8 +6,22 @@ tokenizers inherit from.
 """
 
 from typing import List, Dict, Tuple, Optional, Any, Match, Callable
+import functools
 import re
-from .token import Token, TokenType
+import sys
+import threading
+from .token import EMPTY_METADATA, Token, TokenType
+
+
+# Tokenizers are built per parser instance, and most of them share keyword,
+# operator and delimiter rules, so rule patterns are compiled once per process.
+# re's own cache is bounded and would be evicted by the larger rule sets.
+_compile_rule_pattern = functools.lru_cache(maxsize=None)(re.compile)
+
+# Token values up to this long are interned. Keywords, identifiers and
+# operators repeat throughout a file, so tokens share one string per spelling
+# instead of each keeping its own slice of the source.
+INTERN_MAX_LENGTH = 32
 
 
 class TokenizerState:
@@ -50,8 +64,9 @@ class TokenRule:
             flags: Regex compilation flags (e.g., re.MULTILINE)
             transform: Optional function to transform match into extra token attributes
         """
-        self.pattern = re.compile(pattern, flags)
+        self.pattern = _compile_rule_pattern(pattern, flags)
         self.token_type = token_type
+        self.has_transform = transform is not None
         self.transform = transform or (lambda m: {})
 
     def match(self, code: str, pos: int) -> Optional[Tuple[Token, int]]:
@@ -78,12 +93,85 @@ class TokenRule:
         column = pos - last_nl if last_nl >= 0 else pos + 1
 
         # Apply transform to get extra metadata
-        metadata = self.transform(match)
+        metadata = self.transform(match) or EMPTY_METADATA
 
         token = Token(self.token_type, value, pos, line, column, metadata)
         return token, end_pos
 
 
+# Inline flag letters usable in a scoped group, e.g. (?s:...)
+_SCOPED_FLAG_LETTERS = (
+    (re.IGNORECASE, "i"),
+    (re.MULTILINE, "m"),
+    (re.DOTALL, "s"),
+    (re.VERBOSE, "x"),
+)
+# Backreferences would be renumbered once a pattern is nested in the alternation
+_BACKREFERENCE = re.compile(r"\\[1-9]|\(\?P=")
+
+
+# Combined patterns by rule signature (source and flags of every rule, in order)
+_combined_cache: Dict[Tuple[Tuple[str, int], ...], Optional[re.Pattern]] = {}
+_combined_cache_lock = threading.Lock()
+
+
+def compile_combined_rules_cached(rules: List[TokenRule]) -> Optional[re.Pattern]:
+    """compile_combined_rules, compiled once per process for each distinct rule list."""
+    signature = tuple((rule.pattern.pattern, rule.pattern.flags) for rule in rules)
+    with _combined_cache_lock:
+        if signature in _combined_cache:
+            return _combined_cache[signature]
+    combined = compile_combined_rules(rules)
+    with _combined_cache_lock:
+        _combined_cache[signature] = combined
+    return combined
+
+
+def compile_combined_rules(rules: List[TokenRule]) -> Optional[re.Pattern]:
+    """
+    Compile an ordered rule list into a single alternation regex.
+
+    Each rule becomes a named group ``_r<index>`` carrying its own flags as a
+    scoped inline group. Python's alternation is leftmost-first, so the first
+    branch that matches at a position is the same rule a sequential scan
+    would pick.
+
+    Args:
+        rules: Rules in priority order
+
+    Returns:
+        The compiled pattern, or None if some rule cannot be combined safely
+        (unsupported flags, backreferences or clashing group names).
+    """
+    if not rules:
+        return None
+
+    branches = []
+    for index, rule in enumerate(rules):
+        source = rule.pattern.pattern
+        if _BACKREFERENCE.search(source):
+            return None
+
+        flags = rule.pattern.flags & ~re.UNICODE
+        letters = ""
+        for flag, letter in _SCOPED_FLAG_LETTERS:
+            if flags & flag:
+                letters += letter
+                flags &= ~flag
+        if flags:
+            return None
+
+        if letters:
+            branches.append(f"(?P<_r{index}>(?{letters}:{source}))")
+        else:
+            branches.append(f"(?P<_r{index}>{source})")
+
+    try:
+        return re.compile("|".join(branches))
+    except re.error:
+        return None
+
+
 class Tokenizer:
     """
     Base tokenizer class that converts source code into a list of tokens.
@@ -98,6 +186,10 @@ class Tokenizer:
         self.keywords = set()  # Language-specific keywords
         self.operators = {}  # Mapping from operator string to TokenType
         self.rules: List[TokenRule] = []  # List of token rules
+        # Match all rules with one compiled alternation instead of trying each in turn
+        self.use_combined_regex = True
+        self._combined_key: Optional[Tuple[int, ...]] = None
+        self._combined_pattern: Optional[re.Pattern] = None
 
     def add_rule(self, rule: TokenRule) -> None:
         """
@@ -182,6 +274,73 @@ class Tokenizer:
         if not self.rules:
             self.setup_default_rules()
 
+        if self.use_combined_regex:
+            combined = self._get_combined_pattern()
+            if combined is not None:
+                return self._tokenize_combined(code, combined)
+
+        return self._tokenize_sequential(code)
+
+    def _get_combined_pattern(self) -> Optional[re.Pattern]:
+        """
+        Return the combined regex for the current rule list.
+
+        Rules may be replaced or appended after construction, so the cache is
+        keyed on the identity of every rule.
+        """
+        key = tuple(id(rule) for rule in self.rules)
+        if key != self._combined_key:
+            self._combined_pattern = compile_combined_rules_cached(self.rules)
+            self._combined_key = key
+        return self._combined_pattern
+
+    def _tokenize_combined(self, code: str, combined: re.Pattern) -> List[Token]:
+        """
+        Tokenize with a single alternation regex, tracking line and column
+        incrementally instead of rescanning the source for every token.
+        """
+        rules = self.rules
+        rule_index = {name: int(name[2:]) for name in combined.groupindex}
+        match_at = combined.match
+        code_len = len(code)
+        intern = sys.intern
+
+        tokens: List[Token] = []
+        pos = 0
+        line = 1
+        last_nl = -1  # Position of the last newline before pos
+
+        while pos < code_len:
+            match = match_at(code, pos)
+            if match:
+                rule = rules[rule_index[match.lastgroup]]
+                end_pos = match.end()
+                value = code[pos:end_pos]
+                if end_pos - pos <= INTERN_MAX_LENGTH:
+                    value = intern(value)
+                if rule.has_transform:
+                    # Re-run the rule's own pattern so group numbers match
+                    metadata = rule.transform(rule.pattern.match(code, pos)) or EMPTY_METADATA
+                else:
+                    metadata = EMPTY_METADATA
+                tokens.append(
+                    Token(rule.token_type, value, pos, line, pos - last_nl, metadata)
+                )
+            else:
+                end_pos = pos + 1
+                value = code[pos]
+                tokens.append(Token(TokenType.UNKNOWN, value, pos, line, pos - last_nl))
+
+            newlines = value.count("\n")
+            if newlines:
+                line += newlines
+                last_nl = pos + value.rfind("\n")
+            pos = end_pos
+
+        return tokens
+
+    def _tokenize_sequential(self, code: str) -> List[Token]:
+        """Tokenize by trying each rule in order at every position."""
         tokens: List[Token] = []
         pos = 0
 
@@ -232,7 +391,9 @@ class Tokenizer:
         Returns:
             The created token
         """
-        return Token(token_type, value, position, line, column, metadata)
+        return Token(
+            token_type, value, position, line, column, EMPTY_METADATA if metadata is None else metadata
+        )
 
     # Keep these methods for backward compatibility
     def _is_identifier_start(self, char: str) -> bool:
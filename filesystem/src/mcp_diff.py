@@ -0,0 +1,210 @@
+# mcp_diff.py
+
+import os
+import difflib
+from typing import Callable, Dict, Iterator, List, Optional, Tuple
+
+# --- Configuration Constants ---
+# Unified diff backend used by generate_diff: "myers" (default) or "difflib"
+DIFF_BACKEND = os.environ.get("MCP_DIFF_BACKEND", "myers")
+# Myers gives up after this many inserted plus deleted lines and emits the
+# remaining changed region as one replacement, bounding cost at O(N * limit)
+MYERS_MAX_EDIT_DISTANCE = 1000
+DIFF_CONTEXT_LINES = 3
+
+# (tag, i1, i2, j1, j2) as in difflib.SequenceMatcher.get_opcodes()
+Opcode = Tuple[str, int, int, int, int]
+
+
+def _myers_matches(
+    a: List[int], b: List[int], max_d: int
+) -> Optional[List[Tuple[int, int]]]:
+    """
+    Matched (i, j) index pairs of a shortest edit script from a to b.
+
+    Greedy forward Myers O(ND): V[k] holds the furthest x reached on diagonal
+    k = x - y. The V row after each step is kept for backtracking, so memory
+    is O(D^2). Returns None if more than max_d edits are needed.
+    """
+    n, m = len(a), len(b)
+    max_d = min(max_d, n + m)
+    offset = max_d + 1
+    v = [0] * (2 * max_d + 3)
+    trace: List[List[int]] = []
+    for d in range(max_d + 1):
+        for k in range(-d, d + 1, 2):
+            if k == -d or (k != d and v[offset + k - 1] < v[offset + k + 1]):
+                x = v[offset + k + 1]  # Step down: insert b[y]
+            else:
+                x = v[offset + k - 1] + 1  # Step right: delete a[x]
+            y = x - k
+            while x < n and y < m and a[x] == b[y]:
+                x += 1
+                y += 1
+            v[offset + k] = x
+            if x >= n and y >= m:
+                trace.append(v[offset - d : offset + d + 1])
+                return _backtrack(trace, n, m)
+        trace.append(v[offset - d : offset + d + 1])
+    return None
+
+
+def _backtrack(trace: List[List[int]], n: int, m: int) -> List[Tuple[int, int]]:
+    matches: List[Tuple[int, int]] = []
+    x, y = n, m
+    for d in range(len(trace) - 1, 0, -1):
+        prev = trace[d - 1]  # Indexed by k + (d - 1)
+        k = x - y
+        if k == -d or (k != d and prev[k - 1 + d - 1] < prev[k + 1 + d - 1]):
+            prev_k = k + 1
+            prev_x = prev[prev_k + d - 1]
+            mid_x = prev_x  # Came down from (prev_x, prev_y)
+        else:
+            prev_k = k - 1
+            prev_x = prev[prev_k + d - 1]
+            mid_x = prev_x + 1  # Came right from (prev_x, prev_y)
+        while x > mid_x:  # Snake after the step
+            x -= 1
+            y -= 1
+            matches.append((x, y))
+        x, y = prev_x, prev_x - prev_k
+    while x > 0 and y > 0:  # Leading snake at d = 0
+        x -= 1
+        y -= 1
+        matches.append((x, y))
+    matches.reverse()
+    return matches
+
+
+def _append_opcode(codes: List[Opcode], tag: str, i1: int, i2: int, j1: int, j2: int):
+    if i1 == i2 and j1 == j2:
+        return
+    if codes and codes[-1][0] == tag == "equal":
+        codes[-1] = ("equal", codes[-1][1], i2, codes[-1][3], j2)
+        return
+    codes.append((tag, i1, i2, j1, j2))
+
+
+def myers_opcodes(
+    a: List[str], b: List[str], max_d: int = MYERS_MAX_EDIT_DISTANCE
+) -> List[Opcode]:
+    """
+    difflib-style opcodes for turning a into b.
+
+    The common prefix and suffix are trimmed in linear time first, so a small
+    edit to a large file costs O(size of the changed region), not O(N^2).
+    """
+    n, m = len(a), len(b)
+    prefix = 0
+    limit = min(n, m)
+    while prefix < limit and a[prefix] == b[prefix]:
+        prefix += 1
+    suffix = 0
+    while suffix < limit - prefix and a[n - 1 - suffix] == b[m - 1 - suffix]:
+        suffix += 1
+
+    codes: List[Opcode] = []
+    _append_opcode(codes, "equal", 0, prefix, 0, prefix)
+    a_end, b_end = n - suffix, m - suffix
+
+    # Compare small ints instead of strings in the inner loop
+    ids: Dict[str, int] = {}
+    a_ids = [ids.setdefault(line, len(ids)) for line in a[prefix:a_end]]
+    b_ids = [ids.setdefault(line, len(ids)) for line in b[prefix:b_end]]
+    matches = _myers_matches(a_ids, b_ids, max_d)
+    if matches is None:
+        _append_opcode(codes, "replace", prefix, a_end, prefix, b_end)
+    else:
+        i = j = 0
+        for mi, mj in matches + [(len(a_ids), len(b_ids))]:
+            if mi > i or mj > j:
+                tag = "replace" if mi > i and mj > j else ("delete" if mi > i else "insert")
+                _append_opcode(codes, tag, prefix + i, prefix + mi, prefix + j, prefix + mj)
+            if mi < len(a_ids):
+                _append_opcode(codes, "equal", prefix + mi, prefix + mi + 1, prefix + mj, prefix + mj + 1)
+            i, j = mi + 1, mj + 1
+
+    _append_opcode(codes, "equal", a_end, n, b_end, m)
+    return codes
+
+
+def _grouped_opcodes(codes: List[Opcode], n: int) -> Iterator[List[Opcode]]:
+    """Same grouping as difflib.SequenceMatcher.get_grouped_opcodes()."""
+    codes = list(codes) or [("equal", 0, 1, 0, 1)]
+    if codes[0][0] == "equal":
+        tag, i1, i2, j1, j2 = codes[0]
+        codes[0] = tag, max(i1, i2 - n), i2, max(j1, j2 - n), j2
+    if codes[-1][0] == "equal":
+        tag, i1, i2, j1, j2 = codes[-1]
+        codes[-1] = tag, i1, min(i2, i1 + n), j1, min(j2, j1 + n)
+
+    nn = n + n
+    group: List[Opcode] = []
+    for tag, i1, i2, j1, j2 in codes:
+        # Start a new group whenever there is a large range with no changes
+        if tag == "equal" and i2 - i1 > nn:
+            group.append((tag, i1, min(i2, i1 + n), j1, min(j2, j1 + n)))
+            yield group
+            group = []
+            i1, j1 = max(i1, i2 - n), max(j1, j2 - n)
+        group.append((tag, i1, i2, j1, j2))
+    if group and not (len(group) == 1 and group[0][0] == "equal"):
+        yield group
+
+
+def _format_range(start: int, stop: int) -> str:
+    beginning = start + 1  # Lines are numbered from one
+    length = stop - start
+    if length == 1:
+        return f"{beginning}"
+    if not length:
+        beginning -= 1  # Empty ranges begin at the line just before
+    return f"{beginning},{length}"
+
+
+def myers_unified_diff(
+    a: List[str], b: List[str], fromfile: str, tofile: str, n: int = DIFF_CONTEXT_LINES
+) -> Iterator[str]:
+    """Drop-in for difflib.unified_diff (lines with newlines, lineterm="\\n")."""
+    started = False
+    for group in _grouped_opcodes(myers_opcodes(a, b), n):
+        if not started:
+            started = True
+            yield f"--- {fromfile}\n"
+            yield f"+++ {tofile}\n"
+        first, last = group[0], group[-1]
+        yield f"@@ -{_format_range(first[1], last[2])} +{_format_range(first[3], last[4])} @@\n"
+        for tag, i1, i2, j1, j2 in group:
+            if tag == "equal":
+                for line in a[i1:i2]:
+                    yield " " + line
+                continue
+            if tag in ("replace", "delete"):
+                for line in a[i1:i2]:
+                    yield "-" + line
+            if tag in ("replace", "insert"):
+                for line in b[j1:j2]:
+                    yield "+" + line
+
+
+def difflib_unified_diff(
+    a: List[str], b: List[str], fromfile: str, tofile: str, n: int = DIFF_CONTEXT_LINES
+) -> Iterator[str]:
+    return difflib.unified_diff(a, b, fromfile=fromfile, tofile=tofile, n=n, lineterm="\n")
+
+
+DIFF_BACKENDS: Dict[str, Callable[..., Iterator[str]]] = {
+    "myers": myers_unified_diff,
+    "difflib": difflib_unified_diff,
+}
+
+
+def get_diff_backend(name: Optional[str] = None) -> Callable[..., Iterator[str]]:
+    """The unified diff function registered under name (default: DIFF_BACKEND)."""
+    name = name or DIFF_BACKEND
+    try:
+        return DIFF_BACKENDS[name]
+    except KeyError:
+        raise ValueError(
+            f"Unknown diff backend '{name}'. Choose from: {', '.join(sorted(DIFF_BACKENDS))}"
+        )
@@ -1,24 +1,58 @@
 # mcp_edit_utils.py
 
+import io
 import os
 import re
 import hashlib
 import json
 import logging
-import subprocess
-import difflib
+import zlib
 import filelock
 import threading
+from collections import OrderedDict
+from contextvars import ContextVar
 from pathlib import Path
 from datetime import datetime, timezone
-from typing import Optional, List, Dict, Any
+from typing import Optional, List, Dict, Any, Tuple, Set
+
+try:
+    from .mcp_patch import apply_patch_to_lines, format_diagnostics, split_lines, PatchError
+except ImportError:
+    from mcp_patch import apply_patch_to_lines, format_diagnostics, split_lines, PatchError
+
+try:
+    from .mcp_diff import get_diff_backend
+except ImportError:
+    from mcp_diff import get_diff_backend
+
+try:
+    from .mcp_trace import span, traced, add_bytes
+except ImportError:
+    from mcp_trace import span, traced, add_bytes
 
 # --- Configuration Constants ---
 HISTORY_DIR_NAME = ".mcp/edit_history"
 LOGS_DIR = "logs"
 DIFFS_DIR = "diffs"
 CHECKPOINTS_DIR = "checkpoints"
+OBJECTS_DIR = "objects"  # Content-addressed, compressed checkpoints and diffs
+OBJECT_SUFFIX = ".z"
+# Packs written by `mcpdiff cleanup --compact`; must match cli/mcpdiff_objects.py
+OBJECT_PACK_DIR = "pack"
+PACK_INDEX_MAGIC = b"MCPIDX1\n"
+PACK_INDEX_RECORD_SIZE = 44  # Raw SHA-256, 8-byte offset, 4-byte length
+OBJECT_COMPRESSION_LEVEL = 3  # zlib level; higher levels cost more CPU per edit for little gain
 LOCK_TIMEOUT = 10  # seconds for file locks
+# A file is checkpointed again after this many edits or bytes of diff since its
+# last checkpoint, so reconstruction never replays a long chain. 0 disables a limit.
+CHECKPOINT_EVERY_EDITS = int(os.environ.get("MCP_CHECKPOINT_EVERY_EDITS", "25"))
+CHECKPOINT_EVERY_DIFF_BYTES = int(
+    os.environ.get("MCP_CHECKPOINT_EVERY_DIFF_BYTES", str(256 * 1024))
+)
+# Edits whose changed region (old plus new lines) is larger than this store the
+# new content as an object instead of a diff. 0 disables the limit.
+DIFF_MAX_LINES = int(os.environ.get("MCP_DIFF_MAX_LINES", "20000"))
+LINE_COUNT_CACHE_SIZE = 65536  # Files whose line count is kept in memory
 
 # --- Logging Setup ---
 logging.basicConfig(
@@ -70,6 +104,55 @@ def expand_home(filepath: str) -> str:
 
 
 # --- Core Path Validation ---
+class AllowedDirectoryTrie:
+    """
+    Path-component trie of allowed directories.
+
+    contains() costs one dict lookup per component of the checked path, however
+    many directories are allowed, and matches only at directory boundaries.
+    """
+
+    _END = ""  # Marks an allowed directory; never a real path component
+
+    def __init__(self, allowed_directories: List[str]):
+        self._root: Dict[str, Any] = {}
+        for allowed_dir in allowed_directories:
+            node = self._root
+            for part in self._parts(normalize_path(allowed_dir)):
+                node = node.setdefault(part, {})
+            node[self._END] = True
+
+    @staticmethod
+    def _parts(path: str) -> List[str]:
+        return [part for part in path.split(os.sep) if part]
+
+    def contains(self, normalized_path: str) -> bool:
+        """True if normalized_path is an allowed directory or lies under one."""
+        node = self._root
+        if self._END in node:
+            return True
+        for part in self._parts(normalized_path):
+            node = node.get(part)
+            if node is None:
+                return False
+            if self._END in node:
+                return True
+        return False
+
+
+_allowed_tries: Dict[Tuple[str, ...], AllowedDirectoryTrie] = {}
+
+
+def get_allowed_trie(allowed_directories: List[str]) -> AllowedDirectoryTrie:
+    """The trie for a list of allowed directories, built once per distinct list."""
+    key = tuple(allowed_directories)
+    trie = _allowed_tries.get(key)
+    if trie is None:
+        trie = _allowed_tries[key] = AllowedDirectoryTrie(allowed_directories)
+    return trie
+
+
+@traced("validate_path")
 def validate_path(requested_path: str, allowed_directories: List[str]) -> str:
     """
     Validate that a path is within allowed directories and safe to access.
@@ -96,23 +179,9 @@ def validate_path(requested_path: str, allowed_directories: List[str]) -> str:
     )
     log.debug(f"Allowed directories: {allowed_directories}")
 
-    is_within_allowed = False
-    for allowed_dir_path in allowed_directories:
-        # Check if the requested path *starts with* an allowed directory path.
-        # Ensure matching happens at directory boundaries (append os.sep).
-        allowed_prefix = os.path.join(
-            allowed_dir_path, ""
-        )  # Ensures trailing slash consistency
-        if normalized_requested == allowed_dir_path or normalized_requested.startswith(
-            allowed_prefix
-        ):
-            is_within_allowed = True
-            log.debug(
-                f"Path '{normalized_requested}' is within allowed directory '{allowed_dir_path}'"
-            )
-            break
-
-    if not is_within_allowed:
+    # Matching happens at directory boundaries
+    allowed_trie = get_allowed_trie(allowed_directories)
+    if not allowed_trie.contains(normalized_requested):
         log.warning(
             f"Access denied for path '{normalized_requested}'. Not within allowed: {allowed_directories}"
         )
@@ -130,16 +199,7 @@ def validate_path(requested_path: str, allowed_directories: List[str]) -> str:
             normalized_real = normalize_path(real_path)
 
             # Crucially, re-check if the *resolved* real path is within allowed directories
-            is_real_path_allowed = False
-            for allowed_dir_path in allowed_directories:
-                allowed_prefix = os.path.join(allowed_dir_path, "")
-                if normalized_real == allowed_dir_path or normalized_real.startswith(
-                    allowed_prefix
-                ):
-                    is_real_path_allowed = True
-                    break
-
-            if not is_real_path_allowed:
+            if not allowed_trie.contains(normalized_real):
                 log.warning(
                     f"Access denied for symlink '{normalized_requested}'. Real path '{normalized_real}' is outside allowed directories."
                 )
@@ -197,17 +257,7 @@ def validate_path(requested_path: str, allowed_directories: List[str]) -> str:
             parent_real_path = os.path.realpath(parent_dir)
             normalized_parent = normalize_path(parent_real_path)
 
-            is_parent_allowed = False
-            for allowed_dir_path in allowed_directories:
-                allowed_prefix = os.path.join(allowed_dir_path, "")
-                if (
-                    normalized_parent == allowed_dir_path
-                    or normalized_parent.startswith(allowed_prefix)
-                ):
-                    is_parent_allowed = True
-                    break
-
-            if not is_parent_allowed:
+            if not allowed_trie.contains(normalized_parent):
                 log.warning(
                     f"Access denied for non-existing path '{normalized_requested}'. Parent's real path '{normalized_parent}' is outside allowed directories."
                 )
@@ -270,6 +320,32 @@ def get_file_stats(file_path: str) -> Dict[str, Any]:
     }
 
 
+# Maps absolute file path -> ((st_ino, st_mtime_ns, st_size), line count)
+_line_count_cache: "OrderedDict[str, Tuple[Tuple[int, int, int], int]]" = OrderedDict()
+_line_count_lock = threading.Lock()
+
+
+def count_lines_cached(path: str, stats: os.stat_result) -> int:
+    """Line count of a file, recounted only when its inode, mtime or size changes."""
+    stamp = (stats.st_ino, stats.st_mtime_ns, stats.st_size)
+    with _line_count_lock:
+        cached = _line_count_cache.get(path)
+        if cached is not None and cached[0] == stamp:
+            _line_count_cache.move_to_end(path)
+            return cached[1]
+
+    line_count = 0
+    with open(path, "rb") as f:  # Read bytes to count lines robustly
+        for _ in f:
+            line_count += 1
+    with _line_count_lock:
+        _line_count_cache[path] = (stamp, line_count)
+        _line_count_cache.move_to_end(path)
+        while len(_line_count_cache) > LINE_COUNT_CACHE_SIZE:
+            _line_count_cache.popitem(last=False)
+    return line_count
+
+
 def get_metadata(
     path: str,
     is_file: bool,
@@ -292,6 +368,9 @@ def get_metadata(
     Returns:
         A comma-separated string of metadata, or empty string if no metadata requested.
     """
+    if not (show_size or show_permissions or show_owner or (count_lines and is_file)):
+        return ""  # Nothing requested, skip the stat
+
     # Import pwd/grp only if needed and available (Unix-specific)
     pwd = grp = None
     if show_owner:
@@ -346,11 +425,7 @@ def get_metadata(
 
         if count_lines and is_file:
             try:
-                line_count = 0
-                with open(path, "rb") as f:  # Read bytes to count lines robustly
-                    for line in f:
-                        line_count += 1
-                metadata_parts.append(f"{line_count} lines")
+                metadata_parts.append(f"{count_lines_cached(path, stats)} lines")
             except Exception:
                 metadata_parts.append(
                     "binary/unreadable"
@@ -419,6 +494,7 @@ def sanitize_path_for_filename(abs_path: str, workspace_root: Path) -> str:
         return hashlib.sha256(abs_path.encode()).hexdigest()
 
 
+@traced("lock_wait")
 def acquire_lock(lock_path: str) -> filelock.FileLock:
     """Acquires a file lock, creating parent directory if needed."""
     lock_file = Path(f"{lock_path}.lock")
@@ -462,6 +538,7 @@ def release_lock(lock: Optional[filelock.FileLock]):
             log.error(f"Error releasing lock object for {lock_path}: {e}")
 
 
+@traced("hash")
 def calculate_hash(file_path: str) -> Optional[str]:
     """Calculates the SHA256 hash of a file's content."""
     try:
@@ -477,85 +554,213 @@ def calculate_hash(file_path: str) -> Optional[str]:
         return None
 
 
+def stat_stamp(path) -> Optional[Dict[str, int]]:
+    """
+    A file's size, mtime_ns and inode, logged as stat_after next to hash_after.
+
+    mcpdiff trusts hash_after without re-hashing while the file still has this
+    stamp, so it must be taken before the bytes that were hashed are read.
+    """
+    try:
+        st = os.stat(path)
+    except OSError:
+        return None
+    return {"size": st.st_size, "mtime_ns": st.st_mtime_ns, "inode": st.st_ino}
+
+
+# --- Request-Scoped File Buffers ---
+# While a tracked edit runs, the bytes read from or written to each file are kept
+# here, keyed by (st_dev, st_ino) so that any path spelling finds them, together
+# with the file's (size, mtime_ns) at that moment. The decorator and the tool
+# body then share one read, and the post-write hash comes from memory. A
+# different stat means someone else touched the file, and it is read again.
+_edit_buffers: ContextVar[
+    Optional[Dict[Tuple[int, int], Tuple[Tuple[int, int], bytes]]]
+] = ContextVar("mcp_edit_buffers", default=None)
+
+
+def open_edit_buffers():
+    """Start sharing file contents between read_file_bytes/write_text calls; returns a token for close_edit_buffers."""
+    return _edit_buffers.set({})
+
+
+def close_edit_buffers(token):
+    _edit_buffers.reset(token)
+
+
+def read_file_bytes(path) -> bytes:
+    """A file's bytes, from the edit buffer if it is still current, else from disk."""
+    buffers = _edit_buffers.get()
+    if buffers:
+        try:
+            st = os.stat(path)
+            cached = buffers.get((st.st_dev, st.st_ino))
+            if cached and cached[0] == (st.st_size, st.st_mtime_ns):
+                return cached[1]
+        except OSError:
+            pass
+    with span("read"), open(path, "rb") as f:
+        data = f.read()
+        st = os.fstat(f.fileno())
+    add_bytes("read", len(data))
+    if buffers is not None:
+        buffers[(st.st_dev, st.st_ino)] = ((st.st_size, st.st_mtime_ns), data)
+    return data
+
+
+def decode_text(data: bytes) -> str:
+    """Decode bytes exactly as open(path, "r", encoding="utf-8", errors="ignore").read() would."""
+    return io.TextIOWrapper(io.BytesIO(data), encoding="utf-8", errors="ignore").read()
+
+
+def decode_lines(data: bytes) -> List[str]:
+    """Decode bytes into lines exactly as readlines() on such a file would."""
+    return io.TextIOWrapper(io.BytesIO(data), encoding="utf-8", errors="ignore").readlines()
+
+
+def split_text_lines(text: str) -> List[str]:
+    """
+    Split text where readlines() would (\n, \r\n or a lone \r), keeping each ending as is.
+
+    Line numbers then agree with read_file and replace_lines_in_file, unlike
+    str.splitlines(), which also breaks at \x0c, \x1c, \u2028 and others.
+    """
+    return io.StringIO(text, newline="").readlines()
+
+
+def read_text(path) -> str:
+    return decode_text(read_file_bytes(path))
+
+
+def read_lines(path) -> List[str]:
+    return decode_lines(read_file_bytes(path))
+
+
+def write_text(path, content: str):
+    """Write content as open(path, "w", encoding="utf-8") would, keeping the bytes in the edit buffer."""
+    if os.linesep != "\n":
+        content = content.replace("\n", os.linesep)  # Text mode newline translation
+    data = content.encode("utf-8")
+    with open(path, "wb") as f:
+        f.write(data)
+        f.flush()
+        st = os.fstat(f.fileno())
+    buffers = _edit_buffers.get()
+    if buffers is not None:
+        buffers[(st.st_dev, st.st_ino)] = ((st.st_size, st.st_mtime_ns), data)
+
+
+@traced("diff")
 def generate_diff(
     content_before_lines: List[str],
     content_after_lines: List[str],
     path_a: str,
     path_b: str,
+    backend: Optional[str] = None,
 ) -> str:
-    """Generates a unified diff string."""
+    """
+    Generates a unified diff string.
+
+    backend names an entry of mcp_diff.DIFF_BACKENDS; the default comes from
+    MCP_DIFF_BACKEND ("myers", which trims the common prefix and suffix first).
+    """
 
-    # Ensure lines end with newline for difflib if they don't
+    # Ensure lines end with newline for the diff; only copy when one doesn't
     def ensure_nl(lines):
-        result = []
-        for line in lines:
-            if not line.endswith("\n"):
-                line = line + "\n"
-            result.append(line)
-        return result
-
-    # Properly normalize input lines
-    before_lines = ensure_nl(content_before_lines)
-    after_lines = ensure_nl(content_after_lines)
-
-    # difflib expects lines WITH newlines
-    diff_iter = difflib.unified_diff(
-        before_lines,
-        after_lines,
-        fromfile=f"a/{path_a}",
-        tofile=f"b/{path_b}",
-        lineterm="\n",
+        if all(line.endswith("\n") for line in lines):
+            return lines
+        return [line if line.endswith("\n") else line + "\n" for line in lines]
+
+    diff_iter = get_diff_backend(backend)(
+        ensure_nl(content_before_lines),
+        ensure_nl(content_after_lines),
+        f"a/{path_a}",
+        f"b/{path_b}",
     )
     return "".join(diff_iter)
 
 
+def diff_exceeds_limit(
+    content_before_lines: List[str], content_after_lines: List[str]
+) -> bool:
+    """True if the changed region is too large to be worth storing as a diff (see DIFF_MAX_LINES)."""
+    if DIFF_MAX_LINES <= 0:
+        return False
+    edit_range = compute_edit_range(content_before_lines, content_after_lines)
+    if edit_range is None:
+        return False
+    start, old_end, new_end = edit_range
+    return (old_end - start + 1) + (new_end - start + 1) > DIFF_MAX_LINES
+
+
+def compute_edit_range(
+    content_before_lines: List[str], content_after_lines: List[str]
+) -> Optional[Tuple[int, int, int]]:
+    """
+    Finds the smallest line range that differs between two versions of a file.
+
+    Returns:
+        (start_line, old_end_line, new_end_line), 1-based and inclusive: old
+        lines start..old_end were replaced by new lines start..new_end. None if
+        the contents are identical.
+    """
+    if content_before_lines == content_after_lines:
+        return None
+    max_common = min(len(content_before_lines), len(content_after_lines))
+    prefix = 0
+    while (
+        prefix < max_common
+        and content_before_lines[prefix] == content_after_lines[prefix]
+    ):
+        prefix += 1
+    suffix = 0
+    while (
+        suffix < max_common - prefix
+        and content_before_lines[-1 - suffix] == content_after_lines[-1 - suffix]
+    ):
+        suffix += 1
+    return (
+        prefix + 1,
+        len(content_before_lines) - suffix,
+        len(content_after_lines) - suffix,
+    )
+
+
 def apply_patch(
     diff_content: str, target_file: str, workspace_root: Path, reverse: bool = False
 ) -> bool:
-    """Applies a diff using the patch command. Runs from workspace root."""
-    patch_cmd = ["patch", "--no-backup-if-mismatch", "-p1"]  # Add --no-backup...
-    if reverse:
-        patch_cmd.append("-R")
-
-    target_rel_path = Path(target_file).relative_to(workspace_root)
+    """Applies a unified diff to target_file in memory and writes the result atomically."""
+    target_path = Path(target_file)
+    target_rel_path = target_path.relative_to(workspace_root)
 
     log.debug(
         f"Applying patch to {target_rel_path} (Reverse: {reverse}) within {workspace_root}"
     )
     try:
-        process = subprocess.run(
-            patch_cmd,
-            input=diff_content.encode("utf-8"),
-            # Specify the target file explicitly if patch supports it (GNU patch does)
-            # This avoids ambiguity if CWD is not exactly workspace root
-            args=patch_cmd + [str(target_rel_path)],  # Pass relative path as final arg
-            cwd=workspace_root,  # Run from workspace root
-            capture_output=True,
-            check=False,
-            timeout=15,  # Add a timeout
+        lines: List[str] = []
+        if target_path.exists():
+            with open(
+                target_path, "r", encoding="utf-8", errors="surrogateescape", newline=""
+            ) as f:
+                lines = split_lines(f.read())
+
+        new_lines, diagnostics = apply_patch_to_lines(lines, diff_content, reverse=reverse)
+        notes = format_diagnostics(diagnostics)
+        if notes:
+            log.info(f"Patch for {target_rel_path} needed adjustments: {notes}")
+
+        temp_path = target_path.with_name(f".{target_path.name}.patch.tmp")
+        with open(
+            temp_path, "w", encoding="utf-8", errors="surrogateescape", newline=""
+        ) as f:
+            f.writelines(new_lines)
+        os.replace(temp_path, target_path)
+        log.info(
+            f"Patch applied successfully to {target_rel_path} (Reverse: {reverse})"
         )
-
-        if process.returncode == 0:
-            log.info(
-                f"Patch applied successfully to {target_rel_path} (Reverse: {reverse})"
-            )
-            return True
-        else:
-            log.error(
-                f"Patch command failed for {target_rel_path} (Reverse: {reverse}) RC={process.returncode}"
-            )
-            log.error(
-                f"Patch STDOUT:\n{process.stdout.decode('utf-8', errors='ignore')}"
-            )
-            log.error(
-                f"Patch STDERR:\n{process.stderr.decode('utf-8', errors='ignore')}"
-            )
-            return False
-    except FileNotFoundError:
-        log.error("`patch` command not found. Please install patch.")
-        raise HistoryError("`patch` command not found.")
-    except subprocess.TimeoutExpired:
-        log.error(f"Patch command timed out for {target_rel_path}")
+        return True
+    except PatchError as e:
+        log.error(f"Patch failed for {target_rel_path} (Reverse: {reverse}): {e}")
         return False
     except Exception as e:
         log.exception(f"Unexpected error applying patch to {target_rel_path}: {e}")
@@ -607,6 +812,221 @@ def write_log_file(log_file_path: Path, entries: List[Dict[str, Any]]):
         raise HistoryError(f"Unexpected error writing log file: {log_file_path}") from e
 
 
+# --- Append-Only Log State ---
+# Maps log file path -> ((size, mtime_ns) after our last read or append, file
+# path -> [edits, diff bytes] since that path's last checkpoint). A different
+# stamp on disk means another process (e.g. mcpdiff) rewrote the log, and the
+# state is rebuilt from it.
+_log_seen_paths: Dict[str, Tuple[Optional[Tuple[int, int]], Dict[str, List[int]]]] = {}
+_log_seen_paths_lock = threading.Lock()
+
+
+def _log_stamp(log_file_path: Path) -> Optional[Tuple[int, int]]:
+    try:
+        st = log_file_path.stat()
+    except FileNotFoundError:
+        return None
+    return (st.st_size, st.st_mtime_ns)
+
+
+def _count_logged_entry(
+    paths: Dict[str, List[int]], entry: Dict[str, Any], history_root: Path
+):
+    """Advance the since-last-checkpoint counters of the path an entry touches."""
+    file_path = entry.get("file_path")
+    if not file_path:
+        return
+    counters = paths.setdefault(file_path, [0, 0])
+    if entry.get("checkpoint_file"):
+        counters[0] = counters[1] = 0  # The checkpoint holds the state before this entry
+    counters[0] += 1
+    if "diff_bytes" in entry:
+        counters[1] += entry["diff_bytes"] or 0
+    elif entry.get("diff_file"):
+        # Entries from before diff_bytes was logged; exact for uncompressed diffs/ files
+        try:
+            counters[1] += (history_root / entry["diff_file"]).stat().st_size
+        except OSError:
+            pass
+
+
+def _logged_path_state(log_file_path: Path) -> Dict[str, List[int]]:
+    key = str(log_file_path)
+    stamp = _log_stamp(log_file_path)
+    with _log_seen_paths_lock:
+        cached = _log_seen_paths.get(key)
+        if cached is not None and cached[0] == stamp:
+            return {p: list(c) for p, c in cached[1].items()}
+
+    paths: Dict[str, List[int]] = {}
+    if stamp is not None:
+        history_root = log_file_path.parent.parent
+        latest: Dict[str, Dict[str, Any]] = {}
+        for e in read_log_file(log_file_path):
+            if e.get("edit_id"):
+                latest[e["edit_id"]] = e  # Last record wins, first position is kept
+        for e in latest.values():
+            _count_logged_entry(paths, e, history_root)
+    with _log_seen_paths_lock:
+        _log_seen_paths[key] = (stamp, paths)
+    return {p: list(c) for p, c in paths.items()}
+
+
+def get_logged_file_paths(log_file_path: Path) -> Set[str]:
+    """
+    Returns the set of file_path values already recorded in a log file.
+    Served from memory while the log is only appended to by this process.
+    """
+    return set(_logged_path_state(log_file_path))
+
+
+def checkpoint_due(log_file_path: Path, file_path: str) -> bool:
+    """
+    True if file_path has had CHECKPOINT_EVERY_EDITS edits or
+    CHECKPOINT_EVERY_DIFF_BYTES of diff logged since its last checkpoint.
+    """
+    edits, diff_bytes = _logged_path_state(log_file_path).get(file_path, (0, 0))
+    return (CHECKPOINT_EVERY_EDITS > 0 and edits >= CHECKPOINT_EVERY_EDITS) or (
+        CHECKPOINT_EVERY_DIFF_BYTES > 0 and diff_bytes >= CHECKPOINT_EVERY_DIFF_BYTES
+    )
+
+
+def object_rel_path(content_hash: str) -> Path:
+    """Path, relative to history_root, of the loose object for content_hash."""
+    return Path(OBJECTS_DIR) / content_hash[:2] / f"{content_hash}{OBJECT_SUFFIX}"
+
+
+# Hashes listed by each pack index: idx path -> ((size, mtime_ns), raw hashes)
+_pack_hashes: Dict[str, Tuple[Tuple[int, int], Set[bytes]]] = {}
+_pack_hashes_lock = threading.Lock()
+
+
+def _packed_hashes(idx_path: Path) -> Set[bytes]:
+    """Raw hashes in a pack index, re-read only when the index changes."""
+    st = idx_path.stat()
+    stamp = (st.st_size, st.st_mtime_ns)
+    with _pack_hashes_lock:
+        cached = _pack_hashes.get(str(idx_path))
+    if cached is not None and cached[0] == stamp:
+        return cached[1]
+    data = idx_path.read_bytes()
+    hashes: Set[bytes] = set()
+    if data.startswith(PACK_INDEX_MAGIC):
+        body = data[len(PACK_INDEX_MAGIC) :]
+        end = len(body) - len(body) % PACK_INDEX_RECORD_SIZE
+        hashes = {body[i : i + 32] for i in range(0, end, PACK_INDEX_RECORD_SIZE)}
+    with _pack_hashes_lock:
+        _pack_hashes[str(idx_path)] = (stamp, hashes)
+    return hashes
+
+
+def object_exists(history_root: Path, content_hash: str) -> bool:
+    """True if content_hash is stored, as a loose object or in a pack."""
+    if (history_root / object_rel_path(content_hash)).is_file():
+        return True
+    raw = bytes.fromhex(content_hash)
+    for idx_path in (history_root / OBJECTS_DIR / OBJECT_PACK_DIR).glob("*.idx"):
+        try:
+            if raw in _packed_hashes(idx_path):
+                return True
+        except OSError:
+            continue
+    return False
+
+
+@traced("object_write")
+def write_object(
+    history_root: Path, data: bytes, content_hash: Optional[str] = None
+) -> Path:
+    """
+    Stores data zlib-compressed under its SHA-256, unless it is already there.
+
+    content_hash may be passed when it is already known (e.g. hash_before).
+
+    Returns:
+        The object path relative to history_root, as recorded in log entries.
+    """
+    if content_hash is None:
+        content_hash = hashlib.sha256(data).hexdigest()
+    relative_path = object_rel_path(content_hash)
+    object_path = history_root / relative_path
+    if object_exists(history_root, content_hash):
+        return relative_path  # Same content was stored before, maybe since packed
+
+    temp_path = object_path.with_name(f".{object_path.name}.{os.getpid()}.tmp")
+    try:
+        object_path.parent.mkdir(parents=True, exist_ok=True)
+        with open(temp_path, "wb") as f:
+            f.write(zlib.compress(data, OBJECT_COMPRESSION_LEVEL))
+        os.replace(temp_path, object_path)
+    except OSError as e:
+        if temp_path.exists():
+            os.remove(temp_path)
+        raise HistoryError(f"Failed to store object {content_hash}: {e}") from e
+    return relative_path
+
+
+def store_file_object(
+    history_root: Path, source_path: Path, content_hash: Optional[str] = None
+) -> Path:
+    """Stores the content of source_path in the object store (see write_object)."""
+    if content_hash and object_exists(history_root, content_hash):
+        return object_rel_path(content_hash)  # Skip reading the file at all
+    try:
+        data = source_path.read_bytes()
+    except OSError as e:
+        raise HistoryError(f"Failed to read {source_path} for checkpoint: {e}") from e
+    return write_object(history_root, data, content_hash)
+
+
+def append_log_entry(log_file_path: Path, entry: Dict[str, Any]):
+    """
+    Appends one entry to a JSON Lines log file as a single fsync'd write.
+
+    Unlike write_log_file this never rewrites earlier entries, so the cost of
+    logging an edit does not grow with the length of the conversation.
+    Compaction is left to `mcpdiff cleanup --compact`.
+    """
+    append_log_entries(log_file_path, [entry])
+
+
+@traced("log_write")
+def append_log_entries(log_file_path: Path, entries: List[Dict[str, Any]]):
+    """Appends several entries to a log file in one fsync'd write (see append_log_entry)."""
+    data = b"".join(
+        (json.dumps(entry, separators=(",", ":")) + "\n").encode("utf-8")
+        for entry in entries
+    )
+    key = str(log_file_path)
+    try:
+        log_file_path.parent.mkdir(parents=True, exist_ok=True)  # Ensure dir exists
+        with open(log_file_path, "a+b") as f:
+            size_before = f.seek(0, os.SEEK_END)
+            if size_before > 0:
+                # Never glue onto a line torn by an earlier crash
+                f.seek(size_before - 1)
+                if f.read(1) != b"\n":
+                    data = b"\n" + data
+            f.write(data)
+            f.flush()
+            os.fsync(f.fileno())
+            st = os.fstat(f.fileno())
+    except OSError as e:
+        log.error(f"Error appending to log file {log_file_path}: {e}")
+        raise HistoryError(f"Could not append to log file: {log_file_path}") from e
+
+    with _log_seen_paths_lock:
+        cached = _log_seen_paths.get(key)
+        previous_size = cached[0][0] if cached and cached[0] else 0
+        if cached is not None and previous_size == size_before:
+            for entry in entries:
+                _count_logged_entry(cached[1], entry, log_file_path.parent.parent)
+            _log_seen_paths[key] = ((st.st_size, st.st_mtime_ns), cached[1])
+        else:
+            # Someone else touched the log since we last looked: rebuild on next read
+            _log_seen_paths.pop(key, None)
+
+
 # --- Global Counter and Lock for Tool Call Index ---
 # Needs to be accessible by the decorator in the server file
 _tool_call_counters: Dict[str, int] = {}
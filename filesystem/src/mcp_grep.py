@@ -0,0 +1,216 @@
+# mcp_grep.py
+
+import re
+import threading
+from collections import deque
+from concurrent.futures import ThreadPoolExecutor
+from typing import Callable, Iterable, List, Optional, Tuple
+
+try:
+    from .mcp_trace import traced
+except ImportError:
+    from mcp_trace import traced
+
+# --- Configuration Constants ---
+GREP_MAX_WORKERS = 8  # Files scanned concurrently
+GREP_READ_BUFFER = 64 * 1024  # Bytes read from disk per chunk
+GREP_BINARY_PROBE = 8192  # Leading bytes checked for NUL to skip binary files
+GREP_STOP_CHECK_LINES = 1024  # Lines between checks for a cancelled search
+
+# (line number, is match, text); a None entry separates non-adjacent regions
+GrepEntry = Optional[Tuple[int, bool, str]]
+
+
+class GrepResult:
+    """Matches found in one file, as context regions ready for formatting."""
+
+    def __init__(self, path: str):
+        self.path = path
+        self.entries: List[GrepEntry] = []
+        self.match_count = 0
+        self.capped = False  # Stopped at max_matches with lines left unread
+        self.error: Optional[str] = None
+
+
+def compile_line_matcher(
+    keyword: str, use_regex: bool = False, ignore_case: bool = False
+) -> Callable[[str], bool]:
+    """
+    Predicate for lines containing keyword, or matching it as a regex.
+
+    Raises:
+        re.error: If use_regex is set and keyword is not a valid pattern.
+    """
+    if use_regex:
+        pattern = re.compile(keyword, re.IGNORECASE if ignore_case else 0)
+        return lambda line: pattern.search(line) is not None
+    if ignore_case:
+        search_term = keyword.lower()
+        return lambda line: search_term in line.lower()
+    return lambda line: keyword in line
+
+
+def format_context_line(line_num: int, line: str, is_match: bool) -> str:
+    """One output line in read_file_by_keyword format, e.g. '12> matched text'."""
+    return f"{line_num}{'>' if is_match else ' '} {line}"
+
+
+def grep_file(
+    path: str,
+    matcher: Callable[[str], bool],
+    lines_before: int,
+    lines_after: int,
+    max_matches: int,
+    stop_event: Optional[threading.Event] = None,
+) -> GrepResult:
+    """
+    Stream a file line by line and collect matches with surrounding context.
+
+    Only lines_before lines are held back at any time, so memory does not grow
+    with file size. Scanning stops after max_matches matches (plus their
+    trailing context) or once stop_event is set. Files with a NUL byte near
+    the start are treated as binary and skipped.
+    """
+    result = GrepResult(path)
+    before: deque = deque(maxlen=max(0, lines_before))
+    after_remaining = 0
+    last_emitted = 0
+    try:
+        with open(path, "rb", buffering=GREP_READ_BUFFER) as f:
+            if b"\0" in f.peek(GREP_BINARY_PROBE)[:GREP_BINARY_PROBE]:
+                return result
+            for line_num, raw in enumerate(f, 1):
+                if stop_event is not None and line_num % GREP_STOP_CHECK_LINES == 0:
+                    if stop_event.is_set():
+                        break
+                line = raw.decode("utf-8", errors="ignore").rstrip()
+                at_cap = result.match_count >= max_matches
+                is_match = not at_cap and matcher(line)
+                if is_match:
+                    first = line_num - len(before)
+                    if result.entries and first > last_emitted + 1:
+                        result.entries.append(None)
+                    result.entries.extend(before)
+                    before.clear()
+                    result.entries.append((line_num, True, line))
+                    result.match_count += 1
+                    last_emitted = line_num
+                    after_remaining = lines_after
+                elif after_remaining > 0:
+                    result.entries.append((line_num, False, line))
+                    last_emitted = line_num
+                    after_remaining -= 1
+                elif at_cap:
+                    result.capped = True
+                    break
+                else:
+                    before.append((line_num, False, line))
+    except OSError as e:
+        result.error = str(e)
+    return result
+
+
+def _trim_to_cap(
+    result: GrepResult, max_matches: int, lines_after: int
+) -> Tuple[List[GrepEntry], int]:
+    """Entries up to and including the max_matches-th match and its trailing context."""
+    if result.match_count <= max_matches:
+        return result.entries, result.match_count
+    kept: List[GrepEntry] = []
+    seen = 0
+    trailing = None
+    for entry in result.entries:
+        if trailing is not None:
+            if entry is None or entry[1] or trailing == 0:
+                break
+            trailing -= 1
+        elif entry is not None and entry[1]:
+            seen += 1
+            if seen == max_matches:
+                trailing = lines_after
+        kept.append(entry)
+    return kept, max_matches
+
+
+@traced("grep")
+def grep_paths(
+    paths: Iterable[str],
+    matcher: Callable[[str], bool],
+    lines_before: int,
+    lines_after: int,
+    max_matches: int,
+    max_bytes: int,
+    max_workers: int = GREP_MAX_WORKERS,
+) -> Tuple[List[Tuple[str, List[str]]], int, bool]:
+    """
+    Search files in parallel and collect formatted matches in path order.
+
+    paths may be a lazy iterator; only a small window of files is in flight at
+    once, so once max_matches or max_bytes is reached the remaining paths are
+    never opened.
+
+    Returns:
+        ([(path, formatted lines)] for files with matches, total matches,
+        True if the search stopped at a cap before covering every file).
+    """
+    stop_event = threading.Event()
+    sections: List[Tuple[str, List[str]]] = []
+    total_matches = 0
+    total_bytes = 0
+    truncated = False
+    window = max(1, max_workers) * 2
+    path_iter = iter(paths)
+    pending: deque = deque()
+
+    with ThreadPoolExecutor(max_workers=max(1, max_workers)) as executor:
+
+        def submit_next() -> bool:
+            path = next(path_iter, None)
+            if path is None:
+                return False
+            pending.append(
+                executor.submit(
+                    grep_file, path, matcher, lines_before, lines_after,
+                    max_matches - total_matches, stop_event,
+                )
+            )
+            return True
+
+        while len(pending) < window and submit_next():
+            pass
+
+        while pending:
+            result: GrepResult = pending.popleft().result()
+            if result.match_count:
+                entries, count = _trim_to_cap(
+                    result, max_matches - total_matches, lines_after
+                )
+                lines: List[str] = []
+                for entry in entries:
+                    if entry is None:
+                        line = "---"
+                    else:
+                        line = format_context_line(entry[0], entry[2], entry[1])
+                    total_bytes += len(line) + 1
+                    if total_bytes > max_bytes:
+                        truncated = True
+                        break
+                    lines.append(line)
+                    if entry is not None and entry[1]:
+                        total_matches += 1
+                if lines and lines[-1] == "---":
+                    lines.pop()
+                if lines:
+                    sections.append((result.path, lines))
+                if count < result.match_count or result.capped:
+                    truncated = True
+                if total_matches >= max_matches and not truncated:
+                    truncated = bool(pending) or next(path_iter, None) is not None
+            if truncated or total_matches >= max_matches:
+                stop_event.set()
+                for future in pending:
+                    future.cancel()
+                break
+            submit_next()
+
+    return sections, total_matches, truncated
@@ -0,0 +1,132 @@
+# mcp_line_index.py
+
+import os
+import re
+import mmap
+import threading
+from array import array
+from collections import OrderedDict
+from typing import List, Tuple
+
+try:
+    from .mcp_trace import traced
+except ImportError:
+    from mcp_trace import traced
+
+# --- Configuration Constants ---
+LINE_INDEX_STRIDE = 256  # Record the byte offset of every Nth line
+LINE_INDEX_CACHE_SIZE = 128  # Files whose index is kept in memory
+
+# One match per LINE_INDEX_STRIDE complete lines, so the scan runs in the regex engine
+_STRIDE_PATTERN = re.compile(rb"(?:[^\n]*\n){%d}" % LINE_INDEX_STRIDE)
+
+
+class LineIndex:
+    """
+    Sparse newline index for one version of a file.
+
+    block_offsets[k] is the byte offset where line k * LINE_INDEX_STRIDE + 1
+    starts, so any line is at most LINE_INDEX_STRIDE - 1 newline searches
+    away from a known offset. Memory is 8 bytes per LINE_INDEX_STRIDE lines.
+    """
+
+    def __init__(self, stamp: Tuple[int, int], block_offsets: array, total_lines: int):
+        self.stamp = stamp
+        self.block_offsets = block_offsets
+        self.total_lines = total_lines
+
+    @classmethod
+    def build(cls, data, stamp: Tuple[int, int]) -> "LineIndex":
+        size = len(data)
+        block_offsets = array("Q", [0])
+        for match in _STRIDE_PATTERN.finditer(data):
+            block_offsets.append(match.end())
+        tail_start = block_offsets[-1]
+        # A final block end at EOF is not the start of another line
+        if tail_start == size and len(block_offsets) > 1:
+            block_offsets.pop()
+            total_lines = len(block_offsets) * LINE_INDEX_STRIDE
+        else:
+            tail = data[tail_start:size]
+            total_lines = (len(block_offsets) - 1) * LINE_INDEX_STRIDE + tail.count(b"\n")
+            if tail and not tail.endswith(b"\n"):
+                total_lines += 1  # Last line has no trailing newline
+        return cls(stamp, block_offsets, total_lines)
+
+    def line_offset(self, data, line_number: int) -> int:
+        """Byte offset where 1-based line_number starts."""
+        block, skip = divmod(line_number - 1, LINE_INDEX_STRIDE)
+        pos = self.block_offsets[block]
+        for _ in range(skip):
+            pos = data.find(b"\n", pos) + 1
+        return pos
+
+
+# Maps absolute path -> LineIndex, least recently used first
+_line_index_cache: "OrderedDict[str, LineIndex]" = OrderedDict()
+_line_index_lock = threading.Lock()
+
+
+def _get_index(path: str, data, stamp: Tuple[int, int]) -> LineIndex:
+    with _line_index_lock:
+        index = _line_index_cache.get(path)
+        if index is not None and index.stamp == stamp:
+            _line_index_cache.move_to_end(path)
+            return index
+
+    index = LineIndex.build(data, stamp)
+    with _line_index_lock:
+        _line_index_cache[path] = index
+        _line_index_cache.move_to_end(path)
+        while len(_line_index_cache) > LINE_INDEX_CACHE_SIZE:
+            _line_index_cache.popitem(last=False)
+    return index
+
+
+def merge_line_spans(spans: List[Tuple[int, int]]) -> List[Tuple[int, int]]:
+    """Sort inclusive (start, end) spans and merge overlapping or adjacent ones."""
+    merged: List[Tuple[int, int]] = []
+    for start, end in sorted(spans):
+        if merged and start <= merged[-1][1] + 1:
+            merged[-1] = (merged[-1][0], max(merged[-1][1], end))
+        else:
+            merged.append((start, end))
+    return merged
+
+
+@traced("read")
+def read_line_spans(
+    path: str, spans: List[Tuple[int, int]], encoding: str = "utf-8"
+) -> Tuple[int, List[Tuple[int, str]]]:
+    """
+    Read selected lines of a file without loading the rest of it.
+
+    Args:
+        path: Absolute file path.
+        spans: Inclusive 1-based (start, end) line spans, in any order.
+        encoding: Decoding for returned lines; undecodable bytes are dropped.
+
+    Returns:
+        (total line count, [(line number, line text without its newline)]),
+        in line order with each line at most once. Lines past EOF are skipped.
+    """
+    with open(path, "rb") as f:
+        st = os.fstat(f.fileno())
+        stamp = (st.st_mtime_ns, st.st_size)
+        if st.st_size == 0:
+            return 0, []
+        with mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as data:
+            index = _get_index(path, data, stamp)
+            selected: List[Tuple[int, str]] = []
+            for start, end in merge_line_spans(spans):
+                end = min(end, index.total_lines)
+                if start > end:
+                    continue
+                pos = index.line_offset(data, start)
+                for line_number in range(start, end + 1):
+                    newline = data.find(b"\n", pos)
+                    stop = newline if newline != -1 else len(data)
+                    text = data[pos:stop].decode(encoding, errors="ignore")
+                    selected.append((line_number, text.rstrip("\r")))
+                    pos = stop + 1
+            return index.total_lines, selected
@@ -0,0 +1,282 @@
+# mcp_patch.py
+
+import re
+from dataclasses import dataclass, field
+from typing import List, Optional, Tuple
+
+# Identical to cli/mcpdiff_patch.py; keep the two copies in sync.
+
+# --- Configuration Constants ---
+DEFAULT_MAX_FUZZ = 2  # Context lines per hunk end that may be dropped to find a match
+
+_HUNK_HEADER = re.compile(r"^@@ -(\d+)(?:,(\d+))? \+(\d+)(?:,(\d+))? @@")
+_NO_NEWLINE_MARKER = "\\ No newline at end of file"
+_AFTER_NEWLINE = re.compile(r"(?<=\n)")
+
+
+class PatchError(ValueError):
+    """Raised when a diff cannot be parsed or does not apply."""
+
+    pass
+
+
+@dataclass
+class Hunk:
+    """One @@ block. lines holds (tag, text) with tag in ' ', '-', '+'."""
+
+    old_start: int
+    old_count: int
+    new_start: int
+    new_count: int
+    lines: List[Tuple[str, str]] = field(default_factory=list)
+
+    def old_lines(self) -> List[str]:
+        return [text for tag, text in self.lines if tag != "+"]
+
+    def new_lines(self) -> List[str]:
+        return [text for tag, text in self.lines if tag != "-"]
+
+    def reversed(self) -> "Hunk":
+        swap = {" ": " ", "-": "+", "+": "-"}
+        return Hunk(
+            self.new_start,
+            self.new_count,
+            self.old_start,
+            self.old_count,
+            [(swap[tag], text) for tag, text in self.lines],
+        )
+
+
+@dataclass
+class FilePatch:
+    """All hunks for one file in a unified diff."""
+
+    old_path: Optional[str]
+    new_path: Optional[str]
+    hunks: List[Hunk] = field(default_factory=list)
+
+    def reversed(self) -> "FilePatch":
+        return FilePatch(
+            self.new_path, self.old_path, [h.reversed() for h in self.hunks]
+        )
+
+
+@dataclass
+class HunkResult:
+    """Where a hunk landed: offset is relative to its header position, fuzz is dropped context."""
+
+    index: int
+    line: int
+    offset: int
+    fuzz: int
+
+
+def split_lines(text: str) -> List[str]:
+    """
+    Split text into lines with their endings, breaking after "\n" only.
+
+    str.splitlines() also breaks at \x0b, \x0c, \x1c-\x1e, \x85, \u2028 and
+    \u2029; patch does not, so neither may the engine.
+    """
+    lines = _AFTER_NEWLINE.split(text)
+    if lines[-1] == "":
+        lines.pop()
+    return lines
+
+
+def _strip_path(header_value: str) -> Optional[str]:
+    path = header_value.split("\t", 1)[0].strip()
+    if path == "/dev/null":
+        return None
+    if path.startswith(("a/", "b/")):
+        path = path[2:]
+    return path
+
+
+def _strip_last_newline(hunk: Hunk):
+    if hunk.lines:
+        tag, text = hunk.lines[-1]
+        hunk.lines[-1] = (tag, text.rstrip("\r\n"))
+
+
+def parse_unified_diff(diff_text: str) -> List[FilePatch]:
+    """
+    Parse unified diff text (difflib or git style) into FilePatch objects.
+    Hunk bodies are read by their header counts, so '---' inside a hunk is safe.
+    """
+    patches: List[FilePatch] = []
+    current: Optional[FilePatch] = None
+    lines = split_lines(diff_text)
+    i = 0
+    while i < len(lines):
+        line = lines[i]
+        if line.startswith("--- ") and i + 1 < len(lines) and lines[i + 1].startswith("+++ "):
+            current = FilePatch(_strip_path(line[4:]), _strip_path(lines[i + 1][4:]))
+            patches.append(current)
+            i += 2
+            continue
+
+        match = _HUNK_HEADER.match(line)
+        if not match:
+            i += 1  # diff --git, index, mode lines and other noise
+            continue
+        if current is None:
+            current = FilePatch(None, None)
+            patches.append(current)
+
+        hunk = Hunk(
+            int(match.group(1)),
+            int(match.group(2)) if match.group(2) is not None else 1,
+            int(match.group(3)),
+            int(match.group(4)) if match.group(4) is not None else 1,
+        )
+        old_seen = new_seen = 0
+        i += 1
+        while i < len(lines) and (old_seen < hunk.old_count or new_seen < hunk.new_count):
+            body = lines[i]
+            tag = body[:1]
+            if body.startswith("\\"):
+                _strip_last_newline(hunk)  # e.g. "\ No newline at end of file"
+                i += 1
+                continue
+            if tag not in (" ", "-", "+"):
+                if body in ("\n", "\r\n"):
+                    tag, body = " ", " " + body  # Blank context line with its space stripped
+                else:
+                    raise PatchError(f"Malformed hunk line {i + 1}: {body.rstrip()}")
+            hunk.lines.append((tag, body[1:]))
+            if tag != "+":
+                old_seen += 1
+            if tag != "-":
+                new_seen += 1
+            i += 1
+        if old_seen != hunk.old_count or new_seen != hunk.new_count:
+            raise PatchError(
+                f"Truncated hunk @@ -{hunk.old_start},{hunk.old_count} +{hunk.new_start},{hunk.new_count} @@"
+            )
+        # A trailing marker means the last line of that side has no newline
+        if i < len(lines) and lines[i].rstrip("\r\n") == _NO_NEWLINE_MARKER:
+            _strip_last_newline(hunk)
+            i += 1
+        current.hunks.append(hunk)
+    return patches
+
+
+def _same_line(a: str, b: str) -> bool:
+    # Line endings are not significant when locating a hunk
+    return a == b or a.rstrip("\r\n") == b.rstrip("\r\n")
+
+
+def _matches_at(lines: List[str], pos: int, expected: List[str]) -> bool:
+    if pos < 0 or pos + len(expected) > len(lines):
+        return False
+    return all(_same_line(lines[pos + k], expected[k]) for k in range(len(expected)))
+
+
+def _find_hunk(lines: List[str], expected: List[str], guess: int, lower_bound: int) -> Optional[int]:
+    """Search outward from guess for expected, never before lower_bound."""
+    limit = len(lines) - len(expected)
+    for delta in range(0, max(limit - guess, guess - lower_bound, 0) + 1):
+        for pos in (guess + delta, guess - delta) if delta else (guess,):
+            if lower_bound <= pos <= limit and _matches_at(lines, pos, expected):
+                return pos
+    return None
+
+
+def apply_hunks(
+    lines: List[str],
+    hunks: List[Hunk],
+    reverse: bool = False,
+    max_fuzz: int = DEFAULT_MAX_FUZZ,
+) -> Tuple[List[str], List[HunkResult]]:
+    """
+    Apply hunks to a list of lines (with line endings) and return the new lines.
+
+    Each hunk is first looked for at its header position adjusted by the drift
+    of earlier hunks, then progressively further away, then with up to
+    max_fuzz context lines trimmed from each end. The input list is not modified.
+
+    Raises:
+        PatchError: If a hunk cannot be located.
+    """
+    result: List[str] = []
+    cursor = 0  # Index in lines up to which output has been produced
+    drift = 0
+    diagnostics: List[HunkResult] = []
+
+    for n, hunk in enumerate(hunks):
+        if reverse:
+            hunk = hunk.reversed()
+        body = hunk.lines
+        placed: Optional[Tuple[int, int, int, int]] = None
+        tried = set()
+        for fuzz in range(0, max_fuzz + 1):
+            lead = 0
+            while lead < min(fuzz, len(body)) and body[lead][0] == " ":
+                lead += 1
+            trail = 0
+            while trail < min(fuzz, len(body) - lead) and body[len(body) - 1 - trail][0] == " ":
+                trail += 1
+            if (lead, trail) in tried:
+                continue  # Context already exhausted at both ends
+            tried.add((lead, trail))
+            trimmed = body[lead : len(body) - trail]
+            expected = [text for tag, text in trimmed if tag != "+"]
+            # For pure insertions the start line is the line *after* which to insert
+            start = hunk.old_start - 1 if hunk.old_count else hunk.old_start
+            guess = max(start + lead + drift, cursor)
+            pos = _find_hunk(lines, expected, guess, cursor)
+            if pos is not None:
+                placed = (pos, lead, trail, max(lead, trail))
+                break
+        if placed is None:
+            raise PatchError(
+                f"Hunk #{n + 1} (@@ -{hunk.old_start},{hunk.old_count} +{hunk.new_start},{hunk.new_count} @@) does not apply"
+            )
+
+        pos, lead, trail, fuzz_used = placed
+        trimmed = body[lead : len(body) - trail]
+        old_len = sum(1 for tag, _ in trimmed if tag != "+")
+        result.extend(lines[cursor:pos])
+        result.extend(text for tag, text in trimmed if tag != "-")
+        cursor = pos + old_len
+
+        header_pos = (hunk.old_start - 1 if hunk.old_count else hunk.old_start) + lead
+        offset = pos - header_pos
+        drift = offset
+        diagnostics.append(HunkResult(n + 1, pos + 1, offset, fuzz_used))
+
+    result.extend(lines[cursor:])
+    return result, diagnostics
+
+
+def apply_patch_to_lines(
+    lines: List[str],
+    diff_text: str,
+    reverse: bool = False,
+    max_fuzz: int = DEFAULT_MAX_FUZZ,
+) -> Tuple[List[str], List[HunkResult]]:
+    """
+    Apply (or with reverse=True, undo) a single-file unified diff to lines.
+
+    Raises:
+        PatchError: If the diff is malformed, touches several files, or does not apply.
+    """
+    patches = [p for p in parse_unified_diff(diff_text) if p.hunks]
+    if not patches:
+        return list(lines), []
+    if len(patches) > 1:
+        raise PatchError(f"Diff touches {len(patches)} files, expected one")
+    return apply_hunks(lines, patches[0].hunks, reverse=reverse, max_fuzz=max_fuzz)
+
+
+def format_diagnostics(diagnostics: List[HunkResult]) -> str:
+    """Summarise hunks that needed an offset or fuzz, patch(1) style."""
+    notes = [
+        f"Hunk #{d.index} succeeded at {d.line}"
+        + (f" with fuzz {d.fuzz}" if d.fuzz else "")
+        + (f" (offset {d.offset} line{'s' if abs(d.offset) != 1 else ''})" if d.offset else "")
+        for d in diagnostics
+        if d.offset or d.fuzz
+    ]
+    return "; ".join(notes)
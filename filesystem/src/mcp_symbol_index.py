@@ -0,0 +1,628 @@
+# mcp_symbol_index.py
+
+import os
+import json
+import atexit
+import hashlib
+import threading
+import multiprocessing
+from concurrent.futures import ProcessPoolExecutor
+from concurrent.futures.process import BrokenProcessPool
+from pathlib import Path
+from typing import Optional, List, Dict, Any, Tuple, Callable
+
+try:
+    from .mcp_edit_utils import get_mcp_root, sanitize_path_for_filename, log
+    from .mcp_trace import span, traced
+    from .grammar.regex_parser import get_parser_for_file, CodeElement, ElementType
+except ImportError:
+    from mcp_edit_utils import get_mcp_root, sanitize_path_for_filename, log
+    from mcp_trace import span, traced
+    from src.grammar.regex_parser import get_parser_for_file, CodeElement, ElementType
+
+# --- Configuration Constants ---
+SYMBOL_INDEX_DIR_NAME = ".mcp/symbol_index"
+INDEX_FORMAT_VERSION = 1  # Bump when the serialized layout changes
+PARALLEL_PARSE_MIN_FILES = 8  # Below this many index misses, parse in-process
+PARSE_POOL_WORKERS = os.cpu_count() or 1  # Worker processes of the parse pool
+
+# --- In-Memory Cache ---
+# Maps absolute file path -> entry dict (see load_symbols). Elements are kept
+# deserialized so repeat lookups skip both the parse and the JSON load.
+_memory_index: Dict[str, Dict[str, Any]] = {}
+# Maps absolute file path -> symbols from before a tracked edit plus the edited
+# line range, so the next lookup can re-parse only the damaged region.
+_pending_edits: Dict[str, Dict[str, Any]] = {}
+_memory_index_lock = threading.Lock()
+
+# --- Cross-File Name Index ---
+# Maps symbol name and qualified name -> {absolute file path: [elements]}.
+# Built from the per-file entries above and refreshed file by file when a
+# file's (mtime_ns, size) stamp changes.
+_name_index: Dict[str, Dict[str, List[CodeElement]]] = {}
+# Maps absolute file path -> (stat stamp, names it contributed to _name_index)
+_name_index_files: Dict[str, Tuple[Tuple[int, int], List[str]]] = {}
+_name_index_lock = threading.Lock()
+
+
+def serialize_elements(elements: List[CodeElement]) -> List[Dict[str, Any]]:
+    """
+    Flatten a parsed element list into JSON-compatible dicts.
+
+    Tree structure is stored as an index into the same list. Parents that the
+    parser did not return in its flat list are appended with "listed": False
+    so that parent lookups still work after a round trip.
+    """
+    ordered: List[CodeElement] = list(elements)
+    positions: Dict[int, int] = {id(e): i for i, e in enumerate(ordered)}
+    listed_count = len(ordered)
+
+    i = 0
+    while i < len(ordered):
+        parent = ordered[i].parent
+        if parent is not None and id(parent) not in positions:
+            positions[id(parent)] = len(ordered)
+            ordered.append(parent)
+        i += 1
+
+    serialized = []
+    for i, elem in enumerate(ordered):
+        data = elem.to_dict()
+        data["parent"] = positions[id(elem.parent)] if elem.parent else None
+        data["listed"] = i < listed_count
+        serialized.append(data)
+    return serialized
+
+
+def deserialize_elements(data: List[Dict[str, Any]]) -> List[CodeElement]:
+    """Rebuild the element list produced by serialize_elements()."""
+    elements = [CodeElement.from_dict(d) for d in data]
+    for elem, d in zip(elements, data):
+        parent_index = d.get("parent")
+        if parent_index is not None:
+            elem.parent = elements[parent_index]
+            elements[parent_index].children.append(elem)
+    return [elem for elem, d in zip(elements, data) if d.get("listed", True)]
+
+
+def _index_file_for(abs_path: str) -> Optional[Path]:
+    """Return the on-disk index file for a source file, or None outside a workspace."""
+    mcp_root = get_mcp_root(abs_path)
+    if not mcp_root:
+        return None
+    sanitized = sanitize_path_for_filename(abs_path, mcp_root)
+    return mcp_root / SYMBOL_INDEX_DIR_NAME / f"{sanitized}.json"
+
+
+@traced("read")
+def _read_source(abs_path: str) -> Tuple[str, str]:
+    """Read a file once, returning (text, sha256). Text matches open(..., 'r', errors='ignore')."""
+    with open(abs_path, "rb") as f:
+        raw = f.read()
+    sha256 = hashlib.sha256(raw).hexdigest()
+    # Mirror text-mode universal newline handling so parse results are identical
+    text = raw.decode("utf-8", errors="ignore").replace("\r\n", "\n").replace("\r", "\n")
+    return text, sha256
+
+
+def _load_disk_entry(index_file: Optional[Path]) -> Optional[Dict[str, Any]]:
+    if not index_file or not index_file.is_file():
+        return None
+    try:
+        with open(index_file, "r", encoding="utf-8") as f:
+            entry = json.load(f)
+    except (IOError, json.JSONDecodeError) as e:
+        log.warning(f"Ignoring unreadable symbol index {index_file}: {e}")
+        return None
+    if entry.get("version") != INDEX_FORMAT_VERSION:
+        return None
+    return entry
+
+
+def _write_disk_entry(index_file: Optional[Path], entry: Dict[str, Any]):
+    """Persist an index entry atomically. Failures are logged, never raised."""
+    if not index_file:
+        return
+    temp_path = index_file.with_suffix(index_file.suffix + ".tmp")
+    try:
+        index_file.parent.mkdir(parents=True, exist_ok=True)
+        with open(temp_path, "w", encoding="utf-8") as f:
+            json.dump(entry, f, separators=(",", ":"), default=str)
+        os.replace(temp_path, index_file)
+    except (IOError, OSError, TypeError) as e:
+        log.warning(f"Could not write symbol index {index_file}: {e}")
+        if temp_path.exists():
+            os.remove(temp_path)
+
+
+def _stored_elements(
+    abs_path: str,
+    parser_name: str,
+    sha256: str,
+    cached: Optional[Dict[str, Any]],
+    index_file: Optional[Path],
+) -> Optional[List[CodeElement]]:
+    """Return the in-memory or on-disk tree if it was built from this content by this parser."""
+    if cached and cached["sha256"] == sha256 and cached["parser"] == parser_name:
+        return cached["elements"]
+    disk_entry = _load_disk_entry(index_file)
+    if (
+        disk_entry
+        and disk_entry.get("sha256") == sha256
+        and disk_entry.get("parser") == parser_name
+    ):
+        try:
+            return deserialize_elements(disk_entry["elements"])
+        except (KeyError, IndexError, ValueError, TypeError) as e:
+            log.warning(f"Discarding corrupt symbol index for {abs_path}: {e}")
+    return None
+
+
+def _build_entry(
+    abs_path: str,
+    parser: Any,
+    st: os.stat_result,
+    cached: Optional[Dict[str, Any]] = None,
+    pending: Optional[Dict[str, Any]] = None,
+) -> Dict[str, Any]:
+    """
+    Produce a fresh memory entry for a file whose stat no longer matches.
+
+    Reuses the in-memory or on-disk tree when the content hash still matches,
+    otherwise re-parses (incrementally when a pending edit applies) and
+    persists the result.
+    """
+    parser_name = type(parser).__name__
+    code, sha256 = _read_source(abs_path)
+    index_file = _index_file_for(abs_path)
+
+    elements = _stored_elements(abs_path, parser_name, sha256, cached, index_file)
+    if elements is None:
+        if pending and pending["sha256"] == sha256:
+            try:
+                with span("parse"):
+                    elements = parser.reparse(
+                        pending["elements"], pending["edit_range"], code
+                    )
+            except Exception as e:
+                log.warning(f"Incremental re-parse failed for {abs_path}: {e}")
+        if elements is None:
+            with span("parse"):
+                elements = parser.parse(code)
+        _write_disk_entry(
+            index_file,
+            {
+                "version": INDEX_FORMAT_VERSION,
+                "path": abs_path,
+                "parser": parser_name,
+                "mtime_ns": st.st_mtime_ns,
+                "size": st.st_size,
+                "sha256": sha256,
+                "elements": serialize_elements(elements),
+            },
+        )
+
+    return {
+        "parser": parser_name,
+        "mtime_ns": st.st_mtime_ns,
+        "size": st.st_size,
+        "sha256": sha256,
+        "elements": elements,
+    }
+
+
+def _fresh_cached_elements(abs_path: str, st: os.stat_result) -> Optional[List[CodeElement]]:
+    """Return in-memory elements whose recorded mtime and size still match."""
+    with _memory_index_lock:
+        cached = _memory_index.get(abs_path)
+    if cached and cached["mtime_ns"] == st.st_mtime_ns and cached["size"] == st.st_size:
+        return cached["elements"]
+    return None
+
+
+def load_symbols(file_path: str) -> Optional[List[CodeElement]]:
+    """
+    Return the parsed symbols of a file, using the persistent index when valid.
+
+    An index entry is keyed by path plus (mtime, size, sha256). A matching
+    mtime and size is trusted directly; otherwise the content hash decides
+    whether the stored tree is still current before falling back to a parse.
+
+    Args:
+        file_path: Absolute, already validated path to the file.
+
+    Returns:
+        The list of CodeElement objects, or None if no parser handles the file.
+
+    Raises:
+        OSError: If the file cannot be read.
+        Exception: Any error raised by the parser.
+    """
+    abs_path = os.path.abspath(file_path)
+    st = os.stat(abs_path)
+
+    fresh = _fresh_cached_elements(abs_path, st)
+    if fresh is not None:
+        return fresh
+
+    parser = get_parser_for_file(abs_path)
+    if not parser:
+        return None
+
+    with _memory_index_lock:
+        cached = _memory_index.get(abs_path)
+        pending = _pending_edits.pop(abs_path, None)
+    entry = _build_entry(abs_path, parser, st, cached, pending)
+
+    with _memory_index_lock:
+        _memory_index[abs_path] = entry
+    return entry["elements"]
+
+
+def _outside_functions(elements: List[CodeElement]) -> List[CodeElement]:
+    """Elements that are not nested in a function or method body."""
+    result = []
+    for element in elements:
+        parent = element.parent
+        while parent is not None and parent.element_type not in (
+            ElementType.FUNCTION,
+            ElementType.METHOD,
+        ):
+            parent = parent.parent
+        if parent is None:
+            result.append(element)
+    return result
+
+
+def _load_partial(
+    file_path: str, parse: Callable[[Any, str], List[CodeElement]]
+) -> Tuple[Optional[List[CodeElement]], bool]:
+    """
+    Shared path of load_symbol_outline() and load_symbols_named().
+
+    Returns (elements, complete). A current in-memory or on-disk tree is
+    returned whole and kept in memory, as is the result of resolving a pending
+    edit. Otherwise parse(parser, code) produces a partial result that is not
+    stored, since the index only ever holds complete trees.
+    """
+    abs_path = os.path.abspath(file_path)
+    st = os.stat(abs_path)
+
+    fresh = _fresh_cached_elements(abs_path, st)
+    if fresh is not None:
+        return fresh, True
+
+    parser = get_parser_for_file(abs_path)
+    if not parser:
+        return None, True
+
+    with _memory_index_lock:
+        cached = _memory_index.get(abs_path)
+        has_pending = abs_path in _pending_edits
+    if has_pending:
+        return load_symbols(abs_path), True
+
+    parser_name = type(parser).__name__
+    code, sha256 = _read_source(abs_path)
+    elements = _stored_elements(abs_path, parser_name, sha256, cached, _index_file_for(abs_path))
+    if elements is not None:
+        with _memory_index_lock:
+            _memory_index[abs_path] = {
+                "parser": parser_name,
+                "mtime_ns": st.st_mtime_ns,
+                "size": st.st_size,
+                "sha256": sha256,
+                "elements": elements,
+            }
+        return elements, True
+    with span("parse"):
+        return parse(parser, code), False
+
+
+def load_symbol_outline(file_path: str) -> Optional[List[CodeElement]]:
+    """
+    Return the symbols of a file that are not nested in a function body.
+
+    Served from the index when it is current; otherwise the parser's
+    parse_outline() skips function bodies instead of parsing them. The
+    outline is not stored, so a later load_symbols() still parses in full.
+
+    Args:
+        file_path: Absolute, already validated path to the file.
+
+    Returns:
+        The list of CodeElement objects, or None if no parser handles the file.
+
+    Raises:
+        OSError: If the file cannot be read.
+        Exception: Any error raised by the parser.
+    """
+    elements, complete = _load_partial(file_path, lambda parser, code: parser.parse_outline(code))
+    if elements is None or not complete:
+        return elements
+    return _outside_functions(elements)
+
+
+def load_symbols_named(file_path: str, name: str) -> Optional[List[CodeElement]]:
+    """
+    Return a symbol list of a file that holds every element called name.
+
+    Served whole from the index when it is current; otherwise the parser's
+    parse_symbol() deep-parses only the function bodies that mention name,
+    so other nested elements may be missing. Not stored in the index.
+
+    Args:
+        file_path: Absolute, already validated path to the file.
+        name: Name of the symbol being looked up.
+
+    Returns:
+        The list of CodeElement objects, or None if no parser handles the file.
+
+    Raises:
+        OSError: If the file cannot be read.
+        Exception: Any error raised by the parser.
+    """
+    elements, _ = _load_partial(file_path, lambda parser, code: parser.parse_symbol(code, name))
+    return elements
+
+
+def _load_symbols_in_worker(abs_path: str) -> Tuple[str, Optional[Dict[str, Any]], Optional[str]]:
+    """
+    Process pool entry point: build an index entry for one file.
+
+    Returns (path, entry with serialized elements or None, error message or None).
+    Must stay a module-level function so it can be pickled.
+    """
+    try:
+        st = os.stat(abs_path)
+        parser = get_parser_for_file(abs_path)
+        if not parser:
+            return abs_path, None, None
+        entry = _build_entry(abs_path, parser, st)
+        entry["elements"] = serialize_elements(entry["elements"])
+        return abs_path, entry, None
+    except Exception as e:
+        return abs_path, None, str(e)
+
+
+# Parse workers, started on first use and kept for later batches
+_parse_pool: Optional[ProcessPoolExecutor] = None
+_parse_pool_lock = threading.Lock()
+
+
+def get_parse_pool() -> ProcessPoolExecutor:
+    """The parse worker pool, started on first use"""
+    global _parse_pool
+    with _parse_pool_lock:
+        if _parse_pool is None:
+            # Workers are started by a fork server: forking this multi-threaded
+            # process directly could copy locks held by other threads
+            methods = multiprocessing.get_all_start_methods()
+            context = multiprocessing.get_context("forkserver" if "forkserver" in methods else "spawn")
+            _parse_pool = ProcessPoolExecutor(max_workers=PARSE_POOL_WORKERS, mp_context=context)
+        return _parse_pool
+
+
+def close_parse_pool():
+    global _parse_pool
+    with _parse_pool_lock:
+        if _parse_pool is not None:
+            _parse_pool.shutdown(wait=False, cancel_futures=True)
+            _parse_pool = None
+
+
+atexit.register(close_parse_pool)
+
+
+def load_symbols_many(
+    file_paths: List[str],
+) -> Tuple[Dict[str, Optional[List[CodeElement]]], Dict[str, str]]:
+    """
+    Load symbols for many files, parsing index misses in a process pool.
+
+    The parsers are pure Python and hold the GIL, so files that are not
+    already current in memory are fanned out to the worker processes of
+    get_parse_pool(). Small batches are parsed inline, as is everything
+    when the pool breaks.
+
+    Args:
+        file_paths: Absolute, already validated file paths.
+
+    Returns:
+        (symbols, errors): symbols maps each path to its elements (None when no
+        parser handles it); errors maps paths that failed to an error message.
+    """
+    symbols: Dict[str, Optional[List[CodeElement]]] = {}
+    errors: Dict[str, str] = {}
+    misses: List[str] = []
+
+    for file_path in file_paths:
+        abs_path = os.path.abspath(file_path)
+        try:
+            fresh = _fresh_cached_elements(abs_path, os.stat(abs_path))
+        except OSError as e:
+            errors[abs_path] = str(e)
+            continue
+        with _memory_index_lock:
+            has_pending = abs_path in _pending_edits
+        if fresh is not None:
+            symbols[abs_path] = fresh
+        elif has_pending:
+            # Pending edits are resolved by an incremental re-parse in-process
+            try:
+                symbols[abs_path] = load_symbols(abs_path)
+            except Exception as e:
+                errors[abs_path] = str(e)
+        else:
+            misses.append(abs_path)
+
+    if len(misses) < PARALLEL_PARSE_MIN_FILES:
+        for abs_path in misses:
+            try:
+                symbols[abs_path] = load_symbols(abs_path)
+            except Exception as e:
+                errors[abs_path] = str(e)
+        return symbols, errors
+
+    chunksize = max(1, len(misses) // (PARSE_POOL_WORKERS * 4))
+    try:
+        results = get_parse_pool().map(_load_symbols_in_worker, misses, chunksize=chunksize)
+        for abs_path, entry, error in results:
+            if error is not None:
+                errors[abs_path] = error
+                continue
+            if entry is None:
+                symbols[abs_path] = None
+                continue
+            entry["elements"] = deserialize_elements(entry["elements"])
+            with _memory_index_lock:
+                _memory_index[abs_path] = entry
+            symbols[abs_path] = entry["elements"]
+    except BrokenProcessPool:
+        # A worker died (e.g. killed for memory); start fresh ones next time
+        log.warning("Symbol parse pool broke, parsing the rest in-process")
+        close_parse_pool()
+        for abs_path in misses:
+            if abs_path in symbols or abs_path in errors:
+                continue
+            try:
+                symbols[abs_path] = load_symbols(abs_path)
+            except Exception as e:
+                errors[abs_path] = str(e)
+
+    return symbols, errors
+
+
+def get_cached_symbols(file_path: str, sha256: Optional[str]) -> Optional[List[CodeElement]]:
+    """Return in-memory symbols for a file if they were built from content with this hash."""
+    with _memory_index_lock:
+        cached = _memory_index.get(os.path.abspath(file_path))
+    if cached and sha256 and cached["sha256"] == sha256:
+        return cached["elements"]
+    return None
+
+
+def note_symbol_edit(
+    file_path: str,
+    old_elements: List[CodeElement],
+    edit_range: Tuple[int, int, int],
+    sha256_after: Optional[str],
+):
+    """
+    Remember the pre-edit symbols and changed line range of a tracked edit.
+
+    The next load_symbols() call re-parses only the damaged region via the
+    parser's reparse(), provided the file still hashes to sha256_after.
+    """
+    if not sha256_after:
+        return
+    with _memory_index_lock:
+        _pending_edits[os.path.abspath(file_path)] = {
+            "elements": old_elements,
+            "edit_range": edit_range,
+            "sha256": sha256_after,
+        }
+
+
+def _remove_from_name_index(abs_path: str):
+    """Drop a file's postings from the name index. Caller holds _name_index_lock."""
+    _, names = _name_index_files.pop(abs_path, (None, []))
+    for name in names:
+        postings = _name_index.get(name)
+        if postings is not None:
+            postings.pop(abs_path, None)
+            if not postings:
+                del _name_index[name]
+
+
+def _add_to_name_index(abs_path: str, stamp: Tuple[int, int], elements: List[CodeElement]):
+    """Index a file's elements by name and qualified name. Caller holds _name_index_lock."""
+    names: List[str] = []
+    for elem in elements:
+        for name in {elem.name, elem.get_full_name()}:
+            if not name:
+                continue
+            postings = _name_index.setdefault(name, {})
+            if abs_path not in postings:
+                postings[abs_path] = []
+                names.append(name)
+            postings[abs_path].append(elem)
+    _name_index_files[abs_path] = (stamp, names)
+
+
+def refresh_name_index(file_paths: List[str]) -> Dict[str, str]:
+    """
+    Bring the name index up to date for exactly this set of files.
+
+    Files whose stat stamp is unchanged keep their postings; changed or new
+    files are loaded through load_symbols_many() and files no longer in the
+    set are dropped. The first call therefore indexes everything, later calls
+    only cost a stat per file.
+
+    Returns:
+        Mapping of file path -> error message for files that could not be parsed.
+    """
+    stamps: Dict[str, Tuple[int, int]] = {}
+    errors: Dict[str, str] = {}
+    for file_path in file_paths:
+        abs_path = os.path.abspath(file_path)
+        try:
+            st = os.stat(abs_path)
+        except OSError as e:
+            errors[abs_path] = str(e)
+            continue
+        stamps[abs_path] = (st.st_mtime_ns, st.st_size)
+
+    with _name_index_lock:
+        for abs_path in list(_name_index_files):
+            if abs_path not in stamps:
+                _remove_from_name_index(abs_path)
+        stale = [
+            p
+            for p, stamp in stamps.items()
+            if _name_index_files.get(p, (None,))[0] != stamp
+        ]
+
+    if not stale:
+        return errors
+
+    symbols, load_errors = load_symbols_many(stale)
+    errors.update(load_errors)
+    with _name_index_lock:
+        for abs_path in stale:
+            _remove_from_name_index(abs_path)
+            if abs_path in symbols:
+                _add_to_name_index(abs_path, stamps[abs_path], symbols[abs_path] or [])
+    return errors
+
+
+def lookup_symbol(name: str) -> List[Tuple[str, CodeElement]]:
+    """
+    Return (file path, element) pairs whose name or qualified name equals name.
+    Call refresh_name_index() first to pick up file changes.
+    """
+    with _name_index_lock:
+        postings = _name_index.get(name, {})
+        matches = [(path, elem) for path, elems in postings.items() for elem in elems]
+    return sorted(matches, key=lambda m: (m[0], m[1].start_line))
+
+
+def invalidate_symbols(file_path: str):
+    """Drop any cached symbols for a file. Called after tracked writes."""
+    abs_path = os.path.abspath(file_path)
+    with _memory_index_lock:
+        _memory_index.pop(abs_path, None)
+        _pending_edits.pop(abs_path, None)
+    with _name_index_lock:
+        # Keep the postings but force the next refresh to reload this file
+        if abs_path in _name_index_files:
+            _, names = _name_index_files[abs_path]
+            _name_index_files[abs_path] = ((-1, -1), names)
+    index_file = _index_file_for(abs_path)
+    if index_file:
+        try:
+            index_file.unlink()
+        except FileNotFoundError:
+            pass
+        except OSError as e:
+            log.warning(f"Could not remove symbol index {index_file}: {e}")
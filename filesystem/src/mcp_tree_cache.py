@@ -0,0 +1,171 @@
+# mcp_tree_cache.py
+
+import os
+import time
+import fnmatch
+import threading
+import subprocess
+from collections import OrderedDict
+from typing import Dict, Iterator, List, NamedTuple, Optional, Tuple
+
+# --- Configuration Constants ---
+TREE_CACHE_MAX_DIRS = 65536  # Directory listings kept in memory
+# A listing taken within this long of the directory's last change may have
+# missed a second change in the same mtime tick, so it is not trusted
+RACY_WINDOW_NS = 2 * 10**9
+
+
+class DirEntry(NamedTuple):
+    name: str
+    kind: str  # "dir", "file", "link" or "other"
+    link_target: Optional[str] = None  # Only set for links
+
+
+class _Listing(NamedTuple):
+    stamp: Tuple[int, int, int]  # (st_dev, st_ino, st_mtime_ns) of the directory
+    listed_at_ns: int
+    entries: List[DirEntry]
+
+
+# Maps absolute directory path -> _Listing, least recently used first
+_listing_cache: "OrderedDict[str, _Listing]" = OrderedDict()
+# Maps git root -> (stamp of .git/index, tracked paths relative to the root)
+_tracked_cache: Dict[str, Tuple[Tuple[int, int], List[str]]] = {}
+_tree_cache_lock = threading.Lock()
+
+
+def _dir_stamp(st: os.stat_result) -> Tuple[int, int, int]:
+    return (st.st_dev, st.st_ino, st.st_mtime_ns)
+
+
+def _scan(path: str) -> List[DirEntry]:
+    entries = []
+    with os.scandir(path) as it:
+        for item in it:
+            if item.is_symlink():
+                try:
+                    target = os.readlink(item.path)
+                except OSError:
+                    target = None
+                entries.append(DirEntry(item.name, "link", target))
+            elif item.is_dir(follow_symlinks=False):
+                entries.append(DirEntry(item.name, "dir"))
+            elif item.is_file(follow_symlinks=False):
+                entries.append(DirEntry(item.name, "file"))
+            else:
+                entries.append(DirEntry(item.name, "other"))
+    entries.sort(key=lambda e: e.name)
+    return entries
+
+
+def list_directory_cached(path: str) -> List[DirEntry]:
+    """
+    Sorted entries of a directory, answered from memory while its mtime is unchanged.
+
+    Adding, removing or renaming an entry updates the directory's mtime, so one
+    stat of the directory is enough to tell whether the listing is still valid.
+
+    Raises:
+        OSError: If the directory cannot be read.
+    """
+    stamp = _dir_stamp(os.stat(path))
+    with _tree_cache_lock:
+        cached = _listing_cache.get(path)
+        if (
+            cached is not None
+            and cached.stamp == stamp
+            and cached.listed_at_ns - stamp[2] >= RACY_WINDOW_NS
+        ):
+            _listing_cache.move_to_end(path)
+            return cached.entries
+
+    listed_at_ns = time.time_ns()
+    entries = _scan(path)
+    with _tree_cache_lock:
+        _listing_cache[path] = _Listing(stamp, listed_at_ns, entries)
+        _listing_cache.move_to_end(path)
+        while len(_listing_cache) > TREE_CACHE_MAX_DIRS:
+            _listing_cache.popitem(last=False)
+    return entries
+
+
+def walk_files_cached(
+    path: str, excludePatterns: Optional[List[str]] = None
+) -> Iterator[Tuple[str, DirEntry]]:
+    """
+    Yield (full path, entry) for every non-directory below path, from cached listings.
+
+    An unchanged tree costs one stat per directory. Symlinks are yielded as
+    entries but never followed; unreadable directories are skipped.
+    """
+    excludePatterns = excludePatterns or []
+    stack = [path]
+    while stack:
+        root = stack.pop()
+        try:
+            entries = list_directory_cached(root)
+        except OSError:
+            continue
+        subdirs = []
+        for entry in entries:
+            if any(fnmatch.fnmatch(entry.name, pat) for pat in excludePatterns):
+                continue
+            full_path = os.path.join(root, entry.name)
+            if entry.kind == "dir":
+                subdirs.append(full_path)
+            else:
+                yield full_path, entry
+        stack.extend(reversed(subdirs))
+
+
+def path_exists_cached(path: str) -> bool:
+    """True if path is an entry of its parent directory's (cached) listing."""
+    parent, name = os.path.split(path)
+    try:
+        return any(e.name == name for e in list_directory_cached(parent))
+    except OSError:
+        return False
+
+
+def tracked_files_cached(git_cmd: str, git_root: str) -> List[str]:
+    """
+    Paths tracked by git relative to git_root, re-listed only when .git/index changes.
+
+    safe.directory is passed for this command only, so the user's global git
+    config is left untouched.
+
+    Raises:
+        subprocess.CalledProcessError: If git ls-files fails.
+    """
+    index_path = os.path.join(git_root, ".git", "index")
+    try:
+        st = os.stat(index_path)
+        stamp: Optional[Tuple[int, int]] = (st.st_mtime_ns, st.st_size)
+    except OSError:
+        stamp = None  # Worktree (.git is a file) or empty repo: don't cache
+    if stamp is not None:
+        with _tree_cache_lock:
+            cached = _tracked_cache.get(git_root)
+            if cached is not None and cached[0] == stamp:
+                return cached[1]
+
+    result = subprocess.run(
+        [git_cmd, "-c", f"safe.directory={git_root}", "-C", git_root, "ls-files", "-z"],
+        capture_output=True,
+        check=True,
+    )
+    tracked = [
+        rel_file
+        for rel_file in result.stdout.decode("utf-8", errors="surrogateescape").split("\0")
+        if rel_file
+    ]
+    if stamp is not None:
+        with _tree_cache_lock:
+            _tracked_cache[git_root] = (stamp, tracked)
+    return tracked
+
+
+def clear_tree_cache() -> None:
+    with _tree_cache_lock:
+        _listing_cache.clear()
+        _tracked_cache.clear()
@@ -0,0 +1,90 @@
+# mcp_walk.py
+
+import os
+import fnmatch
+from typing import Iterator, List, Optional
+
+try:
+    from .mcp_edit_utils import get_allowed_trie, normalize_path, log
+except ImportError:
+    from mcp_edit_utils import get_allowed_trie, normalize_path, log
+
+
+def _link_allowed(path: str, allowed_trie) -> bool:
+    """True if a symlink resolves to somewhere inside the allowed directories."""
+    try:
+        return allowed_trie.contains(normalize_path(os.path.realpath(path)))
+    except OSError:
+        return False
+
+
+def walk_matches(
+    validated_start_path: str,
+    allowed_directories: List[str],
+    pattern: str = "*",
+    excludePatterns: Optional[List[str]] = None,
+    include_files: bool = True,
+    include_dirs: bool = True,
+    max_depth: Optional[int] = None,
+) -> Iterator[str]:
+    """
+    Walk a validated directory with os.scandir and yield full paths whose names match pattern.
+
+    Yields the same paths, in the same order, as an os.walk(topdown=True,
+    followlinks=False) pass that validates every match. Most entries need no
+    extra syscalls, because scandir reports their type from the directory
+    read. Symlinks are never followed. They are yielded only when they resolve
+    inside allowed_directories, which is the one per-entry check the walk
+    needs: every other entry inherits its directory's validation.
+
+    Args:
+        validated_start_path: Directory already accepted by validate_path.
+        allowed_directories: Allowed roots, checked through a cached prefix trie.
+        pattern: Glob matched against entry names.
+        excludePatterns: Glob patterns; matching directories are not entered.
+        include_files: Yield matching files (and symlinks to non-directories).
+        include_dirs: Yield matching directories (and symlinks to directories).
+        max_depth: Directories this many levels below the start are not read.
+    """
+    excludePatterns = excludePatterns or []
+    allowed_trie = get_allowed_trie(allowed_directories)
+    stack = [(validated_start_path, 0)]
+    while stack:
+        root, depth = stack.pop()
+        if max_depth is not None and depth >= max_depth:
+            continue
+        try:
+            with os.scandir(root) as it:
+                entries = list(it)
+        except OSError as e:
+            log.warning(f"Skipping unreadable directory '{root}' during search: {e}")
+            continue
+
+        subdirs = []
+        matched_dirs = []
+        matched_files = []
+        for entry in entries:
+            name = entry.name
+            if any(fnmatch.fnmatch(name, pat) for pat in excludePatterns):
+                continue
+            try:
+                is_link = entry.is_symlink()
+                is_dir = entry.is_dir()  # Follows links, as os.walk does for its dirs list
+            except OSError:
+                continue
+            if is_dir:
+                if not is_link:
+                    subdirs.append(entry.path)
+                if include_dirs and fnmatch.fnmatch(name, pattern):
+                    matched_dirs.append((entry.path, is_link))
+            elif include_files and fnmatch.fnmatch(name, pattern):
+                matched_files.append((entry.path, is_link))
+
+        for full_path, is_link in matched_dirs + matched_files:
+            if is_link and not _link_allowed(full_path, allowed_trie):
+                continue
+            yield full_path
+
+        # Reversed so that the first subdirectory is walked next
+        for subdir in reversed(subdirs):
+            stack.append((subdir, depth + 1))
@@ -1,15 +1,29 @@
 import sys
 import os
 import json
+import re
+import time
+import codecs
 import asyncio
+import hashlib
 import httpx
 import markdownify
+import multiprocessing
+from collections import OrderedDict, deque
+from concurrent.futures import ProcessPoolExecutor
+from concurrent.futures.process import BrokenProcessPool
+from contextlib import asynccontextmanager
 from datetime import datetime
+from email.utils import parsedate_to_datetime
+from urllib.parse import parse_qsl, urlencode, urlsplit, urlunsplit
+from urllib.robotparser import RobotFileParser
 from typing import Optional, List, Dict, Any, Tuple
 from pydantic import AnyUrl, ValidationError
 
 from mcp.server.fastmcp import FastMCP
 
+from mcp_trace import add_bytes, instrument, span, start_metrics_server, traced
+
 MCP_INSTRUCTIONS = """
 This Web Processing MCP Server enables you to retrieve, crawl, search, and intelligently process web content, transforming raw web data into structured, useful information.
 
@@ -22,6 +36,7 @@ Key capabilities:
 - Use `crawl_url_and_process` for deep analysis of entire website sections with an AI agent according to your instructions
 - Use `search_web` when you need to find information across the internet on a specific topic
 - Use `search_web_and_process` when you need to synthesize search results into coherent insights with an AI agent according to your instructions. This is useful when going through many results
+- Use `get_server_stats` to see per-tool latency (p50/p99) broken down into fetch, convert and AI processing time
 
 For optimal performance:
 - Provide clear, specific instructions when using AI processing agents
@@ -30,9 +45,6 @@ For optimal performance:
 - Consider content size limits based on the type and depth of information you're looking for
 """
 
-# Create MCP server
-mcp = FastMCP("web-processing-server", instructions=MCP_INSTRUCTIONS)
-
 # Default timeout for requests (in seconds)
 DEFAULT_TIMEOUT = 30
 # Default max length for fetched content before sending to AI (characters)
@@ -49,6 +61,8 @@ DEFAULT_OPENAI_MAX_TOKENS = 10000
 DEFAULT_SEARCH_COUNT = 10
 # Brave API Endpoint
 BRAVE_SEARCH_API_URL = "https://api.search.brave.com/res/v1/web/search"
+# Port for a Prometheus /metrics HTTP endpoint (unset: only the get_server_stats tool)
+METRICS_PORT = os.environ.get("MCP_WEB_METRICS_PORT")
 
 # --- OpenAI Setup ---
 OPENAI_API_KEY = os.environ.get("OPENAI_API_KEY")
@@ -88,6 +102,413 @@ if (
     # Exit because search is fundamental here, unlike optional AI processing for fetch
     sys.exit(1)
 
+# --- Shared HTTP Client ---
+# Requests in flight per host; with HTTP/2 they share one connection
+HTTP_MAX_CONNECTIONS_PER_HOST = int(os.environ.get("MCP_WEB_MAX_CONNECTIONS_PER_HOST", "6"))
+# Connections open across all hosts
+HTTP_MAX_CONNECTIONS = int(os.environ.get("MCP_WEB_MAX_CONNECTIONS", "100"))
+# Idle connections kept alive for reuse, and for how many seconds
+HTTP_MAX_KEEPALIVE_CONNECTIONS = 20
+HTTP_KEEPALIVE_EXPIRY = 30.0
+
+try:
+    import h2  # noqa: F401  httpx negotiates HTTP/2 only when h2 is installed
+
+    HTTP2_AVAILABLE = True
+except ImportError:
+    HTTP2_AVAILABLE = False
+
+http_client: Optional[httpx.AsyncClient] = None
+host_semaphores: Dict[str, asyncio.Semaphore] = {}
+
+
+def get_http_client() -> httpx.AsyncClient:
+    """The client shared by fetch, crawl and search, created on first use"""
+    global http_client
+    if http_client is None or http_client.is_closed:
+        http_client = httpx.AsyncClient(
+            http2=HTTP2_AVAILABLE,
+            limits=httpx.Limits(
+                max_connections=HTTP_MAX_CONNECTIONS,
+                max_keepalive_connections=HTTP_MAX_KEEPALIVE_CONNECTIONS,
+                keepalive_expiry=HTTP_KEEPALIVE_EXPIRY,
+            ),
+            headers={"User-Agent": DEFAULT_USER_AGENT},
+            timeout=DEFAULT_TIMEOUT,
+        )
+    return http_client
+
+
+async def close_http_client():
+    global http_client
+    if http_client is not None:
+        await http_client.aclose()
+        http_client = None
+
+
+@asynccontextmanager
+async def host_slot(url: str):
+    """Hold one of the HTTP_MAX_CONNECTIONS_PER_HOST request slots for the host of url"""
+    host = urlsplit(url).netloc.lower()
+    semaphore = host_semaphores.get(host)
+    if semaphore is None:
+        semaphore = host_semaphores[host] = asyncio.Semaphore(HTTP_MAX_CONNECTIONS_PER_HOST)
+    async with semaphore:
+        yield
+
+
+@asynccontextmanager
+async def server_lifespan(server: FastMCP):
+    """Open the shared HTTP client with the server and close it and the HTML workers on shutdown"""
+    get_http_client()
+    try:
+        yield {}
+    finally:
+        await close_http_client()
+        close_html_pool()
+
+
+# Bytes of a response body read before the download is cut off
+FETCH_MAX_BYTES = int(os.environ.get("MCP_WEB_MAX_RESPONSE_BYTES", str(5 * 1024 * 1024)))
+# Bytes of an error page read for context
+ERROR_BODY_MAX_BYTES = 64 * 1024
+# Non-text/* media types that are fetched as text
+TEXT_MEDIA_TYPES = {
+    "application/json",
+    "application/xml",
+    "application/xhtml+xml",
+    "application/javascript",
+    "application/x-javascript",
+    "application/ecmascript",
+}
+
+
+def _is_text_content_type(content_type: str) -> bool:
+    """Whether a Content-Type is text worth downloading; a missing one is sniffed later"""
+    media_type = content_type.split(";")[0].strip().lower()
+    return (
+        not media_type
+        or media_type.startswith("text/")
+        or media_type.endswith(("+json", "+xml"))
+        or media_type in TEXT_MEDIA_TYPES
+    )
+
+
+async def _read_text(response, max_bytes: int) -> Tuple[str, bool]:
+    """
+    Decode a streamed body as it arrives, stopping after max_bytes.
+    Returns (text, truncated).
+    """
+    try:
+        decoder = codecs.getincrementaldecoder(response.charset_encoding or "utf-8")(errors="replace")
+    except LookupError:
+        decoder = codecs.getincrementaldecoder("utf-8")(errors="replace")
+    parts = []
+    received = 0
+    async for chunk in response.aiter_bytes():
+        if received + len(chunk) > max_bytes:
+            parts.append(decoder.decode(chunk[: max_bytes - received]))
+            return "".join(parts), True  # A split character at the cut is dropped
+        received += len(chunk)
+        parts.append(decoder.decode(chunk))
+    parts.append(decoder.decode(b"", final=True))
+    return "".join(parts), False
+
+
+# --- Response Cache ---
+# Directory for cached HTTP responses (set to an empty string to disable caching)
+CACHE_DIR = os.environ.get(
+    "MCP_WEB_CACHE_DIR",
+    os.path.join(os.environ.get("XDG_CACHE_HOME", os.path.expanduser("~/.cache")), "mcp-web"),
+)
+# Disk space the cache may use; the least recently used entries are evicted first
+CACHE_MAX_BYTES = int(os.environ.get("MCP_WEB_CACHE_MAX_BYTES", str(256 * 1024 * 1024)))
+# Upper bound on the heuristic lifetime of responses with only Last-Modified (RFC 9111 4.2.2)
+CACHE_HEURISTIC_MAX_SECONDS = 24 * 3600
+
+
+def _cache_control(headers) -> Dict[str, Optional[str]]:
+    """Cache-Control directives by lowercase name"""
+    directives = {}
+    for part in (headers.get("cache-control") or "").split(","):
+        name, _, value = part.strip().partition("=")
+        if name:
+            directives[name.lower()] = value.strip('"') or None
+    return directives
+
+
+def _http_date(value: Optional[str]) -> Optional[float]:
+    try:
+        return parsedate_to_datetime(value).timestamp() if value else None
+    except (TypeError, ValueError):
+        return None
+
+
+def _freshness_lifetime(headers, directives: Dict[str, Optional[str]]) -> float:
+    """Seconds a response stays fresh after it was generated (RFC 9111 4.2.1)"""
+    if "max-age" in directives:
+        try:
+            return max(int(directives["max-age"]), 0)
+        except (TypeError, ValueError):
+            return 0
+    date = _http_date(headers.get("date")) or time.time()
+    if headers.get("expires"):
+        expires = _http_date(headers.get("expires"))
+        return max(expires - date, 0) if expires else 0  # Invalid dates mean already expired
+    last_modified = _http_date(headers.get("last-modified"))
+    if last_modified and last_modified < date:
+        return min((date - last_modified) / 10, CACHE_HEURISTIC_MAX_SECONDS)
+    return 0
+
+
+def normalize_url(url: str) -> str:
+    """Cache key form of a URL: lowercase scheme and host, no default port or fragment"""
+    parts = urlsplit(url)
+    scheme = parts.scheme.lower()
+    host = (parts.hostname or "").lower()
+    if parts.port and (scheme, parts.port) not in (("http", 80), ("https", 443)):
+        host = f"{host}:{parts.port}"
+    if parts.username or parts.password:
+        host = f"{parts.username or ''}:{parts.password or ''}@{host}"
+    return urlunsplit((scheme, host, parts.path or "/", parts.query, ""))
+
+
+class ResponseCache:
+    """
+    On-disk cache of successful GET responses, keyed by normalized URL.
+
+    Each entry is <key>.json (status, headers, validators, freshness),
+    <key>.body (the decoded body) and, once a tool has converted the page,
+    <key>.md (its Markdown). Model responses are kept as <key>.json
+    alone, keyed by what was sent. Fresh entries are served without a request;
+    stale ones are revalidated with If-None-Match / If-Modified-Since.
+
+    The directory is scanned once, at startup; after that the total size and
+    the least recently used order are kept in memory and updated on every
+    write, use and eviction.
+    """
+
+    def __init__(self, directory: str, max_bytes: int):
+        self.directory = directory
+        self.max_bytes = max_bytes
+        # Maps key -> {suffix: bytes on disk}, least recently used first
+        self._lru: "OrderedDict[str, Dict[str, int]]" = OrderedDict()
+        self._size = 0
+        for _, key, sizes in sorted(self._scan()):
+            self._lru[key] = sizes
+            self._size += sum(sizes.values())
+
+    def key(self, url: str) -> str:
+        return hashlib.sha256(normalize_url(url).encode()).hexdigest()
+
+    def _path(self, key: str, suffix: str) -> str:
+        return os.path.join(self.directory, key[:2], key + suffix)
+
+    def load(self, key: str) -> Optional[Dict[str, Any]]:
+        """The stored entry with its body, or None"""
+        try:
+            with open(self._path(key, ".json"), "r", encoding="utf-8") as f:
+                entry = json.load(f)
+            with open(self._path(key, ".body"), "r", encoding="utf-8") as f:
+                entry["body"] = f.read()
+        except (OSError, ValueError):
+            return None
+        self._touch(key)
+        return entry
+
+    @staticmethod
+    def is_fresh(entry: Dict[str, Any]) -> bool:
+        if entry["no_cache"]:
+            return False
+        age = entry["initial_age"] + time.time() - entry["stored_at"]
+        return age < entry["lifetime"]
+
+    @staticmethod
+    def validators(entry: Dict[str, Any]) -> Dict[str, str]:
+        """Request headers that ask the server to answer 304 if the entry is current"""
+        headers = {}
+        if entry.get("etag"):
+            headers["If-None-Match"] = entry["etag"]
+        if entry.get("last_modified"):
+            headers["If-Modified-Since"] = entry["last_modified"]
+        return headers
+
+    def store(self, key: str, url: str, response, body: str, metadata: Dict[str, Any]) -> bool:
+        """Save a 200 response if its headers allow it; True when stored"""
+        headers = response.headers
+        directives = _cache_control(headers)
+        lifetime = _freshness_lifetime(headers, directives)
+        etag, last_modified = headers.get("etag"), headers.get("last-modified")
+        if (
+            response.status_code != 200
+            or "no-store" in directives
+            or (headers.get("vary") or "").strip() == "*"
+            or not (lifetime > 0 or etag or last_modified)
+        ):
+            return False
+        entry = {
+            "url": url,
+            "final_url": metadata.get("final_url", url),
+            "content_type": metadata.get("content_type", ""),
+            "headers": metadata.get("headers", {}),
+            "redirects": metadata.get("redirects", []),
+            "stored_at": time.time(),
+            "initial_age": self._age(headers),
+            "lifetime": lifetime,
+            "no_cache": "no-cache" in directives,
+            "etag": etag,
+            "last_modified": last_modified,
+        }
+        try:
+            os.makedirs(os.path.dirname(self._path(key, "")), exist_ok=True)
+            self._remove_file(key, ".md")  # Converted from the previous body
+            self._write(key, ".body", body)
+            self._write(key, ".json", json.dumps(entry))
+        except OSError as e:
+            print(f"Warning: could not cache {url}: {e}", file=sys.stderr)
+            return False
+        self._evict()
+        return True
+
+    def revalidated(self, key: str, entry: Dict[str, Any], headers) -> Dict[str, Any]:
+        """Refresh an entry after a 304, taking the updated headers it carried"""
+        directives = _cache_control(headers)
+        merged = {k.lower(): v for k, v in entry["headers"].items()}
+        merged.update({k.lower(): v for k, v in headers.items()})
+        entry.update(
+            {
+                "headers": merged,
+                "stored_at": time.time(),
+                "initial_age": self._age(headers),
+                "lifetime": _freshness_lifetime(merged, directives or _cache_control(merged)),
+                "no_cache": "no-cache" in (directives or _cache_control(merged)),
+                "etag": merged.get("etag"),
+                "last_modified": merged.get("last-modified"),
+            }
+        )
+        stored = {k: v for k, v in entry.items() if k != "body"}
+        try:
+            self._write(key, ".json", json.dumps(stored))
+        except OSError:
+            pass
+        return entry
+
+    def ai_result(self, key: str) -> Optional[str]:
+        """A stored model response, see _ai_cache_key"""
+        try:
+            with open(self._path(key, ".json"), "r", encoding="utf-8") as f:
+                result = json.load(f).get("ai_result")
+        except (OSError, ValueError):
+            return None
+        self._touch(key)
+        return result
+
+    def store_ai_result(self, key: str, model: str, result: str):
+        try:
+            os.makedirs(os.path.dirname(self._path(key, "")), exist_ok=True)
+            entry = {"model": model, "stored_at": time.time(), "ai_result": result}
+            self._write(key, ".json", json.dumps(entry))
+        except OSError as e:
+            print(f"Warning: could not cache AI result: {e}", file=sys.stderr)
+            return
+        self._evict()
+
+    def markdown(self, key: str) -> Optional[str]:
+        try:
+            with open(self._path(key, ".md"), "r", encoding="utf-8") as f:
+                return f.read()
+        except OSError:
+            return None
+
+    def store_markdown(self, key: str, markdown: str):
+        if ".json" not in self._lru.get(key, {}):
+            return  # Evicted or replaced meanwhile
+        try:
+            self._write(key, ".md", markdown)
+        except OSError:
+            return
+        self._evict()
+
+    @staticmethod
+    def _age(headers) -> float:
+        try:
+            return max(float(headers.get("age") or 0), 0)
+        except ValueError:
+            return 0
+
+    def _write(self, key: str, suffix: str, text: str):
+        """Replace a file atomically and account for its size"""
+        path = self._path(key, suffix)
+        data = text.encode("utf-8")
+        with open(path + ".tmp", "wb") as f:
+            f.write(data)
+        os.replace(path + ".tmp", path)
+        sizes = self._lru.setdefault(key, {})
+        self._size += len(data) - sizes.get(suffix, 0)
+        sizes[suffix] = len(data)
+        self._lru.move_to_end(key)
+
+    def _remove_file(self, key: str, suffix: str):
+        try:
+            os.unlink(self._path(key, suffix))
+        except FileNotFoundError:
+            pass
+        sizes = self._lru.get(key)
+        if sizes is not None:
+            self._size -= sizes.pop(suffix, 0)
+            if not sizes:
+                del self._lru[key]
+
+    def _touch(self, key: str):
+        """Mark an entry recently used, also on disk so the order survives a restart"""
+        if key in self._lru:
+            self._lru.move_to_end(key)
+        try:
+            os.utime(self._path(key, ".json"))
+        except OSError:
+            pass
+
+    def _scan(self) -> List[Tuple[float, str, Dict[str, int]]]:
+        """(last use, key, {suffix: bytes}) of every entry on disk"""
+        entries = []
+        try:
+            shards = list(os.scandir(self.directory))
+        except OSError:
+            return entries  # Created on first store
+        for shard in shards:
+            if not shard.is_dir():
+                continue
+            sizes: Dict[str, Dict[str, int]] = {}
+            used: Dict[str, float] = {}
+            for item in os.scandir(shard.path):
+                key, dot, suffix = item.name.partition(".")
+                try:
+                    stat = item.stat()
+                except OSError:
+                    continue
+                sizes.setdefault(key, {})[dot + suffix] = stat.st_size
+                if suffix == "json":
+                    used[key] = stat.st_mtime
+            entries.extend((used.get(key, 0), key, sizes[key]) for key in sizes)
+        return entries
+
+    def _evict(self):
+        """Drop least recently used entries once over max_bytes, down to 90% of it"""
+        if self._size <= self.max_bytes:
+            return
+        while self._lru and self._size > self.max_bytes * 0.9:
+            key, sizes = next(iter(self._lru.items()))
+            for suffix in list(sizes):
+                self._remove_file(key, suffix)
+
+
+response_cache = ResponseCache(CACHE_DIR, CACHE_MAX_BYTES) if CACHE_DIR else None
+
+
+# Create MCP server
+mcp = FastMCP("web-processing-server", instructions=MCP_INSTRUCTIONS, lifespan=server_lifespan)
+instrument(mcp, "web")
+
 # --- AI Agent System Prompt ---
 AI_AGENT_SYSTEM_PROMPT = """
 You are an expert web content processor and search result analyst. Your task is to analyze the provided content (which might be web page content in Markdown or search results) and follow the user's instructions precisely.
@@ -109,45 +530,221 @@ You will receive the content within `<content>` tags and the user's specific ins
 # --- Helper Functions ---
 
 
-def _extract_content_from_html(html: str, max_length: Optional[int] = None) -> str:
-    """Extract and convert HTML content to Markdown format, with optional truncation."""
+try:
+    import lxml  # noqa: F401  BeautifulSoup parses several times faster with lxml
+
+    HTML_PARSER = "lxml"
+except ImportError:
+    HTML_PARSER = "html.parser"
+
+# Markup with no readable content, removed before conversion to Markdown
+NON_CONTENT_TAGS = ["script", "style", "noscript", "template", "svg", "canvas", "iframe"]
+
+
+def _parse_html(
+    html: str,
+    markdown: bool = True,
+    selectors: Optional[List[str]] = None,
+    output_type: str = "markdown",
+    links: bool = False,
+) -> Dict[str, Any]:
+    """
+    Parse html once and derive everything asked for from the one DOM:
+    "links" (the href of every <a>), "elements" (the matches of CSS
+    selectors as HTML or Markdown, joined by rules) and "markdown" (the
+    page without NON_CONTENT_TAGS). Conversion errors are reported as
+    "<e>...</e>" strings, as _extract_content_from_html does.
+    """
+    result: Dict[str, Any] = {}
     if not html or not html.strip():
-        return "<e>Empty HTML content</e>"
+        if markdown:
+            result["markdown"] = "<e>Empty HTML content</e>"
+        if selectors:
+            result["elements"] = f"<e>No elements found matching selectors: {selectors}</e>"
+        if links:
+            result["links"] = []
+        return result
 
     try:
-        # Use heading_style=ATX for '#' style headings
-        content = markdownify.markdownify(html, heading_style=markdownify.ATX)
-        if max_length and len(content) > max_length:
-            content = (
-                content[:max_length]
-                + f"\n\n[Content truncated at {max_length} characters]"
-            )
-        return content
+        from bs4 import BeautifulSoup
+
+        soup = BeautifulSoup(html, HTML_PARSER)
     except Exception as e:
-        # Add more specific error logging if markdownify fails
-        print(f"Error during markdownify: {e}", file=sys.stderr)
-        # Fallback to basic text extraction if markdownify fails completely
+        # Without a DOM only whole-page conversion is possible
+        if selectors:
+            result["elements"] = (
+                "Error: 'beautifulsoup4' library is required for element extraction."
+                if isinstance(e, ImportError)
+                else f"Error extracting elements: {str(e)}"
+            )
+        if links:
+            result["links"] = []
+        if markdown:
+            try:
+                result["markdown"] = markdownify.markdownify(html, heading_style=markdownify.ATX)
+            except Exception as md_e:
+                result["markdown"] = f"<e>Failed to extract content from HTML: {str(md_e)}</e>"
+        return result
+
+    # Use heading_style=ATX for '#' style headings
+    converter = markdownify.MarkdownConverter(heading_style=markdownify.ATX)
+    if links:
+        result["links"] = [a_tag["href"] for a_tag in soup.find_all("a", href=True)]
+
+    if selectors:
         try:
-            from bs4 import BeautifulSoup
-
-            soup = BeautifulSoup(html, "html.parser")
-            text_content = soup.get_text(" ", strip=True)
-            if max_length and len(text_content) > max_length:
-                text_content = (
-                    text_content[:max_length]
-                    + f"\n\n[Content truncated at {max_length} characters]"
-                )
-            return (
+            extracted_parts = []
+            for selector in selectors:
+                for element in soup.select(selector):
+                    if output_type.lower() == "html":
+                        extracted_parts.append(str(element))
+                    else:  # Default to markdown/text
+                        try:
+                            extracted_parts.append(converter.convert_soup(element).strip("\n"))
+                        except Exception:
+                            extracted_parts.append(
+                                element.get_text(" ", strip=True)
+                            )  # Fallback to text
+            result["elements"] = "\n\n---\n\n".join(extracted_parts) or (
+                f"<e>No elements found matching selectors: {selectors}</e>"
+            )
+        except Exception as e:
+            result["elements"] = f"Error extracting elements: {str(e)}"
+
+    if markdown:
+        for tag in soup.find_all(NON_CONTENT_TAGS):
+            tag.decompose()
+        try:
+            result["markdown"] = converter.convert_soup(soup)
+        except Exception as e:
+            # Add more specific error logging if markdownify fails
+            print(f"Error during markdownify: {e}", file=sys.stderr)
+            # Fallback to basic text extraction if markdownify fails completely
+            try:
+                text_content = soup.get_text(" ", strip=True)
+            except Exception as bs_e:
+                text_content = ""
+                e = f"{e}. Fallback text extraction failed: {bs_e}"
+            result["markdown"] = (
                 text_content
-                if text_content
-                else f"<e>Failed to extract content from HTML, even as text: {str(e)}</e>"
+                or f"<e>Failed to extract content from HTML, even as text: {str(e)}</e>"
             )
-        except ImportError:
-            return f"<e>Failed to extract content from HTML: {str(e)}. BeautifulSoup not installed for fallback.</e>"
-        except Exception as bs_e:
-            return f"<e>Failed to extract content from HTML: {str(e)}. Fallback text extraction failed: {bs_e}</e>"
+    return result
+
+
+def _extract_content_from_html(html: str, max_length: Optional[int] = None) -> str:
+    """Extract and convert HTML content to Markdown format, with optional truncation."""
+    content = _parse_html(html)["markdown"]
+    if max_length and len(content) > max_length:
+        content = (
+            content[:max_length]
+            + f"\n\n[Content truncated at {max_length} characters]"
+        )
+    return content
+
+
+# --- HTML Conversion Pool ---
+# Worker processes converting HTML off the event loop (0: convert in a thread instead)
+HTML_WORKERS = int(os.environ.get("MCP_WEB_HTML_WORKERS", str(min(4, os.cpu_count() or 1))))
+# Pages smaller than this convert faster in-process than the round trip to a worker takes
+HTML_INLINE_BYTES = 16 * 1024
+
+html_pool: Optional[ProcessPoolExecutor] = None
+# Conversions submitted at once. Callers wait here rather than queueing page
+# copies in the pool, and a crawl page waiting here keeps its crawl slot, so
+# fetching slows down when conversion falls behind.
+html_slots = asyncio.Semaphore(max(HTML_WORKERS, 1) * 2)
+
+
+def get_html_pool() -> Optional[ProcessPoolExecutor]:
+    """The HTML worker pool, started on first use, or None when disabled"""
+    global html_pool
+    if html_pool is None and HTML_WORKERS > 0:
+        # Workers are started by a fork server: forking this multi-threaded
+        # process directly could copy locks held by other threads
+        methods = multiprocessing.get_all_start_methods()
+        context = multiprocessing.get_context("forkserver" if "forkserver" in methods else "spawn")
+        html_pool = ProcessPoolExecutor(max_workers=HTML_WORKERS, mp_context=context)
+    return html_pool
+
+
+def close_html_pool():
+    global html_pool
+    if html_pool is not None:
+        html_pool.shutdown(wait=False, cancel_futures=True)
+        html_pool = None
+
+
+@traced("convert")
+async def _run_html_job(func, html: str, *args) -> str:
+    """func(html, *args) in an HTML worker, or inline for small pages"""
+    if len(html) < HTML_INLINE_BYTES:
+        return func(html, *args)
+    async with html_slots:
+        pool = get_html_pool()
+        if pool is not None:
+            try:
+                return await asyncio.get_running_loop().run_in_executor(pool, func, html, *args)
+            except BrokenProcessPool:
+                # A worker died (e.g. killed for memory); start fresh ones next time
+                print("Warning: HTML worker pool broke, restarting it", file=sys.stderr)
+                close_html_pool()
+        return await asyncio.to_thread(func, html, *args)
 
 
+async def html_to_markdown(html: str, max_length: Optional[int] = None) -> str:
+    """_extract_content_from_html without blocking the event loop"""
+    return await _run_html_job(_extract_content_from_html, html, max_length)
+
+
+async def _parse_page(
+    content: str, metadata: Dict[str, Any], links: bool = False
+) -> Tuple[str, List[str]]:
+    """
+    The Markdown of a fetched page, and the href of each of its links when
+    asked for, from a single parse. The Markdown stored with the page's cache
+    entry is reused when the page came from or went into the cache.
+    """
+    key = metadata.get("cache_key")
+    markdown = response_cache.markdown(key) if key and response_cache else None
+    if markdown is None or links:
+        parsed = await _run_html_job(_parse_html, content, markdown is None, None, "markdown", links)
+        if markdown is None:
+            markdown = parsed["markdown"]
+            if key and response_cache and not markdown.startswith("<e>"):
+                response_cache.store_markdown(key, markdown)
+    return markdown, (parsed.get("links", []) if links else [])
+
+
+async def _page_markdown(content: str, metadata: Dict[str, Any], max_length: Optional[int] = None) -> str:
+    """_extract_content_from_html for a fetched page, see _parse_page"""
+    markdown, _ = await _parse_page(content, metadata)
+    if max_length and len(markdown) > max_length:
+        markdown = markdown[:max_length] + f"\n\n[Content truncated at {max_length} characters]"
+    return markdown
+
+
+def _cached_result(
+    entry: Dict[str, Any], key: str, metadata: Dict[str, Any], status: str
+) -> Tuple[Optional[str], Optional[str], int, Dict[str, Any]]:
+    """_fetch_url result for a response served from the cache"""
+    metadata.update(
+        {
+            "final_url": entry["final_url"],
+            "status_code": 200,
+            "content_type": entry["content_type"],
+            "headers": entry["headers"],
+            "elapsed": 0.0,
+            "redirects": entry["redirects"],
+            "size": len(entry["body"]),
+            "cache": status,
+            "cache_key": key,
+        }
+    )
+    return (entry["body"], entry["content_type"], 200, metadata)
+
+
+@traced("fetch")
 async def _fetch_url(
     url: str,
     timeout: int = DEFAULT_TIMEOUT,
@@ -155,13 +752,27 @@ async def _fetch_url(
     """
     Fetch the URL and return the content, content type, status code, and metadata.
     Returns (None, None, status, metadata) on error.
+
+    Responses are served from and stored in the response cache; metadata["cache"]
+    says whether this was a "hit", was "revalidated" with a 304 or a "miss".
     """
-    metadata = {"original_url": url, "error": None}
+    metadata = {"original_url": url, "error": None, "cache": "miss"}
     headers = {"User-Agent": DEFAULT_USER_AGENT}
 
     try:
-        async with httpx.AsyncClient(follow_redirects=True) as client:
-            response = await client.get(url, headers=headers, timeout=timeout)
+        key = response_cache.key(url) if response_cache else None
+        entry = response_cache.load(key) if key else None
+        if entry and response_cache.is_fresh(entry):
+            return _cached_result(entry, key, metadata, "hit")
+        if entry:
+            headers.update(response_cache.validators(entry))
+
+        async with host_slot(url), get_http_client().stream(
+            "GET", url, headers=headers, timeout=timeout, follow_redirects=True
+        ) as response:
+            if response.status_code == 304 and entry:
+                entry = response_cache.revalidated(key, entry, response.headers)
+                return _cached_result(entry, key, metadata, "revalidated")
 
             metadata.update(
                 {
@@ -183,7 +794,7 @@ async def _fetch_url(
                 )
                 # Try to get body for context, even on error
                 try:
-                    content = response.text
+                    content, _ = await _read_text(response, ERROR_BODY_MAX_BYTES)
                     metadata["size"] = len(content)
                 except Exception:
                     content = ""
@@ -195,10 +806,22 @@ async def _fetch_url(
                     metadata,
                 )
 
-            # Success case
-            content = response.text
+            # Binary downloads are refused before any of the body is read
             content_type = metadata["content_type"]
+            if not _is_text_content_type(content_type):
+                metadata["error"] = (
+                    f"Unsupported content type {content_type.split(';')[0]}: only text content is fetched"
+                )
+                return (None, content_type, 415, metadata)  # 415 Unsupported Media Type
+
+            # Success case
+            content, truncated = await _read_text(response, FETCH_MAX_BYTES)
             metadata["size"] = len(content)
+            add_bytes("fetched", len(content))
+            if truncated:
+                metadata["download_truncated"] = FETCH_MAX_BYTES  # Partial: never cached
+            elif key and response_cache.store(key, url, response, content, metadata):
+                metadata["cache_key"] = key
 
             return (content, content_type, response.status_code, metadata)
 
@@ -250,42 +873,15 @@ async def _process_web_content(
 
     # --- Basic Instruction Handling (Non-AI) ---
     processed_output = None
-    if "text/html" in content_type:
-        # Simplistic: try markdownify first
-        processed_output = _extract_content_from_html(content)
-
-    # --- Element Extraction (Requires BeautifulSoup) ---
     if extract_elements and "text/html" in content_type:
-        try:
-            from bs4 import BeautifulSoup
-
-            soup = BeautifulSoup(content, "html.parser")
-            extracted_parts = []
-            for selector in extract_elements:
-                elements = soup.select(selector)
-                for element in elements:
-                    if output_type.lower() == "html":
-                        extracted_parts.append(str(element))
-                    else:  # Default to markdown/text
-                        try:
-                            extracted_parts.append(
-                                markdownify.markdownify(
-                                    str(element), heading_style=markdownify.ATX
-                                )
-                            )
-                        except Exception:
-                            extracted_parts.append(
-                                element.get_text(" ", strip=True)
-                            )  # Fallback to text
-            processed_output = "\n\n---\n\n".join(extracted_parts)
-            if not processed_output:
-                processed_output = (
-                    f"<e>No elements found matching selectors: {extract_elements}</e>"
-                )
-        except ImportError:
-            return "Error: 'beautifulsoup4' library is required for element extraction."
-        except Exception as e:
-            return f"Error extracting elements: {str(e)}"
+        # --- Element Extraction (Requires BeautifulSoup) ---
+        parsed = await _run_html_job(
+            _parse_html, content, False, extract_elements, output_type
+        )
+        processed_output = parsed["elements"]
+    elif "text/html" in content_type:
+        # Simplistic: try markdownify first
+        processed_output = await html_to_markdown(content)
 
     # --- Default Processing based on output_type if no specific handler used ---
     if processed_output is None:
@@ -316,7 +912,7 @@ async def _process_web_content(
             if output_type_lower == "html":
                 processed_output = content
             else:
-                processed_output = _extract_content_from_html(
+                processed_output = await html_to_markdown(
                     content
                 )  # Default to markdown
         else:  # Plain text or other types
@@ -325,50 +921,201 @@ async def _process_web_content(
     return processed_output
 
 
+# --- Chunked AI Processing ---
+# Content longer than this is processed in chunks of at most this many characters
+AI_CHUNK_CHARS = min(
+    int(os.environ.get("MCP_WEB_AI_CHUNK_CHARS", "100000")), DEFAULT_AGENT_INPUT_MAX_LENGTH
+)
+# Chunks processed per request; content beyond them is dropped
+AI_MAX_CHUNKS = 64
+# Model requests in flight at once across all tools
+AI_MAX_CONCURRENT_CALLS = int(os.environ.get("MCP_WEB_AI_CONCURRENCY", "4"))
+# Retries of a rate-limited model request
+AI_MAX_RETRIES = 3
+# Boundaries content is split at, best first: pages, headings, paragraphs, lines
+AI_SPLIT_PATTERNS = [
+    re.compile(r"\n\n(?=--- (?:PAGE \d+|URL): )"),
+    re.compile(r"\n(?=#{1,2} )"),
+    re.compile(r"\n(?=#{3,6} )"),
+    re.compile(r"\n\n"),
+    re.compile(r"\n"),
+]
+
+AI_MAP_NOTE = (
+    "The content is part {part} of {parts} of a larger input. Apply the instructions to this part alone "
+    "and report everything in it that is relevant to them, in full detail; the results for all parts "
+    "will be merged afterwards. If nothing in this part is relevant, say so in one line."
+)
+AI_REDUCE_NOTE = (
+    "The content holds the results of applying the instructions below to consecutive parts of a larger "
+    "input, separated by '--- PART n ---' lines. Merge them into one answer to the instructions as if "
+    "written from the whole input: combine duplicates, keep every distinct detail and do not mention the "
+    "parts."
+)
+
+ai_slots = asyncio.Semaphore(AI_MAX_CONCURRENT_CALLS)
+ai_not_before = 0.0  # Monotonic time before which no model request starts, after a 429
+
+
+def _split_content(content: str, limit: int, patterns: Optional[List[re.Pattern]] = None) -> List[str]:
+    """Split content into chunks of at most limit characters at the best boundaries available"""
+    if len(content) <= limit:
+        return [content]
+    patterns = AI_SPLIT_PATTERNS if patterns is None else patterns
+    if not patterns:
+        return [content[i : i + limit] for i in range(0, len(content), limit)]
+    pieces = patterns[0].split(content)
+    chunks: List[str] = []
+    current = ""
+    for piece in pieces:
+        joined = f"{current}\n\n{piece}" if current else piece
+        if len(joined) <= limit:
+            current = joined
+            continue
+        if len(piece) <= limit:
+            chunks.append(current)
+            current = piece
+        else:
+            # Too long on its own: fill up the chunk at the next kind of boundary
+            *done, current = _split_content(joined, limit, patterns[1:])
+            chunks.extend(done)
+    if current:
+        chunks.append(current)
+    return chunks
+
+
+def _ai_cache_key(content: str, instructions: str, model: str, max_tokens: int) -> str:
+    digest = hashlib.sha256()
+    for part in ("ai", AI_AGENT_SYSTEM_PROMPT, model, str(max_tokens), instructions, content):
+        digest.update(part.encode("utf-8", "surrogatepass"))
+        digest.update(b"\0")
+    return digest.hexdigest()
+
+
+def _retry_after(error: Exception) -> float:
+    response = getattr(error, "response", None)
+    value = response.headers.get("retry-after") if response is not None else None
+    try:
+        return min(max(float(value), 0.5), 60.0) if value else 0
+    except ValueError:
+        return 0
+
+
+async def _complete(
+    content: str, instructions: str, model: str, max_tokens: int
+) -> Tuple[Optional[str], Optional[str]]:
+    """One cached model request. Returns (result, error_message)."""
+    global ai_not_before
+    key = _ai_cache_key(content, instructions, model, max_tokens)
+    cached = response_cache.ai_result(key) if response_cache else None
+    if cached is not None:
+        return cached, None
+
+    user_message = f"<content>\n{content}\n</content>\n\n<instructions>\n{instructions}\n</instructions>"
+
+    for attempt in range(AI_MAX_RETRIES + 1):
+        try:
+            async with ai_slots:
+                # Every caller holds off after a 429 instead of each finding out on its own
+                delay = ai_not_before - time.monotonic()
+                if delay > 0:
+                    await asyncio.sleep(delay)
+                with span("openai"):
+                    completion = await openai_client.chat.completions.create(
+                        model=model,
+                        messages=[
+                            {"role": "system", "content": AI_AGENT_SYSTEM_PROMPT},
+                            {"role": "user", "content": user_message},
+                        ],
+                        max_completion_tokens=max_tokens,
+                    )
+            result = completion.choices[0].message.content
+            result = result.strip() if result else ""
+            if response_cache and result:
+                response_cache.store_ai_result(key, model, result)
+            return result, None
+        except openai.APIError as e:
+            status_code = getattr(e, "status_code", None)
+            if status_code == 429 and attempt < AI_MAX_RETRIES:
+                backoff = _retry_after(e) or 2.0 ** (attempt + 1)
+                ai_not_before = max(ai_not_before, time.monotonic() + backoff)
+                print(f"OpenAI rate limit hit, retrying in {backoff:.1f}s", file=sys.stderr)
+                continue
+            error_msg = f"OpenAI API Error: {status_code} - {e.message}"
+            print(f"Error: {error_msg}", file=sys.stderr)
+            return None, error_msg
+        except Exception as e:
+            if "rate limit" in str(e).lower():
+                error_msg = f"OpenAI Error: Rate limit possibly exceeded. {str(e)}"
+            else:
+                error_msg = f"Error during OpenAI call: {str(e)}"
+            print(f"Error: {error_msg}", file=sys.stderr)
+            return None, error_msg
+
+
 async def _call_openai(
     content: str, instructions: str, model: str, max_tokens: int
 ) -> Tuple[Optional[str], Optional[str]]:
-    """Helper to call OpenAI API. Returns (result, error_message)."""
+    """
+    Helper to call OpenAI API. Returns (result, error_message).
+
+    Content longer than AI_CHUNK_CHARS is split at page and heading
+    boundaries. The instructions are applied to the chunks concurrently
+    (map) and the partial results merged by a further request (reduce),
+    repeated until they fit in one. Responses are cached by what was sent.
+    """
     if not openai_client:
         return None, "OpenAI client not initialized (missing API key or library)."
 
-    # Ensure content and instructions are not excessively long before sending
-    # This is a basic safety check, more sophisticated truncation might be needed
-    if len(content) > DEFAULT_AGENT_INPUT_MAX_LENGTH:  # Example limit
-        content = (
-            content[:DEFAULT_AGENT_INPUT_MAX_LENGTH]
-            + "\n\n[SYSTEM NOTE: Input content truncated due to length limit]"
-        )
+    chunks = _split_content(content, AI_CHUNK_CHARS)
+    if len(chunks) == 1:
+        return await _complete(content, instructions, model, max_tokens)
+
+    if len(chunks) > AI_MAX_CHUNKS:
         print(
-            "Warning: Truncating content sent to OpenAI due to length.", file=sys.stderr
+            f"Warning: Processing the first {AI_MAX_CHUNKS} of {len(chunks)} chunks of content sent to OpenAI.",
+            file=sys.stderr,
         )
-
-    user_message = f"<content>\n{content}\n</content>\n\n<instructions>\n{instructions}\n</instructions>"
-
-    try:
-        completion = await openai_client.chat.completions.create(
-            model=model,
-            messages=[
-                {"role": "system", "content": AI_AGENT_SYSTEM_PROMPT},
-                {"role": "user", "content": user_message},
-            ],
-            max_completion_tokens=max_tokens,
+        chunks = chunks[:AI_MAX_CHUNKS]
+        chunks[-1] += "\n\n[SYSTEM NOTE: Input content truncated due to length limit]"
+
+    # Map: each chunk on its own
+    results = await asyncio.gather(
+        *[
+            _complete(
+                chunk,
+                f"{AI_MAP_NOTE.format(part=i + 1, parts=len(chunks))}\n\n{instructions}",
+                model,
+                max_tokens,
+            )
+            for i, chunk in enumerate(chunks)
+        ]
+    )
+    errors = [error for _, error in results if error]
+    if errors:
+        return None, f"{len(errors)} of {len(chunks)} content chunks failed: {errors[0]}"
+    partials = [result for result, _ in results]
+
+    # Reduce: merge partial results, in rounds while they are too long for one request
+    reduce_instructions = f"{AI_REDUCE_NOTE}\n\n{instructions}"
+    while True:
+        sections = [f"--- PART {i + 1} ---\n\n{partial}" for i, partial in enumerate(partials)]
+        groups = _split_content("\n\n".join(sections), AI_CHUNK_CHARS, [re.compile(r"\n\n(?=--- PART \d+ ---)")])
+        results = await asyncio.gather(
+            *[_complete(group, reduce_instructions, model, max_tokens) for group in groups]
         )
-        result = completion.choices[0].message.content
-        return result.strip() if result else "", None
-    except openai.APIError as e:
-        error_msg = f"OpenAI API Error: {e.status_code} - {e.message}"
-        print(f"Error: {error_msg}", file=sys.stderr)
-        return None, error_msg
-    except Exception as e:
-        if "rate limit" in str(e).lower():
-            error_msg = f"OpenAI Error: Rate limit possibly exceeded. {str(e)}"
-        else:
-            error_msg = f"Error during OpenAI call: {str(e)}"
-        print(f"Error: {error_msg}", file=sys.stderr)
-        return None, error_msg
-
-
+        errors = [error for _, error in results if error]
+        if errors:
+            return None, f"Merging the results of {len(chunks)} content chunks failed: {errors[0]}"
+        partials = [result for result, _ in results]
+        if len(partials) == 1:
+            return partials[0], None
+        if len(groups) == len(sections):
+            # Merging did not shrink anything: return what there is rather than loop
+            return "\n\n".join(partials), None
+
+
+@traced("search")
 async def _call_brave_search(
     query: str,
     count: int = DEFAULT_SEARCH_COUNT,
@@ -398,8 +1145,8 @@ async def _call_brave_search(
     }
 
     try:
-        async with httpx.AsyncClient() as client:
-            response = await client.get(
+        async with host_slot(BRAVE_SEARCH_API_URL):
+            response = await get_http_client().get(
                 BRAVE_SEARCH_API_URL, params=params, headers=headers, timeout=timeout
             )
 
@@ -453,6 +1200,230 @@ async def _call_brave_search(
         return None, f"Unknown error during Brave search: {str(e)}"
 
 
+# --- Crawl Frontier ---
+# Pages fetched at once across all hosts during a crawl
+CRAWL_MAX_CONCURRENCY = int(os.environ.get("MCP_WEB_CRAWL_CONCURRENCY", "16"))
+# Requests per second started against one host unless robots.txt asks for less
+CRAWL_HOST_RATE = float(os.environ.get("MCP_WEB_CRAWL_HOST_RATE", "8"))
+# Longest robots.txt Crawl-delay or Retry-After honoured, in seconds
+CRAWL_MAX_DELAY = 30.0
+# Times a page answered with 429 or 503 is retried
+CRAWL_MAX_RETRIES = 2
+# Product token matched against robots.txt User-agent lines
+ROBOTS_USER_AGENT = DEFAULT_USER_AGENT.split("/")[0]
+
+
+class HostSchedule:
+    """
+    Politeness and concurrency for one host during a crawl.
+
+    A token bucket spaces out request starts (one per robots.txt
+    Crawl-delay, or CRAWL_HOST_RATE per second). Concurrency grows by
+    about one request per round of successes and shrinks when responses
+    slow down, time out or are throttled with 429/503.
+    """
+
+    def __init__(self, scheme: str, host: str):
+        self.scheme = scheme
+        self.host = host
+        self.queue: deque = deque()  # (url, depth, check_robots, attempt)
+        self.later: deque = deque()  # Links found on duplicate pages, fetched after the rest
+        self.in_flight = 0
+        self.max_concurrency = HTTP_MAX_CONNECTIONS_PER_HOST
+        self.limit = float(min(2, self.max_concurrency))
+        self.interval = 1 / CRAWL_HOST_RATE
+        self.burst = float(self.max_concurrency)
+        self.tokens = self.burst
+        self.refilled = time.monotonic()
+        self.not_before = 0.0  # Set from Retry-After
+        self.robots: Optional[RobotFileParser] = None
+        self.robots_state: Optional[str] = None  # None, "loading" or "ready"
+        self.min_latency: Optional[float] = None
+        self.latency: Optional[float] = None
+
+    def apply_robots(self, parser: Optional[RobotFileParser]):
+        self.robots = parser
+        self.robots_state = "ready"
+        if parser is None:
+            return
+        delay = parser.crawl_delay(ROBOTS_USER_AGENT)
+        rate = parser.request_rate(ROBOTS_USER_AGENT)
+        if rate and rate.requests:
+            delay = max(delay or 0, rate.seconds / rate.requests)
+        if delay:
+            # A crawl delay means one request at a time, that far apart
+            self.interval = min(float(delay), CRAWL_MAX_DELAY)
+            self.burst = self.tokens = 1.0
+            self.limit = self.max_concurrency = 1
+
+    def allowed(self, url: str) -> bool:
+        return self.robots is None or self.robots.can_fetch(ROBOTS_USER_AGENT, url)
+
+    def wait_time(self, now: float) -> float:
+        """Seconds until this host may start another request"""
+        self.tokens = min(self.burst, self.tokens + (now - self.refilled) / self.interval)
+        self.refilled = now
+        return max(self.not_before - now, (1 - self.tokens) * self.interval, 0)
+
+    def start(self):
+        self.tokens -= 1
+        self.in_flight += 1
+
+    def finished(self, status_code: int, latency: float, metadata: Dict[str, Any]):
+        """Adapt concurrency to how the host answered"""
+        self.in_flight -= 1
+        if metadata.get("cache") == "hit":
+            self.tokens = min(self.burst, self.tokens + 1)  # Served locally: no request was made
+            return
+        if status_code in (429, 503, 408):
+            self.limit = max(1.0, self.limit / 2)
+            retry_after = metadata.get("headers", {}).get("retry-after")
+            delay = _retry_after_seconds(retry_after) if retry_after else self.interval * 4
+            self.not_before = time.monotonic() + min(delay, CRAWL_MAX_DELAY)
+            return
+        if status_code >= 400:
+            return
+        self.min_latency = latency if self.min_latency is None else min(self.min_latency, latency)
+        self.latency = latency if self.latency is None else 0.8 * self.latency + 0.2 * latency
+        if self.latency > 2 * max(self.min_latency, 0.05):
+            self.limit = max(1.0, self.limit * 0.75)  # Slowing down under load
+        else:
+            self.limit = min(float(self.max_concurrency), self.limit + 1 / self.limit)
+
+
+def _retry_after_seconds(value: str) -> float:
+    try:
+        return max(float(value), 0)
+    except ValueError:
+        when = _http_date(value)
+        return max(when - time.time(), 0) if when else 0
+
+
+class CrawlFrontier:
+    """URLs waiting to be crawled, queued per host and handed out as each host allows"""
+
+    def __init__(self):
+        self.hosts: Dict[str, HostSchedule] = {}
+
+    def push(
+        self,
+        url: str,
+        depth: int,
+        check_robots: bool = True,
+        attempt: int = 0,
+        front: bool = False,
+        later: bool = False,
+    ):
+        parts = urlsplit(url)
+        host = self.hosts.get(parts.netloc.lower())
+        if host is None:
+            host = self.hosts[parts.netloc.lower()] = HostSchedule(parts.scheme, parts.netloc.lower())
+        entry = (url, depth, check_robots, attempt)
+        if later:
+            host.later.append(entry)
+        elif front:
+            host.queue.appendleft(entry)
+        else:
+            host.queue.append(entry)
+
+    @property
+    def pending(self) -> int:
+        return sum(len(host.queue) + len(host.later) for host in self.hosts.values())
+
+    def clear(self):
+        for host in self.hosts.values():
+            host.queue.clear()
+            host.later.clear()
+
+    def next_ready(self, now: float) -> Tuple[Optional[Tuple[HostSchedule, Optional[tuple]]], Optional[float]]:
+        """
+        ((host, entry), None) for a request that may start now, where entry is
+        None when the host's robots.txt must be loaded first, or (None, delay)
+        with the seconds until a host's rate limit allows one (None: no
+        host can start until a request in flight finishes).
+        """
+        soonest = None
+        for queue_name in ("queue", "later"):  # Deprioritized links only when nothing else can start
+            for host in self.hosts.values():
+                queue = getattr(host, queue_name)
+                if not queue or host.robots_state == "loading":
+                    continue
+                if host.robots_state is None:
+                    host.robots_state = "loading"
+                    return (host, None), None
+                if host.in_flight >= int(host.limit):
+                    continue
+                delay = host.wait_time(now)
+                if delay > 0:
+                    soonest = delay if soonest is None else min(soonest, delay)
+                    continue
+                host.start()
+                return (host, queue.popleft()), None
+        return None, soonest
+
+
+# Query parameters that only track where a visitor came from
+TRACKING_PARAMS = {"fbclid", "gclid", "dclid", "msclkid", "mc_cid", "mc_eid", "_ga", "ref", "ref_src"}
+# Pages whose SimHashes differ in at most this many of 64 bits are near-duplicates
+# (unrelated pages differ in about 32)
+SIMHASH_MAX_DISTANCE = 6
+SIMHASH_SHINGLE_WORDS = 3
+
+
+def canonical_crawl_url(url: str) -> str:
+    """normalize_url without tracking parameters and with the query sorted, for crawl dedup"""
+    parts = urlsplit(normalize_url(url))
+    query = sorted(
+        (name, value)
+        for name, value in parse_qsl(parts.query, keep_blank_values=True)
+        if name.lower() not in TRACKING_PARAMS and not name.lower().startswith("utm_")
+    )
+    return urlunsplit(parts._replace(query=urlencode(query)))
+
+
+def simhash(text: str) -> int:
+    """64-bit SimHash of the word shingles of text"""
+    words = re.findall(r"\w+", text.lower())
+    if len(words) < SIMHASH_SHINGLE_WORDS:
+        words += [""] * (SIMHASH_SHINGLE_WORDS - len(words))
+    bits = [
+        format(
+            int.from_bytes(
+                hashlib.blake2b(" ".join(words[i : i + SIMHASH_SHINGLE_WORDS]).encode(), digest_size=8).digest(),
+                "big",
+            ),
+            "064b",
+        )
+        for i in range(len(words) - SIMHASH_SHINGLE_WORDS + 1)
+    ]
+    # Each bit is set when it is set in more than half of the shingle hashes
+    half = len(bits) / 2
+    return int("".join("1" if column.count("1") > half else "0" for column in zip(*bits)), 2)
+
+
+def _near_duplicate(fingerprint: int, seen: List[Tuple[int, str]]) -> Optional[str]:
+    """URL of an earlier page whose fingerprint is within SIMHASH_MAX_DISTANCE bits"""
+    for other, url in seen:
+        if bin(fingerprint ^ other).count("1") <= SIMHASH_MAX_DISTANCE:
+            return url
+    return None
+
+
+async def _load_robots(host: HostSchedule, timeout: int):
+    """Fetch and apply a host's robots.txt; an unreachable or missing one allows everything"""
+    parser = None
+    try:
+        content, _, status_code, _ = await _fetch_url(
+            f"{host.scheme}://{host.host}/robots.txt", timeout=min(timeout, 10)
+        )
+        if status_code == 200 and content:
+            parser = RobotFileParser()
+            parser.parse(content.splitlines())
+    except Exception as e:
+        print(f"Warning: could not read robots.txt for {host.host}: {e}", file=sys.stderr)
+    host.apply_robots(parser)
+
+
 async def _crawl_url(
     url: str,
     max_pages: int = 5,
@@ -467,7 +1438,7 @@ async def _crawl_url(
         Tuple containing (list of page content dicts, crawl metadata dict)
     """
     try:
-        from bs4 import BeautifulSoup
+        import bs4  # noqa: F401  Links are found by _parse_html
         from urllib.parse import urljoin, urlparse
     except ImportError:
         raise ImportError("'beautifulsoup4' library is required for crawling.")
@@ -510,12 +1481,12 @@ async def _crawl_url(
             base_domain.lower().strip()
         )  # Ensure start domain is always allowed
 
-    # BFS crawl state
-    queue = asyncio.Queue()
-    queue.put_nowait((url, 0))  # (url, depth)
-    crawled = {url}  # Set to track visited URLs
+    # Crawl state
+    frontier = CrawlFrontier()
+    frontier.push(url, 0, check_robots=False)  # The start page was asked for explicitly
+    crawled = {canonical_crawl_url(url)}  # Set to track visited URLs
     pages_content = []  # List to store page content
-    processed_count = 0  # Count pages actually processed for content
+    fingerprints: List[Tuple[int, str]] = []  # (SimHash, URL) of each page kept
 
     crawl_metadata = {
         "start_url": url,
@@ -524,215 +1495,183 @@ async def _crawl_url(
         "max_depth_reached": 0,
         "duration_seconds": 0,
         "allowed_domains": list(_allowed_domains),
+        "skipped_by_robots": 0,
+        "duplicates_skipped": 0,  # Pages whose content nearly matched an earlier page
         "errors": [],
     }
 
-    # Limit concurrent fetches to avoid overwhelming sites or hitting local limits
-    MAX_CONCURRENT_FETCHES = 5
-    semaphore = asyncio.Semaphore(MAX_CONCURRENT_FETCHES)
-
-    async def worker(worker_id):
-        nonlocal processed_count
-        while True:
-            try:
-                # Wait if queue is empty for a moment, then check conditions
-                try:
-                    current_url, depth = await asyncio.wait_for(
-                        queue.get(), timeout=1.0
-                    )
-                except asyncio.TimeoutError:
-                    # Check if crawl should stop
-                    if queue.empty() and processed_count >= max_pages:
-                        break  # All done
-                    if (datetime.now() - start_time).total_seconds() > (
-                        max_pages * timeout + 60
-                    ):  # Overall timeout
-                        print(f"Worker {worker_id}: Crawl timed out.", file=sys.stderr)
-                        crawl_metadata["errors"].append(
-                            "Overall crawl timeout exceeded"
-                        )
-                        break
-                    continue  # Queue was temporarily empty, try again
-
-                crawl_metadata["pages_crawled"] += 1
-                crawl_metadata["max_depth_reached"] = max(
-                    crawl_metadata["max_depth_reached"], depth
-                )
+    async def crawl_page(host: HostSchedule, current_url: str, depth: int, attempt: int):
+        crawl_metadata["pages_crawled"] += 1
+        crawl_metadata["max_depth_reached"] = max(
+            crawl_metadata["max_depth_reached"], depth
+        )
+        print(
+            f"Crawling [Depth:{depth}, Count:{len(pages_content)}/{max_pages}]: {current_url}",
+            file=sys.stderr,
+        )
 
-                # Check if max_pages limit is already reached by other workers
-                if processed_count >= max_pages:
-                    queue.task_done()
-                    continue  # Stop processing new URLs
+        started = time.monotonic()
+        try:
+            content, content_type, status_code, metadata = await _fetch_url(
+                current_url,
+                timeout=timeout,
+            )
+        except BaseException:
+            host.finished(0, time.monotonic() - started, {})
+            raise
+        host.finished(status_code, time.monotonic() - started, metadata)
+
+        if status_code in (429, 503) and "headers" in metadata and attempt < CRAWL_MAX_RETRIES:
+            # Throttled: try again once the host's backoff has passed
+            crawl_metadata["pages_crawled"] -= 1
+            frontier.push(current_url, depth, False, attempt + 1, front=True)
+            return
+
+        page_data = {
+            "url": metadata.get("final_url", current_url),
+            "depth": depth,
+            "status_code": status_code,
+            "content_type": content_type,
+            "content": None,  # Initialize content as None
+            "error": metadata.get("error"),
+        }
 
-                print(
-                    f"Worker {worker_id}: Crawling [Depth:{depth}, Count:{processed_count}/{max_pages}]: {current_url}",
-                    file=sys.stderr,
+        if status_code < 400 and content is not None:
+            processed_content = ""
+            links: List[str] = []
+            if content_type and "text/html" in content_type:
+                # One parse gives the Markdown (with _extract_content_from_html's
+                # errors/fallbacks) and the links to follow.
+                # Don't apply max_length here, apply later if needed by consumer
+                processed_content, links = await _parse_page(
+                    content, metadata, links=depth < max_depth
                 )
-
-                async with semaphore:  # Limit concurrency
-                    # Fetch page using the passed user_agent
-                    content, content_type, status_code, metadata = await _fetch_url(
-                        current_url,
-                        timeout=timeout,
+                if "<e>Failed to extract content" in processed_content:
+                    page_data["error"] = (
+                        processed_content  # Store extraction error
                     )
-
-                page_data = {
-                    "url": metadata.get("final_url", current_url),
-                    "depth": depth,
-                    "status_code": status_code,
-                    "content_type": content_type,
-                    "content": None,  # Initialize content as None
-                    "error": metadata.get("error"),
-                }
-
-                if status_code < 400 and content is not None:
-                    processed_content = ""
-                    if content_type and "text/html" in content_type:
-                        # Use _extract_content_from_html (which handles errors/fallbacks)
-                        # Don't apply max_length here, apply later if needed by consumer
-                        processed_content = _extract_content_from_html(content)
-                        if "<e>Failed to extract content" in processed_content:
-                            page_data["error"] = (
-                                processed_content  # Store extraction error
-                            )
-                            print(
-                                f"Warning: Failed to extract content for {page_data['url']}: {processed_content}",
-                                file=sys.stderr,
-                            )
-                            processed_content = (
-                                ""  # Don't include error message as content
-                            )
-                        elif not processed_content.strip():
-                            print(
-                                f"Note: Extracted empty content from {page_data['url']}",
-                                file=sys.stderr,
-                            )
-
-                    elif content_type and "text/" in content_type:
-                        processed_content = content  # Store raw text
-                    # Add handling for JSON, XML etc. if needed here
-                    # else: Ignore non-text/html content for now? Or store raw?
-                    #    processed_content = f"[Non-HTML/Text Content Type: {content_type}]"
-
-                    if processed_content and processed_content.strip():
-                        page_data["content"] = processed_content
-                        pages_content.append(page_data)
-                        processed_count += (
-                            1  # Increment only if content was successfully processed
-                        )
-
-                    # Find and queue links only if successful fetch and content is HTML
-                    # And depth/page limits not reached
-                    if (
-                        depth < max_depth
-                        and content_type
-                        and "text/html" in content_type
-                        and processed_count < max_pages
-                    ):
-                        try:
-                            soup = BeautifulSoup(content, "html.parser")
-                            links_found = 0
-                            for a_tag in soup.find_all("a", href=True):
-                                # Check page limit inside loop to avoid adding too many tasks
-                                if processed_count + queue.qsize() >= max_pages:
-                                    break
-
-                                href = a_tag["href"]
-                                try:
-                                    absolute_url = urljoin(current_url, href)
-                                    parsed_link = urlparse(absolute_url)
-
-                                    # Clean URL (remove fragment)
-                                    clean_url = parsed_link._replace(
-                                        fragment=""
-                                    ).geturl()
-
-                                    # Basic validation and filtering
-                                    if (
-                                        parsed_link.scheme in ("http", "https")
-                                        and parsed_link.netloc  # Has domain
-                                        and parsed_link.netloc.lower().strip()
-                                        in _allowed_domains
-                                        and clean_url not in crawled
-                                    ):
-                                        # Check queue size relative to max_pages more carefully
-                                        # Estimate remaining capacity needed
-                                        if len(crawled) < max_pages:
-                                            crawled.add(clean_url)
-                                            await queue.put((clean_url, depth + 1))
-                                            links_found += 1
-
-                                except Exception:
-                                    # Don't log every minor link error unless debugging
-                                    # print(f"Worker {worker_id}: Skipping link '{href}' due to parsing error: {link_e}", file=sys.stderr)
-                                    pass  # Ignore invalid links silently
-                            # print(f"Worker {worker_id}: Found {links_found} new valid links on {current_url}", file=sys.stderr)
-
-                        except Exception as parse_e:
-                            err_msg = (
-                                f"Could not parse links on {current_url}: {parse_e}"
-                            )
-                            page_data["error"] = (
-                                f"{page_data.get('error', '')} | {err_msg}"
-                                if page_data.get("error")
-                                else err_msg
-                            )
-                            print(f"Warning: {err_msg}", file=sys.stderr)
-                else:
-                    # Record error from fetch
-                    err_msg = (
-                        page_data["error"] or f"Fetch failed with status {status_code}"
+                    print(
+                        f"Warning: Failed to extract content for {page_data['url']}: {processed_content}",
+                        file=sys.stderr,
+                    )
+                    processed_content = (
+                        ""  # Don't include error message as content
                     )
-                    crawl_metadata["errors"].append(f"{page_data['url']}: {err_msg}")
+                elif not processed_content.strip():
                     print(
-                        f"Worker {worker_id}: Failed ({status_code}) {current_url} - {err_msg}",
+                        f"Note: Extracted empty content from {page_data['url']}",
                         file=sys.stderr,
                     )
-                    # Optionally add page_data with error to pages_content?
-                    # pages_content.append(page_data) # If you want to include failed pages
 
-                queue.task_done()
+            elif content_type and "text/" in content_type:
+                processed_content = content  # Store raw text
+            # Add handling for JSON, XML etc. if needed here
+
+            duplicate_of = None
+            if processed_content and processed_content.strip() and len(pages_content) < max_pages:
+                # Print views, mirrors and the like are dropped by content fingerprint
+                fingerprint = await _run_html_job(simhash, processed_content)
+                duplicate_of = _near_duplicate(fingerprint, fingerprints)
+                if duplicate_of:
+                    crawl_metadata["duplicates_skipped"] += 1
+                    print(
+                        f"Note: Skipping {page_data['url']}, a near-duplicate of {duplicate_of}",
+                        file=sys.stderr,
+                    )
+                else:
+                    fingerprints.append((fingerprint, page_data["url"]))
+                    page_data["content"] = processed_content
+                    pages_content.append(page_data)
+
+            # Queue links only while depth/page limits are not reached
+            if depth < max_depth and len(pages_content) < max_pages:
+                for href in links:
+                    # Never queue more pages than the crawl may fetch; duplicates did not use up any
+                    if len(crawled) - crawl_metadata["duplicates_skipped"] >= max_pages:
+                        break
+
+                    try:
+                        absolute_url = urljoin(current_url, href)
+                        parsed_link = urlparse(absolute_url)
+
+                        # Clean URL (remove fragment)
+                        clean_url = parsed_link._replace(fragment="").geturl()
+
+                        # Basic validation and filtering
+                        if (
+                            parsed_link.scheme in ("http", "https")
+                            and parsed_link.netloc  # Has domain
+                            and parsed_link.netloc.lower().strip()
+                            in _allowed_domains
+                            and canonical_crawl_url(clean_url) not in crawled
+                        ):
+                            crawled.add(canonical_crawl_url(clean_url))
+                            # Links on a duplicate page likely lead to more duplicates
+                            frontier.push(clean_url, depth + 1, later=duplicate_of is not None)
+
+                    except Exception:
+                        pass  # Ignore invalid links silently
+        else:
+            # Record error from fetch
+            err_msg = (
+                page_data["error"] or f"Fetch failed with status {status_code}"
+            )
+            crawl_metadata["errors"].append(f"{page_data['url']}: {err_msg}")
+            print(
+                f"Failed ({status_code}) {current_url} - {err_msg}",
+                file=sys.stderr,
+            )
 
-            except asyncio.CancelledError:
-                print(f"Worker {worker_id} cancelled.", file=sys.stderr)
+    async def run_job(host: HostSchedule, entry: Optional[tuple]):
+        if entry is None:
+            await _load_robots(host, timeout)
+            return
+        current_url, depth, _, attempt = entry
+        try:
+            await crawl_page(host, current_url, depth, attempt)
+        except Exception as e:
+            print(f"Error in crawler for {current_url}: {e}", file=sys.stderr)
+            import traceback
+
+            traceback.print_exc(file=sys.stderr)
+
+    # Start pages as their hosts allow, and stop as soon as nothing is left to do
+    deadline = time.monotonic() + max_pages * timeout + 60  # Safety net for stalled hosts
+    running: set = set()
+    while True:
+        if len(pages_content) >= max_pages:
+            frontier.clear()  # Enough pages; let the requests in flight finish
+        delay = None
+        while len(running) < CRAWL_MAX_CONCURRENCY:
+            job, delay = frontier.next_ready(time.monotonic())
+            if job is None:
                 break
-            except Exception as e:
-                # Log unexpected worker errors
-                worker_error_url = "UnknownURL"
-                try:
-                    worker_error_url = current_url  # Try to get URL if defined
-                except NameError:
-                    pass
-                print(
-                    f"Error in crawler worker {worker_id} for {worker_error_url}: {e}",
-                    file=sys.stderr,
-                )
-                import traceback
+            host, entry = job
+            if entry is not None and entry[2] and not host.allowed(entry[0]):
+                host.in_flight -= 1  # Never requested
+                host.tokens += 1
+                crawl_metadata["skipped_by_robots"] += 1
+                continue
+            running.add(asyncio.create_task(run_job(host, entry)))
+
+        if not running and not frontier.pending:
+            break
+        remaining = deadline - time.monotonic()
+        if remaining <= 0:
+            print("Crawl timed out.", file=sys.stderr)
+            crawl_metadata["errors"].append("Overall crawl timeout exceeded")
+            break
+        wait = remaining if delay is None else min(delay, remaining)
+        if running:
+            done, running = await asyncio.wait(
+                running, timeout=wait, return_when=asyncio.FIRST_COMPLETED
+            )
+        else:
+            await asyncio.sleep(wait)  # Every queued host is waiting out its rate limit
 
-                traceback.print_exc(file=sys.stderr)
-                try:
-                    queue.task_done()  # Ensure task_done is called even on unexpected error
-                except ValueError:  # Might happen if task_done called twice
-                    pass
-                # Decide if worker should stop or continue
-                break  # Stop worker on unexpected error
-
-    # --- Start and manage workers ---
-    worker_tasks = []
-    num_workers = MAX_CONCURRENT_FETCHES
-    for i in range(num_workers):
-        task = asyncio.create_task(worker(i))
-        worker_tasks.append(task)
-
-    # Wait for queue to be processed
-    await queue.join()
-
-    # Cancel any workers that might still be waiting (e.g., on queue.get timeout)
-    for task in worker_tasks:
+    for task in running:
         task.cancel()
-
-    # Wait for tasks to finish cancellation
-    await asyncio.gather(*worker_tasks, return_exceptions=True)
+    await asyncio.gather(*running, return_exceptions=True)
 
     # Update final metadata
     crawl_metadata["duration_seconds"] = (datetime.now() - start_time).total_seconds()
@@ -815,8 +1754,8 @@ async def fetch_urls_and_process(
             processed_content = ""
             format_lower = preprocess_to_format.lower()
             if "text/html" in (content_type or "") and format_lower != "html":
-                processed_content = _extract_content_from_html(
-                    content, max_length=max_length
+                processed_content = await _page_markdown(
+                    content, metadata, max_length=max_length
                 )
                 if "<e>Failed to extract content" in processed_content:
                     # Log the error but maybe proceed with raw text if possible?
@@ -1010,6 +1949,9 @@ async def crawl_url_and_process(
             f"- Pages Crawled Attempted: {crawl_metadata.get('pages_crawled', 'N/A')}"
         )
         output_parts.append(f"- Pages With Content Processed: {len(content_urls)}")
+        output_parts.append(
+            f"- Near-Duplicate Pages Skipped: {crawl_metadata.get('duplicates_skipped', 0)}"
+        )
         output_parts.append(
             f"- Max Depth Reached: {crawl_metadata.get('max_depth_reached', 'N/A')}"
         )
@@ -1190,11 +2132,16 @@ async def fetch_url(
 
     # Handle truncation notice separately
     original_size = metadata.get("size", len(content))  # Use metadata size if available
+    if metadata.get("download_truncated"):
+        original_size = f"over {original_size}"  # The download itself was cut off
     truncated = False
     if max_length > 0 and len(content) > max_length:  # Check max_length > 0
         content = content[:max_length]
         truncated = True
+        metadata.pop("cache_key", None)  # The cached Markdown is of the whole page
         truncation_notice = f"\n\n[Content truncated at {max_length} characters. Original size: {original_size} chars]"
+    elif metadata.get("download_truncated"):
+        truncation_notice = f"\n\n[Download stopped at {metadata['download_truncated']} bytes. Content is incomplete]"
     else:
         truncation_notice = ""
 
@@ -1213,12 +2160,14 @@ async def fetch_url(
             "metadata": {  # Include selected metadata
                 "elapsed_seconds": metadata.get("elapsed"),
                 "redirect_history": metadata.get("redirects", []),
+                "cache": metadata.get("cache"),
+                "download_truncated_at_bytes": metadata.get("download_truncated"),
             },
         }
         if "text/html" in (content_type or ""):
             # Provide both markdown and raw (truncated) html snippet
-            output_data["markdown_content"] = _extract_content_from_html(
-                content
+            output_data["markdown_content"] = await _page_markdown(
+                content, metadata
             )  # No length limit here, content is already truncated
             output_data["raw_html_snippet"] = content  # Use already truncated content
         elif "application/json" in (content_type or ""):
@@ -1246,7 +2195,7 @@ async def fetch_url(
             "markdown",
             "text",
         ]:  # Treat text request same as markdown for HTML
-            extracted = _extract_content_from_html(content)
+            extracted = await _page_markdown(content, metadata)
             if "<e>Failed to extract content" in extracted:
                 return (
                     f"Error processing HTML for {url}: Could not convert to Markdown/Text. Raw HTML snippet:\n{content[:1000]}..."
@@ -1254,7 +2203,7 @@ async def fetch_url(
                 )
             return extracted + truncation_notice
         else:  # Default to markdown for unknown types from HTML
-            extracted = _extract_content_from_html(content)
+            extracted = await _page_markdown(content, metadata)
             if "<e>Failed to extract content" in extracted:
                 return (
                     f"Error processing HTML for {url}: Could not convert to Markdown. Raw HTML snippet:\n{content[:1000]}..."
@@ -1320,6 +2269,9 @@ async def crawl_website(
         output_parts.append(
             f"- Pages With Content Extracted: {crawl_metadata.get('pages_with_content', 'N/A')}"
         )
+        output_parts.append(
+            f"- Near-Duplicate Pages Skipped: {crawl_metadata.get('duplicates_skipped', 0)}"
+        )
         output_parts.append(
             f"- Max Depth Reached: {crawl_metadata.get('max_depth_reached', 'N/A')}"
         )
@@ -1408,5 +2360,7 @@ if __name__ == "__main__":
             "Warning: OpenAI client not initialized. AI-powered tools (`fetch_and_process_*`) will return errors.",
             file=sys.stderr,
         )
+    if METRICS_PORT:
+        start_metrics_server(int(METRICS_PORT))
     print("Web Processing MCP Server running", file=sys.stderr)
     mcp.run()